@@ -0,0 +1,50 @@
+#include "sim_udp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+uint8_t  sim_udp_buf[SIM_UDP_BUF_SIZE];
+uint16_t sim_udp_buf_idx = 0;
+uint32_t sim_udp_nb_bytes = 0;
+uint32_t sim_udp_nb_datagrams = 0;
+
+static int sim_udp_fd = -1;
+static struct sockaddr_in sim_udp_addr;
+
+static bool_t sim_udp_open(void) {
+  sim_udp_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sim_udp_fd < 0) {
+    perror("sim_udp socket");
+    return FALSE;
+  }
+  memset(&sim_udp_addr, 0, sizeof(sim_udp_addr));
+  sim_udp_addr.sin_family = AF_INET;
+  sim_udp_addr.sin_port = htons(SIM_UDP_PORT);
+  sim_udp_addr.sin_addr.s_addr = inet_addr(SIM_UDP_HOST);
+  return TRUE;
+}
+
+void sim_udp_flush(void) {
+  if (sim_udp_buf_idx == 0)
+    return;
+  if (sim_udp_fd >= 0 || sim_udp_open()) {
+    if (sendto(sim_udp_fd, sim_udp_buf, sim_udp_buf_idx, 0,
+               (struct sockaddr*)&sim_udp_addr, sizeof(sim_udp_addr)) == sim_udp_buf_idx) {
+      sim_udp_nb_bytes += sim_udp_buf_idx;
+      sim_udp_nb_datagrams++;
+    }
+  }
+  sim_udp_buf_idx = 0;
+}
+
+void sim_udp_close(void) {
+  sim_udp_flush();
+  if (sim_udp_fd >= 0) {
+    close(sim_udp_fd);
+    sim_udp_fd = -1;
+  }
+}
@@ -0,0 +1,45 @@
+/** \file sim_udp.h
+ * \brief Binary downlink for simulated aircraft over UDP
+ *
+ * Device for pprz_transport : frames are packed back to back in a
+ * datagram sent to SIM_UDP_HOST:SIM_UDP_PORT when it is full or when
+ * sim_udp_flush() is called ( by the simulator, every display period
+ * of simulated time and at the end of a batch run ).
+ * Decoded on the ground by "link -udp -udp_port SIM_UDP_PORT", which
+ * demultiplexes any number of aircraft on the same port.
+ */
+
+#ifndef SIM_UDP_H
+#define SIM_UDP_H
+
+#include <inttypes.h>
+#include "std.h"
+
+#ifndef SIM_UDP_HOST
+#define SIM_UDP_HOST "127.0.0.1"
+#endif
+
+#ifndef SIM_UDP_PORT
+#define SIM_UDP_PORT 4242
+#endif
+
+/* fits an ethernet frame */
+#define SIM_UDP_BUF_SIZE 1472
+
+extern uint8_t  sim_udp_buf[SIM_UDP_BUF_SIZE];
+extern uint16_t sim_udp_buf_idx;
+extern uint32_t sim_udp_nb_bytes;
+extern uint32_t sim_udp_nb_datagrams;
+
+extern void sim_udp_flush(void);
+/* flushes, then closes the socket, opened again by the next flush */
+extern void sim_udp_close(void);
+
+#define SimUdpCheckFreeSpace(_x) \
+  (sim_udp_buf_idx + (_x) <= SIM_UDP_BUF_SIZE || (sim_udp_flush(), (_x) <= SIM_UDP_BUF_SIZE))
+
+#define SimUdpTransmit(_x) { sim_udp_buf[sim_udp_buf_idx++] = (_x); }
+
+#define SimUdpSendMessage() {}
+
+#endif /* SIM_UDP_H */
@@ -42,7 +42,11 @@
 #include "sim_uart.h"
 #include "pprz_transport.h"
 #include "xbee.h"
-#else /* SIM_UART */
+#elif defined SIM_UDP
+/** binary pprz frames over UDP, for many simulated aircraft on one host */
+#include "sim_udp.h"
+#include "pprz_transport.h"
+#else /* !SIM_UART && !SIM_UDP */
 /** Software In The Loop simulation uses IVY bus directly as the transport layer */
 #include "ivy_transport.h"
 #endif
@@ -20,7 +20,6 @@
 #define DATALINK_PORT 4243
 
 static void dl_handle_msg(struct DownlinkTransport *tp);
-static inline int checked_read(int fd, char *buf, size_t len);
 static void on_datalink_event(int fd, short event __attribute__((unused)), void *arg);
 
 struct OveroGcsCom gcs_com;
@@ -36,30 +35,16 @@ void gcs_com_init(void) {
 }
 
 void gcs_com_periodic(void) {
+  while (udp_transport_pop_msg(gcs_com.udp_transport, gcs_com.my_dl_buffer, GCS_COM_DL_BUF_SIZE))
+    dl_handle_msg(gcs_com.udp_transport);
   if (gcs_com.udp_transport->Periodic)
     gcs_com.udp_transport->Periodic(gcs_com.udp_transport->impl);
 }
 
 
-static void on_datalink_event(int fd, short event __attribute__((unused)), void *arg) {
-
-  char buf[255];
-  int bytes_read;
-  bytes_read = checked_read(fd, buf, sizeof(buf) - 1);
+static void on_datalink_event(int fd __attribute__((unused)), short event __attribute__((unused)), void *arg) {
   struct DownlinkTransport *tp = (struct DownlinkTransport *) arg;
-  struct udp_transport *udp_impl = tp->impl;
-  //printf("on datalink event: %d bytes\n",bytes_read);
-  int i = 0;
-  while (i<bytes_read) {
-    parse_udp_dl(udp_impl, buf[i]);
-    i++;
-    if (udp_impl->udp_dl_msg_received) {
-      memcpy(gcs_com.my_dl_buffer, udp_impl->udp_dl_payload, udp_impl->udp_dl_payload_len);
-      dl_handle_msg(tp);
-      udp_impl->udp_dl_msg_received = FALSE;
-    }
-  }
-
+  udp_transport_receive(tp);
 }
 
 #define IdOfMsg(x) (x[1])
@@ -89,17 +74,3 @@ static void dl_handle_msg(struct DownlinkTransport *tp) {
 
 }
 
-
-static inline int checked_read(int fd, char *buf, size_t len)
-{
-  int bytes = read(fd, buf, len);
-
-  if (bytes == 0) {
-    fprintf(stderr, "Connection closed\n");
-  } else if (bytes == -1) {
-    perror("read");
-  }
-  return bytes;
-}
-
-
@@ -21,7 +21,7 @@ uint8_t telemetry_mode_Main_DefaultChannel;
 #define PERIODIC_SEND_DL_VALUE(_chan) PeriodicSendDlValue(_chan)
 
 static void on_datalink_event(int fd, short event __attribute__((unused)), void *arg);
-static void on_datalink_message(void);
+static void on_datalink_message(uint8_t *payload);
 
 uint8_t fms_gs_com_init(const char* gs_host, uint16_t gs_port,
 			       uint16_t datalink_port, uint8_t broadcast) {
@@ -37,41 +37,35 @@ uint8_t fms_gs_com_init(const char* gs_host, uint16_t gs_port,
 
 void fms_gs_com_periodic(void) {
 
+  /* the uplink frames received since the last cycle */
+  static uint8_t payload[UDP_DL_PAYLOAD_LEN] __attribute__ ((aligned));
+  while (udp_transport_pop_msg(fms_gs_com.udp_transport, payload, sizeof(payload)))
+    on_datalink_message(payload);
+
   PeriodicSendMain(fms_gs_com.udp_transport);
 
-  RunOnceEvery(10, {fms_gs_com.udp_transport->Periodic(fms_gs_com.udp_transport->impl);});
+  /* sends what is due, the transport keeps the datagrams under their deadline */
+  fms_gs_com.udp_transport->Periodic(fms_gs_com.udp_transport->impl);
 
 }
 
 
-static void on_datalink_event(int fd, short event __attribute__((unused)), void *arg) {
-  char buf[512];
-  int bytes_read = read(fd, buf, 512);
-  uint16_t i = 0;
-  struct udp_transport *tp = fms_gs_com.udp_transport->impl;
-  while (i<bytes_read) {
-    parse_udp_dl(tp, buf[i]);
-    if (tp->udp_dl_msg_received) {
-      on_datalink_message();
-      tp->udp_dl_msg_received = FALSE;
-    }
-    i++;
-  }
-
+static void on_datalink_event(int fd __attribute__((unused)), short event __attribute__((unused)),
+                              void *arg __attribute__((unused))) {
+  udp_transport_receive(fms_gs_com.udp_transport);
 }
 
-static void on_datalink_message(void) {
+static void on_datalink_message(uint8_t *payload) {
 
-  struct udp_transport *tp = fms_gs_com.udp_transport->impl;
-  uint8_t msg_id = tp->udp_dl_payload[1];
+  uint8_t msg_id = payload[1];
 
   switch (msg_id) {
   case  DL_PING:
     DOWNLINK_SEND_PONG(fms_gs_com.udp_transport);
     break;
   case DL_SETTING :  {
-    uint8_t i = DL_SETTING_index(tp->udp_dl_payload);
-    float var = DL_SETTING_value(tp->udp_dl_payload);
+    uint8_t i = DL_SETTING_index(payload);
+    float var = DL_SETTING_value(payload);
     DlSetting(i, var);
     DOWNLINK_SEND_DL_VALUE(fms_gs_com.udp_transport, &i, &var);
   }
@@ -1,8 +1,13 @@
+#define _GNU_SOURCE
+
 #include "fms_network.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "fms_debug.h"
 
@@ -34,6 +39,8 @@ struct FmsNetwork* network_new(const char* str_ip_out, const int port_out, const
   me->addr_in.sin_addr.s_addr = htonl(INADDR_ANY);
 
   bind(me->socket_in, (struct sockaddr *)&me->addr_in, sizeof(me->addr_in));
+  /* drained until empty from the event loop */
+  fcntl(me->socket_in, F_SETFL, fcntl(me->socket_in, F_GETFL) | O_NONBLOCK);
 
   return me;
 
@@ -47,3 +54,92 @@ int network_write(struct FmsNetwork* me, char* buf, int len) {
   }
   return len;
 }
+
+#ifndef FMS_NETWORK_MAX_BATCH
+#define FMS_NETWORK_MAX_BATCH 16
+#endif
+
+int network_write_multi(struct FmsNetwork* me, char* const bufs[], const int lens[], int nb) {
+  int sent = 0;
+#ifndef FMS_NETWORK_NO_SENDMMSG
+  static int have_sendmmsg = 1;
+  struct mmsghdr msgs[FMS_NETWORK_MAX_BATCH];
+  struct iovec iovs[FMS_NETWORK_MAX_BATCH];
+  while (have_sendmmsg && sent < nb) {
+    int n = nb - sent < FMS_NETWORK_MAX_BATCH ? nb - sent : FMS_NETWORK_MAX_BATCH;
+    for (int i = 0; i < n; i++) {
+      iovs[i].iov_base = bufs[sent + i];
+      iovs[i].iov_len = lens[sent + i];
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_name = &me->addr_out;
+      msgs[i].msg_hdr.msg_namelen = sizeof(me->addr_out);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int ret = sendmmsg(me->socket_out, msgs, n, MSG_DONTWAIT);
+    if (ret == -1 && errno == ENOSYS) {
+      /* older kernel : one datagram at a time */
+      have_sendmmsg = 0;
+      break;
+    }
+    if (ret != n) {
+      TRACE(TRACE_ERROR, "error sending to network %d of %d\n", ret, n);
+      return sent + (ret > 0 ? ret : 0);
+    }
+    sent += n;
+  }
+#endif
+  for (; sent < nb; sent++) {
+    ssize_t byte_written = sendto(me->socket_out, bufs[sent], lens[sent], MSG_DONTWAIT,
+                                  (struct sockaddr*)&me->addr_out, sizeof(me->addr_out));
+    if (byte_written != lens[sent]) {
+      TRACE(TRACE_ERROR, "error sending to network %d\n", (int)byte_written);
+      break;
+    }
+  }
+  return sent;
+}
+
+int network_read_multi(struct FmsNetwork* me, char* const bufs[], int size, int lens[], int nb) {
+  int received = 0;
+#ifndef FMS_NETWORK_NO_SENDMMSG
+  static int have_recvmmsg = 1;
+  if (have_recvmmsg) {
+    struct mmsghdr msgs[FMS_NETWORK_MAX_BATCH];
+    struct iovec iovs[FMS_NETWORK_MAX_BATCH];
+    int n = nb < FMS_NETWORK_MAX_BATCH ? nb : FMS_NETWORK_MAX_BATCH;
+    for (int i = 0; i < n; i++) {
+      iovs[i].iov_base = bufs[i];
+      iovs[i].iov_len = size;
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int ret = recvmmsg(me->socket_in, msgs, n, MSG_DONTWAIT, NULL);
+    if (ret >= 0) {
+      for (int i = 0; i < ret; i++)
+        lens[i] = msgs[i].msg_len;
+      return ret;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    if (errno != ENOSYS) {
+      TRACE(TRACE_ERROR, "error reading from network %d\n", errno);
+      return -1;
+    }
+    /* older kernel : one datagram at a time */
+    have_recvmmsg = 0;
+  }
+#endif
+  for (; received < nb; received++) {
+    ssize_t bytes = recv(me->socket_in, bufs[received], size, MSG_DONTWAIT);
+    if (bytes == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      TRACE(TRACE_ERROR, "error reading from network %d\n", errno);
+      return received ? received : -1;
+    }
+    lens[received] = bytes;
+  }
+  return received;
+}
@@ -17,6 +17,12 @@ struct FmsNetwork {
 
 extern struct FmsNetwork* network_new(const char* str_ip_out, const int port_out, const int port_in, const int broadcast);
 extern int network_write(struct FmsNetwork* me, char* buf, int len);
+/* sends nb datagrams, with one system call where the kernel has sendmmsg,
+   returns the number of datagrams sent */
+extern int network_write_multi(struct FmsNetwork* me, char* const bufs[], const int lens[], int nb);
+/* receives up to nb datagrams without blocking, bufs[i] holding size bytes,
+   lens[i] set to the length of each, returns the number received, -1 on error */
+extern int network_read_multi(struct FmsNetwork* me, char* const bufs[], int size, int lens[], int nb);
 
 #endif /* FMS_NETWORK_H */
 
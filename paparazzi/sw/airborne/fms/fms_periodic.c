@@ -24,49 +24,89 @@
 
 #include "fms_periodic.h"
 
-#include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <sched.h>
 #include <time.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/timerfd.h>
+#include <event.h>
 
 #include "fms_debug.h"
 
-static void fms_periodic_run(void);
-//static void fms_periodic_delete(void);
+/*
+ * SCHED_FIFO priority of the whole process: the periodic handler shares
+ * it with every network and datalink callback of the event loop.  Keep it
+ * below the SPI and kernel threads; the timerfd deadlines give the timing.
+ * Set per program from the airframe, e.g. ap.CFLAGS += -DFMS_PERIODIC_PRIORITY=60
+ */
+#ifndef FMS_PERIODIC_PRIORITY
+#define FMS_PERIODIC_PRIORITY 49
+#endif
+
+#define NS_PER_SEC         1000000000
+#define PERIODIC_DT_NSEC  (NS_PER_SEC/(FMS_PERIODIC_FREQ))
+
+static void on_periodic_event(int fd, short event, void *arg);
+static void hist_add(uint32_t* hist, uint32_t* max, int64_t ns);
 
 struct FmsPeriodic {
-  pid_t ap_pid;
+  int timer_fd;
+  struct event timer_event;
+  void (*handler)(int);
+  /* deadline of the next cycle and start of the last one, in ns */
+  int64_t next;
+  int64_t last_start;
 };
 
+static struct FmsPeriodic fms_periodic;
+struct FmsPeriodicStats fms_periodic_stats;
+
+static inline int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
 
 int fms_periodic_init(void(*periodic_handler)(int) ) {
 
-  pid_t my_pid = fork();
-  if (my_pid == -1) {
-    TRACE(TRACE_ERROR,"fms_periodic : unable to fork : %s (%d)\n", strerror(errno), errno);
+  memset(&fms_periodic_stats, 0, sizeof(fms_periodic_stats));
+  fms_periodic.handler = periodic_handler;
+
+  fms_periodic.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (fms_periodic.timer_fd == -1) {
+    TRACE(TRACE_ERROR,"fms_periodic : unable to create timer : %s (%d)\n", strerror(errno), errno);
     return -1;
   }
-  /* child process                 */
-  else if  (my_pid == 0) {
-    fms_periodic_run();
+
+  /* absolute deadlines : the period does not drift with the wake up delays */
+  fms_periodic.next = now_ns() + PERIODIC_DT_NSEC;
+  fms_periodic.last_start = 0;
+  struct itimerspec spec;
+  spec.it_value.tv_sec  = fms_periodic.next / NS_PER_SEC;
+  spec.it_value.tv_nsec = fms_periodic.next % NS_PER_SEC;
+  spec.it_interval.tv_sec  = 0;
+  spec.it_interval.tv_nsec = PERIODIC_DT_NSEC;
+  if (timerfd_settime(fms_periodic.timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) == -1) {
+    TRACE(TRACE_ERROR,"fms_periodic : unable to start timer : %s (%d)\n", strerror(errno), errno);
+    close(fms_periodic.timer_fd);
+    return -1;
   }
-  /* succesful fork parent process */
 
-  /* install signal handler */
-  struct sigaction my_sigaction = {.sa_handler = periodic_handler };
-  if (sigaction(SIGUSR1, &my_sigaction, NULL)) {
-    TRACE(TRACE_ERROR,"fms_periodic : unable to install signal handler : %s (%d)\n", strerror(errno), errno);
+  event_set(&fms_periodic.timer_event, fms_periodic.timer_fd, EV_READ | EV_PERSIST,
+            on_periodic_event, NULL);
+  if (event_add(&fms_periodic.timer_event, NULL) == -1) {
+    TRACE(TRACE_ERROR,"fms_periodic : unable to add timer event : %s (%d)\n", strerror(errno), errno);
+    close(fms_periodic.timer_fd);
     return -1;
   }
 
-  /* set main process priority */
+  /* the process runs the periodic task itself now, at the priority it always had */
   struct sched_param param;
-  param.sched_priority = 49;
+  param.sched_priority = FMS_PERIODIC_PRIORITY;
   if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
     TRACE(TRACE_ERROR,"fms_periodic : hs sched_setscheduler failed : %s (%d)\n", strerror(errno), errno);
   }
@@ -74,37 +114,61 @@ int fms_periodic_init(void(*periodic_handler)(int) ) {
   return 0;
 }
 
-//static void fms_periodic_delete(void) {
-//
-//}
 
+static void on_periodic_event(int fd, short event __attribute__ ((unused)),
+                              void *arg __attribute__ ((unused))) {
 
-#define NS_PER_SEC         1000000000
-#define PERIODIC_DT_NSEC  (NS_PER_SEC/(FMS_PERIODIC_FREQ))
+  uint64_t expirations;
+  if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+    return;
 
-static void fms_periodic_run(void) {
+  int64_t start = now_ns();
+  struct FmsPeriodicStats* s = &fms_periodic_stats;
 
-  struct sched_param param;
-  param.sched_priority = 95;
-  if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
-    TRACE(TRACE_ERROR,"fms_periodic : hs sched_setscheduler failed : %s (%d)\n", strerror(errno), errno);
-  }
+  /* the deadline we are serving is the last one that expired */
+  int64_t deadline = fms_periodic.next + (int64_t)(expirations - 1) * PERIODIC_DT_NSEC;
+  fms_periodic.next = deadline + PERIODIC_DT_NSEC;
+  s->nb_overruns += expirations - 1;
+  hist_add(s->latency_hist, &s->latency_max_us, start - deadline);
+  if (fms_periodic.last_start)
+    hist_add(s->jitter_hist, &s->jitter_max_us,
+             llabs(start - fms_periodic.last_start - PERIODIC_DT_NSEC));
+  fms_periodic.last_start = start;
 
-  pid_t father_pid = getppid();
+  fms_periodic.handler(0);
 
-  struct timespec periodic_next;
-  clock_gettime(CLOCK_MONOTONIC, &periodic_next);
+  int64_t run = now_ns() - start;
+  hist_add(s->run_hist, &s->run_max_us, run);
+  if (run > PERIODIC_DT_NSEC)
+    s->nb_late++;
+  s->nb_cycles++;
+}
 
-  while (1) {
-    periodic_next.tv_nsec += PERIODIC_DT_NSEC;
-    while (periodic_next.tv_nsec > NS_PER_SEC) {
-      periodic_next.tv_nsec -= NS_PER_SEC;
-      periodic_next.tv_sec++;
-    }
-    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &periodic_next, NULL);
-    kill(father_pid, SIGUSR1);
-  }
 
-  _exit(EXIT_SUCCESS);
+static void hist_add(uint32_t* hist, uint32_t* max, int64_t ns) {
+  uint32_t us = ns > 0 ? ns / 1000 : 0;
+  int bucket = 0;
+  while (us >> bucket && bucket < FMS_PERIODIC_HIST_SIZE - 1)
+    bucket++;
+  hist[bucket]++;
+  if (us > *max)
+    *max = us;
+}
 
+
+void fms_periodic_print_stats(FILE* out) {
+
+  struct FmsPeriodicStats* s = &fms_periodic_stats;
+  fprintf(out, "periodic %d Hz : %u cycles, %u overruns, %u late\n",
+          FMS_PERIODIC_FREQ, s->nb_cycles, s->nb_overruns, s->nb_late);
+  fprintf(out, "max latency %u us, jitter %u us, run %u us\n",
+          s->latency_max_us, s->jitter_max_us, s->run_max_us);
+  fprintf(out, "%10s %10s %10s %10s\n", "us <", "latency", "jitter", "run");
+  for (int i = 0; i < FMS_PERIODIC_HIST_SIZE; i++) {
+    if (i < FMS_PERIODIC_HIST_SIZE - 1)
+      fprintf(out, "%10u", 1u << i);
+    else
+      fprintf(out, "%10s", "inf");
+    fprintf(out, " %10u %10u %10u\n", s->latency_hist[i], s->jitter_hist[i], s->run_hist[i]);
+  }
 }
@@ -26,6 +26,43 @@
 #ifndef FMS_PERIODIC_H
 #define FMS_PERIODIC_H
 
-extern int fms_periodic_init( void(*periodic_handler)(int) );
+#include <inttypes.h>
+#include <stdio.h>
+
+/*
+ * Periodic executor: a timerfd armed on absolute CLOCK_MONOTONIC
+ * deadlines, FMS_PERIODIC_FREQ times a second, is watched by the libevent
+ * loop of the process, which calls the handler in its own context
+ * (no signal, no second process).  event_init() must have been called
+ * before fms_periodic_init() and the handler runs once event_dispatch()
+ * is entered.  The handler argument is kept for compatibility and is 0.
+ * fms_periodic_init() moves the process to SCHED_FIFO at
+ * FMS_PERIODIC_PRIORITY, 49 unless the airframe sets it.
+ */
+
+/* log2 buckets in microseconds : [0,1[, [1,2[, [2,4[, ... and above */
+#define FMS_PERIODIC_HIST_SIZE 16
+
+struct FmsPeriodicStats {
+  uint32_t nb_cycles;
+  /* deadlines that went by without the handler being run */
+  uint32_t nb_overruns;
+  /* cycles whose handler outlasted the period */
+  uint32_t nb_late;
+  /* wake up delay after the deadline */
+  uint32_t latency_max_us;
+  uint32_t latency_hist[FMS_PERIODIC_HIST_SIZE];
+  /* distance of the interval between two cycles to the period */
+  uint32_t jitter_max_us;
+  uint32_t jitter_hist[FMS_PERIODIC_HIST_SIZE];
+  /* time spent in the handler */
+  uint32_t run_max_us;
+  uint32_t run_hist[FMS_PERIODIC_HIST_SIZE];
+};
+
+extern struct FmsPeriodicStats fms_periodic_stats;
+
+extern int  fms_periodic_init( void(*periodic_handler)(int) );
+extern void fms_periodic_print_stats(FILE* out);
 
 #endif /* FMS_PERIODIC_H */
@@ -0,0 +1,384 @@
+/*
+ * $Id$
+ *
+ * Copyright (C) 2010 The Paparazzi Team
+ *
+ * This file is part of paparazzi.
+ *
+ * paparazzi is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * paparazzi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with paparazzi; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "fms_shm_stream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "fms_debug.h"
+
+/* the ring starts on a cache line */
+#define RING_OFFSET 64
+#define RECORD_HEADER_LEN 8
+#define RECORD_LEN(_len) ((RECORD_HEADER_LEN + (_len) + 3) & ~3)
+
+static void on_accept(int fd, short event, void *arg);
+static void on_client_event(int fd, short event, void *arg);
+static void drop_client(struct FmsShmStreamWriter* w, int i);
+
+static void socket_path(char* path, size_t size, const char* name) {
+  snprintf(path, size, "/tmp/%s.sock", name);
+}
+
+
+/*
+ * Writer
+ */
+
+int fms_shm_stream_writer_open(struct FmsShmStreamWriter* w, const char* name) {
+
+  char shm_name[40];
+  snprintf(w->name, sizeof(w->name), "%s", name);
+  snprintf(shm_name, sizeof(shm_name), "/%s", name);
+  for (int i = 0; i < FMS_SHM_STREAM_MAX_CLIENTS; i++)
+    w->clients[i].fd = -1;
+  w->listen_fd = -1;
+  w->header = NULL;
+
+  shm_unlink(shm_name);
+  int fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd == -1 || ftruncate(fd, RING_OFFSET + FMS_SHM_STREAM_SIZE) == -1) {
+    TRACE(TRACE_ERROR, "fms_shm_stream : unable to create %s : %s (%d)\n", shm_name, strerror(errno), errno);
+    if (fd != -1)
+      close(fd);
+    return -1;
+  }
+  void* mem = mmap(NULL, RING_OFFSET + FMS_SHM_STREAM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    TRACE(TRACE_ERROR, "fms_shm_stream : unable to map %s : %s (%d)\n", shm_name, strerror(errno), errno);
+    return -1;
+  }
+  w->header = mem;
+  w->ring = (uint8_t*)mem + RING_OFFSET;
+  w->header->size = FMS_SHM_STREAM_SIZE;
+  w->header->head = w->header->reserve = 0;
+  w->header->nb_msgs = 0;
+  w->notified = 0;
+  __atomic_store_n(&w->header->magic, FMS_SHM_STREAM_MAGIC, __ATOMIC_RELEASE);
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  socket_path(addr.sun_path, sizeof(addr.sun_path), name);
+  unlink(addr.sun_path);
+  w->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (w->listen_fd == -1 ||
+      bind(w->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(w->listen_fd, FMS_SHM_STREAM_MAX_CLIENTS) == -1) {
+    TRACE(TRACE_ERROR, "fms_shm_stream : unable to listen on %s : %s (%d)\n", addr.sun_path, strerror(errno), errno);
+    if (w->listen_fd != -1)
+      close(w->listen_fd);
+    w->listen_fd = -1;
+    fms_shm_stream_writer_close(w);
+    return -1;
+  }
+  fcntl(w->listen_fd, F_SETFL, fcntl(w->listen_fd, F_GETFL) | O_NONBLOCK);
+  event_set(&w->listen_event, w->listen_fd, EV_READ | EV_PERSIST, on_accept, w);
+  event_add(&w->listen_event, NULL);
+
+  return 0;
+}
+
+void fms_shm_stream_writer_close(struct FmsShmStreamWriter* w) {
+
+  char name[48];
+  for (int i = 0; i < FMS_SHM_STREAM_MAX_CLIENTS; i++)
+    if (w->clients[i].fd != -1)
+      drop_client(w, i);
+  if (w->listen_fd != -1) {
+    event_del(&w->listen_event);
+    close(w->listen_fd);
+    w->listen_fd = -1;
+  }
+  socket_path(name, sizeof(name), w->name);
+  unlink(name);
+  snprintf(name, sizeof(name), "/%s", w->name);
+  shm_unlink(name);
+  if (w->header) {
+    munmap(w->header, RING_OFFSET + FMS_SHM_STREAM_SIZE);
+    w->header = NULL;
+  }
+}
+
+void fms_shm_stream_write(struct FmsShmStreamWriter* w, uint8_t msg_id,
+                          const uint8_t* data, uint16_t len) {
+
+  const uint32_t mask = FMS_SHM_STREAM_SIZE - 1;
+  if (RECORD_LEN(len) > FMS_SHM_STREAM_SIZE / 2)
+    return;
+  uint64_t head = w->header->head;
+  uint32_t pos = head & mask;
+  /* records do not wrap around : pad up to the end of the ring */
+  uint32_t pad = FMS_SHM_STREAM_SIZE - pos < RECORD_LEN(len) ? FMS_SHM_STREAM_SIZE - pos : 0;
+  uint64_t end = head + pad + RECORD_LEN(len);
+
+  /* readers must know what is about to be overwritten before it is */
+  __atomic_store_n(&w->header->reserve, end, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  struct FmsShmStreamRecord* rec;
+  if (pad) {
+    rec = (struct FmsShmStreamRecord*)(w->ring + pos);
+    rec->len = FMS_SHM_STREAM_PAD;
+    pos = 0;
+  }
+  rec = (struct FmsShmStreamRecord*)(w->ring + pos);
+  rec->len = len;
+  rec->msg_id = msg_id;
+  rec->flags = 0;
+  rec->seq = w->header->nb_msgs;
+  memcpy(rec->data, data, len);
+
+  w->header->nb_msgs++;
+  __atomic_store_n(&w->header->head, end, __ATOMIC_RELEASE);
+}
+
+void fms_shm_stream_notify(struct FmsShmStreamWriter* w) {
+
+  uint64_t head = w->header->head;
+  if (head == w->notified)
+    return;
+  w->notified = head;
+  const uint64_t one = 1;
+  for (int i = 0; i < FMS_SHM_STREAM_MAX_CLIENTS; i++)
+    if (w->clients[i].fd != -1 &&
+        write(w->clients[i].event_fd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+      drop_client(w, i);
+}
+
+static void on_accept(int fd, short event __attribute__ ((unused)), void *arg) {
+
+  struct FmsShmStreamWriter* w = arg;
+  int conn = accept(fd, NULL, NULL);
+  if (conn == -1)
+    return;
+  int i = 0;
+  while (i < FMS_SHM_STREAM_MAX_CLIENTS && w->clients[i].fd != -1)
+    i++;
+  int event_fd = i < FMS_SHM_STREAM_MAX_CLIENTS ? eventfd(0, EFD_NONBLOCK) : -1;
+  if (event_fd == -1) {
+    TRACE(TRACE_ERROR, "fms_shm_stream : %s refusing a client\n", w->name);
+    close(conn);
+    return;
+  }
+
+  /* hand the eventfd over */
+  char byte = 0;
+  struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &event_fd, sizeof(int));
+  if (sendmsg(conn, &msg, MSG_NOSIGNAL) != 1) {
+    close(event_fd);
+    close(conn);
+    return;
+  }
+
+  w->clients[i].fd = conn;
+  w->clients[i].event_fd = event_fd;
+  event_set(&w->clients[i].event, conn, EV_READ | EV_PERSIST, on_client_event, w);
+  event_add(&w->clients[i].event, NULL);
+}
+
+/* readers send nothing : this is their hang up */
+static void on_client_event(int fd, short event __attribute__ ((unused)), void *arg) {
+
+  struct FmsShmStreamWriter* w = arg;
+  char buf[16];
+  if (read(fd, buf, sizeof(buf)) > 0)
+    return;
+  for (int i = 0; i < FMS_SHM_STREAM_MAX_CLIENTS; i++)
+    if (w->clients[i].fd == fd)
+      drop_client(w, i);
+}
+
+static void drop_client(struct FmsShmStreamWriter* w, int i) {
+  event_del(&w->clients[i].event);
+  close(w->clients[i].fd);
+  close(w->clients[i].event_fd);
+  w->clients[i].fd = -1;
+}
+
+
+/*
+ * Reader
+ */
+
+int fms_shm_stream_reader_open(struct FmsShmStreamReader* r, const char* name) {
+
+  char shm_name[40];
+  snprintf(shm_name, sizeof(shm_name), "/%s", name);
+  r->header = NULL;
+  r->fd = r->event_fd = -1;
+
+  int fd = shm_open(shm_name, O_RDONLY, 0);
+  if (fd == -1)
+    return -1;
+  struct stat st;
+  void* mem = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= RING_OFFSET + FMS_SHM_STREAM_SIZE)
+    mem = mmap(NULL, RING_OFFSET + FMS_SHM_STREAM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    return -1;
+  r->header = mem;
+  r->ring = (const uint8_t*)mem + RING_OFFSET;
+  if (__atomic_load_n(&r->header->magic, __ATOMIC_ACQUIRE) != FMS_SHM_STREAM_MAGIC ||
+      r->header->size != FMS_SHM_STREAM_SIZE)
+    goto error;
+
+  /* the writer answers from its event loop : do not wait for it here */
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  socket_path(addr.sun_path, sizeof(addr.sun_path), name);
+  r->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (r->fd == -1 ||
+      fcntl(r->fd, F_SETFL, fcntl(r->fd, F_GETFL) | O_NONBLOCK) == -1 ||
+      connect(r->fd, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+    goto error;
+  return 0;
+
+ error:
+  fms_shm_stream_reader_close(r);
+  return -1;
+}
+
+void fms_shm_stream_reader_close(struct FmsShmStreamReader* r) {
+  if (r->event_fd != -1)
+    close(r->event_fd);
+  if (r->fd != -1)
+    close(r->fd);
+  if (r->header)
+    munmap((void*)r->header, RING_OFFSET + FMS_SHM_STREAM_SIZE);
+  r->header = NULL;
+  r->fd = r->event_fd = -1;
+}
+
+int fms_shm_stream_reader_handle(struct FmsShmStreamReader* r) {
+
+  char buf[16];
+  struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n = recvmsg(r->fd, &msg, MSG_DONTWAIT);
+  if (n == -1)
+    return errno == EAGAIN || errno == EINTR ? 0 : -1;
+  if (n == 0)
+    return -1;
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (r->event_fd != -1 || !cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    return 0;
+  memcpy(&r->event_fd, CMSG_DATA(cmsg), sizeof(int));
+
+  /*
+   * From now on.  nb_msgs is counted before head is published, so this
+   * is at least the seq of the record at tail : the first record read
+   * never counts records lost that were not.
+   */
+  r->tail = r->last = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+  r->seq = __atomic_load_n(&r->header->nb_msgs, __ATOMIC_RELAXED);
+  r->nb_lost = 0;
+  return 1;
+}
+
+void fms_shm_stream_ack(struct FmsShmStreamReader* r) {
+  uint64_t count;
+  if (read(r->event_fd, &count, sizeof(count)) != sizeof(count))
+    return;
+}
+
+/* nothing read since from could have been overwritten */
+static inline int unchanged_since(const struct FmsShmStreamReader* r, uint64_t from) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&r->header->reserve, __ATOMIC_RELAXED) <= from + FMS_SHM_STREAM_SIZE;
+}
+
+const uint8_t* fms_shm_stream_next(struct FmsShmStreamReader* r, uint8_t* msg_id, uint16_t* len) {
+
+  const uint32_t mask = FMS_SHM_STREAM_SIZE - 1;
+  while (1) {
+    uint64_t head = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+    if (r->tail == head)
+      return NULL;
+    uint32_t pos = r->tail & mask;
+    const struct FmsShmStreamRecord* rec = (const struct FmsShmStreamRecord*)(r->ring + pos);
+    /* copies first, they are only checked once read */
+    uint16_t rec_len = rec->len;
+    uint8_t rec_msg_id = rec->msg_id;
+    uint32_t rec_seq = rec->seq;
+    if (head - r->tail > FMS_SHM_STREAM_SIZE || !unchanged_since(r, r->tail)) {
+      /* lapped : the records in between are gone, counted at the next one */
+      r->tail = head;
+      continue;
+    }
+    if (rec_len == FMS_SHM_STREAM_PAD) {
+      r->tail += FMS_SHM_STREAM_SIZE - pos;
+      continue;
+    }
+    if (pos + RECORD_LEN(rec_len) > FMS_SHM_STREAM_SIZE) {
+      /* not something the writer wrote, wait for what it writes next */
+      r->tail = head;
+      continue;
+    }
+    if ((int32_t)(rec_seq - r->seq) > 0)
+      r->nb_lost += rec_seq - r->seq;
+    r->seq = rec_seq + 1;
+    r->last = r->tail;
+    r->tail += RECORD_LEN(rec_len);
+    *msg_id = rec_msg_id;
+    *len = rec_len;
+    return rec->data;
+  }
+}
+
+int fms_shm_stream_valid(const struct FmsShmStreamReader* r) {
+  return unchanged_since(r, r->last);
+}
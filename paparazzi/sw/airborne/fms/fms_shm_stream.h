@@ -0,0 +1,133 @@
+/*
+ * $Id$
+ *
+ * Copyright (C) 2010 The Paparazzi Team
+ *
+ * This file is part of paparazzi.
+ *
+ * paparazzi is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * paparazzi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with paparazzi; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+ * One writer, many local readers message stream in shared memory.
+ *
+ * The writer appends records to a ring in a POSIX shared memory object
+ * (/dev/shm/<name>) which the readers map read only: a reader gets a
+ * pointer into the ring, no copy, and never blocks the writer.  A reader
+ * too slow to follow is lapped, notices it and skips to the newest
+ * record.
+ *
+ * Readers connect to the unix socket /tmp/<name>.sock and receive an
+ * eventfd there, that the writer signals when it has published records.
+ * Nothing blocks on the reader side either: the eventfd arrives once the
+ * writer accepted the connection, see fms_shm_stream_reader_handle().
+ * The writer side of the socket and of the eventfds is run from the
+ * libevent loop of the writer process: event_init() must have been
+ * called before fms_shm_stream_writer_open().
+ */
+
+#ifndef FMS_SHM_STREAM_H
+#define FMS_SHM_STREAM_H
+
+#include <inttypes.h>
+#include <event.h>
+
+/* ring bytes, a power of two */
+#ifndef FMS_SHM_STREAM_SIZE
+#define FMS_SHM_STREAM_SIZE 65536
+#endif
+#define FMS_SHM_STREAM_MAX_CLIENTS 8
+#define FMS_SHM_STREAM_MAGIC 0x50534d32   /* "PSM2" */
+
+/* At the start of the shared object, the ring follows */
+struct FmsShmStreamHeader {
+  uint32_t magic;
+  uint32_t size;
+  /* bytes published, and bytes the writer may be overwriting */
+  uint64_t head;
+  uint64_t reserve;
+  uint32_t nb_msgs;
+};
+
+/* A record in the ring, 4 bytes aligned */
+struct FmsShmStreamRecord {
+  uint16_t len;            /* of data, FMS_SHM_STREAM_PAD up to the ring end */
+  uint8_t msg_id;
+  uint8_t flags;
+  uint32_t seq;            /* nb_msgs when it was written */
+  uint8_t data[];
+};
+#define FMS_SHM_STREAM_PAD 0xffff
+
+struct FmsShmStreamWriter {
+  struct FmsShmStreamHeader* header;
+  uint8_t* ring;
+  char name[32];
+  int listen_fd;
+  struct event listen_event;
+  struct {
+    int fd;                /* connection, -1 if free */
+    int event_fd;
+    struct event event;    /* hang up of the connection */
+  } clients[FMS_SHM_STREAM_MAX_CLIENTS];
+  uint64_t notified;       /* head at the last notification */
+};
+
+struct FmsShmStreamReader {
+  const struct FmsShmStreamHeader* header;
+  const uint8_t* ring;
+  int fd;                  /* connection to the writer */
+  int event_fd;            /* -1 until the writer handed it over */
+  uint64_t tail;
+  uint64_t last;           /* position of the last record returned */
+  uint32_t seq;            /* of the next record expected */
+  uint32_t nb_lost;        /* records skipped, lapped by the writer */
+};
+
+extern int  fms_shm_stream_writer_open(struct FmsShmStreamWriter* w, const char* name);
+extern void fms_shm_stream_writer_close(struct FmsShmStreamWriter* w);
+/* appends one record, readers see it at the next notify */
+extern void fms_shm_stream_write(struct FmsShmStreamWriter* w, uint8_t msg_id,
+                                 const uint8_t* data, uint16_t len);
+/* signals the readers if records were written since the last call */
+extern void fms_shm_stream_notify(struct FmsShmStreamWriter* w);
+
+/*
+ * Maps the ring and connects to the writer without waiting for it:
+ * 0 on success, -1 if there is no writer yet.  Watch r->fd for reading
+ * and call fms_shm_stream_reader_handle() when it is readable.
+ */
+extern int  fms_shm_stream_reader_open(struct FmsShmStreamReader* r, const char* name);
+extern void fms_shm_stream_reader_close(struct FmsShmStreamReader* r);
+/*
+ * 1 when it just received r->event_fd, reading starts from there,
+ * 0 if there was nothing to do, -1 once the writer is gone.
+ */
+extern int  fms_shm_stream_reader_handle(struct FmsShmStreamReader* r);
+/* clears a notification of r->event_fd */
+extern void fms_shm_stream_ack(struct FmsShmStreamReader* r);
+/*
+ * The data of the next record, in the ring, NULL if there is none.
+ * Its id and length are copied to msg_id and len once checked: use
+ * those, never the record header that the writer may be rewriting.
+ * The data may be overwritten once the writer laps the reader: check
+ * with fms_shm_stream_valid() after using it.
+ */
+extern const uint8_t* fms_shm_stream_next(struct FmsShmStreamReader* r, uint8_t* msg_id, uint16_t* len);
+extern int  fms_shm_stream_valid(const struct FmsShmStreamReader* r);
+
+#endif /* FMS_SHM_STREAM_H */
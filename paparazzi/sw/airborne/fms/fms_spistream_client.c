@@ -43,6 +43,7 @@
 #include "std.h"
 #include "fms_debug.h"
 #include "fms_periodic.h"
+#include "fms_shm_stream.h"
 
 /* stuff for io processor link */
 #include "fms_spi_link.h"
@@ -61,10 +62,17 @@ static void main_periodic(int my_sig_num);
 static int open_stream(void);
 
 static void on_kill(int signum);
+static void on_data_event(int fd, short event, void *arg);
+static void on_socket_event(int fd, short event, void *arg);
 
-static int dfifo[4];
+struct DataStream {
+  struct FmsShmStreamReader reader;
+  struct event data_event;
+  struct event socket_event;
+};
+
+static struct DataStream dstream[4];
 static int cfifo[4];
-static char dfifo_files[4][40];
 static char cfifo_files[4][40];
 
 
@@ -90,44 +98,65 @@ int main(int argc, char *argv[]) {
 }
 
 static void main_periodic(int my_sig_num) {
-	uint8_t fifo_idx;
-	uint8_t msg_id;
-	uint16_t num_bytes;
-	int16_t ret;
-	static uint8_t buf[SPISTREAM_MAX_MESSAGE_LENGTH*10];
-
-	for(fifo_idx = 0; fifo_idx < 4; fifo_idx++) {
-		// The periodic is triggered before fifo
-		// connections have been initialized, so
-		// check for a valid fd first:
-		if(dfifo[fifo_idx] > 0) {
-			ret = read(dfifo[fifo_idx], (uint8_t *)(&num_bytes), 2);
-			ret = read(dfifo[fifo_idx], (uint8_t *)(&msg_id), 1);
-
-			memset(&buf, 0, SPISTREAM_MAX_MESSAGE_LENGTH);
-			if(num_bytes > SPISTREAM_MAX_MESSAGE_LENGTH) {
-				fprintf(stderr, "Warning: Message has length %d, but limit "
-												"is %d\n",
-								num_bytes, SPISTREAM_MAX_MESSAGE_LENGTH);
-				num_bytes = SPISTREAM_MAX_MESSAGE_LENGTH;
-			}
-			ret = read(dfifo[fifo_idx], &buf, num_bytes);
-			if(ret > 0 && ret == num_bytes) {
-				// Message received
-				print_message(">> Client", msg_id, buf, num_bytes);
-			}
-			else if(ret > 0 && ret < num_bytes) {
-				fprintf(stderr, "Tried to read %d bytes, but only got %d\n",
-								num_bytes, ret);
+	uint8_t stream_idx;
+	char name[32];
+
+	for(stream_idx = 0; stream_idx < 4; stream_idx++) {
+		// The periodic only (re)connects to the streams, the
+		// messages are read when the daemon signals them
+		if(!dstream[stream_idx].reader.header) {
+			sprintf(name, "spistream_d%d", stream_idx);
+			// Does not wait for the daemon: its eventfd comes
+			// through the socket event
+			if(fms_shm_stream_reader_open(&dstream[stream_idx].reader, name) == 0) {
+				event_set(&dstream[stream_idx].socket_event, dstream[stream_idx].reader.fd,
+				          EV_READ | EV_PERSIST, on_socket_event, &dstream[stream_idx]);
+				event_add(&dstream[stream_idx].socket_event, NULL);
 			}
 		}
-		else {
-			// FIFO file descriptor is invalid,
-			// retry to open it:
-			dfifo[fifo_idx] = open(dfifo_files[fifo_idx], O_RDONLY | O_NONBLOCK);
+	}
+
+}
+
+static void on_data_event(int fd, short event, void *arg) {
+	struct FmsShmStreamReader* reader = &((struct DataStream*)arg)->reader;
+	const uint8_t* data;
+	uint8_t msg_id;
+	uint16_t len;
+	uint32_t nb_lost = reader->nb_lost;
+
+	fms_shm_stream_ack(reader);
+	while((data = fms_shm_stream_next(reader, &msg_id, &len)) != NULL) {
+		// The message is read in place, in the daemon's ring
+		print_message(">> Client", msg_id, (uint8_t*)data, len);
+		if(!fms_shm_stream_valid(reader)) {
+			fprintf(stderr, "Message overwritten while printed\n");
 		}
 	}
+	if(reader->nb_lost != nb_lost) {
+		fprintf(stderr, "Too slow, %u messages lost\n", reader->nb_lost - nb_lost);
+	}
+}
 
+// The daemon hands its eventfd over, or went away: back to
+// waiting for it in the periodic
+static void on_socket_event(int fd, short event, void *arg) {
+	struct DataStream* stream = arg;
+	switch(fms_shm_stream_reader_handle(&stream->reader)) {
+	case 1:
+		event_set(&stream->data_event, stream->reader.event_fd,
+		          EV_READ | EV_PERSIST, on_data_event, stream);
+		event_add(&stream->data_event, NULL);
+		break;
+	case -1:
+		fprintf(stderr, "Daemon gone, waiting for it\n");
+		if(stream->reader.event_fd != -1) {
+			event_del(&stream->data_event);
+		}
+		event_del(&stream->socket_event);
+		fms_shm_stream_reader_close(&stream->reader);
+		break;
+	}
 }
 
 static void main_init(void) {
@@ -160,7 +189,11 @@ static void main_init(void) {
 }
 
 /**
- * For every FIFO, a non-blocking connection try is called
+ * The data streams are shared memory rings (fms_shm_stream.h),
+ * connected to, and reconnected after a restart of the daemon,
+ * by the periodic.
+ *
+ * For every command FIFO, a non-blocking connection try is called
  * via open(..., O_NONBLOCK).
  * This immediately returns a file descriptor or 0 if
  * the other end of the fifo is closed.
@@ -181,21 +214,13 @@ static void main_init(void) {
 static int open_stream(void) {
 	uint8_t fifo_idx;
 
-	strcpy(dfifo_files[0], "/tmp/spistream_d0.fifo"); // FIFOs for data
-	strcpy(dfifo_files[1], "/tmp/spistream_d1.fifo"); // (STM -> daemon -> client)
-	strcpy(dfifo_files[2], "/tmp/spistream_d2.fifo");
-	strcpy(dfifo_files[3], "/tmp/spistream_d3.fifo");
 	strcpy(cfifo_files[0], "/tmp/spistream_c0.fifo"); // FIFOs for commands
 	strcpy(cfifo_files[1], "/tmp/spistream_c1.fifo"); // (client -> daemon -> STM)
 	strcpy(cfifo_files[2], "/tmp/spistream_c2.fifo");
 	strcpy(cfifo_files[3], "/tmp/spistream_c3.fifo");
 
-	for(fifo_idx = 0; fifo_idx < 4; fifo_idx++) {
-		fprintf(stderr, "Open data stream %s ... \n", dfifo_files[fifo_idx]);
-		dfifo[fifo_idx] = open(dfifo_files[fifo_idx], O_RDONLY | O_NONBLOCK);
-		fprintf(stderr, " ...\n");
-	}
-
+	// The data streams are shared memory, connected to by the
+	// periodic once the daemon has created them
 	return 1;
 
 	for(fifo_idx = 0; fifo_idx < 3; fifo_idx++) {
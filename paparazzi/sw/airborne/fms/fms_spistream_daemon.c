@@ -43,6 +43,7 @@
 #include "std.h"
 #include "fms_debug.h"
 #include "fms_periodic.h"
+#include "fms_shm_stream.h"
 
 /* stuff for io processor link */
 #include "fms_spi_link.h"
@@ -73,13 +74,11 @@ static void on_dead_pipe(int signum);
 static void on_spistream_msg_received(uint8_t msg_id, uint8_t * data, uint16_t num_bytes);
 static void on_spistream_msg_sent(uint8_t msg_id);
 
-static void send_to_client(uint8_t * data, uint16_t num_bytes, uint8_t fifo_idx);
-
 static uint8_t spistream_msg[123];
 
-static int dfifo[4];
+/* data streams (STM -> daemon -> clients), one per uart */
+static struct FmsShmStreamWriter dstream[4];
 static int cfifo[4];
-static char dfifo_files[4][40];
 static char cfifo_files[4][40];
 
 
@@ -113,6 +112,14 @@ static void main_periodic(int my_sig_num) {
 	}
 
 	spistream_event();
+
+	/* wake the clients up once for everything this cycle brought */
+	uint8_t stream_idx;
+	for(stream_idx = 0; stream_idx < 4; stream_idx++) {
+		if(dstream[stream_idx].header) {
+			fms_shm_stream_notify(&dstream[stream_idx]);
+		}
+	}
 }
 
 static void spistream_event() {
@@ -152,7 +159,6 @@ static void on_spistream_msg_received(uint8_t msg_id,
                                       uint8_t * data,
                                       uint16_t num_bytes) {
 	uint8_t uart;
-	uint8_t buf[SPISTREAM_MAX_MESSAGE_LENGTH+3];
 
 	print_message("<< Daemon", msg_id, data, num_bytes);
 
@@ -160,36 +166,16 @@ static void on_spistream_msg_received(uint8_t msg_id,
 	// Check for valid uart ID
 	if(uart >= 0 && uart <= 3) {
 		if(msg_id > 0) {
-			buf[0] = (uint8_t)(num_bytes & 0x00ff);
-			buf[1] = (uint8_t)((num_bytes << 8) & 0x00ff);
-			buf[2] = msg_id;
 			if(num_bytes > SPISTREAM_MAX_MESSAGE_LENGTH) {
 				fprintf(LOG_OUT, "Warning: Message has length %d, but limit "
                          "is %d - truncating message\n",
 								num_bytes, SPISTREAM_MAX_MESSAGE_LENGTH);
 				num_bytes = SPISTREAM_MAX_MESSAGE_LENGTH;
 			}
-			memcpy(buf+3, data, num_bytes);
-			send_to_client(buf, num_bytes+3, uart);
-		}
-	}
-}
-
-static void send_to_client(uint8_t * data, uint16_t num_bytes, uint8_t fifo_idx)
-{
-	if(dfifo[fifo_idx] <= 0) {
-		// No client connected to this fifo, yet
-		dfifo[fifo_idx] = open(dfifo_files[fifo_idx], O_WRONLY | O_NONBLOCK);
-		if(dfifo[fifo_idx] <= 0) {
-			fprintf(LOG_OUT, "No client for data fifo %d (%s)\n",
-							fifo_idx, dfifo_files[fifo_idx]);
-			return;
-		}
-	}
-	else {
-		// Client connected to this fifo
-		if(write(dfifo[fifo_idx], data, num_bytes) == -1) {
-			fprintf(LOG_OUT, "Write error on data fifo %d\n", fifo_idx);
+			// Published to every client of this uart at once
+			if(dstream[uart].header) {
+				fms_shm_stream_write(&dstream[uart], msg_id, data, num_bytes);
+			}
 		}
 	}
 }
@@ -245,6 +231,7 @@ static void main_exit(void)
 {
 	fprintf(LOG_OUT, "Closing socket\n");
 	close_stream();
+	fms_periodic_print_stats(LOG_OUT);
 }
 
 static void parse_command_line(int argc, char** argv) {
@@ -262,28 +249,25 @@ static void parse_command_line(int argc, char** argv) {
 static int open_stream(void) {
 	uint8_t fifo_idx;
 	int ret;
+	char dstream_name[32];
 
-	strcpy(dfifo_files[0], "/tmp/spistream_d0.fifo"); // FIFOs for data
-	strcpy(dfifo_files[1], "/tmp/spistream_d1.fifo"); // (STM -> daemon -> client)
-	strcpy(dfifo_files[2], "/tmp/spistream_d2.fifo");
-	strcpy(dfifo_files[3], "/tmp/spistream_d3.fifo");
 	strcpy(cfifo_files[0], "/tmp/spistream_c0.fifo"); // FIFOs for commands
 	strcpy(cfifo_files[1], "/tmp/spistream_c1.fifo"); // (client -> daemon -> STM)
 	strcpy(cfifo_files[2], "/tmp/spistream_c2.fifo");
 	strcpy(cfifo_files[3], "/tmp/spistream_c3.fifo");
 
+	// Shared memory streams for data (STM -> daemon -> clients),
+	// see fms_shm_stream.h
 	for(fifo_idx = 0; fifo_idx < 4; fifo_idx++) {
-		fprintf(LOG_OUT, "Creating data stream %s ...", dfifo_files[fifo_idx]);
-		if((ret = mkfifo(dfifo_files[fifo_idx], 0777)) < 0) {
+		sprintf(dstream_name, "spistream_d%d", fifo_idx);
+		fprintf(LOG_OUT, "Creating data stream %s ...", dstream_name);
+		if(fms_shm_stream_writer_open(&dstream[fifo_idx], dstream_name) < 0) {
 			fprintf(LOG_OUT, " failed\n");
-			fprintf(LOG_OUT, "Could not create data fifo %d: %s\n",
-						 fifo_idx, dfifo_files[fifo_idx]);
 			close_stream();
 			return 0;
 		}
 		else {
 			fprintf(LOG_OUT, " ok\n");
-			dfifo[fifo_idx] = open(dfifo_files[fifo_idx], O_WRONLY | O_NONBLOCK);
 		}
 	}
 
@@ -309,10 +293,9 @@ static void close_stream(void) {
 	fprintf(LOG_OUT, "Closing streams\n");
 	for(fifo_idx = 0; fifo_idx < 4; fifo_idx++)
 	{
-		if(dfifo[fifo_idx] >= 0) {
-			close(dfifo[fifo_idx]);
+		if(dstream[fifo_idx].header) {
+			fms_shm_stream_writer_close(&dstream[fifo_idx]);
 		}
-		unlink(dfifo_files[fifo_idx]);
 		if(cfifo[fifo_idx] >= 0) {
 			close(cfifo[fifo_idx]);
 		}
@@ -335,13 +318,8 @@ static void on_kill(int signum)
 
 static void on_dead_pipe(int signum)
 {
-	uint8_t fifo_idx;
 	fprintf(LOG_OUT, "Got SIGPIPE (signal %d)\n", signum);
-	// *Pop* goes the pipe. Looks like our client got AWOL.
-	// Let's be nice and invalidate the file descriptors:
-	for(fifo_idx = 0; fifo_idx < 4; fifo_idx++) {
-		close(dfifo[fifo_idx]);
-		dfifo[fifo_idx] = -1;
-	}
+	// Data clients come and go through fms_shm_stream, which
+	// does not raise SIGPIPE for them: nothing to clean up here.
 }
 
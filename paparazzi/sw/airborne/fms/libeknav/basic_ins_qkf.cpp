@@ -24,33 +24,50 @@
 
 using namespace Eigen;
 
-basic_ins_qkf::basic_ins_qkf(
+template<typename FloatT>
+ins_qkf<FloatT>::ins_qkf(
 		const Vector3d& estimate,
-		double pos_error, double bias_error, double v_error,
-		const Vector3d& gyro_white_noise,
-		const Vector3d& gyro_stability_noise,
-		const Vector3d& accel_white_noise,
-		Quaterniond initial_orientation,		// this is new
-		const Vector3d& vel_estimate)
+		FloatT pos_error, FloatT bias_error, FloatT v_error,
+		const vector3_t& gyro_white_noise,
+		const vector3_t& gyro_stability_noise,
+		const vector3_t& accel_white_noise,
+		quaternion_t initial_orientation,		// this is new
+		const vector3_t& vel_estimate)
 	: gyro_stability_noise(gyro_stability_noise)
 	, gyro_white_noise(gyro_white_noise)
 	, accel_white_noise(accel_white_noise)
 {
 	avg_state.position = estimate;
-	avg_state.gyro_bias = Vector3d::Zero();
+	avg_state.gyro_bias = vector3_t::Zero();
 	//avg_state.orientation = Quaterniond::Identity();
 	avg_state.orientation = initial_orientation;
 	avg_state.velocity = vel_estimate;
 
-	cov << Matrix3d::Identity()*bias_error*bias_error, Matrix<double, 3, 9>::Zero(),
-		Matrix3d::Zero(), Matrix3d::Identity()*M_PI*M_PI*0.5, Matrix<double, 3, 6>::Zero(),
-		Matrix<double, 3, 6>::Zero(), Matrix3d::Identity()*pos_error*pos_error, Matrix3d::Zero(),
-		Matrix<double, 3, 9>::Zero(), Matrix3d::Identity()*v_error*v_error;
+	cov << matrix3_t::Identity()*bias_error*bias_error, Matrix<FloatT, 3, 9>::Zero(),
+		matrix3_t::Zero(), matrix3_t::Identity()*FloatT(M_PI*M_PI*0.5), Matrix<FloatT, 3, 6>::Zero(),
+		Matrix<FloatT, 3, 6>::Zero(), matrix3_t::Identity()*pos_error*pos_error, matrix3_t::Zero(),
+		Matrix<FloatT, 3, 9>::Zero(), matrix3_t::Identity()*v_error*v_error;
+#if INS_QKF_UD_COVARIANCE
+	cov_ud.set(cov);
+	cov_stale = false;
+#endif
 	assert(is_real());
 }
 
+template<typename FloatT>
 void
-basic_ins_qkf::counter_rotate_cov(const Quaterniond&)
+ins_qkf<FloatT>::set_cov(const covariance_t& P)
+{
+	cov = P;
+#if INS_QKF_UD_COVARIANCE
+	cov_ud.set(P);
+	cov_stale = false;
+#endif
+}
+
+template<typename FloatT>
+void
+ins_qkf<FloatT>::counter_rotate_cov(const quaternion_t&)
 {
 	// Rotate the principle axes of the angular error covariance by the
 	// mean update.
@@ -98,53 +115,64 @@ basic_ins_qkf::average_sigma_points(const std::vector<state, aligned_allocator<s
 }
 #endif
 
+template<typename FloatT>
 bool
-basic_ins_qkf::is_real(void) const
+ins_qkf<FloatT>::is_real(void) const
 {
+#if INS_QKF_UD_COVARIANCE
+	// check the factors, rebuilding cov at every assert would defeat its laziness
+	return !(hasNaN(cov_ud.U) || hasInf(cov_ud.U) || hasNaN(cov_ud.D) || hasInf(cov_ud.D))
+			&& avg_state.is_real();
+#else
 	return !(hasNaN(cov) || hasInf(cov)) && avg_state.is_real();
+#endif
 }
 
-Quaterniond
-basic_ins_qkf::state::apply_kalman_vec_update(const Matrix<double, 12, 1> update)
+template<typename FloatT>
+typename ins_qkf<FloatT>::quaternion_t
+ins_qkf<FloatT>::state::apply_kalman_vec_update(const state_error_t update)
 {
 	// std::cout << "***update available***\n"
 	// 		<< "\tstate: "; print(std::cout);
 	// std::cout << "\n\tupdate: " << update.transpose() << "\n";
-	gyro_bias += update.segment<3>(0);
-	Quaterniond posterior_update = exp<double>(update.segment<3>(3));
+	gyro_bias += update.template segment<3>(0);
+	quaternion_t posterior_update = exp<FloatT>(update.template segment<3>(3));
 	orientation = (orientation * posterior_update).normalized();
-	position += update.segment<3>(6);
-	velocity += update.segment<3>(9);
+	position += update.template segment<3>(6).template cast<double>();
+	velocity += update.template segment<3>(9);
 	assert(is_real());
 	return posterior_update;
 }
 
 #if 0
-Quaterniond
-basic_ins_qkf::state::apply_left_kalman_vec_update(const Matrix<double, 12, 1> update)
+template<typename FloatT>
+typename ins_qkf<FloatT>::quaternion_t
+ins_qkf<FloatT>::state::apply_left_kalman_vec_update(const state_error_t update)
 {
 	// std::cout << "***update available***\n"
 	// 		<< "\tstate: "; print(std::cout);
 	// std::cout << "\n\tupdate: " << update.transpose() << "\n";
-	gyro_bias += update.segment<3>(0);
-	Quaterniond posterior_update = exp<double>(update.segment<3>(3));
+	gyro_bias += update.template segment<3>(0);
+	quaternion_t posterior_update = exp<FloatT>(update.template segment<3>(3));
 	orientation = (posterior_update * orientation).normalized();
-	position += update.segment<3>(6);
-	velocity += update.segment<3>(9);
+	position += update.template segment<3>(6).template cast<double>();
+	velocity += update.template segment<3>(9);
 	assert(is_real());
 	return posterior_update;
 }
 #endif
 
+template<typename FloatT>
 bool
-basic_ins_qkf::state::has_nan(void)const
+ins_qkf<FloatT>::state::has_nan(void)const
 {
 	return hasNaN(gyro_bias) || hasNaN(orientation.coeffs())
 			|| hasNaN(position) || hasNaN(velocity);
 }
 
+template<typename FloatT>
 bool
-basic_ins_qkf::state::is_real(void) const
+ins_qkf<FloatT>::state::is_real(void) const
 {
 	return !(hasNaN(gyro_bias) || hasNaN(orientation.coeffs())
 			|| hasNaN(position) || hasNaN(velocity))
@@ -152,3 +180,5 @@ basic_ins_qkf::state::is_real(void) const
 				|| hasInf(position) || hasInf(velocity));
 }
 
+template struct ins_qkf<double>;
+template struct ins_qkf<float>;
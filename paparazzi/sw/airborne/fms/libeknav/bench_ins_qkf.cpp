@@ -0,0 +1,100 @@
+/*
+ * bench_ins_qkf.cpp
+ *
+ * Cost of the ins_qkf predict and observation steps, for the double and
+ * the float filter, in the covariance representation selected at compile
+ * time.
+ *
+ *   bench_ins_qkf [seconds of log]
+ */
+
+#include "ins_qkf.hpp"
+#include "synthetic_flight.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+using namespace Eigen;
+
+enum { PREDICT, OBS_VECTOR, OBS_BARO, OBS_GPS_PV, NB_OPS };
+static const char* op_names[NB_OPS] = { "predict", "obs_vector", "obs_baro_report", "obs_gps_pv_report" };
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+template<typename FloatT>
+static void run(double seconds)
+{
+	typedef ins_qkf<FloatT> filter_t;
+	typedef typename filter_t::vector3_t vector3_t;
+	uint64_t nb_steps = (uint64_t)(seconds * synthetic_flight::imu_frequency);
+
+	synthetic_flight log;
+	filter_t ins(log.position, 5., 0.05, 1.,
+			vector3_t::Ones() * FloatT(log.gyro_noise * log.gyro_noise),
+			vector3_t::Ones() * FloatT(1e-6),
+			vector3_t::Ones() * FloatT(log.accel_noise * log.accel_noise),
+			log.orientation.template cast<FloatT>(), log.velocity.template cast<FloatT>());
+	const vector3_t gps_p_error = vector3_t::Ones() * FloatT(log.gps_p_noise * log.gps_p_noise);
+	const vector3_t gps_v_error = vector3_t::Ones() * FloatT(log.gps_v_noise * log.gps_v_noise);
+
+	double total[NB_OPS] = { 0 };
+	uint64_t count[NB_OPS] = { 0 };
+	double t0, t_run = now_ns();
+	for (uint64_t i = 0; i < nb_steps; ++i) {
+		log.next();
+		// the conversions stay out of the timed sections
+		const vector3_t gyro = log.gyro.template cast<FloatT>();
+		const vector3_t accel = log.accel.template cast<FloatT>();
+		t0 = now_ns();
+		ins.predict(gyro, accel, FloatT(log.dt));
+		total[PREDICT] += now_ns() - t0;
+		count[PREDICT]++;
+		if (log.mag_ready) {
+			const vector3_t ref = log.mag_reference.template cast<FloatT>();
+			const vector3_t mag = log.mag.template cast<FloatT>();
+			t0 = now_ns();
+			ins.obs_vector(ref, mag, FloatT(log.mag_noise * log.mag_noise));
+			total[OBS_VECTOR] += now_ns() - t0;
+			count[OBS_VECTOR]++;
+		}
+		if (log.baro_ready) {
+			t0 = now_ns();
+			ins.obs_baro_report(log.baro, FloatT(log.baro_noise * log.baro_noise));
+			total[OBS_BARO] += now_ns() - t0;
+			count[OBS_BARO]++;
+		}
+		if (log.gps_ready) {
+			const vector3_t gps_v = log.gps_v.template cast<FloatT>();
+			t0 = now_ns();
+			ins.obs_gps_pv_report(log.gps_p, gps_v, gps_p_error, gps_v_error);
+			total[OBS_GPS_PV] += now_ns() - t0;
+			count[OBS_GPS_PV]++;
+		}
+	}
+	t_run = now_ns() - t_run;
+
+#if INS_QKF_UD_COVARIANCE
+	printf("%s filter, U*D*U^T covariance, %s factors\n", sizeof(FloatT) == sizeof(float) ? "float" : "double",
+			sizeof(typename filter_t::ud_scalar_t) == sizeof(float) ? "float" : "double");
+#else
+	printf("%s filter, dense covariance\n", sizeof(FloatT) == sizeof(float) ? "float" : "double");
+#endif
+	for (int op = 0; op < NB_OPS; ++op)
+		printf("%-18s %9llu calls %9.0f ns/call\n", op_names[op],
+				(unsigned long long)count[op], count[op] ? total[op] / count[op] : 0.);
+	printf("%.0f s of log in %.3f s (%.0fx realtime)\n", seconds, t_run * 1e-9, seconds / (t_run * 1e-9));
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 600.;
+	run<double>(seconds);
+	run<float>(seconds);
+	return 0;
+}
@@ -0,0 +1,206 @@
+#include "fms/libeknav/columnar_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define COLUMNAR_LOG_MAX_NAME 256
+
+static int columnar_log_flush(struct columnar_log* log) {
+  if (!log->nb_rows)
+    return 0;
+  int ok = fwrite(&log->nb_rows, sizeof(log->nb_rows), 1, log->file) == 1;
+  int c;
+  for (c=0; c<log->nb_columns; c++) {
+    const double* values = log->block + (size_t)c * COLUMNAR_LOG_BLOCK_ROWS;
+    if (log->columns[c].type == 'd')
+      ok &= fwrite(values, sizeof(double), log->nb_rows, log->file) == log->nb_rows;
+    else {
+      uint32_t i;
+      for (i=0; i<log->nb_rows; i++)
+        log->out[i] = values[i];
+      ok &= fwrite(log->out, sizeof(float), log->nb_rows, log->file) == log->nb_rows;
+    }
+  }
+  log->nb_rows = 0;
+  if (!ok)
+    log->failed = 1;
+  return ok ? 0 : -1;
+}
+
+int columnar_log_open(struct columnar_log* log, const char* filename,
+                      const struct columnar_log_column* columns, int nb_columns) {
+  memset(log, 0, sizeof(*log));
+  if (!(log->file = fopen(filename, "wb")))
+    return -1;
+  log->columns = columns;
+  log->nb_columns = nb_columns;
+  log->block = (double*)malloc(sizeof(double) * nb_columns * COLUMNAR_LOG_BLOCK_ROWS);
+  log->out = (float*)malloc(sizeof(float) * COLUMNAR_LOG_BLOCK_ROWS);
+  int ok = log->block && log->out;
+
+  uint32_t header[2] = { (uint32_t)nb_columns, COLUMNAR_LOG_BLOCK_ROWS };
+  ok = ok && fwrite(COLUMNAR_LOG_MAGIC, 1, strlen(COLUMNAR_LOG_MAGIC), log->file) == strlen(COLUMNAR_LOG_MAGIC);
+  ok = ok && fwrite(header, sizeof(header), 1, log->file) == 1;
+  int c;
+  for (c=0; ok && c<nb_columns; c++) {
+    size_t len = strlen(columns[c].name) + 1;
+    ok = fputc(columns[c].type, log->file) != EOF &&
+         fwrite(columns[c].name, 1, len, log->file) == len;
+  }
+  if (!ok) {
+    int err = errno;
+    columnar_log_close(log);
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+int columnar_log_add_row(struct columnar_log* log, const double* row) {
+  int c;
+  for (c=0; c<log->nb_columns; c++)
+    log->block[(size_t)c * COLUMNAR_LOG_BLOCK_ROWS + log->nb_rows] = row[c];
+  if (++log->nb_rows == COLUMNAR_LOG_BLOCK_ROWS)
+    return columnar_log_flush(log);
+  return 0;
+}
+
+int columnar_log_close(struct columnar_log* log) {
+  int ret = log->failed ? -1 : 0;
+  if (log->file) {
+    if (log->block && columnar_log_flush(log))
+      ret = -1;
+    if (fclose(log->file))
+      ret = -1;
+  }
+  free(log->block);
+  free(log->out);
+  memset(log, 0, sizeof(*log));
+  return ret;
+}
+
+
+static int read_name(FILE* file, char* name) {
+  int i, ch;
+  for (i=0; i<COLUMNAR_LOG_MAX_NAME; i++) {
+    if ((ch = fgetc(file)) == EOF)
+      return -1;
+    if (!(name[i] = ch))
+      return 0;
+  }
+  return -1;
+}
+
+/* reads nb rows of one column, converted to double */
+static int read_column(FILE* file, char type, double* values, uint32_t nb, float* in) {
+  uint32_t i;
+  if (type == 'd')
+    return fread(values, sizeof(double), nb, file) == nb ? 0 : -1;
+  if (fread(in, sizeof(float), nb, file) != nb)
+    return -1;
+  for (i=0; i<nb; i++)
+    values[i] = in[i];
+  return 0;
+}
+
+int columnar_log_load(struct columnar_log_data* data, const char* filename) {
+  memset(data, 0, sizeof(*data));
+  FILE* file = fopen(filename, "rb");
+  if (!file)
+    return -1;
+
+  char magic[sizeof(COLUMNAR_LOG_MAGIC) - 1];
+  uint32_t header[2], block_rows, capacity = 0, nb;
+  float* in = NULL;
+  int c, err = EINVAL;
+  if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, COLUMNAR_LOG_MAGIC, sizeof(magic)) ||
+      fread(header, sizeof(header), 1, file) != 1 || header[0] == 0 ||
+      header[0] > COLUMNAR_LOG_MAX_NAME || header[1] == 0 || header[1] > (1u << 24))
+    goto fail;
+  block_rows = header[1];
+  data->nb_columns = header[0];
+  data->names = (char**)calloc(data->nb_columns, sizeof(char*));
+  data->types = (char*)malloc(data->nb_columns);
+  data->values = (double**)calloc(data->nb_columns, sizeof(double*));
+  in = (float*)malloc(sizeof(float) * block_rows);
+  if (!data->names || !data->types || !data->values || !in) {
+    err = ENOMEM;
+    goto fail;
+  }
+  for (c=0; c<data->nb_columns; c++) {
+    char name[COLUMNAR_LOG_MAX_NAME];
+    int type = fgetc(file);
+    if ((type != 'f' && type != 'd') || read_name(file, name))
+      goto fail;
+    data->types[c] = type;
+    if (!(data->names[c] = strdup(name))) {
+      err = ENOMEM;
+      goto fail;
+    }
+  }
+
+  while (fread(&nb, sizeof(nb), 1, file) == 1) {
+    if (nb == 0 || nb > block_rows)
+      goto fail;
+    if (data->nb_rows + nb > capacity) {
+      if (capacity > (UINT32_MAX - block_rows) / 2) {
+        err = ENOMEM;
+        goto fail;
+      }
+      capacity = 2 * capacity + block_rows;
+      for (c=0; c<data->nb_columns; c++) {
+        double* values = (double*)realloc(data->values[c], sizeof(double) * capacity);
+        if (!values) {
+          err = ENOMEM;
+          goto fail;
+        }
+        data->values[c] = values;
+      }
+    }
+    for (c=0; c<data->nb_columns; c++)
+      if (read_column(file, data->types[c], data->values[c] + data->nb_rows, nb, in))
+        break;
+    if (c < data->nb_columns) {
+      data->truncated = 1;
+      break;
+    }
+    data->nb_rows += nb;
+  }
+  if (ferror(file)) {
+    err = EIO;
+    goto fail;
+  }
+  free(in);
+  fclose(file);
+  return 0;
+
+fail:
+  free(in);
+  fclose(file);
+  columnar_log_free(data);
+  errno = err;
+  return -1;
+}
+
+int columnar_log_find(const struct columnar_log_data* data, const char* name) {
+  int c;
+  for (c=0; c<data->nb_columns; c++)
+    if (!strcmp(data->names[c], name))
+      return c;
+  return -1;
+}
+
+void columnar_log_free(struct columnar_log_data* data) {
+  int c;
+  for (c=0; c<data->nb_columns; c++) {
+    if (data->names)
+      free(data->names[c]);
+    if (data->values)
+      free(data->values[c]);
+  }
+  free(data->names);
+  free(data->types);
+  free(data->values);
+  memset(data, 0, sizeof(*data));
+}
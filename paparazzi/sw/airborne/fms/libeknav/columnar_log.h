@@ -0,0 +1,65 @@
+#ifndef LIBEKNAV_COLUMNAR_LOG_H
+#define LIBEKNAV_COLUMNAR_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Binary columnar log: rows are buffered and written in blocks, each
+ * block storing its columns one after the other, so that a reader can
+ * load one signal without parsing the others.  Host byte order.
+ *
+ *   header  "EKNVCOL1"
+ *           uint32 nb_columns, uint32 block_rows
+ *           nb_columns times: uint8 type ('f' float32, 'd' float64),
+ *                             name, NUL terminated
+ *   blocks  uint32 nb_rows (<= block_rows)
+ *           nb_columns times: nb_rows values of the column type
+ */
+
+#define COLUMNAR_LOG_MAGIC      "EKNVCOL1"
+#define COLUMNAR_LOG_BLOCK_ROWS 4096
+
+struct columnar_log_column {
+  const char* name;
+  char type;                 /* 'f' or 'd' */
+};
+
+struct columnar_log {
+  FILE* file;
+  int nb_columns;
+  const struct columnar_log_column* columns;
+  uint32_t nb_rows;          /* rows buffered in the current block */
+  double* block;             /* column major, COLUMNAR_LOG_BLOCK_ROWS rows */
+  float* out;                /* one column converted to float32 */
+  int failed;                /* a write did not reach the file */
+};
+
+/* a whole log loaded back in memory */
+struct columnar_log_data {
+  int nb_columns;
+  char** names;
+  char* types;
+  uint32_t nb_rows;
+  double** values;           /* nb_columns arrays of nb_rows values */
+  int truncated;             /* the file ends in the middle of a block */
+};
+
+/* 0 on success, -1 with errno set otherwise */
+extern int columnar_log_open(struct columnar_log* log, const char* filename,
+                             const struct columnar_log_column* columns, int nb_columns);
+/* row holds one value per column, -1 with errno set if a block could not be written */
+extern int columnar_log_add_row(struct columnar_log* log, const double* row);
+/* writes the last block, 0 if everything reached the file */
+extern int columnar_log_close(struct columnar_log* log);
+
+/*
+ * Reads a whole log, the rows of a truncated last block are dropped.
+ * 0 on success, -1 with errno set otherwise (EINVAL for a malformed file)
+ */
+extern int columnar_log_load(struct columnar_log_data* data, const char* filename);
+/* index of the column, -1 if there is none */
+extern int columnar_log_find(const struct columnar_log_data* data, const char* name);
+extern void columnar_log_free(struct columnar_log_data* data);
+
+#endif /* LIBEKNAV_COLUMNAR_LOG_H */
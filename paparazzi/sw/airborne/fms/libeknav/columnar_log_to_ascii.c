@@ -0,0 +1,54 @@
+/*
+ * Prints an EKNVCOL1 columnar log (the binary output of run_filter_on_log)
+ * as text, one row per line, optionally restricted to some columns:
+ *
+ *   columnar_log_to_ascii file [column ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fms/libeknav/columnar_log.h"
+
+int main(int argc, char** argv) {
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file [column ...]\n", argv[0]);
+    return -1;
+  }
+
+  struct columnar_log_data log;
+  if (columnar_log_load(&log, argv[1]) == -1) {
+    perror(argv[1]);
+    return -1;
+  }
+
+  int nb = argc > 2 ? argc - 2 : log.nb_columns;
+  int* columns = (int*)malloc(sizeof(int) * nb);
+  int c;
+  for (c=0; c<nb; c++) {
+    columns[c] = argc > 2 ? columnar_log_find(&log, argv[c+2]) : c;
+    if (columns[c] == -1) {
+      fprintf(stderr, "%s: no column %s\n", argv[1], argv[c+2]);
+      return -1;
+    }
+  }
+
+  printf("#");
+  for (c=0; c<nb; c++)
+    printf(" %s", log.names[columns[c]]);
+  printf("\n");
+  uint32_t i;
+  for (i=0; i<log.nb_rows; i++) {
+    for (c=0; c<nb; c++)
+      printf(c ? " %.9g" : "%.9g", log.values[columns[c]][i]);
+    printf("\n");
+  }
+
+  int truncated = log.truncated;
+  if (truncated)
+    fprintf(stderr, "%s: truncated, last block dropped\n", argv[1]);
+  free(columns);
+  columnar_log_free(&log);
+  return truncated ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * compare_ins_qkf_precision.cpp
+ *
+ * Replays the same sensor stream through the double and the float
+ * instantiations of ins_qkf and reports how far apart their estimates
+ * drift, and what each one costs per step.  The stream is either a raw
+ * log recorded on the FMS (see raw_log.h) or, without argument, the
+ * synthetic flight, for which the error against the truth is reported too.
+ *
+ *   compare_ins_qkf_precision [raw_log.bin | -s seconds]
+ */
+
+#include "ins_qkf_replay.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Eigen;
+
+/** The differences between the two estimates */
+struct divergence
+{
+	double position, velocity, attitude, gyro_bias;
+};
+
+static divergence compare(const basic_ins_qkf& d, const basic_ins_qkf_f& f)
+{
+	divergence r;
+	r.position = (d.avg_state.position - f.avg_state.position).norm();
+	r.velocity = (d.avg_state.velocity - f.avg_state.velocity.cast<double>()).norm();
+	r.attitude = angle_between(d.avg_state.orientation, f.avg_state.orientation.cast<double>());
+	r.gyro_bias = (d.avg_state.gyro_bias - f.avg_state.gyro_bias.cast<double>()).norm();
+	return r;
+}
+
+int main(int argc, char** argv)
+{
+	bool synthetic = true;
+	struct raw_log_map raw_log;
+	size_t raw_index = 0;
+	double seconds = 600.;
+	if (argc > 2 && !strcmp(argv[1], "-s"))
+		seconds = atof(argv[2]);
+	else if (argc > 1) {
+		synthetic = false;
+		if (raw_log_map_open(&raw_log, argv[1]) == -1) {
+			perror(argv[1]);
+			return 1;
+		}
+	}
+
+	replay_setup setup;
+	synthetic_flight log;
+	double baro_offset = 0;
+	if (synthetic)
+		synthetic_setup(setup, log);
+	else if (!raw_log_setup(raw_log, raw_index, setup, baro_offset)) {
+		fprintf(stderr, "%s: too short to initialize the filter\n", argv[1]);
+		return 1;
+	}
+
+	replay_filter<double> filter_d(setup);
+	replay_filter<float> filter_f(setup);
+
+	printf("%8s %10s %10s %10s %12s\n", "time", "d_pos_m", "d_vel_m/s", "d_att_deg", "d_bias_deg/s");
+	divergence max = { 0, 0, 0, 0 }, sum2 = { 0, 0, 0, 0 };
+	uint64_t nb_steps = 0;
+	double next_print = 0;
+	replay_input in;
+	for (;;) {
+		if (synthetic) {
+			if (log.time() >= seconds)
+				break;
+			synthetic_input(in, log);
+		}
+		else {
+			if (!read_raw_input(raw_log, raw_index, in))
+				break;
+			if (!in.imu_ready && !in.gps_ready)
+				continue;
+			in.baro += baro_offset;
+		}
+		filter_d.step(in, setup);
+		filter_f.step(in, setup);
+		nb_steps++;
+
+		if (!filter_f.ins.is_real()) {
+			printf("float filter diverged at %.3f s\n", in.time);
+			break;
+		}
+		divergence d = compare(filter_d.ins, filter_f.ins);
+		max.position = std::max(max.position, d.position);
+		max.velocity = std::max(max.velocity, d.velocity);
+		max.attitude = std::max(max.attitude, d.attitude);
+		max.gyro_bias = std::max(max.gyro_bias, d.gyro_bias);
+		sum2.position += d.position * d.position;
+		sum2.velocity += d.velocity * d.velocity;
+		sum2.attitude += d.attitude * d.attitude;
+		sum2.gyro_bias += d.gyro_bias * d.gyro_bias;
+		if (in.time >= next_print) {
+			printf("%8.1f %10.5f %10.5f %10.5f %12.6f\n", in.time, d.position, d.velocity,
+					d.attitude * 180/M_PI, d.gyro_bias * 180/M_PI);
+			next_print = in.time + 10.;
+		}
+	}
+	if (!nb_steps)
+		return 1;
+
+	printf("\n%llu steps\n", (unsigned long long)nb_steps);
+	printf("%-10s %10s %10s %10s %12s\n", "", "d_pos_m", "d_vel_m/s", "d_att_deg", "d_bias_deg/s");
+	printf("%-10s %10.5f %10.5f %10.5f %12.6f\n", "max", max.position, max.velocity,
+			max.attitude * 180/M_PI, max.gyro_bias * 180/M_PI);
+	printf("%-10s %10.5f %10.5f %10.5f %12.6f\n", "rms", sqrt(sum2.position / nb_steps),
+			sqrt(sum2.velocity / nb_steps), sqrt(sum2.attitude / nb_steps) * 180/M_PI,
+			sqrt(sum2.gyro_bias / nb_steps) * 180/M_PI);
+	if (synthetic) {
+		printf("error against the truth: double %.3f m %.3f deg, float %.3f m %.3f deg\n",
+				(filter_d.ins.avg_state.position - log.position).norm(),
+				angle_between(filter_d.ins.avg_state.orientation, log.orientation) * 180/M_PI,
+				(filter_f.ins.avg_state.position - log.position).norm(),
+				angle_between(filter_f.ins.avg_state.orientation.cast<double>(), log.orientation) * 180/M_PI);
+	}
+	double ns_d = filter_d.total_ns / nb_steps, ns_f = filter_f.total_ns / nb_steps;
+	printf("double %.0f ns/step, float %.0f ns/step, float speedup %.2fx\n", ns_d, ns_f, ns_d / ns_f);
+	return 0;
+}
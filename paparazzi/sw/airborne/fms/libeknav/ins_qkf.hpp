@@ -26,6 +26,20 @@
 
 #define BARO_CENTER_OF_MASS 1
 
+/*
+ * Set INS_QKF_UD_COVARIANCE to 1 to propagate the covariance as U*D*U^T
+ * factors (see ud_covariance.hpp) instead of a dense matrix.
+ * INS_QKF_UD_SCALAR is the precision of the factors, by default the
+ * precision of the filter.
+ */
+#ifndef INS_QKF_UD_COVARIANCE
+#define INS_QKF_UD_COVARIANCE 0
+#endif
+
+#if INS_QKF_UD_COVARIANCE
+#include "ud_covariance.hpp"
+#endif
+
 using Eigen::Vector3f;
 using Eigen::Vector3d;
 using Eigen::Vector2d;
@@ -34,9 +48,33 @@ using Eigen::Matrix;
 using Eigen::aligned_allocator;
 
 
-struct basic_ins_qkf
+/**
+ * The filter, in the precision FloatT (double or float).  The ECEF position
+ * is kept in double in both cases: a float cannot resolve it below half
+ * a meter.  All the other terms, and the covariance, are FloatT so that a
+ * float filter runs on the fixed size vectorized kernels of Eigen.
+ */
+template<typename FloatT>
+struct ins_qkf
 {
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	typedef FloatT scalar_t;
+	typedef Eigen::Matrix<FloatT, 3, 1> vector3_t;
+	typedef Eigen::Matrix<FloatT, 2, 1> vector2_t;
+	typedef Eigen::Matrix<FloatT, 3, 3> matrix3_t;
+	typedef Eigen::Quaternion<FloatT> quaternion_t;
+	/// The type of the covariance and of the Kalman update vectors
+	typedef Eigen::Matrix<FloatT, 12, 12> covariance_t;
+	/// The type of an error term between two state vectors.
+	typedef Eigen::Matrix<FloatT, 12, 1> state_error_t;
+#if INS_QKF_UD_COVARIANCE
+#ifdef INS_QKF_UD_SCALAR
+	typedef INS_QKF_UD_SCALAR ud_scalar_t;
+#else
+	typedef FloatT ud_scalar_t;
+#endif
+#endif
+
 	/// The maximum number of satellites that may be tracked by the filter
 	static const size_t max_sv = 12;
 	/**
@@ -44,19 +82,19 @@ struct basic_ins_qkf
 	 * the gyro bias at each time step.  This value is treated as a diagonal
 	 *  matrix, in units of radians^2/second^2.
 	 */
-	const Vector3d gyro_stability_noise;
+	const vector3_t gyro_stability_noise;
 
 	/**
 	 * The covariance of the zero-mean gaussian white noise that is added to
 	 * the gyro measurement at each time step, in rad^2/second^2
 	 */
-	const Vector3d gyro_white_noise;
+	const vector3_t gyro_white_noise;
 
 	/**
 	 * The covariance of the zero-mean gaussian white noise that is added to
 	 * the accelerometer measurement at each time step, in (m/s/s)^2
 	 */
-	const Vector3d accel_white_noise;
+	const vector3_t accel_white_noise;
 
 	/**
 	 * A term for the basic state of the system
@@ -74,7 +112,7 @@ struct basic_ins_qkf
 		template <typename Vector_T>
 		state(const state& mean, const Vector_T& error)
 			: gyro_bias(mean.gyro_bias + error.template segment<3>(0))
-			, orientation(mean.orientation * exp<double>(error.template segment<3>(3)))
+			, orientation(mean.orientation * exp<FloatT>(error.template segment<3>(3)))
 			, position(mean.position + error.template segment<3>(6).template cast<double>())
 			, velocity(mean.velocity + error.template segment<3>(9))
 		{
@@ -85,7 +123,7 @@ struct basic_ins_qkf
 		template <typename Vector_T>
 		state(const state& mean, const Vector_T& error, bool)
 			: gyro_bias(mean.gyro_bias + error.segment(0, 3))
-			, orientation(mean.orientation * exp<double>(error.segment(3, 3)))
+			, orientation(mean.orientation * exp<FloatT>(error.segment(3, 3)))
 			, position(mean.position + error.segment(6, 3).template cast<double>())
 			, velocity(mean.velocity + error.segment(9, 3))
 		{
@@ -104,25 +142,25 @@ struct basic_ins_qkf
 		 * @param update A 12-vector to be applied
 		 * @return The rotation applied to the mean orientation
 		 */
-		Quaterniond apply_kalman_vec_update(const Matrix<double, 12, 1> update);
-		Quaterniond apply_left_kalman_vec_update(const Matrix<double, 12, 1> update);
+		quaternion_t apply_kalman_vec_update(const state_error_t update);
+		quaternion_t apply_left_kalman_vec_update(const state_error_t update);
 
 		/**
 		 * An estimate of the bias error in the rate gyros, in radians/second
 		 */
-		Vector3d gyro_bias;
+		vector3_t gyro_bias;
 
 		/**
 		 * An estimate of the orientation of the vehicle.  This quaternion represents
 		 * a transformation from ECEF coordinates to the vehicle body frame.
 		 */
-		Quaterniond orientation;
+		quaternion_t orientation;
 
 		/// Position in Earth-centered Earth-fixed reference frame, in meters
 		Vector3d position;
 
 		/// Velocity in Earth-centered Earth-fixed reference frame, in m/s
-		Vector3d velocity;
+		vector3_t velocity;
 
 		/**
 		 * @return True if the state vector contains any NaNs
@@ -144,8 +182,43 @@ struct basic_ins_qkf
 	/// The average state of the filter at any time t.
 	state avg_state;
 
+#if INS_QKF_UD_COVARIANCE
 	/// Covariance term.  Elements are ordered exactly as in struct state
-	Matrix<double, 12, 12> cov;
+	/// A copy of cov_ud, only rebuilt when read: use covariance() to read
+	/// it and set_cov() to change it.
+	mutable covariance_t cov;
+
+	/// Factorized covariance term, the one the filter actually updates
+	ud_covariance<ud_scalar_t, 12> cov_ud;
+
+	/// cov_ud changed since cov was last rebuilt
+	mutable bool cov_stale;
+#else
+	/// Covariance term.  Elements are ordered exactly as in struct state
+	covariance_t cov;
+#endif
+
+	/**
+	 * The covariance of the filter.  With INS_QKF_UD_COVARIANCE, rebuilding
+	 * it from the factors is O(N^3): read it only where it is needed.
+	 * @return The covariance, elements ordered as in struct state
+	 */
+	const covariance_t& covariance(void) const
+	{
+#if INS_QKF_UD_COVARIANCE
+		if (cov_stale) {
+			cov = cov_ud.covariance().template cast<FloatT>();
+			cov_stale = false;
+		}
+#endif
+		return cov;
+	}
+
+	/**
+	 * Replace the covariance of the filter
+	 * @param P The new covariance, symmetric positive definite
+	 */
+	void set_cov(const covariance_t& P);
 
 	/**
 	 * Initialize a new basic INS QKF
@@ -158,13 +231,13 @@ struct basic_ins_qkf
 	 * @param accel_white_noise The diagonal matrix of accelerometer white noise
 	 */
 			//Old one without orientation_init()
-	basic_ins_qkf(const Vector3d& pos_estimate,
-			double pos_error, double bias_error, double v_error,
-			const Vector3d& gyro_white_noise,
-			const Vector3d& gyro_stability_noise,
-			const Vector3d& accel_white_noise,
-			Quaterniond initial_orientation = Quaterniond::Identity(),
-			const Vector3d& vel_estimate = Vector3d::Zero());
+	ins_qkf(const Vector3d& pos_estimate,
+			FloatT pos_error, FloatT bias_error, FloatT v_error,
+			const vector3_t& gyro_white_noise,
+			const vector3_t& gyro_stability_noise,
+			const vector3_t& accel_white_noise,
+			quaternion_t initial_orientation = quaternion_t::Identity(),
+			const vector3_t& vel_estimate = vector3_t::Zero());
 	
 
 	/*		//Old one without orientation_init()
@@ -185,14 +258,14 @@ struct basic_ins_qkf
 	 * @param accel_meas The measured inertial reference frame acceleration, in m/s
 	 * @param dt The elapsed time since the last measurement, in seconds.
 	 */
-	void predict(const Vector3d& gyro_meas, const Vector3d& accel_meas, double dt);
+	void predict(const vector3_t& gyro_meas, const vector3_t& accel_meas, FloatT dt);
 
 	/**
 	 * Report an INS observation, to propagate the filter forward by one time
 	 * step. This function differs from predict() in that it uses the NED frame
 	 * instead of the ECEF frame.
 	 */
-	void predict_ned(const Vector3d& gyro_meas, const Vector3d& accel_meas, double dt);
+	void predict_ned(const vector3_t& gyro_meas, const vector3_t& accel_meas, FloatT dt);
 
 	/**
 	 * Make a single vector observation, with some angular uncertainty.
@@ -203,7 +276,7 @@ struct basic_ins_qkf
 	 *	@param obs Vector observation, should not be a unit vector
 	 *	@param error one-sigma squared magnitude error in the observation
 	 */
-	void obs_vector(const Vector3d& ref, const Vector3d& obs, double error);
+	void obs_vector(const vector3_t& ref, const vector3_t& obs, FloatT error);
 
 	/**
 	 * Incorporate a GPS PVT report.
@@ -212,14 +285,14 @@ struct basic_ins_qkf
 	 * @param p_error The RMS position error, (m)^2
 	 * @param v_error The RMS velocity error, (m/s)^2
 	 */
-	void obs_gps_pv_report(const Vector3d& pos, const Vector3d& vel, const Vector3d& p_error, const Vector3d v_error);
+	void obs_gps_pv_report(const Vector3d& pos, const vector3_t& vel, const vector3_t& p_error, const vector3_t v_error);
 
 	/**
 	 * Incorporate a GPS position report, in either ECEF or NED coordinates.
 	 * @param pos The position, in meters
 	 * @param p_error The position error, in meters.
 	 */
-	void obs_gps_p_report(const Vector3d& pos, const Vector3d& p_error);
+	void obs_gps_p_report(const Vector3d& pos, const vector3_t& p_error);
   
   /**
    * Incoporate a barometer report, the altitude should be ein ENU coordinates (Up=Positive)
@@ -230,9 +303,9 @@ struct basic_ins_qkf
    * @param pos_0, the position where ENU would be (0, 0, 0).
    */
   #if BARO_CENTER_OF_MASS
-  void obs_baro_report(double altitude, double baro_error);
+  void obs_baro_report(double altitude, FloatT baro_error);
   #else
-  void obs_baro_report(double altitude, double baro_error, Matrix<double, 3, 3> ecef2enu, const Vector3d& pos_0);
+  void obs_baro_report(double altitude, FloatT baro_error, Matrix<double, 3, 3> ecef2enu, const Vector3d& pos_0);
   #endif
 
 	/**
@@ -240,14 +313,14 @@ struct basic_ins_qkf
 	 * @param vel The 3d velocity, relative to the fixed earth frame, in (m/s).
 	 * @param v_error The one-sigma RMS velocity error (m/s)^2
 	 */
-	void obs_gps_v_report(const Vector3d& vel, const Vector3d& v_error);
+	void obs_gps_v_report(const vector3_t& vel, const vector3_t& v_error);
 
 	/**
 	 * Observe a GPS vector track over ground report, in north-east-down coordinates
 	 * @param vel The 2d velocity value, parallel to the ground, in m/s
 	 * @param v_error The one-sigma RMS velocity error (m/s)^2
 	 */
-	void obs_gps_vtg_report(const Vector2d vel, const double v_error);
+	void obs_gps_vtg_report(const vector2_t vel, const FloatT v_error);
 
 	/**
 	 * Directly observe the gyro sensor bias. In practice, we cannot do this. However,
@@ -262,7 +335,7 @@ struct basic_ins_qkf
 	 * @param bias The observed bias, in radians/sec
 	 * @param bias_error The one-sigma estimate of the gyro bias error, in radians/sec
 	 */
-	void obs_gyro_bias(const Vector3d& bias, const Vector3d& bias_error);
+	void obs_gyro_bias(const vector3_t& bias, const vector3_t& bias_error);
 
 	/**
 	 * Measure the total angular error between the filter's attitude estimate
@@ -270,7 +343,7 @@ struct basic_ins_qkf
 	 * @param orientation The attitude to compare against
 	 * @return The angular difference between them, in radians
 	 */
-	double angular_error(const Quaterniond& orientation) const;
+	FloatT angular_error(const quaternion_t& orientation) const;
 
 	/**
 	 * Measure the total gyro bias error between the filter's estimate and
@@ -278,29 +351,43 @@ struct basic_ins_qkf
 	 * @param gyro_bias The gyro bias vector to compare against
 	 * @return The vector difference between them, in radians/second
 	 */
-	double gyro_bias_error(const Vector3d& gyro_bias) const;
+	FloatT gyro_bias_error(const vector3_t& gyro_bias) const;
 
 	/**
 	 * Determine the statistical distance between an example sample point
 	 * and the distribution computed by the estimator.
 	 */
-	double mahalanobis_distance(const state& sample) const;
+	FloatT mahalanobis_distance(const state& sample) const;
 
 private:
 
-	/**
-	 * The type of an error term between two state vectors.
-	 */
-	typedef Eigen::Matrix<double, 12, 1> state_error_t;
 	/// Compute the error difference between a sigma point and the mean as: point - mean
 	state_error_t sigma_point_difference(const state& mean, const state& point) const;
 
+#if INS_QKF_UD_COVARIANCE
+	/**
+	 * Rank-one update of cov_ud for the observation y = h^T x + v
+	 * @param h The observation vector
+	 * @param error The variance of v
+	 * @return The Kalman gain
+	 */
+	state_error_t ud_scalar_obs(const state_error_t& h, FloatT error)
+	{
+		state_error_t gain;
+		cov_ud.update(h, error, gain);
+		return gain;
+	}
+
+	/// The factors changed: rebuild the dense copy at the next covariance()
+	void mark_cov_stale(void) { cov_stale = true; }
+#endif
+
 
 public:
 	/** Perform the posterior counter-rotation of the covariance matrix by
 	  the update that gets applied to the estimated state.
 	  */
-	void counter_rotate_cov(const Quaterniond& update);
+	void counter_rotate_cov(const quaternion_t& update);
 
 	/**
 	 * Verify that the covariance and average state are niether NaN nor Inf
@@ -309,4 +396,9 @@ public:
 	bool is_real(void) const;
 };
 
+/// The double precision filter, as used so far
+typedef ins_qkf<double> basic_ins_qkf;
+/// The single precision filter
+typedef ins_qkf<float> basic_ins_qkf_f;
+
 #endif
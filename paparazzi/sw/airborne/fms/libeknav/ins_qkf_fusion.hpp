@@ -0,0 +1,276 @@
+/*
+ * ins_qkf_fusion.hpp
+ *
+ * Time-indexed front-end of ins_qkf.  The filter is propagated with the
+ * real interval between IMU samples rather than the nominal period, so
+ * that dropped IMU frames do not slow its clock down, and GPS fixes are
+ * applied at their measurement time rather than at their arrival.
+ *
+ * Each IMU step is kept in a short history, with a copy of the filter as
+ * it was before the step and the observations applied after it, at most
+ * one of each kind.  A fix older than the last step rewinds the filter to
+ * the step it belongs to, is applied there, and the steps since are
+ * replayed with their own observations: the result is the one the filter
+ * would have reached had the fix come in on time, to one IMU period.
+ */
+
+#ifndef INS_QKF_FUSION_HPP
+#define INS_QKF_FUSION_HPP
+
+#include "ins_qkf.hpp"
+#include <stdint.h>
+#include <string.h>
+
+template<typename FloatT, int HistoryLength = 256>
+class ins_qkf_fusion
+{
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	typedef ins_qkf<FloatT> filter_t;
+	typedef typename filter_t::vector3_t vector3_t;
+
+	/// The filter driven, updated in place
+	filter_t& filter;
+
+	/// Counters since construction
+	struct statistics
+	{
+		uint32_t nb_steps;
+		uint32_t nb_dropped;           ///< IMU samples missing, from the intervals
+		uint32_t nb_gaps;              ///< intervals longer than max_dt, clamped
+		uint32_t nb_out_of_order;      ///< IMU samples not newer than the last one
+		uint32_t nb_gps;
+		uint32_t nb_gps_delayed;       ///< fixes applied by rewinding
+		uint32_t nb_gps_rejected;      ///< fixes older than the history
+		uint32_t nb_replayed;          ///< steps replayed after delayed fixes
+	} stats;
+
+	/**
+	 * @param f The filter, initialized
+	 * @param nominal_dt The IMU period, used for the first sample
+	 * @param max_dt Longer intervals are taken as a log discontinuity and
+	 *   propagated over max_dt only
+	 */
+	ins_qkf_fusion(filter_t& f, double nominal_dt, double max_dt)
+		: filter(f)
+		, nominal_dt(nominal_dt)
+		, max_dt(max_dt)
+		, last_time(0)
+		, head(0)
+		, nb_history(0)
+	{
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	/// Time of the last IMU sample
+	double time(void) const { return last_time; }
+
+	/**
+	 * Propagate the filter to the IMU sample at time.  The observations
+	 * that follow apply to this sample.
+	 * @return false if the sample is not newer than the last one, and ignored
+	 */
+	bool imu(double time, const vector3_t& gyro, const vector3_t& accel)
+	{
+		double dt = nominal_dt;
+		if (nb_history) {
+			dt = time - last_time;
+			if (dt <= 0) {
+				stats.nb_out_of_order++;
+				return false;
+			}
+			if (dt > max_dt) {
+				stats.nb_gaps++;
+				dt = max_dt;
+			}
+			else if (dt > 1.5 * nominal_dt)
+				stats.nb_dropped += (uint32_t)(dt / nominal_dt + 0.5) - 1;
+		}
+		step& s = push();
+		s.time = time;
+		s.dt = FloatT(dt);
+		s.gyro = gyro;
+		s.accel = accel;
+		s.observations = 0;
+		save(s);
+		filter.predict(gyro, accel, s.dt);
+		last_time = time;
+		stats.nb_steps++;
+		return true;
+	}
+
+	/// Magnetometer, or any other direction, at the last IMU sample
+	void obs_vector(const vector3_t& reference, const vector3_t& measured, FloatT error)
+	{
+		if (!nb_history)
+			return;
+		step& s = last();
+		s.observations |= OBS_VECTOR;
+		s.reference = reference;
+		s.measured = measured;
+		s.vector_error = error;
+		filter.obs_vector(reference, measured, error);
+	}
+
+	/// Gravity as the reference of the last accelerometer sample
+	void obs_gravity(FloatT error)
+	{
+		if (!nb_history)
+			return;
+		step& s = last();
+		s.observations |= OBS_GRAVITY;
+		s.gravity_error = error;
+		apply_gravity(s);
+	}
+
+	void obs_baro_report(double altitude, FloatT error)
+	{
+		if (!nb_history)
+			return;
+		step& s = last();
+		s.observations |= OBS_BARO;
+		s.baro = altitude;
+		s.baro_error = error;
+		filter.obs_baro_report(altitude, error);
+	}
+
+	/**
+	 * A GPS fix measured at time, which may be older than the last IMU
+	 * sample.
+	 * @return false if it is older than the history, or falls on a step
+	 *   that already has a fix, and is dropped
+	 */
+	bool obs_gps_pv_report(double time, const Eigen::Vector3d& pos, const vector3_t& vel,
+			const vector3_t& p_error, const vector3_t& v_error)
+	{
+		stats.nb_gps++;
+		if (!nb_history || time < at(0).time) {
+			stats.nb_gps_rejected++;
+			return false;
+		}
+		// the last step not after the fix
+		int k = nb_history - 1;
+		while (at(k).time > time)
+			k--;
+		step& s = at(k);
+		if (s.observations & OBS_GPS) {
+			stats.nb_gps_rejected++;
+			return false;
+		}
+		s.observations |= OBS_GPS;
+		s.gps_p = pos;
+		s.gps_v = vel;
+		s.gps_p_error = p_error;
+		s.gps_v_error = v_error;
+		if (k == nb_history - 1) {
+			filter.obs_gps_pv_report(pos, vel, p_error, v_error);
+			return true;
+		}
+
+		// back to step k after its observations, then forward again
+		stats.nb_gps_delayed++;
+		restore(at(k+1));
+		filter.obs_gps_pv_report(pos, vel, p_error, v_error);
+		for (int i = k+1; i < nb_history; i++) {
+			step& r = at(i);
+			save(r);
+			filter.predict(r.gyro, r.accel, r.dt);
+			replay_observations(r);
+			stats.nb_replayed++;
+		}
+		return true;
+	}
+
+private:
+	enum {
+		OBS_VECTOR  = 1,
+		OBS_GRAVITY = 2,
+		OBS_BARO    = 4,
+		OBS_GPS     = 8
+	};
+
+	/// One IMU step and what was observed after it
+	struct step
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+		double time;
+		FloatT dt;
+		vector3_t gyro, accel;
+		uint8_t observations;
+		vector3_t reference, measured;
+		FloatT vector_error, gravity_error;
+		double baro;
+		FloatT baro_error;
+		Eigen::Vector3d gps_p;
+		vector3_t gps_v, gps_p_error, gps_v_error;
+		/// the filter before the step, but for its constant noises
+		typename filter_t::state state;
+#if INS_QKF_UD_COVARIANCE
+		ud_covariance<typename filter_t::ud_scalar_t, 12> cov_ud;
+#else
+		typename filter_t::covariance_t cov;
+#endif
+	};
+
+	double nominal_dt, max_dt;
+	double last_time;
+	/// Ring of the last HistoryLength steps, oldest at head
+	step history[HistoryLength];
+	int head;
+	int nb_history;
+
+	step& at(int i) { return history[(head + i) % HistoryLength]; }
+	step& last(void) { return at(nb_history - 1); }
+
+	step& push(void)
+	{
+		if (nb_history < HistoryLength)
+			nb_history++;
+		else
+			head = (head + 1) % HistoryLength;
+		return last();
+	}
+
+	void save(step& s)
+	{
+		s.state = filter.avg_state;
+#if INS_QKF_UD_COVARIANCE
+		s.cov_ud = filter.cov_ud;
+#else
+		s.cov = filter.cov;
+#endif
+	}
+
+	void restore(const step& s)
+	{
+		filter.avg_state = s.state;
+#if INS_QKF_UD_COVARIANCE
+		// the dense copy is rebuilt from the factors when read
+		filter.cov_ud = s.cov_ud;
+		filter.cov_stale = true;
+#else
+		filter.cov = s.cov;
+#endif
+	}
+
+	void apply_gravity(const step& s)
+	{
+		filter.obs_vector(filter.avg_state.position.normalized().template cast<FloatT>(),
+				s.accel, s.gravity_error);
+	}
+
+	/// in the order the front-end applies them as they come
+	void replay_observations(const step& s)
+	{
+		if (s.observations & OBS_VECTOR)
+			filter.obs_vector(s.reference, s.measured, s.vector_error);
+		if (s.observations & OBS_GRAVITY)
+			apply_gravity(s);
+		if (s.observations & OBS_BARO)
+			filter.obs_baro_report(s.baro, s.baro_error);
+		if (s.observations & OBS_GPS)
+			filter.obs_gps_pv_report(s.gps_p, s.gps_v, s.gps_p_error, s.gps_v_error);
+	}
+};
+
+#endif /* INS_QKF_FUSION_HPP */
@@ -32,68 +32,107 @@
 
 using namespace Eigen;
 
+template<typename FloatT>
 void
-basic_ins_qkf::obs_gps_p_report(const Vector3d& pos, const Vector3d& p_error)
+ins_qkf<FloatT>::obs_gps_p_report(const Vector3d& pos, const vector3_t& p_error)
 {
-	Matrix<double, 3, 1> residual = pos - avg_state.position;	
+	// difference of two ECEF positions, small enough for FloatT
+	vector3_t residual = (pos - avg_state.position).template cast<FloatT>();
 
 
 #ifdef RANK_ONE_UPDATES
-	Matrix<double, 12, 1> update = Matrix<double, 12, 1>::Zero();
+	state_error_t update = state_error_t::Zero();
 	for (int i = 0; i < 3; ++i) {
-		double innovation_cov_inv = 1.0/(cov(6+i, 6+i) + p_error[i]);
-		Matrix<double, 12, 1> gain = cov.block<12, 1>(0, 6+i) * innovation_cov_inv;
+#if INS_QKF_UD_COVARIANCE
+		state_error_t gain = ud_scalar_obs(state_error_t::Unit(6+i), p_error[i]);
 		update += gain * (residual[i] - update[6+i]);
-		cov -= gain * cov.block<1, 12>(6+i, 0);
+#else
+		FloatT innovation_cov_inv = FloatT(1)/(cov(6+i, 6+i) + p_error[i]);
+		state_error_t gain = cov.template block<12, 1>(0, 6+i) * innovation_cov_inv;
+		update += gain * (residual[i] - update[6+i]);
+		cov -= gain * cov.template block<1, 12>(6+i, 0);
+#endif
 	}
+#if INS_QKF_UD_COVARIANCE
+	mark_cov_stale();
+#endif
 
 #else
-	Matrix<double, 3, 3> innovation_cov = cov.block<3, 3>(6, 6);
+	matrix3_t innovation_cov = cov.template block<3, 3>(6, 6);
 	innovation_cov += p_error.asDiagonal();
 
-	Matrix<double, 12, 3> kalman_gain = cov.block<12, 3>(0, 6)
-		* innovation_cov.part<Eigen::SelfAdjoint>().inverse();
-	Matrix<double, 12, 1> update = kalman_gain * residual;
-	cov.part<Eigen::SelfAdjoint>() -= kalman_gain * cov.block<3, 12>(6, 0);
+	Matrix<FloatT, 12, 3> kalman_gain = cov.template block<12, 3>(0, 6)
+		* innovation_cov.template part<Eigen::SelfAdjoint>().inverse();
+	state_error_t update = kalman_gain * residual;
+	cov.template part<Eigen::SelfAdjoint>() -= kalman_gain * cov.template block<3, 12>(6, 0);
 #endif
-	Quaterniond rotor = avg_state.apply_kalman_vec_update(update);
+	quaternion_t rotor = avg_state.apply_kalman_vec_update(update);
 	counter_rotate_cov(rotor);
 	assert(is_real());
 }
 
 // Martin's stuff for Baro
 #if BARO_CENTER_OF_MASS
+template<typename FloatT>
 void
-basic_ins_qkf::obs_baro_report(double altitude, double baro_error){
+ins_qkf<FloatT>::obs_baro_report(double altitude, FloatT baro_error){
   double height_state = avg_state.position.norm();
-  Matrix<double, 1, 3> H = avg_state.position.transpose()/height_state;
-  Matrix<double, 1, 1> innovation_cov = H * cov.block<3,3>(6,6) * H.transpose();
+  Matrix<FloatT, 1, 3> H = (avg_state.position.transpose()/height_state).template cast<FloatT>();
+  // the altitudes are geocentric: only their difference fits in FloatT
+  FloatT residual = FloatT(altitude - height_state);
+#if INS_QKF_UD_COVARIANCE
+  state_error_t h = state_error_t::Zero();
+  h.template segment<3>(6) = H.transpose();
+  state_error_t update = ud_scalar_obs(h, baro_error) * residual;
+  mark_cov_stale();
+  quaternion_t rotor = avg_state.apply_kalman_vec_update(update);
+  counter_rotate_cov(rotor);
+#else
+  Matrix<FloatT, 1, 1> innovation_cov = H * cov.template block<3,3>(6,6) * H.transpose();
   
-  Matrix<double, 12, 1> kalman_gain = cov.block<12, 3>(0,6) * H.transpose() / (innovation_cov(0)+baro_error);
+  state_error_t kalman_gain = cov.template block<12, 3>(0,6) * H.transpose() / (innovation_cov(0)+baro_error);
   
-  Matrix<double, 12, 1> update = kalman_gain * (altitude - height_state);
+  state_error_t update = kalman_gain * residual;
   //std::cout <<"Delta: " << (altitude - height_state) << std::endl;
   //std::cout <<"Update: " << update.block<6,1>(0,0).transpose() << "\t" << update.block<6,1>(6,0).transpose() << std::endl;
-	Quaterniond rotor = avg_state.apply_kalman_vec_update(update);
+	quaternion_t rotor = avg_state.apply_kalman_vec_update(update);
 	counter_rotate_cov(rotor);
   
-  cov.part<Eigen::SelfAdjoint>() -= kalman_gain * H * cov.block<3, 12>(6, 0);
-  
+  cov.template part<Eigen::SelfAdjoint>() -= kalman_gain * H * cov.template block<3, 12>(6, 0);
+#endif
 }
 #else  /* BARO_CENTER_OF_MASS */
+template<typename FloatT>
 void
-basic_ins_qkf::obs_baro_report(double altitude, double baro_error, Matrix<double, 3, 3> ecef2enu, const Vector3d& pos_0){
-  Matrix<double, 1, 3> h = ecef2enu.block<1, 3>(2,0);
-  Matrix<double, 1, 1> innovation_cov = h * cov.block<3,3>(6,6) * h.transpose();
-  double innovation_cov_scalar = innovation_cov(0)+baro_error;
-  Matrix<double, 12, 1> kalman_gain = cov.block<12, 3>(0,6) * h.transpose() / innovation_cov_scalar;
-  
-  Matrix<double, 1, 1> state_projection = h*(avg_state.position-pos_0);
-  double residual = altitude - state_projection(0);
+ins_qkf<FloatT>::obs_baro_report(double altitude, FloatT baro_error, Matrix<double, 3, 3> ecef2enu, const Vector3d& pos_0){
+  Matrix<double, 1, 3> h_ecef = ecef2enu.block<1, 3>(2,0);
+  Matrix<FloatT, 1, 3> h = h_ecef.template cast<FloatT>();
+  Matrix<double, 1, 1> state_projection = h_ecef*(avg_state.position-pos_0);
+  FloatT residual = FloatT(altitude - state_projection(0));
+#if INS_QKF_UD_COVARIANCE
+  state_error_t h_state = state_error_t::Zero();
+  h_state.template segment<3>(6) = h.transpose();
+  state_error_t update = ud_scalar_obs(h_state, baro_error) * residual;
+  mark_cov_stale();
+#else
+  Matrix<FloatT, 1, 1> innovation_cov = h * cov.template block<3,3>(6,6) * h.transpose();
+  FloatT innovation_cov_scalar = innovation_cov(0)+baro_error;
+  state_error_t kalman_gain = cov.template block<12, 3>(0,6) * h.transpose() / innovation_cov_scalar;
   
-  Matrix<double, 12, 1> update = kalman_gain * residual;
-  cov.part<Eigen::SelfAdjoint>() -= kalman_gain * h * cov.block<3, 12>(6, 0);
-	Quaterniond rotor = avg_state.apply_kalman_vec_update(update);
+  state_error_t update = kalman_gain * residual;
+  cov.template part<Eigen::SelfAdjoint>() -= kalman_gain * h * cov.template block<3, 12>(6, 0);
+#endif
+	quaternion_t rotor = avg_state.apply_kalman_vec_update(update);
 	counter_rotate_cov(rotor);
 }
 #endif  /* BARO_CENTER_OF_MASS */
+
+template void ins_qkf<double>::obs_gps_p_report(const Vector3d&, const Vector3d&);
+template void ins_qkf<float>::obs_gps_p_report(const Vector3d&, const Vector3f&);
+#if BARO_CENTER_OF_MASS
+template void ins_qkf<double>::obs_baro_report(double, double);
+template void ins_qkf<float>::obs_baro_report(double, float);
+#else
+template void ins_qkf<double>::obs_baro_report(double, double, Matrix<double, 3, 3>, const Vector3d&);
+template void ins_qkf<float>::obs_baro_report(double, float, Matrix<double, 3, 3>, const Vector3d&);
+#endif
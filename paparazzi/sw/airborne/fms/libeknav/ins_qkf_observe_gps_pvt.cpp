@@ -32,41 +32,51 @@ using namespace Eigen;
 
 #define RANK_ONE_UPDATES
 
+template<typename FloatT>
 void
-basic_ins_qkf::obs_gps_v_report(const Vector3d& vel, const Vector3d& v_error)
+ins_qkf<FloatT>::obs_gps_v_report(const vector3_t& vel, const vector3_t& v_error)
 {
-	Vector3d residual = vel - avg_state.velocity;
+	vector3_t residual = vel - avg_state.velocity;
 	//std::cout << "diff_v(" <<residual(0) << ", " << residual(1) << ", " << residual(2) <<")\n";
 
 #ifdef RANK_ONE_UPDATES
-	Matrix<double, 12, 1> update = Matrix<double, 12, 1>::Zero();
+	state_error_t update = state_error_t::Zero();
 	for (int i = 0; i < 3; ++i) {
-		double innovation_cov_inv = 1.0/(cov(9+i, 9+i) + v_error[i]);
-		Matrix<double, 12, 1> gain = cov.block<12, 1>(0, 9+i) * innovation_cov_inv;
+#if INS_QKF_UD_COVARIANCE
+		state_error_t gain = ud_scalar_obs(state_error_t::Unit(9+i), v_error[i]);
 		update += gain * (residual[i] - update[9+i]);
-		cov -= gain * cov.block<1, 12>(9+i, 0);
+#else
+		FloatT innovation_cov_inv = FloatT(1)/(cov(9+i, 9+i) + v_error[i]);
+		state_error_t gain = cov.template block<12, 1>(0, 9+i) * innovation_cov_inv;
+		update += gain * (residual[i] - update[9+i]);
+		cov -= gain * cov.template block<1, 12>(9+i, 0);
+#endif
 	}
+#if INS_QKF_UD_COVARIANCE
+	mark_cov_stale();
+#endif
 #else
-	Matrix<double, 3, 3> innovation_cov = cov.block<3, 3>(9, 9);
+	matrix3_t innovation_cov = cov.template block<3, 3>(9, 9);
 	innovation_cov += v_error.asDiagonal();
-	Matrix<double, 3, 12> kalman_gain_t;
-	innovation_cov.qr().solve(cov.block<3, 12>(9, 0), &kalman_gain_t);
-	cov.part<Eigen::SelfAdjoint>() -= cov.block<12, 3>(0, 9) * kalman_gain_t; // .transpose() * cov.block<3, 12>(9, 0);
-	Matrix<double, 12, 1> update = kalman_gain_t.transpose() * residual;
+	Matrix<FloatT, 3, 12> kalman_gain_t;
+	innovation_cov.qr().solve(cov.template block<3, 12>(9, 0), &kalman_gain_t);
+	cov.template part<Eigen::SelfAdjoint>() -= cov.template block<12, 3>(0, 9) * kalman_gain_t; // .transpose() * cov.block<3, 12>(9, 0);
+	state_error_t update = kalman_gain_t.transpose() * residual;
 #endif
 	//std::cout << "update(" << update.segment<6>(0).transpose()*180/M_PI << "\t" << update.segment<6>(6).transpose() << ")\n";
 
 	//update.segment<6>(0) = Matrix<double, 6, 1>::Zero(); // only for debugging
 	//std::cout << "update(" << update.segment<6>(0).transpose()*180/M_PI << "\t" << update.segment<6>(6).transpose() << ")\n";
-	Quaterniond rotor = avg_state.apply_kalman_vec_update(update);
+	quaternion_t rotor = avg_state.apply_kalman_vec_update(update);
 	counter_rotate_cov(rotor);
 	assert(is_real());
 }
 
+template<typename FloatT>
 void
-basic_ins_qkf::obs_gps_pv_report(
-		const Vector3d& pos, const Vector3d& vel,
-		const Vector3d& p_error, const Vector3d v_error)
+ins_qkf<FloatT>::obs_gps_pv_report(
+		const Vector3d& pos, const vector3_t& vel,
+		const vector3_t& p_error, const vector3_t v_error)
 {
 #ifdef TIME_OPS
 	timer clock;
@@ -81,17 +91,17 @@ basic_ins_qkf::obs_gps_pv_report(
 
 	// The observation model is strictly linear here, so use the linear
 	// form of the kalman gain and update
-	Matrix<double, 6, 12> obs_matrix;
-	obs_matrix << Matrix<double, 6, 6>::Zero(), Matrix<double, 6, 6>::Identity();
+	Matrix<FloatT, 6, 12> obs_matrix;
+	obs_matrix << Matrix<FloatT, 6, 6>::Zero(), Matrix<FloatT, 6, 6>::Identity();
 
-	Matrix<double, 6, 1> residual;
-	residual.segment<3>(0) = (pos - avg_state.position);
-	residual.segment<3>(3) = vel - avg_state.velocity;
+	Matrix<FloatT, 6, 1> residual;
+	residual.template segment<3>(0) = (pos - avg_state.position).template cast<FloatT>();
+	residual.template segment<3>(3) = vel - avg_state.velocity;
 
-	Matrix<double, 6, 6> innovation_cov = cov.corner<6, 6>(Eigen::BottomRight);
+	Matrix<FloatT, 6, 6> innovation_cov = cov.template corner<6, 6>(Eigen::BottomRight);
 	//innovation_cov = obs_matrix * cov * obs_matrix.transpose();
-	innovation_cov.corner<3, 3>(Eigen::TopLeft) += p_error.asDiagonal();
-	innovation_cov.corner<3, 3>(Eigen::BottomRight) += v_error.asDiagonal();
+	innovation_cov.template corner<3, 3>(Eigen::TopLeft) += p_error.asDiagonal();
+	innovation_cov.template corner<3, 3>(Eigen::BottomRight) += v_error.asDiagonal();
 #if 1
 	// Perform matrix inverse by LU decomposition instead of cofactor expansion.
 	// K = P*transpose(H)*inverse(S)
@@ -101,14 +111,14 @@ basic_ins_qkf::obs_gps_pv_report(
 	// S == transpose(S)
 	// K = P*transpose(inverse(S)*H)
 	// obs_matrx <- inverse(S)*H
-	Matrix<double, 6, 12> inv_s_h;
+	Matrix<FloatT, 6, 12> inv_s_h;
 	innovation_cov.qr().solve(obs_matrix, &inv_s_h);
-	Matrix<double, 12, 6> kalman_gain = cov * inv_s_h.transpose();
+	Matrix<FloatT, 12, 6> kalman_gain = cov * inv_s_h.transpose();
 #else
-	Matrix<double, 12, 6> kalman_gain = cov.block<12, 6>(0, 6) * innovation_cov.inverse();
+	Matrix<FloatT, 12, 6> kalman_gain = cov.template block<12, 6>(0, 6) * innovation_cov.inverse();
 #endif
-	Quaterniond rotor = avg_state.apply_kalman_vec_update(kalman_gain * residual);
-	cov.part<Eigen::SelfAdjoint>() -= kalman_gain * obs_matrix * cov;
+	quaternion_t rotor = avg_state.apply_kalman_vec_update(kalman_gain * residual);
+	cov.template part<Eigen::SelfAdjoint>() -= kalman_gain * obs_matrix * cov;
 	counter_rotate_cov(rotor);
 	assert(is_real());
 #endif
@@ -119,3 +129,7 @@ basic_ins_qkf::obs_gps_pv_report(
 #endif
 }
 
+template void ins_qkf<double>::obs_gps_v_report(const Vector3d&, const Vector3d&);
+template void ins_qkf<float>::obs_gps_v_report(const Vector3f&, const Vector3f&);
+template void ins_qkf<double>::obs_gps_pv_report(const Vector3d&, const Vector3d&, const Vector3d&, const Vector3d);
+template void ins_qkf<float>::obs_gps_pv_report(const Vector3d&, const Vector3f&, const Vector3f&, const Vector3f);
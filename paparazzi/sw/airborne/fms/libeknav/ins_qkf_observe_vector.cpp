@@ -32,20 +32,33 @@ using namespace Eigen;
 
 #include <Eigen/LU>
 
+template<typename FloatT>
 void
-basic_ins_qkf::obs_gyro_bias(const Vector3d& bias, const Vector3d& bias_error)
+ins_qkf<FloatT>::obs_gyro_bias(const vector3_t& bias, const vector3_t& bias_error)
 {
-	Matrix<double, 12, 3> kalman_gain = cov.block<12, 3>(0, 0) 
-			* (cov.block<3, 3>(0, 0) + bias_error.asDiagonal()).inverse();
-	cov -= kalman_gain * cov.block<3, 12>(0, 0);
-	Vector3d innovation = bias - avg_state.gyro_bias;
+#if INS_QKF_UD_COVARIANCE
+	vector3_t innovation = bias - avg_state.gyro_bias;
+	state_error_t update = state_error_t::Zero();
+	for (int i = 0; i < 3; ++i) {
+		state_error_t gain = ud_scalar_obs(state_error_t::Unit(i), bias_error[i]);
+		update += gain * (innovation[i] - update[i]);
+	}
+	mark_cov_stale();
+	avg_state.apply_kalman_vec_update(update);
+#else
+	Matrix<FloatT, 12, 3> kalman_gain = cov.template block<12, 3>(0, 0) 
+			* (cov.template block<3, 3>(0, 0) + bias_error.asDiagonal()).inverse();
+	cov -= kalman_gain * cov.template block<3, 12>(0, 0);
+	vector3_t innovation = bias - avg_state.gyro_bias;
 
 	// Apply the Kalman gain to obtain the posterior state and error estimates.
 	avg_state.apply_kalman_vec_update(kalman_gain * innovation);
+#endif
 }
 
+template<typename FloatT>
 void
-basic_ins_qkf::obs_vector(const Vector3d& ref, const Vector3d& obs, double error)
+ins_qkf<FloatT>::obs_vector(const vector3_t& ref, const vector3_t& obs, FloatT error)
 {
 #ifdef TIME_OPS
 	timer clock;
@@ -140,48 +153,58 @@ basic_ins_qkf::obs_vector(const Vector3d& ref, const Vector3d& obs, double error
 #else
 	// BIG optimization opportunity: Use a pseudo-linear measurement model.
 
-	Vector3d obs_ref = avg_state.orientation.conjugate()*obs;
-	Vector3d v_residual = log<double>(Quaterniond().setFromTwoVectors(ref, obs_ref));
+	vector3_t obs_ref = avg_state.orientation.conjugate()*obs;
+	vector3_t v_residual = log<FloatT>(quaternion_t().setFromTwoVectors(ref, obs_ref));
 
-	Matrix<double, 3, 2> h_trans;
+	Matrix<FloatT, 3, 2> h_trans;
 	h_trans.col(0) = ref.cross(
 			(abs(ref.dot(obs_ref)) < 0.9994) ? obs_ref :
-				(abs(ref.dot(Vector3d::UnitX())) < 0.707)
-				? Vector3d::UnitX() : Vector3d::UnitY()).normalized();
+				(abs(ref.dot(vector3_t::UnitX())) < 0.707)
+				? vector3_t::UnitX() : vector3_t::UnitY()).normalized();
   
 	h_trans.col(1) = -ref.cross(h_trans.col(0));
 	assert(!hasNaN(h_trans));
 	assert(h_trans.isUnitary());
-	Vector2d innovation = h_trans.transpose() * v_residual;
+	vector2_t innovation = h_trans.transpose() * v_residual;
 #ifdef RANK_ONE_UPDATES
 	// Running a rank-one update here is a strict win.
-	Matrix<double, 12, 1> update = Matrix<double, 12, 1>::Zero();
+	state_error_t update = state_error_t::Zero();
 	for (int i = 0; i < 2; ++i) {
-		double obs_error = error;
-		double obs_cov = (h_trans.col(i).transpose() * cov.block<3, 3>(3, 3) * h_trans.col(i))[0];
-		Matrix<double, 12, 1> gain = cov.block<12, 3>(0, 3) * h_trans.col(i) / (obs_error + obs_cov);
+#if INS_QKF_UD_COVARIANCE
+		state_error_t h = state_error_t::Zero();
+		h.template segment<3>(3) = h_trans.col(i);
+		state_error_t gain = ud_scalar_obs(h, error);
+		update += gain * h_trans.col(i).transpose() * v_residual;
+#else
+		FloatT obs_error = error;
+		FloatT obs_cov = (h_trans.col(i).transpose() * cov.template block<3, 3>(3, 3) * h_trans.col(i))[0];
+		state_error_t gain = cov.template block<12, 3>(0, 3) * h_trans.col(i) / (obs_error + obs_cov);
 		update += gain * h_trans.col(i).transpose() * v_residual;
-		cov -= gain * h_trans.col(i).transpose() * cov.block<3, 12>(3, 0);
+		cov -= gain * h_trans.col(i).transpose() * cov.template block<3, 12>(3, 0);
+#endif
 	}
+#if INS_QKF_UD_COVARIANCE
+	mark_cov_stale();
+#endif
 #else
-	Matrix<double, 12, 2> kalman_gain = cov.block<12, 3>(0, 3) * h_trans
-			* (h_trans.transpose() * cov.block<3, 3>(3, 3) * h_trans 
-				+ (Vector2d() << error, error).finished().asDiagonal()).inverse();
-	cov -= kalman_gain * h_trans.transpose() * cov.block<3, 12>(3, 0);
+	Matrix<FloatT, 12, 2> kalman_gain = cov.template block<12, 3>(0, 3) * h_trans
+			* (h_trans.transpose() * cov.template block<3, 3>(3, 3) * h_trans 
+				+ (vector2_t() << error, error).finished().asDiagonal()).inverse();
+	cov -= kalman_gain * h_trans.transpose() * cov.template block<3, 12>(3, 0);
 #endif
 
 #endif
 
 	// Apply the Kalman gain to obtain the posterior state and error estimates.
 #ifndef RANK_ONE_UPDATES
-	Matrix<double, 12, 1> update = (kalman_gain * innovation);
+	state_error_t update = (kalman_gain * innovation);
 #endif
 
 #if DEBUG_VECTOR_OBS
 	// std::cout << "projected update: " << (obs_projection * update.segment<3>(3)).transpose() << "\n";
-	std::cout << "deprojected update: " << update.segment<3>(3).transpose() << "\n";
+	std::cout << "deprojected update: " << update.template segment<3>(3).transpose() << "\n";
 #endif
-	Quaterniond posterior_update = avg_state.apply_kalman_vec_update(update);
+	quaternion_t posterior_update = avg_state.apply_kalman_vec_update(update);
 	counter_rotate_cov(posterior_update);
 
 	assert(is_real());
@@ -191,3 +214,8 @@ basic_ins_qkf::obs_vector(const Vector3d& ref, const Vector3d& obs, double error
 #endif
 
 }
+
+template void ins_qkf<double>::obs_gyro_bias(const Vector3d&, const Vector3d&);
+template void ins_qkf<float>::obs_gyro_bias(const Vector3f&, const Vector3f&);
+template void ins_qkf<double>::obs_vector(const Vector3d&, const Vector3d&, double);
+template void ins_qkf<float>::obs_vector(const Vector3f&, const Vector3f&, float);
@@ -37,15 +37,22 @@ using namespace Eigen;
 
 namespace {
 
-Matrix<double, 3, 3>
-axis_scale(const Vector3d& axis, double scale)
+template<typename FloatT>
+Matrix<FloatT, 3, 3>
+axis_scale(const Matrix<FloatT, 3, 1>& axis, FloatT scale)
 {
-	return (scale - 1) * axis * axis.transpose() + Matrix3d::Identity();
+	return (scale - 1) * axis * axis.transpose() + Matrix<FloatT, 3, 3>::Identity();
 }
 
+template<typename FloatT>
 void
-linear_predict(basic_ins_qkf& _this, const Vector3d& gyro_meas, const Vector3d& accel_meas, double dt)
+linear_predict(ins_qkf<FloatT>& _this, const Matrix<FloatT, 3, 1>& gyro_meas,
+		const Matrix<FloatT, 3, 1>& accel_meas, FloatT dt)
 {
+	typedef typename ins_qkf<FloatT>::vector3_t vector3_t;
+	typedef typename ins_qkf<FloatT>::matrix3_t matrix3_t;
+	typedef typename ins_qkf<FloatT>::quaternion_t quaternion_t;
+
 	// The two components of rotation that do not spin about the gravity vector
 	// have an influence on the position and velocity of the vehicle.
 	// Let r be an error axis of rotation, and z be the gravity vector.
@@ -59,11 +66,11 @@ linear_predict(basic_ins_qkf& _this, const Vector3d& gyro_meas, const Vector3d&
 	// of the vehicle orientation and the translational reference frame.
 	
 	
-	Matrix3d rot = _this.avg_state.orientation.conjugate().toRotationMatrix();
+	matrix3_t rot = _this.avg_state.orientation.conjugate().toRotationMatrix();
 	
-	Vector3d accel_ecef = rot*accel_meas;		// a_e = (q_e2b)^* x a_b = q_b2e x a_b
-	Vector3d accel_gravity = _this.avg_state.position.normalized()*(-9.81);         
-	Vector3d accel_resid = accel_ecef + accel_gravity;								// a = (xdd-g)+g = xdd;
+	vector3_t accel_ecef = rot*accel_meas;		// a_e = (q_e2b)^* x a_b = q_b2e x a_b
+	vector3_t accel_gravity = (_this.avg_state.position.normalized()*(-9.81)).template cast<FloatT>();
+	vector3_t accel_resid = accel_ecef + accel_gravity;								// a = (xdd-g)+g = xdd;
 	
 	#if 0
 	printf("==================================================\n");
@@ -79,84 +86,104 @@ linear_predict(basic_ins_qkf& _this, const Vector3d& gyro_meas, const Vector3d&
 	
 #if 0
 	// This form works well with zero static acceleration.
-	Matrix<double, 3, 3> accel_cov =
-		Eigen::AngleAxisd(-M_PI*0.5, _this.avg_state.position.normalized())
-		* axis_scale(_this.avg_state.position.normalized(), 0) * 9.81;
+	Matrix<FloatT, 3, 3> accel_cov =
+		Eigen::AngleAxis<FloatT>(-M_PI*0.5, _this.avg_state.position.normalized())
+		* axis_scale<FloatT>(_this.avg_state.position.normalized(), 0) * 9.81;
 #elif 1
-	Matrix<double, 3, 3> accel_cov =
-		Eigen::AngleAxisd(-M_PI*0.5, accel_ecef.normalized())
-		* axis_scale(accel_ecef.normalized(), 0) * accel_meas.norm();
+	matrix3_t accel_cov =
+		Eigen::AngleAxis<FloatT>(FloatT(-M_PI*0.5), accel_ecef.normalized())
+		* axis_scale<FloatT>(accel_ecef.normalized(), 0) * accel_meas.norm();
 #else
 	// The following form ends up being identical to the simpler one
 	// above
-	Matrix<double, 3, 3> accel_cov =
-		Eigen::AngleAxisd(-M_PI*0.5, _this.avg_state.position.normalized())
-		* axis_scale(_this.avg_state.position.normalized(), 0) * 9.81
-		+ Eigen::AngleAxisd(-M_PI*0.5, accel_resid.normalized())
-		* axis_scale(accel_resid.normalized(), 0)*accel_resid.norm();
+	Matrix<FloatT, 3, 3> accel_cov =
+		Eigen::AngleAxis<FloatT>(-M_PI*0.5, _this.avg_state.position.normalized())
+		* axis_scale<FloatT>(_this.avg_state.position.normalized(), 0) * 9.81
+		+ Eigen::AngleAxis<FloatT>(-M_PI*0.5, accel_resid.normalized())
+		* axis_scale<FloatT>(accel_resid.normalized(), 0)*accel_resid.norm();
 #endif
 	// TODO: Optimization opportunity: the accel_cov doesn't change much over
 	// the life of a mission. Precompute it once and then retain the original.
 	// Then, only one 3x3 block ever gets updated in the A matrix below.
 
+#if INS_QKF_UD_COVARIANCE
+	// Same projection as the unrolled block update below, applied to the
+	// U*D*U^T factors: no re-symmetrization needed.
+	const matrix3_t dtR = dt * _this.avg_state.orientation.conjugate().toRotationMatrix();
+	const matrix3_t dtQ = accel_cov * dt;
+	Matrix<FloatT, 12, 12> A = Matrix<FloatT, 12, 12>::Identity();
+	A.template block<3, 3>(3, 0) = -dtR;
+	A.template block<3, 3>(6, 9) = matrix3_t::Identity() * dt;
+	A.template block<3, 3>(9, 3) = -dtQ;
+	Matrix<FloatT, 12, 1> q;
+	q << _this.gyro_stability_noise * dt,
+		 _this.gyro_white_noise * dt,
+		 _this.accel_white_noise * FloatT(0.5)*dt*dt,
+		 _this.accel_white_noise * dt;
+	_this.cov_ud.predict(A, q);
+	_this.cov_stale = true; // rebuilt at the next covariance()
+#else
 	// The linearized Kalman state projection matrix.
 #if 0
-	Matrix<double, 12, 12> A;
+	Matrix<FloatT, 12, 12> A;
 	     // gyro bias row
-	A << Matrix<double, 3, 3>::Identity(), Matrix<double, 3, 9>::Zero(),
+	A << Matrix<FloatT, 3, 3>::Identity(), Matrix<FloatT, 3, 9>::Zero(),
 		 // Orientation row
 		 _this.avg_state.orientation.conjugate().toRotationMatrix()*-dt,
-			 Matrix<double, 3, 3>::Identity(), Matrix<double, 3, 6>::Zero(),
+			 Matrix<FloatT, 3, 3>::Identity(), Matrix<FloatT, 3, 6>::Zero(),
 		 // Position row
-		 Matrix<double, 3, 3>::Zero(), -accel_cov*0.5*dt*dt,
-			 Matrix<double, 3, 3>::Identity(), Matrix<double, 3, 3>::Identity()*dt,
+		 Matrix<FloatT, 3, 3>::Zero(), -accel_cov*0.5*dt*dt,
+			 Matrix<FloatT, 3, 3>::Identity(), Matrix<FloatT, 3, 3>::Identity()*dt,
 		 // Velocity row
-		 Matrix<double, 3, 3>::Zero(), -accel_cov * dt,
-			 Matrix<double, 3, 3>::Zero(), Matrix<double, 3, 3>::Identity();
+		 Matrix<FloatT, 3, 3>::Zero(), -accel_cov * dt,
+			 Matrix<FloatT, 3, 3>::Zero(), Matrix<FloatT, 3, 3>::Identity();
 
 	// 800x realtime, with vectorization
-	_this.cov.part<Eigen::SelfAdjoint>() = A * _this.cov * A.transpose();
+	_this.cov.template part<Eigen::SelfAdjoint>() = A * _this.cov * A.transpose();
 #else
 	// 1500x realtime, without vectorization, on 2.2 GHz Athlon X2
-	const Matrix<double, 12, 12> cov = _this.cov;
-	const Matrix3d dtR = dt * _this.avg_state.orientation.conjugate().toRotationMatrix();
-	const Matrix3d dtQ = accel_cov * dt;
-
-	_this.cov.block<3, 3>(0, 3) -= cov.block<3,3>(0, 0)*dtR.transpose();
-	_this.cov.block<3, 3>(0, 6) += dt * cov.block<3, 3>(0, 9);
-	_this.cov.block<3, 3>(0, 9) -= cov.block<3, 3>(0, 3) * dtQ.transpose();
-	_this.cov.block<3, 3>(3, 3).part<Eigen::SelfAdjoint>() += dtR*cov.block<3, 3>(0, 0)*dtR.transpose()
-			- dtR*cov.block<3, 3>(0, 3) - cov.block<3, 3>(3, 0)*dtR.transpose();
-	_this.cov.block<3, 3>(3, 6) += -dtR * (cov.block<3, 3>(0, 6) + dt*cov.block<3, 3>(0, 9))
-			+ dt*cov.block<3, 3>(3, 9);
-	_this.cov.block<3, 3>(3, 9) += -dtR*( -cov.block<3, 3>(0, 3)*dtQ.transpose() + cov.block<3, 3>(0, 9))
-			- cov.block<3, 3>(3, 3)*dtQ.transpose();
-	_this.cov.block<3, 3>(6, 6).part<Eigen::SelfAdjoint>() += dt*cov.block<3, 3>(6, 9) + dt*dt*cov.block<3, 3>(9, 9)
-			+ dt*cov.block<3, 3>(9, 6);
-	_this.cov.block<3, 3>(6, 9) += -cov.block<3, 3>(6, 3)*dtQ.transpose() + dt*cov.block<3, 3>(9, 9)
-			- dt*cov.block<3, 3>(9, 3)*dtQ.transpose();
-	_this.cov.block<3, 3>(9, 9).part<Eigen::SelfAdjoint>() += dtQ*cov.block<3, 3>(3, 3)*dtQ.transpose()
-			- dtQ*cov.block<3, 3>(3, 9) - cov.block<3, 3>(9, 3)*dtQ.transpose();
-
-	_this.cov.block<3, 3>(3, 0) = _this.cov.block<3, 3>(0, 3).transpose();
-	_this.cov.block<3, 3>(6, 0) = _this.cov.block<3, 3>(0, 6).transpose();
-	_this.cov.block<3, 3>(6, 3) = _this.cov.block<3, 3>(3, 6).transpose();
-	_this.cov.block<3, 3>(9, 0) = _this.cov.block<3, 3>(0, 9).transpose();
-	_this.cov.block<3, 3>(9, 3) = _this.cov.block<3, 3>(3, 9).transpose();
-	_this.cov.block<3, 3>(9, 6) = _this.cov.block<3, 3>(6, 9).transpose();
+	const Matrix<FloatT, 12, 12> cov = _this.cov;
+	const matrix3_t dtR = dt * _this.avg_state.orientation.conjugate().toRotationMatrix();
+	const matrix3_t dtQ = accel_cov * dt;
+
+	_this.cov.template block<3, 3>(0, 3) -= cov.template block<3,3>(0, 0)*dtR.transpose();
+	_this.cov.template block<3, 3>(0, 6) += dt * cov.template block<3, 3>(0, 9);
+	_this.cov.template block<3, 3>(0, 9) -= cov.template block<3, 3>(0, 3) * dtQ.transpose();
+	_this.cov.template block<3, 3>(3, 3).template part<Eigen::SelfAdjoint>() += dtR*cov.template block<3, 3>(0, 0)*dtR.transpose()
+			- dtR*cov.template block<3, 3>(0, 3) - cov.template block<3, 3>(3, 0)*dtR.transpose();
+	_this.cov.template block<3, 3>(3, 6) += -dtR * (cov.template block<3, 3>(0, 6) + dt*cov.template block<3, 3>(0, 9))
+			+ dt*cov.template block<3, 3>(3, 9);
+	_this.cov.template block<3, 3>(3, 9) += -dtR*( -cov.template block<3, 3>(0, 3)*dtQ.transpose() + cov.template block<3, 3>(0, 9))
+			- cov.template block<3, 3>(3, 3)*dtQ.transpose();
+	_this.cov.template block<3, 3>(6, 6).template part<Eigen::SelfAdjoint>() += dt*cov.template block<3, 3>(6, 9) + dt*dt*cov.template block<3, 3>(9, 9)
+			+ dt*cov.template block<3, 3>(9, 6);
+	_this.cov.template block<3, 3>(6, 9) += -cov.template block<3, 3>(6, 3)*dtQ.transpose() + dt*cov.template block<3, 3>(9, 9)
+			- dt*cov.template block<3, 3>(9, 3)*dtQ.transpose();
+	_this.cov.template block<3, 3>(9, 9).template part<Eigen::SelfAdjoint>() += dtQ*cov.template block<3, 3>(3, 3)*dtQ.transpose()
+			- dtQ*cov.template block<3, 3>(3, 9) - cov.template block<3, 3>(9, 3)*dtQ.transpose();
+
+	_this.cov.template block<3, 3>(3, 0) = _this.cov.template block<3, 3>(0, 3).transpose();
+	_this.cov.template block<3, 3>(6, 0) = _this.cov.template block<3, 3>(0, 6).transpose();
+	_this.cov.template block<3, 3>(6, 3) = _this.cov.template block<3, 3>(3, 6).transpose();
+	_this.cov.template block<3, 3>(9, 0) = _this.cov.template block<3, 3>(0, 9).transpose();
+	_this.cov.template block<3, 3>(9, 3) = _this.cov.template block<3, 3>(3, 9).transpose();
+	_this.cov.template block<3, 3>(9, 6) = _this.cov.template block<3, 3>(6, 9).transpose();
 #endif
 
-	_this.cov.block<3, 3>(0, 0) += _this.gyro_stability_noise.asDiagonal() * dt;
-	_this.cov.block<3, 3>(3, 3) += _this.gyro_white_noise.asDiagonal() * dt;
-	_this.cov.block<3, 3>(6, 6) += _this.accel_white_noise.asDiagonal() * 0.5*dt*dt;
-	_this.cov.block<3, 3>(9, 9) += _this.accel_white_noise.asDiagonal() * dt;
+	_this.cov.template block<3, 3>(0, 0) += _this.gyro_stability_noise.asDiagonal() * dt;
+	_this.cov.template block<3, 3>(3, 3) += _this.gyro_white_noise.asDiagonal() * dt;
+	_this.cov.template block<3, 3>(6, 6) += _this.accel_white_noise.asDiagonal() * FloatT(0.5)*dt*dt;
+	_this.cov.template block<3, 3>(9, 9) += _this.accel_white_noise.asDiagonal() * dt;
+#endif /* INS_QKF_UD_COVARIANCE */
 
-	Quaterniond orientation = exp<double>((gyro_meas - _this.avg_state.gyro_bias) * dt)
+	quaternion_t orientation = exp<FloatT>((gyro_meas - _this.avg_state.gyro_bias) * dt)
 			* _this.avg_state.orientation;
 	//Vector3d accel = accel_ecef - _this.avg_state.position.normalized() * 9.81;
 	//std::cout << "   ACCEL______(" << accel.transpose() << ")\n";
-	Vector3d position = _this.avg_state.position + _this.avg_state.velocity * dt + 0.5*accel_resid*dt*dt;
-	Vector3d velocity = _this.avg_state.velocity + accel_resid*dt;
+	// the position alone is double
+	Vector3d position = _this.avg_state.position + (_this.avg_state.velocity * dt).template cast<double>()
+			+ (FloatT(0.5)*accel_resid*dt*dt).template cast<double>();
+	vector3_t velocity = _this.avg_state.velocity + accel_resid*dt;
 
 	_this.avg_state.position = position;
 	_this.avg_state.velocity = velocity;
@@ -165,8 +192,9 @@ linear_predict(basic_ins_qkf& _this, const Vector3d& gyro_meas, const Vector3d&
 
 } // !namespace (anon)
 
+template<typename FloatT>
 void
-basic_ins_qkf::predict(const Vector3d& gyro_meas, const Vector3d& accel_meas, double dt)
+ins_qkf<FloatT>::predict(const vector3_t& gyro_meas, const vector3_t& accel_meas, FloatT dt)
 {
 #ifdef TIME_OPS
 	timer clock;
@@ -182,3 +210,5 @@ basic_ins_qkf::predict(const Vector3d& gyro_meas, const Vector3d& accel_meas, do
 #endif
 }
 
+template void ins_qkf<double>::predict(const Vector3d&, const Vector3d&, double);
+template void ins_qkf<float>::predict(const Vector3f&, const Vector3f&, float);
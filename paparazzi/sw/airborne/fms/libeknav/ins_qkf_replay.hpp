@@ -0,0 +1,429 @@
+/*
+ * ins_qkf_replay.hpp
+ *
+ * Feeding ins_qkf from a recorded sensor stream, shared by the host tools
+ * that replay logs: a raw log recorded on the FMS (see raw_log.h), read
+ * through a memory map, or the synthetic flight.  run_filter_on_log
+ * (libeknav_from_log) runs its filter through the same initialization,
+ * tuning and ins_qkf_fusion front end, so that what the other tools
+ * measure or tune is the pipeline it runs.
+ */
+
+#ifndef INS_QKF_REPLAY_HPP
+#define INS_QKF_REPLAY_HPP
+
+#include "ins_qkf.hpp"
+#include "ins_qkf_fusion.hpp"
+#include "estimate_attitude.h"
+#include "synthetic_flight.hpp"
+
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "std.h"
+#include "math/pprz_algebra_int.h"
+#include "math/pprz_algebra_float.h"
+#include "math/pprz_geodetic_double.h"
+#include "fms/fms_autopilot_msg.h"
+#include "fms/libeknav/raw_log.h"
+#include "fms/libeknav/raw_log_map.h"
+
+#define IMU_DT                0.001953125
+/* intervals between IMU samples longer than this are log discontinuities */
+#define MAX_IMU_INTERVAL      0.1
+#define INT32_BARO_FRAC       8
+// measured with GPS while climbing approximately 80 m
+#define BARO_SCALING          10.17
+#define BARO_FLOAT_OF_BFP(_ai) (FLOAT_OF_BFP((_ai), INT32_BARO_FRAC)*BARO_SCALING)
+#define GRAVITY               9.81
+#define MAX_DISTANCE_FROM_GRAVITY_FOR_UPDATE 0.03
+/* GPS noises are inflated by this factor in the filter */
+#define GPS_NOISE_SCALE       10
+
+/* samples averaged by raw_log_setup() before the filter starts */
+#define MINIMAL_IMU_MEASUREMENTS            1000
+#define MINIMAL_MAGNETIC_FIELD_MEASUREMENTS   30
+#define MINIMAL_BARO_MEASUREMENTS             30
+#define MINIMAL_GPS_MEASUREMENTS              10
+
+/* NED, normalized */
+static const Eigen::Vector3d mag_field_ned(0.51562740288882, -0.05707735220832, 0.85490967783446);
+
+// NOTE: Measured during hovering in the air. Movement in the range of a 1 m³ cube with (approx.) max. 0.2 m/s speed.
+static const Eigen::Vector3d gyroscope_noise      ( 1.0449e-1,  1.1191e-1,  4.5906e-2 );
+static const Eigen::Vector3d gyro_stability_noise ( 1.0000e-3,  1.0000e-3,  1.0000e-3 );
+static const Eigen::Vector3d accelerometer_noise  ( 2.5457e+0,  1.8242e+0,  1.5660e+0 );
+static const Eigen::Vector3d magnetometer_noise   ( 1.5783e-2,  1.4736e-2,  1.0911e-2 );
+static const Eigen::Vector3d gps_pos_noise        ( 6.9348e+0,  1.4180e+0,  7.3982e+0 );
+static const Eigen::Vector3d gps_speed_noise      ( 1.4283e+0,  4.2384e-1,  1.5453e+0 );
+static const double   baro_noise = 0.25;
+static const unsigned short imu_frequency = 512;
+static const unsigned short mag_frequency = 13;
+
+/** One step of sensor data */
+struct replay_input
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	double time;
+	Eigen::Vector3d gyro, accel, mag, gps_p, gps_v;
+	double baro;
+	bool imu_ready, mag_ready, baro_ready, gps_ready;
+};
+
+/** Everything the filters need besides the measurements */
+struct replay_setup
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	Eigen::Vector3d position, velocity, gyro_bias;
+	Eigen::Quaterniond orientation;
+	Eigen::Matrix<double, 12, 1> sigma;    // initial one sigma errors
+	Eigen::Vector3d gyro_white, gyro_stability, accel_white;
+	Eigen::Vector3d mag_reference;         // ecef
+	double mag_error, gravity_error, baro_error;
+	Eigen::Vector3d gps_p_error, gps_v_error;
+	bool gravity_update;
+	double nominal_dt;                     // IMU period
+	double gps_latency;                    // age of the GPS fixes when logged
+};
+
+static inline double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * A filter of precision FloatT fed from double inputs, through the
+ * ins_qkf_fusion front end: propagated by the sample timestamps, GPS
+ * fixes applied at their measurement time.  The conversions are done
+ * before the clock starts.  step() is propagate() followed by
+ * observe_gps(), split for the tools that look at the filter right
+ * before the GPS update.
+ */
+template<typename FloatT>
+struct replay_filter
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	typedef typename ins_qkf<FloatT>::vector3_t vector3_t;
+	typedef typename ins_qkf<FloatT>::covariance_t covariance_t;
+
+	ins_qkf<FloatT> ins;
+	ins_qkf_fusion<FloatT> fusion;
+	double total_ns;
+
+	replay_filter(const replay_setup& s)
+		: ins(s.position, 0, 0, 0,
+				s.gyro_white.template cast<FloatT>(),
+				s.gyro_stability.template cast<FloatT>(),
+				s.accel_white.template cast<FloatT>(),
+				s.orientation.template cast<FloatT>(),
+				s.velocity.template cast<FloatT>())
+		, fusion(ins, s.nominal_dt, MAX_IMU_INTERVAL)
+		, total_ns(0)
+	{
+		ins.avg_state.gyro_bias = s.gyro_bias.template cast<FloatT>();
+		Eigen::Matrix<double, 12, 1> var = s.sigma.cwise() * s.sigma;
+		ins.set_cov(covariance_t(var.template cast<FloatT>().asDiagonal()));
+	}
+
+	/**
+	 * predict and every update but the GPS
+	 * @return false if the input has no IMU sample, or one not newer than the last
+	 */
+	bool propagate(const replay_input& in, const replay_setup& s)
+	{
+		if (!in.imu_ready)
+			return false;
+		const vector3_t gyro = in.gyro.template cast<FloatT>();
+		const vector3_t accel = in.accel.template cast<FloatT>();
+		const vector3_t mag = in.mag.template cast<FloatT>();
+		const vector3_t mag_ref = s.mag_reference.template cast<FloatT>();
+		const bool gravity = s.gravity_update
+			&& fabs(in.accel.norm() - GRAVITY) < MAX_DISTANCE_FROM_GRAVITY_FOR_UPDATE;
+
+		double t0 = now_ns();
+		bool accepted = fusion.imu(in.time, gyro, accel);
+		if (accepted) {
+			if (in.mag_ready)
+				fusion.obs_vector(mag_ref, mag, FloatT(s.mag_error));
+			if (gravity)
+				fusion.obs_gravity(FloatT(s.gravity_error));
+			if (in.baro_ready)
+				fusion.obs_baro_report(in.baro, FloatT(s.baro_error));
+		}
+		total_ns += now_ns() - t0;
+		return accepted;
+	}
+
+	void observe_gps(const replay_input& in, const replay_setup& s)
+	{
+		if (!in.gps_ready)
+			return;
+		const vector3_t gps_v = in.gps_v.template cast<FloatT>();
+		const vector3_t gps_p_error = s.gps_p_error.template cast<FloatT>();
+		const vector3_t gps_v_error = s.gps_v_error.template cast<FloatT>();
+
+		double t0 = now_ns();
+		fusion.obs_gps_pv_report(in.time - s.gps_latency, in.gps_p, gps_v, gps_p_error, gps_v_error);
+		total_ns += now_ns() - t0;
+	}
+
+	/**
+	 * The GPS fix is used even when the IMU sample is not: the fusion
+	 * places it by its own time, and counts it if it is dropped.
+	 * @return false if the IMU sample was not used
+	 */
+	bool step(const replay_input& in, const replay_setup& s)
+	{
+		bool imu_used = propagate(in, s);
+		observe_gps(in, s);
+		return imu_used;
+	}
+};
+
+/*
+ * Raw FMS log
+ */
+
+/** Decode the entry *index of the log, false at its end */
+static inline bool read_raw_input(const struct raw_log_map& log, size_t& index, replay_input& in)
+{
+	using Eigen::Vector3d;
+	if (index >= log.nb_entries)
+		return false;
+	const struct raw_log_entry& e = log.entries[index++];
+	uint8_t valid = e.message.valid_sensors;
+	in.time = e.time;
+	in.gyro = Vector3d(RATE_FLOAT_OF_BFP(e.message.gyro.p), RATE_FLOAT_OF_BFP(e.message.gyro.q),
+			RATE_FLOAT_OF_BFP(e.message.gyro.r));
+	in.accel = Vector3d(ACCEL_FLOAT_OF_BFP(e.message.accel.x), ACCEL_FLOAT_OF_BFP(e.message.accel.y),
+			ACCEL_FLOAT_OF_BFP(e.message.accel.z));
+	in.mag = Vector3d(MAG_FLOAT_OF_BFP(e.message.mag.x), MAG_FLOAT_OF_BFP(e.message.mag.y),
+			MAG_FLOAT_OF_BFP(e.message.mag.z));
+	in.gps_p = Vector3d(e.message.ecef_pos.x, e.message.ecef_pos.y, e.message.ecef_pos.z) / 100;
+	in.gps_v = Vector3d(e.message.ecef_vel.x, e.message.ecef_vel.y, e.message.ecef_vel.z) / 100;
+	in.baro = -BARO_FLOAT_OF_BFP(e.message.pressure_absolute);
+	in.imu_ready = valid & (1<<VI_IMU_DATA_VALID);
+	in.mag_ready = valid & (1<<VI_MAG_DATA_VALID);
+	in.baro_ready = valid & (1<<VI_BARO_ABS_DATA_VALID);
+	in.gps_ready = valid & (1<<VI_GPS_DATA_VALID);
+	return true;
+}
+
+/** ecef to body orientation from the ned to body one of pprz, at ecef_pos */
+static inline Eigen::Quaterniond ecef2body_from_pprz_ned2body(const Eigen::Vector3d& ecef_pos,
+		struct DoubleQuat q_ned2body)
+{
+	using namespace Eigen;
+	struct LtpDef_d   ltp;
+	struct EcefCoor_d ecef_pos_pprz;
+	struct DoubleQuat q_ecef2enu,
+	                  q_ecef2ned,
+	                  q_ecef2body;
+
+	VECTOR_AS_VECT3(ecef_pos_pprz, ecef_pos);
+	ltp_def_from_ecef_d(&ltp, &ecef_pos_pprz);
+	DOUBLE_QUAT_OF_RMAT(q_ecef2enu, ltp.ltp_of_ecef);
+	QUAT_ENU_FROM_TO_NED(q_ecef2enu, q_ecef2ned);
+	// a = ecef b = ned c = body
+	FLOAT_QUAT_COMP_INV_NORM_SHORTEST(q_ecef2body, q_ecef2ned, q_ned2body);
+	return DOUBLEQUAT_AS_QUATERNIOND(q_ecef2body);
+}
+
+/** one sigma euler errors of the orientation q, from the one sigma quaternion error */
+static inline struct DoubleEulers sigma_euler_from_sigma_q(struct DoubleQuat q, struct DoubleQuat sigma_q)
+{
+	struct DoubleVect3 v_q, v_sigma, temporary_result;
+	struct DoubleEulers sigma_eu;
+
+	QUAT_IMAGINARY_PART(q, v_q);
+	QUAT_IMAGINARY_PART(sigma_q, v_sigma);
+	if (DOUBLE_VECT3_NORM(v_sigma) > 0.5) {
+		EULERS_ASSIGN(sigma_eu, M_PI_2, M_PI_2, M_PI_2);
+		return sigma_eu;
+	}
+
+	DOUBLE_VECT3_CROSS_PRODUCT(temporary_result, v_q, v_sigma);
+
+	VECT3_SMUL(v_q, v_q, sigma_q.qi);
+	VECT3_SMUL(v_sigma, v_sigma, q.qi);
+
+	VECT3_ADD(temporary_result, v_sigma);
+	VECT3_SUB(temporary_result, v_q);
+
+	VECT3_TO_EULERS(temporary_result, sigma_eu);
+
+	return sigma_eu;
+}
+
+/**
+ * The initialization of run_filter_on_log.  From the first GPS fix on,
+ * or from the start of the log with a known position pos_0, the sensors
+ * are averaged until MINIMAL_*_MEASUREMENTS of each came in.  The gyro
+ * bias is their mean rate, the orientation the solution of Wahba's
+ * problem on gravity and magnetic field (estimate_attitude.h), position
+ * and velocity the mean of the GPS fixes.  index is left on the first
+ * entry to replay.
+ * @param pos_0 Initial ECEF position, NULL to take it from the GPS
+ * @return false if the log ends before
+ */
+static inline bool raw_log_setup(const struct raw_log_map& log, size_t& index,
+		replay_setup& s, double& baro_offset, const Eigen::Vector3d* pos_0 = NULL)
+{
+	using namespace Eigen;
+	Vector3d gyro_sum = Vector3d::Zero(), gps_p_sum = Vector3d::Zero(), gps_v_sum = Vector3d::Zero();
+	double baro_sum = 0;
+	int nb_imu = 0, nb_mag = 0, nb_baro = 0, nb_gps = 0;
+	replay_input in;
+
+	struct DoubleMat33 attitude_profile_matrix, sigmaB;   // the attitude profile matrix is often called "B"
+	struct Orientation_Measurement gravity, magneto, fake;
+	struct DoubleQuat q_ned2body, sigma_q;
+	FLOAT_MAT33_ZERO(attitude_profile_matrix);
+	FLOAT_MAT33_ZERO(sigmaB);
+	// for faster converging, but probably more rounding error
+	const double weight_scale = 10;
+	VECT3_ASSIGN(gravity.reference_direction, 0, 0, -1);
+	VECT3_ASSIGN(gravity.measured_direction, 0, 0, -1);
+	gravity.weight_of_the_measurement = weight_scale / imu_frequency;
+	VECT3_ASSIGN(magneto.reference_direction, mag_field_ned(0), mag_field_ned(1), mag_field_ned(2));
+	magneto.weight_of_the_measurement = weight_scale / mag_frequency;
+
+	if (!pos_0) {
+		do {
+			if (!read_raw_input(log, index, in))
+				return false;
+		} while (!in.gps_ready);
+		index--;
+	}
+	while (nb_imu < MINIMAL_IMU_MEASUREMENTS || nb_mag < MINIMAL_MAGNETIC_FIELD_MEASUREMENTS ||
+			nb_baro < MINIMAL_BARO_MEASUREMENTS || (!pos_0 && nb_gps < MINIMAL_GPS_MEASUREMENTS)) {
+		if (!read_raw_input(log, index, in))
+			return false;
+		if (in.imu_ready) {
+			gyro_sum += in.gyro;
+			nb_imu++;
+			VECTOR_AS_VECT3(gravity.measured_direction, in.accel);
+			add_orientation_measurement(&attitude_profile_matrix, gravity);
+		}
+		if (in.mag_ready) {
+			nb_mag++;
+			VECTOR_AS_VECT3(magneto.measured_direction, in.mag);
+			add_orientation_measurement(&attitude_profile_matrix, magneto);
+			// now, generate fake measurement with the last gravity measurement
+			fake = fake_orientation_measurement(gravity, magneto);
+			add_orientation_measurement(&attitude_profile_matrix, fake);
+		}
+		if (in.baro_ready) {
+			baro_sum += in.baro;
+			nb_baro++;
+		}
+		if (in.gps_ready) {
+			gps_p_sum += in.gps_p;
+			gps_v_sum += in.gps_v;
+			nb_gps++;
+		}
+	}
+
+	Vector3d pos_sigma, vel_sigma;
+	if (pos_0) {
+		s.position = *pos_0;
+		s.velocity = Vector3d::Zero();
+		pos_sigma = Vector3d::Ones() * 100;
+		vel_sigma = Vector3d::Ones();
+	}
+	else {
+		s.position = gps_p_sum / nb_gps;
+		s.velocity = gps_v_sum / nb_gps;
+		pos_sigma = GPS_NOISE_SCALE * gps_pos_noise / nb_gps;
+		vel_sigma = GPS_NOISE_SCALE * gps_speed_noise / nb_gps;
+	}
+
+	// setting the covariance of the attitude measurements
+	gravity.weight_of_the_measurement *= nb_imu;
+	VECTOR_AS_VECT3(gravity.measured_direction, accelerometer_noise);
+	magneto.weight_of_the_measurement *= nb_mag;
+	VECTOR_AS_VECT3(magneto.measured_direction, magnetometer_noise);
+	add_set_of_three_measurements(&sigmaB, gravity, magneto);
+	q_ned2body = estimated_attitude(attitude_profile_matrix, 1000, 1e-6, sigmaB, &sigma_q);
+	s.orientation = ecef2body_from_pprz_ned2body(s.position, q_ned2body);
+	struct DoubleEulers sigma_eu = sigma_euler_from_sigma_q(q_ned2body, sigma_q);
+	Vector3d orientation_sigma = EULER_AS_VECTOR3D(sigma_eu);
+
+	struct EcefCoor_d pos_0_pprz;
+	struct NedCoor_d mag_ned;
+	struct EcefCoor_d mag_ecef;
+	struct LtpDef_d ltp;
+	VECTOR_AS_VECT3(pos_0_pprz, s.position);
+	ltp_def_from_ecef_d(&ltp, &pos_0_pprz);
+	VECT3_ASSIGN(mag_ned, mag_field_ned(0), mag_field_ned(1), mag_field_ned(2));
+	ecef_of_ned_vect_d(&mag_ecef, &ltp, &mag_ned);
+	s.mag_reference = VECT3_AS_VECTOR3D(mag_ecef).normalized();
+
+	s.gyro_bias = gyro_sum / nb_imu;
+	baro_offset = s.position.norm() - baro_sum / nb_baro;
+	s.sigma << gyro_stability_noise, orientation_sigma, pos_sigma, vel_sigma;
+	/*
+	 * as libeknav_from_log always built its filter: the stability
+	 * constant as the white noise and the other way round
+	 */
+	s.gyro_white = gyro_stability_noise;
+	s.gyro_stability = gyroscope_noise;
+	s.accel_white = accelerometer_noise;
+	s.mag_error = magnetometer_noise.norm();
+	s.gravity_error = accelerometer_noise.norm();
+	s.baro_error = baro_noise;
+	s.gps_p_error = GPS_NOISE_SCALE * gps_pos_noise;
+	s.gps_v_error = GPS_NOISE_SCALE * gps_speed_noise;
+	s.gravity_update = true;
+	s.nominal_dt = IMU_DT;
+	s.gps_latency = 0;
+	return true;
+}
+
+/*
+ * Synthetic flight
+ */
+
+static inline void synthetic_setup(replay_setup& s, const synthetic_flight& log)
+{
+	using namespace Eigen;
+	s.position = log.position + Vector3d(3, -2, 1);
+	s.velocity = log.velocity;
+	s.gyro_bias = Vector3d::Zero();
+	s.orientation = Quaterniond(AngleAxisd(0.1, Vector3d::UnitX())) * log.orientation;
+	s.sigma << Vector3d::Ones() * 0.05, Vector3d::Ones() * M_PI * sqrt(0.5),
+		Vector3d::Ones() * 5., Vector3d::Ones() * 1.;
+	s.gyro_white = Vector3d::Ones() * log.gyro_noise * log.gyro_noise;
+	s.gyro_stability = Vector3d::Ones() * 1e-6;
+	s.accel_white = Vector3d::Ones() * log.accel_noise * log.accel_noise;
+	s.mag_reference = log.mag_reference;
+	s.mag_error = log.mag_noise * log.mag_noise;
+	s.gravity_error = 0;
+	s.baro_error = log.baro_noise * log.baro_noise;
+	s.gps_p_error = Vector3d::Ones() * log.gps_p_noise * log.gps_p_noise;
+	s.gps_v_error = Vector3d::Ones() * log.gps_v_noise * log.gps_v_noise;
+	s.gravity_update = false;
+	s.nominal_dt = 1.0 / synthetic_flight::imu_frequency;
+	s.gps_latency = 0;
+}
+
+static inline void synthetic_input(replay_input& in, synthetic_flight& log)
+{
+	log.next();
+	in.time = log.time();
+	in.gyro = log.gyro;
+	in.accel = log.accel;
+	in.mag = log.mag;
+	in.gps_p = log.gps_p;
+	in.gps_v = log.gps_v;
+	in.baro = log.baro;
+	in.imu_ready = true;
+	in.mag_ready = log.mag_ready;
+	in.baro_ready = log.baro_ready;
+	in.gps_ready = log.gps_ready;
+}
+
+#endif /* INS_QKF_REPLAY_HPP */
@@ -23,6 +23,7 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <cmath>
 
 using Eigen::Quaternion;
 
@@ -140,4 +141,16 @@ Eigen::Matrix<FloatT, 3, 1> log(const Quaternion<FloatT>& q)
 	// return res.axis() * res.angle();
 }
 
+/**
+ * The angle of the rotation between two orientations.
+ * @return The angle, in [0, pi].  Not from acos(w): it cannot resolve the
+ * small angles a float quaternion can.
+ */
+template<typename FloatT>
+FloatT angle_between(const Quaternion<FloatT>& a, const Quaternion<FloatT>& b)
+{
+	Quaternion<FloatT> dq = a.conjugate() * b;
+	return 2*std::atan2(dq.vec().norm(), std::fabs(dq.w()));
+}
+
 #endif
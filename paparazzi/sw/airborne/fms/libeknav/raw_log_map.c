@@ -0,0 +1,45 @@
+#include "fms/libeknav/raw_log_map.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int raw_log_map_open(struct raw_log_map* log, const char* filename) {
+  log->entries = NULL;
+  log->nb_entries = 0;
+  log->map_size = 0;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return -1;
+  }
+  if (st.st_size > 0) {
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+    /* entries are read once, front to back */
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    log->entries = (const struct raw_log_entry*)map;
+    log->map_size = st.st_size;
+    log->nb_entries = st.st_size / sizeof(struct raw_log_entry);
+  }
+  /* the mapping outlives the descriptor */
+  close(fd);
+  return 0;
+}
+
+void raw_log_map_close(struct raw_log_map* log) {
+  if (log->entries)
+    munmap((void*)log->entries, log->map_size);
+  log->entries = NULL;
+  log->nb_entries = 0;
+  log->map_size = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef LIBEKNAV_RAW_LOG_MAP_H
+#define LIBEKNAV_RAW_LOG_MAP_H
+
+#include <stddef.h>
+#include "fms/libeknav/raw_log.h"
+
+/*
+ * A raw log mapped read-only in memory: entries are read in place, with
+ * no system call per entry.  The map is never written, so any number of
+ * readers can walk it at the same time.
+ */
+struct raw_log_map {
+  const struct raw_log_entry* entries;
+  size_t nb_entries;       /* a truncated last entry is ignored */
+  size_t map_size;
+};
+
+/* 0 on success, -1 with errno set otherwise */
+extern int raw_log_map_open(struct raw_log_map* log, const char* filename);
+extern void raw_log_map_close(struct raw_log_map* log);
+
+#endif /* LIBEKNAV_RAW_LOG_MAP_H */
@@ -0,0 +1,431 @@
+/*
+ * sweep_ins_qkf.cpp
+ *
+ * Filter tuning sweep: the sensor stream is decoded once into memory,
+ * then replayed through one basic_ins_qkf per combination of noise
+ * parameters, on all the cores.  The parameter sets are ranked by the
+ * consistency of their GPS innovations: the normalized innovation
+ * squared (NIS) of a well tuned filter averages its 6 degrees of freedom.
+ * On the synthetic flight the truth is known, and the normalized
+ * estimation error squared (NEES) of position and velocity is used too.
+ * A raw log is replayed through the initialization, tuning and fusion
+ * front end of run_filter_on_log (ins_qkf_replay.hpp), -l being its
+ * --gps-latency.
+ *
+ *   sweep_ins_qkf [-j threads] [-n lines] [-o all_runs.csv] [-l gps_latency]
+ *                 [-s seconds | raw_log.bin] [NAME=f1,f2,... ...]
+ *
+ * NAME=f1,f2,... scales the variance NAME of the baseline tuning by each
+ * of the factors in turn, NAME in gyro_white, gyro_stability,
+ * accel_white, mag, gravity, baro, gps_p, gps_v.  Without any, the white
+ * noises of gyro, accelerometer and GPS are swept over 1/4, 1 and 4.
+ */
+
+#include "ins_qkf_replay.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+
+using namespace Eigen;
+
+/* 95% bound of a chi square with 6 degrees of freedom */
+#define NIS_DOF         6
+#define NIS_BOUND_95    12.592
+
+/** The tunable variances, in the order of the command line names */
+enum sweep_parameter {
+	SWEEP_GYRO_WHITE, SWEEP_GYRO_STABILITY, SWEEP_ACCEL_WHITE, SWEEP_MAG, SWEEP_GRAVITY, SWEEP_BARO, SWEEP_GPS_P, SWEEP_GPS_V,
+	NB_SWEEP_PARAMETERS
+};
+static const char* parameter_names[NB_SWEEP_PARAMETERS] = {
+	"gyro_white", "gyro_stability", "accel_white", "mag", "gravity", "baro", "gps_p", "gps_v"
+};
+
+#define MAX_FACTORS 16
+/* bound on the number of combinations, the runs are all kept in memory */
+#define MAX_RUNS    1000000
+struct sweep_axis
+{
+	int nb_factors;
+	double factors[MAX_FACTORS];
+};
+
+/** One replay, with its scale factors and results */
+struct sweep_run
+{
+	double scale[NB_SWEEP_PARAMETERS];
+	bool diverged;
+	int nb_gps;
+	double nis_sum;
+	int nb_nis_in_bound;
+	double nees_sum;
+	double position_error2_sum;
+	double score;                     // 0 for a consistent filter
+};
+
+/** Truth at the GPS epochs of the synthetic flight */
+struct truth_sample
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	Vector3d position, velocity;
+};
+
+/** What the workers share, read only but for next_run */
+struct sweep
+{
+	const replay_input* inputs;
+	const truth_sample* truth;        // one per input, NULL for a raw log
+	int nb_inputs;
+	const replay_setup* baseline;
+	sweep_run* runs;
+	int nb_runs;
+	int next_run;
+	pthread_mutex_t lock;
+};
+
+static void scaled_setup(replay_setup& s, const replay_setup& baseline, const double* scale)
+{
+	s = baseline;
+	s.gyro_white *= scale[SWEEP_GYRO_WHITE];
+	s.gyro_stability *= scale[SWEEP_GYRO_STABILITY];
+	s.accel_white *= scale[SWEEP_ACCEL_WHITE];
+	s.mag_error *= scale[SWEEP_MAG];
+	s.gravity_error *= scale[SWEEP_GRAVITY];
+	s.baro_error *= scale[SWEEP_BARO];
+	s.gps_p_error *= scale[SWEEP_GPS_P];
+	s.gps_v_error *= scale[SWEEP_GPS_V];
+}
+
+/**
+ * Normalized innovation squared of the coming GPS update.  A fix older
+ * than the last IMU sample is moved forward by its age, to compare it
+ * with the current prediction.
+ */
+static double gps_nis(const basic_ins_qkf& ins, const replay_input& in, const replay_setup& s)
+{
+	Matrix<double, 6, 1> innovation;
+	innovation.segment<3>(0) = in.gps_p + in.gps_v * s.gps_latency - ins.avg_state.position;
+	innovation.segment<3>(3) = in.gps_v - ins.avg_state.velocity;
+	Matrix<double, 6, 6> innovation_cov = ins.covariance().block<6, 6>(6, 6);
+	innovation_cov.block<3, 3>(0, 0) += s.gps_p_error.asDiagonal();
+	innovation_cov.block<3, 3>(3, 3) += s.gps_v_error.asDiagonal();
+	return innovation.dot(innovation_cov.inverse() * innovation);
+}
+
+/** Normalized estimation error squared of position and velocity */
+static double pv_nees(const basic_ins_qkf& ins, const truth_sample& truth)
+{
+	Matrix<double, 6, 1> error;
+	error.segment<3>(0) = truth.position - ins.avg_state.position;
+	error.segment<3>(3) = truth.velocity - ins.avg_state.velocity;
+	Matrix<double, 6, 6> cov = ins.covariance().block<6, 6>(6, 6);
+	return error.dot(cov.inverse() * error);
+}
+
+static void replay(const sweep& w, sweep_run& r)
+{
+	replay_setup s;
+	scaled_setup(s, *w.baseline, r.scale);
+	replay_filter<double>* filter = new replay_filter<double>(s);
+
+	r.diverged = false;
+	r.nb_gps = 0;
+	r.nis_sum = 0;
+	r.nb_nis_in_bound = 0;
+	r.nees_sum = 0;
+	r.position_error2_sum = 0;
+	for (int i = 0; i < w.nb_inputs; i++) {
+		const replay_input& in = w.inputs[i];
+		// as replay_filter::step(): a fix counts even if its IMU sample is not used
+		filter->propagate(in, s);
+		if (in.gps_ready) {
+			double nis = gps_nis(filter->ins, in, s);
+			filter->observe_gps(in, s);
+			r.nb_gps++;
+			r.nis_sum += nis;
+			if (nis < NIS_BOUND_95)
+				r.nb_nis_in_bound++;
+			if (w.truth) {
+				r.nees_sum += pv_nees(filter->ins, w.truth[i]);
+				r.position_error2_sum += (w.truth[i].position - filter->ins.avg_state.position).squaredNorm();
+			}
+			if (!filter->ins.is_real()) {
+				r.diverged = true;
+				break;
+			}
+		}
+	}
+	delete filter;
+
+	if (r.diverged || !r.nb_gps) {
+		r.score = HUGE_VAL;
+		return;
+	}
+	r.score = fabs(log(r.nis_sum / r.nb_gps / NIS_DOF));
+	if (w.truth)
+		r.score += fabs(log(r.nees_sum / r.nb_gps / NIS_DOF));
+}
+
+static void* sweep_worker(void* arg)
+{
+	sweep* w = (sweep*)arg;
+	for (;;) {
+		pthread_mutex_lock(&w->lock);
+		int run = w->next_run++;
+		pthread_mutex_unlock(&w->lock);
+		if (run >= w->nb_runs)
+			return NULL;
+		replay(*w, w->runs[run]);
+	}
+}
+
+static bool parse_axis(const char* arg, sweep_axis* axes)
+{
+	const char* eq = strchr(arg, '=');
+	if (!eq)
+		return false;
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++) {
+		if (strlen(parameter_names[p]) != (size_t)(eq - arg) || strncmp(arg, parameter_names[p], eq - arg))
+			continue;
+		sweep_axis& a = axes[p];
+		a.nb_factors = 0;
+		const char* f = eq + 1;
+		while (*f && a.nb_factors < MAX_FACTORS) {
+			char* end;
+			double factor = strtod(f, &end);
+			if (end == f || factor <= 0)
+				return false;
+			a.factors[a.nb_factors++] = factor;
+			f = (*end == ',') ? end + 1 : end;
+		}
+		return a.nb_factors > 0 && !*f;
+	}
+	return false;
+}
+
+static bool better(const sweep_run& a, const sweep_run& b)
+{
+	return a.score < b.score;
+}
+
+static void print_run(FILE* out, const sweep_run& r, bool with_truth)
+{
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++)
+		fprintf(out, "%7.3g ", r.scale[p]);
+	if (r.diverged || !r.nb_gps) {
+		fprintf(out, "%8s\n", "diverged");
+		return;
+	}
+	fprintf(out, "%8.3f %8.2f %6.1f%%", r.score, r.nis_sum / r.nb_gps,
+			100. * r.nb_nis_in_bound / r.nb_gps);
+	if (with_truth)
+		fprintf(out, " %8.2f %8.3f", r.nees_sum / r.nb_gps, sqrt(r.position_error2_sum / r.nb_gps));
+	fprintf(out, "\n");
+}
+
+static void write_csv(FILE* out, const sweep_run* runs, int nb_runs, bool with_truth)
+{
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++)
+		fprintf(out, "%s,", parameter_names[p]);
+	fprintf(out, "diverged,nb_gps,score,nis_mean,nis_in_bound%s\n",
+			with_truth ? ",nees_mean,pos_err_rms" : "");
+	for (int i = 0; i < nb_runs; i++) {
+		const sweep_run& r = runs[i];
+		for (int p = 0; p < NB_SWEEP_PARAMETERS; p++)
+			fprintf(out, "%g,", r.scale[p]);
+		int n = r.nb_gps ? r.nb_gps : 1;
+		fprintf(out, "%d,%d,%g,%g,%g", r.diverged, r.nb_gps, r.score, r.nis_sum / n,
+				(double)r.nb_nis_in_bound / n);
+		if (with_truth)
+			fprintf(out, ",%g,%g", r.nees_sum / n, sqrt(r.position_error2_sum / n));
+		fprintf(out, "\n");
+	}
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-j threads] [-n lines] [-o all_runs.csv] [-l gps_latency] "
+			"[-s seconds | raw_log.bin] [NAME=f1,f2,...]\n  NAME in", name);
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++)
+		fprintf(stderr, " %s", parameter_names[p]);
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv)
+{
+	int nb_threads = 0, nb_lines = 0;
+	double seconds = 600., gps_latency = 0.;
+	const char* log_file = NULL;
+	const char* csv_file = NULL;
+	int c;
+	while ((c = getopt(argc, argv, "j:n:o:l:s:")) != -1) {
+		switch (c) {
+			case 'j': nb_threads = atoi(optarg); break;
+			case 'l': gps_latency = atof(optarg); break;
+			case 'n': nb_lines = atoi(optarg); break;
+			case 'o': csv_file = optarg; break;
+			case 's': seconds = atof(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+
+	sweep_axis axes[NB_SWEEP_PARAMETERS];
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++) {
+		axes[p].nb_factors = 1;
+		axes[p].factors[0] = 1.;
+	}
+	bool default_axes = true;
+	for (int i = optind; i < argc; i++) {
+		if (strchr(argv[i], '=')) {
+			default_axes = false;
+			if (!parse_axis(argv[i], axes)) {
+				fprintf(stderr, "invalid sweep %s\n", argv[i]);
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (!log_file)
+			log_file = argv[i];
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (default_axes) {
+		const int swept[] = { SWEEP_GYRO_WHITE, SWEEP_ACCEL_WHITE, SWEEP_GPS_P, SWEEP_GPS_V };
+		for (unsigned i = 0; i < sizeof(swept) / sizeof(swept[0]); i++) {
+			sweep_axis& a = axes[swept[i]];
+			a.nb_factors = 3;
+			a.factors[0] = 0.25;
+			a.factors[1] = 1.;
+			a.factors[2] = 4.;
+		}
+	}
+
+	/* decode the whole stream once, the runs share it */
+	replay_setup baseline;
+	replay_input* inputs;
+	truth_sample* truth = NULL;
+	int nb_inputs = 0;
+	if (log_file) {
+		struct raw_log_map raw_log;
+		if (raw_log_map_open(&raw_log, log_file) == -1) {
+			perror(log_file);
+			return 1;
+		}
+		size_t index = 0;
+		double baro_offset;
+		if (!raw_log_setup(raw_log, index, baseline, baro_offset)) {
+			fprintf(stderr, "%s: too short to initialize the filter\n", log_file);
+			return 1;
+		}
+		baseline.gps_latency = gps_latency;
+		inputs = new replay_input[raw_log.nb_entries - index];
+		while (read_raw_input(raw_log, index, inputs[nb_inputs])) {
+			if (!inputs[nb_inputs].imu_ready && !inputs[nb_inputs].gps_ready)
+				continue;
+			inputs[nb_inputs].baro += baro_offset;
+			nb_inputs++;
+		}
+		raw_log_map_close(&raw_log);
+	}
+	else {
+		synthetic_flight flight;
+		synthetic_setup(baseline, flight);
+		int n = (int)(seconds * synthetic_flight::imu_frequency);
+		inputs = new replay_input[n];
+		truth = new truth_sample[n];
+		for (nb_inputs = 0; nb_inputs < n; nb_inputs++) {
+			synthetic_input(inputs[nb_inputs], flight);
+			truth[nb_inputs].position = flight.position;
+			truth[nb_inputs].velocity = flight.velocity;
+		}
+	}
+
+	/* every combination of the factors */
+	int nb_runs = 1;
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++) {
+		if (nb_runs > MAX_RUNS / axes[p].nb_factors) {
+			fprintf(stderr, "more than %d parameter sets, sweep fewer factors\n", MAX_RUNS);
+			return 1;
+		}
+		nb_runs *= axes[p].nb_factors;
+	}
+	sweep w;
+	w.inputs = inputs;
+	w.truth = truth;
+	w.nb_inputs = nb_inputs;
+	w.baseline = &baseline;
+	w.runs = new sweep_run[nb_runs];
+	w.nb_runs = nb_runs;
+	w.next_run = 0;
+	pthread_mutex_init(&w.lock, NULL);
+	for (int i = 0; i < nb_runs; i++) {
+		int k = i;
+		for (int p = 0; p < NB_SWEEP_PARAMETERS; p++) {
+			w.runs[i].scale[p] = axes[p].factors[k % axes[p].nb_factors];
+			k /= axes[p].nb_factors;
+		}
+	}
+
+	if (nb_threads <= 0)
+		nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nb_threads <= 0)
+		nb_threads = 1;
+	if (nb_threads > nb_runs)
+		nb_threads = nb_runs;
+	printf("%d parameter sets over %d steps (%.1f s), %d threads\n", nb_runs, nb_inputs,
+			nb_inputs ? inputs[nb_inputs-1].time - inputs[0].time : 0., nb_threads);
+
+	double t0 = now_ns();
+	pthread_t* threads = new pthread_t[nb_threads];
+	int nb_started = 0;
+	for (int i = 0; i < nb_threads; i++) {
+		if (pthread_create(&threads[i], NULL, sweep_worker, &w)) {
+			perror("pthread_create");
+			break;
+		}
+		nb_started++;
+	}
+	if (!nb_started)
+		sweep_worker(&w);
+	for (int i = 0; i < nb_started; i++)
+		pthread_join(threads[i], NULL);
+	double elapsed = (now_ns() - t0) * 1e-9;
+
+	if (csv_file) {
+		FILE* out = fopen(csv_file, "w");
+		if (!out)
+			perror(csv_file);
+		else {
+			write_csv(out, w.runs, nb_runs, truth != NULL);
+			fclose(out);
+		}
+	}
+
+	std::stable_sort(w.runs, w.runs + nb_runs, better);
+	printf("%.1f s, %.0f steps/s\n\n", elapsed, (double)nb_runs * nb_inputs / elapsed);
+	printf("variance scale factors%*s", 8 * NB_SWEEP_PARAMETERS - 22, "");
+	printf("%8s %8s %7s", "score", "NIS", "in 95%");
+	if (truth)
+		printf(" %8s %8s", "NEES", "pos_rms");
+	printf("\n");
+	for (int p = 0; p < NB_SWEEP_PARAMETERS; p++)
+		printf("%7.7s ", parameter_names[p]);
+	printf("\n");
+	if (nb_lines <= 0 || nb_lines > nb_runs)
+		nb_lines = nb_runs;
+	for (int i = 0; i < nb_lines; i++)
+		print_run(stdout, w.runs[i], truth != NULL);
+
+	delete[] threads;
+	delete[] w.runs;
+	delete[] inputs;
+	delete[] truth;
+	pthread_mutex_destroy(&w.lock);
+	return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef LIBEKNAV_SYNTHETIC_FLIGHT_HPP
+#define LIBEKNAV_SYNTHETIC_FLIGHT_HPP
+/*
+ * synthetic_flight.hpp
+ *
+ * Deterministic sensor log of a vehicle circling at constant attitude
+ * above Toulouse, used to exercise the filter without a recorded log:
+ * 512 Hz IMU, 50 Hz magnetometer and baro, 4 Hz GPS.
+ */
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <stdint.h>
+
+struct synthetic_flight
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	static const int imu_frequency = 512;
+	static const int mag_decimation = 10;
+	static const int baro_decimation = 10;
+	static const int gps_decimation = 128;
+
+	/* one sigma sensor noises */
+	double gyro_noise, accel_noise, mag_noise, baro_noise, gps_p_noise, gps_v_noise;
+
+	/* truth */
+	Eigen::Vector3d center, east, north, up;
+	Eigen::Vector3d position, velocity, gyro_bias;
+	Eigen::Quaterniond orientation;      // ecef to body
+	Eigen::Vector3d mag_reference;       // unit, ecef
+	double radius, omega;
+
+	/* measurements of the current step */
+	uint64_t step;
+	double dt;
+	Eigen::Vector3d gyro, accel, mag, gps_p, gps_v;
+	double baro;
+	bool mag_ready, baro_ready, gps_ready;
+
+	synthetic_flight()
+		: gyro_noise(0.01), accel_noise(0.1), mag_noise(0.01), baro_noise(0.5)
+		, gps_p_noise(2.), gps_v_noise(0.3)
+		, radius(20.), omega(0.2), step(0), dt(1.0/imu_frequency)
+		, rng_state(0x2545F4914F6CDD1DULL)
+	{
+		// 43.6N 1.4E, 200 m
+		const double lat = 43.6 * M_PI/180, lon = 1.4 * M_PI/180;
+		const double r = 6378137. + 200.;
+		up = Eigen::Vector3d(cos(lat)*cos(lon), cos(lat)*sin(lon), sin(lat));
+		east = Eigen::Vector3d(-sin(lon), cos(lon), 0);
+		north = up.cross(east);
+		center = up * r;
+		gyro_bias = Eigen::Vector3d(0.01, -0.02, 0.005);
+		orientation = Eigen::Quaterniond(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()))
+			* Eigen::Quaterniond().setFromTwoVectors(up, -Eigen::Vector3d::UnitZ());
+		mag_reference = (0.52*north + 0.85*(-up)).normalized();
+		update_truth();
+	}
+
+	/// Advance by one IMU period and generate the measurements
+	void next(void)
+	{
+		++step;
+		update_truth();
+		Eigen::Vector3d accel_ecef = -omega*omega * (position - center) + up * 9.81;
+		gyro = gyro_bias + gaussian3(gyro_noise);
+		accel = orientation * accel_ecef + gaussian3(accel_noise);
+		mag_ready = step % mag_decimation == 0;
+		if (mag_ready)
+			mag = orientation * mag_reference + gaussian3(mag_noise);
+		baro_ready = step % baro_decimation == 0;
+		if (baro_ready)
+			baro = position.norm() + baro_noise * gaussian();
+		gps_ready = step % gps_decimation == 0;
+		if (gps_ready) {
+			gps_p = position + gaussian3(gps_p_noise);
+			gps_v = velocity + gaussian3(gps_v_noise);
+		}
+	}
+
+	double time(void) const { return step * dt; }
+
+private:
+	uint64_t rng_state;
+
+	void update_truth(void)
+	{
+		double a = omega * time();
+		position = center + radius * (cos(a)*east + sin(a)*north);
+		velocity = radius * omega * (-sin(a)*east + cos(a)*north);
+	}
+
+	/// xorshift64* and Box-Muller: identical sequences on every host
+	double uniform(void)
+	{
+		rng_state ^= rng_state >> 12;
+		rng_state ^= rng_state << 25;
+		rng_state ^= rng_state >> 27;
+		return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0/9007199254740992.0);
+	}
+
+	double gaussian(void)
+	{
+		double u1 = uniform(), u2 = uniform();
+		return sqrt(-2*log(u1 + 1e-300)) * cos(2*M_PI*u2);
+	}
+
+	Eigen::Vector3d gaussian3(double sigma)
+	{
+		double x = gaussian(), y = gaussian(), z = gaussian();
+		return Eigen::Vector3d(x, y, z) * sigma;
+	}
+};
+
+#endif /* LIBEKNAV_SYNTHETIC_FLIGHT_HPP */
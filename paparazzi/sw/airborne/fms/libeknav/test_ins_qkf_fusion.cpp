@@ -0,0 +1,159 @@
+/*
+ * test_ins_qkf_fusion.cpp
+ *
+ * Runs three basic_ins_qkf on the synthetic flight:
+ *  - the reference sees every IMU sample and every GPS fix on time,
+ *  - the naive one loses IMU frames, propagates with the nominal period
+ *    and applies the GPS fixes when they arrive, late,
+ *  - the last one gets the same stream through ins_qkf_fusion.
+ * The fused filter must stay close to the reference.
+ *
+ *   test_ins_qkf_fusion [seconds [gps_latency [dropped_fraction]]]
+ */
+
+#include "ins_qkf.hpp"
+#include "ins_qkf_fusion.hpp"
+#include "synthetic_flight.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <deque>
+
+using namespace Eigen;
+
+/* the fused filter may not be worse than the reference by more than */
+#define MAX_POS_RMS_EXCESS   0.5     // m
+#define MAX_ATT_RMS_EXCESS   0.5     // deg
+
+struct gps_fix
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	double time;
+	Vector3d p, v;
+};
+
+struct error_sum
+{
+	double position2, attitude2;
+	int n;
+};
+
+static void accumulate(error_sum& e, const basic_ins_qkf& ins, const synthetic_flight& log)
+{
+	e.position2 += (ins.avg_state.position - log.position).squaredNorm();
+	double a = angle_between(ins.avg_state.orientation, log.orientation) * 180/M_PI;
+	e.attitude2 += a * a;
+	e.n++;
+}
+
+/// the same drops on every host: bursts and scattered frames
+static bool dropped(uint64_t step, double fraction, uint64_t& rng)
+{
+	if (step % (60 * synthetic_flight::imu_frequency) < 50)
+		return true;
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return ((rng * 2685821657736338717ULL) >> 11) * (1.0/9007199254740992.0) < fraction;
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 300.;
+	double latency = argc > 2 ? atof(argv[2]) : 0.2;
+	double fraction = argc > 3 ? atof(argv[3]) : 0.2;
+	uint64_t nb_steps = (uint64_t)(seconds * synthetic_flight::imu_frequency);
+
+	synthetic_flight log;
+	const Vector3d gyro_white = Vector3d::Ones() * log.gyro_noise * log.gyro_noise;
+	const Vector3d gyro_stability = Vector3d::Ones() * 1e-6;
+	const Vector3d accel_white = Vector3d::Ones() * log.accel_noise * log.accel_noise;
+	const Vector3d p_error = Vector3d::Ones() * log.gps_p_noise * log.gps_p_noise;
+	const Vector3d v_error = Vector3d::Ones() * log.gps_v_noise * log.gps_v_noise;
+	const double mag_error = log.mag_noise * log.mag_noise;
+	const double baro_error = log.baro_noise * log.baro_noise;
+	const Vector3d position_0 = log.position + Vector3d(3, -2, 1);
+	const Quaterniond orientation_0 = Quaterniond(AngleAxisd(0.1, Vector3d::UnitX())) * log.orientation;
+
+	basic_ins_qkf reference(position_0, 5., 0.05, 1., gyro_white, gyro_stability, accel_white,
+			orientation_0, log.velocity);
+	basic_ins_qkf naive = reference;
+	basic_ins_qkf fused = reference;
+	ins_qkf_fusion<double>* fusion = new ins_qkf_fusion<double>(fused, log.dt, 0.1);
+
+	std::deque<gps_fix> in_flight;
+	error_sum e_reference = { 0, 0, 0 }, e_naive = { 0, 0, 0 }, e_fused = { 0, 0, 0 };
+	uint64_t rng = 0x9E3779B97F4A7C15ULL;
+	uint64_t nb_dropped = 0;
+	for (uint64_t i = 0; i < nb_steps; ++i) {
+		log.next();
+		const double t = log.time();
+
+		reference.predict(log.gyro, log.accel, log.dt);
+		if (log.mag_ready)
+			reference.obs_vector(log.mag_reference, log.mag, mag_error);
+		if (log.baro_ready)
+			reference.obs_baro_report(log.baro, baro_error);
+		if (log.gps_ready) {
+			reference.obs_gps_pv_report(log.gps_p, log.gps_v, p_error, v_error);
+			gps_fix f;
+			f.time = t;
+			f.p = log.gps_p;
+			f.v = log.gps_v;
+			in_flight.push_back(f);
+		}
+
+		if (!dropped(log.step, fraction, rng)) {
+			naive.predict(log.gyro, log.accel, log.dt);
+			fusion->imu(t, log.gyro, log.accel);
+			if (log.mag_ready) {
+				naive.obs_vector(log.mag_reference, log.mag, mag_error);
+				fusion->obs_vector(log.mag_reference, log.mag, mag_error);
+			}
+			if (log.baro_ready) {
+				naive.obs_baro_report(log.baro, baro_error);
+				fusion->obs_baro_report(log.baro, baro_error);
+			}
+			while (!in_flight.empty() && in_flight.front().time + latency <= t) {
+				const gps_fix& f = in_flight.front();
+				naive.obs_gps_pv_report(f.p, f.v, p_error, v_error);
+				fusion->obs_gps_pv_report(f.time, f.p, f.v, p_error, v_error);
+				in_flight.pop_front();
+			}
+		}
+		else
+			nb_dropped++;
+
+		// skip the convergence
+		if (t > 30.) {
+			accumulate(e_reference, reference, log);
+			accumulate(e_naive, naive, log);
+			accumulate(e_fused, fused, log);
+		}
+	}
+
+	printf("%.0f s, GPS latency %.3f s, %llu of %llu IMU frames dropped\n", seconds, latency,
+			(unsigned long long)nb_dropped, (unsigned long long)nb_steps);
+	printf("fusion: %u steps, %u frames seen missing, %u delayed fixes, %u rejected, %u steps replayed\n",
+			fusion->stats.nb_steps, fusion->stats.nb_dropped, fusion->stats.nb_gps_delayed,
+			fusion->stats.nb_gps_rejected, fusion->stats.nb_replayed);
+	if (!e_reference.n)
+		return 1;
+	printf("%-10s %10s %10s\n", "", "pos_rms_m", "att_rms_deg");
+	const char* names[] = { "reference", "naive", "fused" };
+	const error_sum* sums[] = { &e_reference, &e_naive, &e_fused };
+	for (int i = 0; i < 3; ++i)
+		printf("%-10s %10.3f %10.3f\n", names[i], sqrt(sums[i]->position2 / sums[i]->n),
+				sqrt(sums[i]->attitude2 / sums[i]->n));
+
+	double pos_excess = sqrt(e_fused.position2 / e_fused.n) - sqrt(e_reference.position2 / e_reference.n);
+	double att_excess = sqrt(e_fused.attitude2 / e_fused.n) - sqrt(e_reference.attitude2 / e_reference.n);
+	delete fusion;
+	if (pos_excess > MAX_POS_RMS_EXCESS || att_excess > MAX_ATT_RMS_EXCESS) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * test_ins_qkf_stability.cpp
+ *
+ * Runs basic_ins_qkf for hours of synthetic flight and checks after
+ * every second of log that the covariance is still symmetric positive
+ * definite and the estimate still close to the truth.  Build it with
+ * -DINS_QKF_UD_COVARIANCE=1 (optionally -DINS_QKF_UD_SCALAR=float) to
+ * check the factorized covariance.
+ *
+ *   test_ins_qkf_stability [hours]
+ */
+
+#include "ins_qkf.hpp"
+#include "assertions.hpp"
+#include "synthetic_flight.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace Eigen;
+
+#define MAX_POS_ERROR   20.     // m
+#define MAX_ATT_ERROR   10.     // deg
+
+/**
+ * @return The smallest pivot of the Cholesky decomposition of P, which
+ * is negative or zero as soon as P is not positive definite
+ */
+static double min_cholesky_pivot(const Matrix<double, 12, 12>& P)
+{
+	Matrix<double, 12, 12> L = Matrix<double, 12, 12>::Zero();
+	double min_pivot = HUGE_VAL;
+	for (int j = 0; j < 12; ++j) {
+		double d = P(j, j);
+		for (int k = 0; k < j; ++k)
+			d -= L(j, k) * L(j, k);
+		if (d < min_pivot)
+			min_pivot = d;
+		if (d <= 0)
+			return d;
+		L(j, j) = sqrt(d);
+		for (int i = j+1; i < 12; ++i) {
+			double s = P(i, j);
+			for (int k = 0; k < j; ++k)
+				s -= L(i, k) * L(j, k);
+			L(i, j) = s / L(j, j);
+		}
+	}
+	return min_pivot;
+}
+
+/// @return max |P - P^T| relative to max |P|
+static double asymmetry(const Matrix<double, 12, 12>& P)
+{
+	double max_diff = 0, max_elt = 0;
+	for (int i = 0; i < 12; ++i) {
+		for (int j = 0; j < 12; ++j) {
+			max_diff = std::max(max_diff, std::fabs(P(i, j) - P(j, i)));
+			max_elt = std::max(max_elt, std::fabs(P(i, j)));
+		}
+	}
+	return max_elt > 0 ? max_diff / max_elt : 0;
+}
+
+int main(int argc, char** argv)
+{
+	double hours = argc > 1 ? atof(argv[1]) : 1.;
+	uint64_t nb_steps = (uint64_t)(hours * 3600 * synthetic_flight::imu_frequency);
+
+	synthetic_flight log;
+	basic_ins_qkf ins(log.position + Vector3d(3, -2, 1), 5., 0.05, 1.,
+			Vector3d::Ones() * log.gyro_noise * log.gyro_noise,
+			Vector3d::Ones() * 1e-6,
+			Vector3d::Ones() * log.accel_noise * log.accel_noise,
+			Quaterniond(AngleAxisd(0.1, Vector3d::UnitX())) * log.orientation,
+			log.velocity);
+
+#if INS_QKF_UD_COVARIANCE
+	printf("U*D*U^T covariance, %s factors\n", sizeof(basic_ins_qkf::ud_scalar_t) == sizeof(float) ? "float" : "double");
+#else
+	printf("dense covariance\n");
+#endif
+	printf("%8s %10s %10s %12s %12s\n", "time", "pos_err", "att_err", "min_pivot", "asymmetry");
+
+	double worst_pivot = HUGE_VAL, worst_asym = 0;
+	double pos_err = 0, att_err = 0;
+	bool ok = true;
+	for (uint64_t i = 1; i <= nb_steps && ok; ++i) {
+		log.next();
+		ins.predict(log.gyro, log.accel, log.dt);
+		if (log.mag_ready)
+			ins.obs_vector(log.mag_reference, log.mag, log.mag_noise * log.mag_noise);
+		if (log.baro_ready)
+			ins.obs_baro_report(log.baro, log.baro_noise * log.baro_noise);
+		if (log.gps_ready)
+			ins.obs_gps_pv_report(log.gps_p, log.gps_v,
+					Vector3d::Ones() * log.gps_p_noise * log.gps_p_noise,
+					Vector3d::Ones() * log.gps_v_noise * log.gps_v_noise);
+
+		if (i % synthetic_flight::imu_frequency)
+			continue;
+
+		double pivot = min_cholesky_pivot(ins.covariance());
+		double asym = asymmetry(ins.covariance());
+		worst_pivot = std::min(worst_pivot, pivot);
+		worst_asym = std::max(worst_asym, asym);
+		pos_err = (ins.avg_state.position - log.position).norm();
+		att_err = angle_between(ins.avg_state.orientation, log.orientation) * 180 / M_PI;
+
+		// give the filter a minute to converge before judging the estimate
+		bool converged = log.time() > 60.;
+		ok = ins.is_real() && pivot > 0
+			&& (!converged || (pos_err < MAX_POS_ERROR && att_err < MAX_ATT_ERROR));
+		if (!ok || i % (600 * synthetic_flight::imu_frequency) == 0)
+			printf("%8.0f %10.3f %10.3f %12.3g %12.3g\n", log.time(), pos_err, att_err, pivot, asym);
+	}
+
+	printf("%s after %.0f s: worst min pivot %g, worst asymmetry %g\n",
+			ok ? "PASSED" : "FAILED", log.time(), worst_pivot, worst_asym);
+	return ok ? 0 : 1;
+}
@@ -219,7 +219,7 @@ static void init_ins_state(void){
 							Vector3d::Ones() *  M_PI*0.5   *  M_PI*0.5  ,
 							Vector3d::Ones() *  pos_cov_0  *  pos_cov_0 ,
 							Vector3d::Ones() * speed_cov_0 * speed_cov_0;
-	ins.cov = diag_cov.asDiagonal();
+	ins.set_cov(diag_cov.asDiagonal());
 	
 }
 
@@ -373,10 +373,10 @@ static void print_estimator_state(double time) {
 	#endif
   fprintf(ins_logfile, "%f %d AHRS_EULER %f %f %f\n", time, AC_ID, e.phi, e.theta, e.psi);
   fprintf(ins_logfile, "%f %d DEBUG_COVARIANCE %f %f %f %f %f %f %f %f %f %f %f %f\n", time, AC_ID,
-				sqrt(ins.cov( 0, 0)),  sqrt(ins.cov( 1, 1)),  sqrt(ins.cov( 2, 2)), 
-				sqrt(ins.cov( 3, 3)),  sqrt(ins.cov( 4, 4)),  sqrt(ins.cov( 5, 5)), 
-				sqrt(ins.cov( 6, 6)),  sqrt(ins.cov( 7, 7)),  sqrt(ins.cov( 8, 8)), 
-				sqrt(ins.cov( 9, 9)),  sqrt(ins.cov(10,10)),  sqrt(ins.cov(11,11)));
+				sqrt(ins.covariance()( 0, 0)),  sqrt(ins.covariance()( 1, 1)),  sqrt(ins.covariance()( 2, 2)), 
+				sqrt(ins.covariance()( 3, 3)),  sqrt(ins.covariance()( 4, 4)),  sqrt(ins.covariance()( 5, 5)), 
+				sqrt(ins.covariance()( 6, 6)),  sqrt(ins.covariance()( 7, 7)),  sqrt(ins.covariance()( 8, 8)), 
+				sqrt(ins.covariance()( 9, 9)),  sqrt(ins.covariance()(10,10)),  sqrt(ins.covariance()(11,11)));
   fprintf(ins_logfile, "%f %d BOOZ_SIM_GYRO_BIAS %f %f %f\n", time, AC_ID, ins.avg_state.gyro_bias(0), ins.avg_state.gyro_bias(1), ins.avg_state.gyro_bias(2));
 	
 #else
@@ -401,10 +401,10 @@ static void print_estimator_state(double time) {
 
   fprintf(ins_logfile, "%f %d AHRS_EULER %f %f %f\n", time, AC_ID, e_ecef2body.phi, e_ecef2body.theta, e_ecef2body.psi);
   fprintf(ins_logfile, "%f %d DEBUG_COVARIANCE %f %f %f %f %f %f %f %f %f %f %f %f\n", time, AC_ID,
-				sqrt(ins.cov( 0, 0)),  sqrt(ins.cov( 1, 1)),  sqrt(ins.cov( 2, 2)), 
-				sqrt(ins.cov( 3, 3)),  sqrt(ins.cov( 4, 4)),  sqrt(ins.cov( 5, 5)), 
-				sqrt(ins.cov( 6, 6)),  sqrt(ins.cov( 7, 7)),  sqrt(ins.cov( 8, 8)), 
-				sqrt(ins.cov( 9, 9)),  sqrt(ins.cov(10,10)),  sqrt(ins.cov(11,11)));
+				sqrt(ins.covariance()( 0, 0)),  sqrt(ins.covariance()( 1, 1)),  sqrt(ins.covariance()( 2, 2)), 
+				sqrt(ins.covariance()( 3, 3)),  sqrt(ins.covariance()( 4, 4)),  sqrt(ins.covariance()( 5, 5)), 
+				sqrt(ins.covariance()( 6, 6)),  sqrt(ins.covariance()( 7, 7)),  sqrt(ins.covariance()( 8, 8)), 
+				sqrt(ins.covariance()( 9, 9)),  sqrt(ins.covariance()(10,10)),  sqrt(ins.covariance()(11,11)));
   fprintf(ins_logfile, "%f %d BOOZ_SIM_GYRO_BIAS %f %f %f\n", time, AC_ID, ins.avg_state.gyro_bias(0), ins.avg_state.gyro_bias(1), ins.avg_state.gyro_bias(2));
 #endif
 }
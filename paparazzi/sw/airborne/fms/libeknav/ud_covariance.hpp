@@ -0,0 +1,162 @@
+#ifndef LIBEKNAV_UD_COVARIANCE_HPP
+#define LIBEKNAV_UD_COVARIANCE_HPP
+/*
+ * ud_covariance.hpp
+ *
+ * Covariance kept as P = U*D*U^T, U unit upper triangular and D diagonal
+ * (Bierman/Thornton factorization).  The factors are updated directly,
+ * so P stays symmetric and positive definite by construction, even in
+ * single precision.
+ */
+
+#include <Eigen/Core>
+
+template<typename Scalar, int N>
+struct ud_covariance
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	/// Unit upper triangular factor, only the strict upper part is used
+	Eigen::Matrix<Scalar, N, N> U;
+	/// Diagonal factor
+	Eigen::Matrix<Scalar, N, 1> D;
+
+	/**
+	 * Factorize a symmetric positive definite matrix.
+	 * @param P The covariance.  Only its upper triangle is read.
+	 */
+	template<typename T>
+	void set(const Eigen::Matrix<T, N, N>& P)
+	{
+		// Cholesky-like decomposition, from the last column to the first
+		Eigen::Matrix<double, N, N> p = P.template cast<double>();
+		U.setZero();
+		for (int j = N-1; j >= 0; --j) {
+			double d = p(j, j);
+			D(j) = d;
+			U(j, j) = 1;
+			double d_inv = (d > 0) ? 1.0/d : 0;
+			for (int k = 0; k < j; ++k) {
+				double u = p(k, j) * d_inv;
+				U(k, j) = u;
+				for (int i = 0; i <= k; ++i)
+					p(i, k) -= u * d * U(i, j);
+			}
+		}
+	}
+
+	/// @return The dense covariance U*D*U^T
+	Eigen::Matrix<double, N, N> covariance(void) const
+	{
+		Eigen::Matrix<double, N, N> P;
+		for (int i = 0; i < N; ++i) {
+			for (int j = i; j < N; ++j) {
+				// U is upper triangular: row i starts at column i, row j at column j
+				double sum = 0;
+				for (int k = j; k < N; ++k)
+					sum += double(U(i, k)) * double(D(k)) * double(U(j, k));
+				P(i, j) = sum;
+				P(j, i) = sum;
+			}
+		}
+		return P;
+	}
+
+	/// @return The variance of state i
+	double variance(int i) const
+	{
+		double sum = 0;
+		for (int k = i; k < N; ++k)
+			sum += double(U(i, k)) * double(U(i, k)) * double(D(k));
+		return sum;
+	}
+
+	/**
+	 * Bierman scalar measurement update, for the observation y = h^T x + v
+	 * with var(v) = r.
+	 * @param h The observation vector
+	 * @param r The variance of the observation noise
+	 * @param gain Output, the Kalman gain P*h/(h^T*P*h + r)
+	 * @return The innovation variance h^T*P*h + r
+	 */
+	template<typename T>
+	T update(const Eigen::Matrix<T, N, 1>& h, T r, Eigen::Matrix<T, N, 1>& gain)
+	{
+		Scalar f[N], v[N], b[N];
+		for (int j = 0; j < N; ++j) {
+			// f = U^T h
+			Scalar s = Scalar(h(j));
+			for (int i = 0; i < j; ++i)
+				s += U(i, j) * Scalar(h(i));
+			f[j] = s;
+			v[j] = D(j) * s;
+		}
+
+		Scalar alpha = Scalar(r);
+		for (int j = 0; j < N; ++j) {
+			Scalar alpha_prev = alpha;
+			alpha += f[j] * v[j];
+			Scalar lambda = -f[j] / alpha_prev;
+			D(j) *= alpha_prev / alpha;
+			b[j] = v[j];
+			for (int i = 0; i < j; ++i) {
+				Scalar u = U(i, j);
+				U(i, j) = u + b[i] * lambda;
+				b[i] += u * v[j];
+			}
+		}
+
+		for (int i = 0; i < N; ++i)
+			gain(i) = T(double(b[i]) / double(alpha));
+		return T(alpha);
+	}
+
+	/**
+	 * Time update P <- A*P*A^T + diag(q), by modified weighted Gram-Schmidt
+	 * orthogonalization of [A*U | I] (Thornton).
+	 * @param A The state transition matrix
+	 * @param q The diagonal of the process noise covariance
+	 */
+	template<typename T>
+	void predict(const Eigen::Matrix<T, N, N>& A, const Eigen::Matrix<T, N, 1>& q)
+	{
+		// W = [A*U | I], weights [D | q]
+		Scalar W[N][2*N];
+		Scalar Dw[2*N];
+		for (int i = 0; i < N; ++i) {
+			for (int k = 0; k < N; ++k) {
+				// A*U with U unit upper triangular
+				Scalar s = Scalar(A(i, k));
+				for (int m = 0; m < k; ++m)
+					s += Scalar(A(i, m)) * U(m, k);
+				W[i][k] = s;
+				W[i][N+k] = (i == k) ? Scalar(1) : Scalar(0);
+			}
+			Dw[i] = D(i);
+			Dw[N+i] = Scalar(q(i));
+		}
+
+		for (int j = N-1; j >= 0; --j) {
+			Scalar c[2*N];
+			Scalar d = 0;
+			for (int k = 0; k < 2*N; ++k) {
+				c[k] = Dw[k] * W[j][k];
+				d += W[j][k] * c[k];
+			}
+			D(j) = d;
+			U(j, j) = 1;
+			Scalar d_inv = (d > 0) ? Scalar(1)/d : Scalar(0);
+			for (int i = 0; i < j; ++i) {
+				Scalar s = 0;
+				for (int k = 0; k < 2*N; ++k)
+					s += W[i][k] * c[k];
+				s *= d_inv;
+				U(i, j) = s;
+				for (int k = 0; k < 2*N; ++k)
+					W[i][k] -= s * W[j][k];
+			}
+		}
+	}
+};
+
+#endif /* LIBEKNAV_UD_COVARIANCE_HPP */
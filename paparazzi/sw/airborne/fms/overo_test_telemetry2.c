@@ -6,9 +6,6 @@
 #include <event.h>
 #include <evutil.h>
 
-#include <string.h>
-#include <unistd.h>
-
 #include "downlink_transport.h"
 #include "messages2.h"
 #include "udp_transport2.h"
@@ -23,7 +20,7 @@
 //#define TIMEOUT_DT_USEC 500000
 #define TIMEOUT_DT_USEC 50000
 
-#define DL_MSG_SIZE 128
+#define DL_MSG_SIZE UDP_DL_PAYLOAD_LEN
 
 #define ADD_TIMEOUT() {				\
     struct timeval tv;				\
@@ -34,16 +31,24 @@
   }
 
 static void timeout_cb(int fd, short event, void *arg);
+static void dl_handle_msg(struct DownlinkTransport *tp);
 
 static struct event timeout;
 static struct event read_event;
 static struct FmsNetwork* network;
 static struct DownlinkTransport *udp_transport;
 
+bool_t my_dl_msg_available;
+uint8_t my_dl_buffer[DL_MSG_SIZE]  __attribute__ ((aligned));
+
 void timeout_cb(int fd, short event, void *arg) {
 
   //  printf("in timeout_cb\n");
 
+  /* the uplink frames received since the last timeout */
+  while (udp_transport_pop_msg(udp_transport, my_dl_buffer, sizeof(my_dl_buffer)))
+    dl_handle_msg(udp_transport);
+
   DOWNLINK_SEND_ALIVE(udp_transport, 16, MD5SUM);
 
   float  foof = 3.14159265358979323846;
@@ -58,22 +63,6 @@ void timeout_cb(int fd, short event, void *arg) {
 
 }
 
-static inline int checked_read(int fd, char *buf, size_t len)
-{
-  int bytes = read(fd, buf, len);
-
-  if (bytes == 0) {
-    fprintf(stderr, "Connection closed\n");
-  } else if (bytes == -1) {
-    perror("read");
-  }
-
-  return bytes;
-}
-
-bool_t my_dl_msg_available;
-uint8_t my_dl_buffer[DL_MSG_SIZE]  __attribute__ ((aligned));
-
 #define IdOfMsg(x) (x[1])
 
 static void dl_handle_msg(struct DownlinkTransport *tp) {
@@ -98,24 +87,10 @@ static void dl_handle_msg(struct DownlinkTransport *tp) {
 
 }
 
-static void on_datalink_event(int fd, short event __attribute__((unused)), void *arg)
+static void on_datalink_event(int fd __attribute__((unused)), short event __attribute__((unused)), void *arg)
 {
-  char buf[255];
-  int bytes_read;
-  bytes_read = checked_read(fd, buf, sizeof(buf) - 1);
   struct DownlinkTransport *tp = (struct DownlinkTransport *) arg;
-  struct udp_transport *udp_impl = tp->impl;
-
-  int i = 0;
-  while (i<bytes_read) {
-    parse_udp_dl(udp_impl, buf[i]);
-    i++;
-    if (udp_impl->udp_dl_msg_received) {
-      memcpy(my_dl_buffer, udp_impl->udp_dl_payload, udp_impl->udp_dl_payload_len);
-      dl_handle_msg(tp);
-      udp_impl->udp_dl_msg_received = FALSE;
-    }
-  }
+  udp_transport_receive(tp);
 }
 
 int main(int argc, char** argv) {
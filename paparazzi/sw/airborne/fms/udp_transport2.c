@@ -1,13 +1,40 @@
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "udp_transport2.h"
 #include "fms_network.h"
 #include "downlink_transport.h"
 
+static void flush(struct udp_transport *udp, int with_open);
+
+static inline uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline int *open_len(struct udp_transport *udp)
+{
+  return &udp->udpt_tx_len[udp->udpt_tx_nb_closed];
+}
+
+/* the open datagram is done, flush if it was the last buffer */
+static void close_datagram(struct udp_transport *udp)
+{
+  if (*open_len(udp) == 0)
+    return;
+  udp->udpt_tx_nb_closed++;
+  if (udp->udpt_tx_nb_closed == UDPT_TX_NB_BUF)
+    flush(udp, FALSE);
+}
+
 
 static void put_1byte(struct udp_transport *udp, const uint8_t x)
 {
-  udp->updt_tx_buf[udp->udpt_tx_buf_idx] = x;
-  udp->udpt_tx_buf_idx++;
+  int *len = open_len(udp);
+  udp->updt_tx_buf[udp->udpt_tx_nb_closed][*len] = x;
+  (*len)++;
 }
 
 static void put_uint8_t(struct udp_transport *udp, const uint8_t byte)
@@ -45,6 +72,8 @@ static void header(struct udp_transport *udp, uint8_t payload_len)
 static void start_message(void *impl, char *name, uint8_t msg_id, uint8_t payload_len)
 {
   struct udp_transport *udp = (struct udp_transport *) impl;
+  if (*open_len(udp) == 0)
+    udp->udpt_tx_first_us[udp->udpt_tx_nb_closed] = now_us();
   header(udp, 2 + payload_len);
   put_uint8_t(udp, AC_ID);
   put_named_uint8_t(udp, name, msg_id);
@@ -55,15 +84,15 @@ static void end_message(void *impl)
   struct udp_transport *udp = (struct udp_transport *) impl;
   put_1byte(udp, udp->udpt_ck_a);
   put_1byte(udp, udp->udpt_ck_b);
-  if (udp->udpt_tx_buf_idx > UDPT_TX_BUF_WATERMARK) {
-    network_write(udp->network, udp->updt_tx_buf, udp->udpt_tx_buf_idx);
-    udp->udpt_tx_buf_idx = 0;
-  }
+  udp->stats.nb_msgs++;
+  if (*open_len(udp) > UDPT_TX_BUF_WATERMARK)
+    close_datagram(udp);
 }
 
-static void overrun(void *impl __attribute__((unused)))
+static void overrun(void *impl)
 {
-
+  struct udp_transport *udp = (struct udp_transport *) impl;
+  udp->stats.nb_ovrn++;
 }
 
 static void count_bytes(void *udp __attribute__((unused)), uint8_t bytes __attribute__((unused)))
@@ -71,23 +100,129 @@ static void count_bytes(void *udp __attribute__((unused)), uint8_t bytes __attri
 
 }
 
-static int check_free_space(void *udp __attribute__((unused)), uint8_t bytes __attribute__((unused)))
+/* bytes is the whole message, as returned by size_of() */
+static int check_free_space(void *impl, uint8_t bytes)
 {
-	return TRUE;
+  struct udp_transport *udp = (struct udp_transport *) impl;
+  if (*open_len(udp) + bytes > UDPT_TX_BUF_LEN)
+    close_datagram(udp);
+  return *open_len(udp) + bytes <= UDPT_TX_BUF_LEN;
 }
 
+/* payload, plus STX, length, timestamp, AC_ID, msg_id and checksums */
 static uint8_t size_of(void *udp __attribute__((unused)), uint8_t len)
 {
-	return len + 2;
+  return len + PPRZ_PROTOCOL_OVERHEAD + 2;
+}
+
+/* sends the closed datagrams, and the open one if with_open */
+static void flush(struct udp_transport *udp, int with_open)
+{
+  int nb = udp->udpt_tx_nb_closed;
+  /* none when all the buffers are closed */
+  int open = nb < UDPT_TX_NB_BUF ? udp->udpt_tx_len[nb] : 0;
+  if (with_open && open > 0)
+    nb++;
+  if (nb == 0)
+    return;
+
+  char *bufs[UDPT_TX_NB_BUF];
+  uint64_t now = now_us();
+  for (int i = 0; i < nb; i++) {
+    bufs[i] = udp->updt_tx_buf[i];
+    uint32_t latency = now - udp->udpt_tx_first_us[i];
+    udp->stats.latency_sum_us += latency;
+    if (latency > udp->stats.latency_max_us)
+      udp->stats.latency_max_us = latency;
+  }
+  int sent = network_write_multi(udp->network, bufs, udp->udpt_tx_len, nb);
+  udp->stats.nb_syscalls++;
+  udp->stats.nb_packets += sent;
+  udp->stats.nb_send_err += nb - sent;
+  for (int i = 0; i < sent; i++)
+    udp->stats.nb_bytes += udp->udpt_tx_len[i];
+
+  /* a still open datagram moves to the first buffer */
+  if (nb == udp->udpt_tx_nb_closed && open > 0) {
+    memcpy(udp->updt_tx_buf[0], udp->updt_tx_buf[nb], open);
+    udp->udpt_tx_first_us[0] = udp->udpt_tx_first_us[nb];
+    udp->udpt_tx_len[0] = open;
+  }
+  else
+    udp->udpt_tx_len[0] = 0;
+  udp->udpt_tx_nb_closed = 0;
+  for (int i = 1; i < UDPT_TX_NB_BUF; i++)
+    udp->udpt_tx_len[i] = 0;
 }
 
 static void periodic(void *impl)
 {
   struct udp_transport *udp = (struct udp_transport *) impl;
-  if (udp->udpt_tx_buf_idx > 0) {
-    network_write(udp->network, udp->updt_tx_buf, udp->udpt_tx_buf_idx);
-    udp->udpt_tx_buf_idx = 0;
+  int stale = *open_len(udp) > 0 &&
+    now_us() - udp->udpt_tx_first_us[udp->udpt_tx_nb_closed] >= UDPT_TX_MAX_LATENCY_US;
+  flush(udp, stale);
+}
+
+static void push_msg(struct udp_transport *udp)
+{
+  uint32_t head = udp->udp_dl_queue_head;
+  if (head - __atomic_load_n(&udp->udp_dl_queue_tail, __ATOMIC_ACQUIRE) == UDP_DL_QUEUE_LEN) {
+    udp->udp_dl_ovrn++;
+    return;
+  }
+  struct udp_dl_msg *msg = &udp->udp_dl_queue[head % UDP_DL_QUEUE_LEN];
+  msg->len = udp->udp_dl_payload_len;
+  memcpy(msg->payload, udp->udp_dl_payload, msg->len);
+  __atomic_store_n(&udp->udp_dl_queue_head, head + 1, __ATOMIC_RELEASE);
+  udp->stats.nb_rx_msgs++;
+}
+
+int udp_transport_receive(struct DownlinkTransport *tp)
+{
+  struct udp_transport *udp = (struct udp_transport *) tp->impl;
+  static char buf[UDPT_RX_BATCH][UDPT_RX_BUF_LEN];
+  static char *bufs[UDPT_RX_BATCH];
+  int lens[UDPT_RX_BATCH];
+  uint32_t nb_msgs = udp->stats.nb_rx_msgs;
+  int nb;
+
+  for (int i = 0; i < UDPT_RX_BATCH; i++)
+    bufs[i] = buf[i];
+  do {
+    nb = network_read_multi(udp->network, bufs, UDPT_RX_BUF_LEN, lens, UDPT_RX_BATCH);
+    udp->stats.nb_rx_syscalls++;
+    for (int i = 0; i < nb; i++) {
+      udp->stats.nb_rx_datagrams++;
+      udp->stats.nb_rx_bytes += lens[i];
+      for (int j = 0; j < lens[i]; j++) {
+        parse_udp_dl(udp, buf[i][j]);
+        if (udp->udp_dl_msg_received) {
+          push_msg(udp);
+          udp->udp_dl_msg_received = FALSE;
+        }
+      }
+    }
+  } while (nb == UDPT_RX_BATCH);
+
+  return udp->stats.nb_rx_msgs - nb_msgs;
+}
+
+uint8_t udp_transport_pop_msg(struct DownlinkTransport *tp, uint8_t *payload, uint16_t size)
+{
+  struct udp_transport *udp = (struct udp_transport *) tp->impl;
+  uint32_t tail = udp->udp_dl_queue_tail;
+  uint8_t len = 0;
+  while (!len && tail != __atomic_load_n(&udp->udp_dl_queue_head, __ATOMIC_ACQUIRE)) {
+    struct udp_dl_msg *msg = &udp->udp_dl_queue[tail % UDP_DL_QUEUE_LEN];
+    /* a frame longer than the caller's buffer is skipped */
+    if (msg->len <= size) {
+      len = msg->len;
+      memcpy(payload, msg->payload, len);
+    }
+    tail++;
+    __atomic_store_n(&udp->udp_dl_queue_tail, tail, __ATOMIC_RELEASE);
   }
+  return len;
 }
 
 struct DownlinkTransport *udp_transport_new(struct FmsNetwork *network)
@@ -15,18 +15,73 @@
 #endif
 
 struct DownlinkTransport *udp_transport_new(struct FmsNetwork *network);
+/* reads the pending datagrams, returns the number of frames queued */
+extern int udp_transport_receive(struct DownlinkTransport *tp);
+/* copies the oldest frame to payload, returns its length, 0 if none */
+extern uint8_t udp_transport_pop_msg(struct DownlinkTransport *tp, uint8_t *payload, uint16_t size);
 
+/*
+ * Downlink messages are packed in datagrams of up to UDPT_TX_BUF_LEN
+ * bytes.  A datagram is closed once it holds more than
+ * UDPT_TX_BUF_WATERMARK bytes, or the next message does not fit, and the
+ * closed ones go out together, with one system call, when the
+ * UDPT_TX_NB_BUF buffers are used up or on the next Periodic().
+ * Periodic() also sends the open datagram once its first message is
+ * UDPT_TX_MAX_LATENCY_US old, so that low rate telemetry does not wait
+ * for the watermark: it has to be called at least that often.
+ */
 #define UDPT_TX_BUF_LEN 1496
 #define UDPT_TX_BUF_WATERMARK 1024
+#define UDPT_TX_NB_BUF 8
+#ifndef UDPT_TX_MAX_LATENCY_US
+#define UDPT_TX_MAX_LATENCY_US 20000
+#endif
 #define UDP_DL_PAYLOAD_LEN 256
 
+/*
+ * Uplink datagrams are drained from the socket, UDPT_RX_BATCH at a time,
+ * by udp_transport_receive() in the event loop, and the frames parsed go
+ * through a single producer, single consumer queue to
+ * udp_transport_pop_msg(), called from the periodic task.
+ */
+#define UDPT_RX_BATCH 8
+#define UDPT_RX_BUF_LEN 1500
+/* a power of two */
+#define UDP_DL_QUEUE_LEN 16
+
+struct udp_dl_msg {
+  uint8_t len;
+  uint8_t payload[UDP_DL_PAYLOAD_LEN];
+};
+
+struct udp_transport_stats {
+  uint32_t nb_msgs;
+  uint32_t nb_bytes;
+  uint32_t nb_packets;
+  uint32_t nb_syscalls;
+  uint32_t nb_ovrn;           /* messages dropped, not fitting a datagram */
+  uint32_t nb_send_err;       /* datagrams the network did not take       */
+  /* from the first message of a datagram to its sending */
+  uint32_t latency_max_us;
+  uint64_t latency_sum_us;
+  /* uplink, errors and overruns are counted by the parser */
+  uint32_t nb_rx_datagrams;
+  uint32_t nb_rx_bytes;
+  uint32_t nb_rx_syscalls;
+  uint32_t nb_rx_msgs;
+};
+
 struct udp_transport {
   /*
    * Downlink
    */
-  char updt_tx_buf[UDPT_TX_BUF_LEN];
-  uint16_t udpt_tx_buf_idx;
+  char updt_tx_buf[UDPT_TX_NB_BUF][UDPT_TX_BUF_LEN];
+  int udpt_tx_len[UDPT_TX_NB_BUF];
+  uint64_t udpt_tx_first_us[UDPT_TX_NB_BUF];
+  /* datagrams closed, the open one is next */
+  uint8_t udpt_tx_nb_closed;
   uint8_t udpt_ck_a, udpt_ck_b;
+  struct udp_transport_stats stats;
 
   /*
    * Uplink
@@ -34,9 +89,13 @@ struct udp_transport {
   uint8_t udp_dl_payload[UDP_DL_PAYLOAD_LEN];
   volatile uint8_t udp_dl_payload_len;
   volatile bool_t udp_dl_msg_received;
-  uint8_t udp_dl_ovrn, udp_dl_nb_err;
+  /* frames lost, the previous one or the queue being full, bad checksums */
+  uint32_t udp_dl_ovrn, udp_dl_nb_err;
   uint8_t udp_dl_status;
   uint8_t _ck_a, _ck_b, payload_idx;
+  struct udp_dl_msg udp_dl_queue[UDP_DL_QUEUE_LEN];
+  /* written by the producer and the consumer only, respectively */
+  uint32_t udp_dl_queue_head, udp_dl_queue_tail;
 
   struct FmsNetwork *network;
 };
@@ -31,6 +31,7 @@ void overo_link_arch_init(void) {
   SPI_InitStructure.SPI_NSS               = SPI_NSS_Hard;
   SPI_InitStructure.SPI_BaudRatePrescaler = SPI_BaudRatePrescaler_2;
   SPI_InitStructure.SPI_FirstBit          = SPI_FirstBit_MSB;
+  /* same crc as pprz_crc8_block() on the Overo side, math/pprz_crc8.h */
   SPI_InitStructure.SPI_CRCPolynomial     = 0x31;
   SPI_Init(SPI1, &SPI_InitStructure);
 
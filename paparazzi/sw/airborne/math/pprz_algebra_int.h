@@ -532,12 +532,7 @@ struct Int64Vect3 {
   }
 
 #define INT32_QUAT_NORMALISE(q) {		                        \
-    int32_t n;								\
-    INT32_QUAT_NORM(n, q);						\
-    q.qi = q.qi * QUAT1_BFP_OF_REAL(1) / n;				\
-    q.qx = q.qx * QUAT1_BFP_OF_REAL(1) / n;				\
-    q.qy = q.qy * QUAT1_BFP_OF_REAL(1) / n;				\
-    q.qz = q.qz * QUAT1_BFP_OF_REAL(1) / n;				\
+    int32_quat_normalise(&(q));						\
   }
 
 /* _a2c = _a2b comp _b2c , aka  _a2c = _b2c * _a2b */
@@ -730,17 +725,9 @@ struct Int64Vect3 {
 
 #define INT32_EULERS_OF_RMAT(_e, _rm) {					\
     									\
-    const float dcm00 = TRIG_FLOAT_OF_BFP((_rm).m[0]);			\
-    const float dcm01 = TRIG_FLOAT_OF_BFP((_rm).m[1]);			\
-    const float dcm02 = TRIG_FLOAT_OF_BFP((_rm).m[2]);			\
-    const float dcm12 = TRIG_FLOAT_OF_BFP((_rm).m[5]);			\
-    const float dcm22 = TRIG_FLOAT_OF_BFP((_rm).m[8]);			\
-    const float phi   = atan2f( dcm12, dcm22 );				\
-    const float theta = -asinf( dcm02 );				\
-    const float psi   = atan2f( dcm01, dcm00 );				\
-    (_e).phi   = ANGLE_BFP_OF_REAL(phi);				\
-    (_e).theta = ANGLE_BFP_OF_REAL(theta);				\
-    (_e).psi   = ANGLE_BFP_OF_REAL(psi);				\
+    (_e).phi   = int32_atan2((_rm).m[5], (_rm).m[8]);			\
+    (_e).theta = -int32_asin((_rm).m[2]);				\
+    (_e).psi   = int32_atan2((_rm).m[1], (_rm).m[0]);			\
     									\
   }
 
@@ -774,18 +761,9 @@ struct Int64Vect3 {
     /* dcm22 = 1.0 - 2.*(  qx2 +  qy2 ); */				\
     const int32_t idcm22 = one - INT_MULT_RSHIFT( two, (qx2+qy2),	\
 						  INT32_TRIG_FRAC+INT32_QUAT_FRAC-INT32_TRIG_FRAC); \
-    const float dcm00 = (float)idcm00/(1<<INT32_TRIG_FRAC);		\
-    const float dcm01 = (float)idcm01/(1<<INT32_TRIG_FRAC);		\
-    const float dcm02 = (float)idcm02/(1<<INT32_TRIG_FRAC);		\
-    const float dcm12 = (float)idcm12/(1<<INT32_TRIG_FRAC);		\
-    const float dcm22 = (float)idcm22/(1<<INT32_TRIG_FRAC);		\
-									\
-    const float phi   = atan2f( dcm12, dcm22 );				\
-    const float theta = -asinf( dcm02 );				\
-    const float psi   = atan2f( dcm01, dcm00 );				\
-    (_e).phi   = ANGLE_BFP_OF_REAL(phi);				\
-    (_e).theta = ANGLE_BFP_OF_REAL(theta);				\
-    (_e).psi   = ANGLE_BFP_OF_REAL(psi);				\
+    (_e).phi   = int32_atan2(idcm12, idcm22);				\
+    (_e).theta = -int32_asin(idcm02);					\
+    (_e).psi   = int32_atan2(idcm01, idcm00);				\
     									\
   }
 
@@ -800,6 +778,12 @@ struct Int64Vect3 {
 
 #define INT_RATES_ZERO(_e) RATES_ASSIGN(_e, 0, 0, 0)
 
+#define INT_RATES_RSHIFT(_o, _i, _r) { \
+    (_o).p = ((_i).p >> (_r));		 \
+    (_o).q = ((_i).q >> (_r));		 \
+    (_o).r = ((_i).r >> (_r));		 \
+  }
+
 #define INT32_RATES_OF_EULERS_DOT_321(_r, _e, _ed) {				\
 									\
     int32_t sphi;							\
@@ -851,26 +835,128 @@ struct Int64Vect3 {
 #define INT32_EULERS_DOT_OF_RATES(_ed, _e, _r) INT32_EULERS_DOT_321_OF_RATES(_ed, _e, _r)
 
 /*
- *
+ * Integer kernels of bounded latency: the same number of iterations
+ * whatever the input, and no division, for processors without FPU nor
+ * hardware divider.  Check their accuracy with test/test_int_trig and
+ * their speed with test/bench_math.
+ */
+
+/* floor(sqrt(in)), bit by bit in 16 steps */
+static inline uint32_t int32_sqrt(uint32_t in) {
+  uint32_t root = 0;
+  uint32_t rem = in;
+  uint32_t bit = 1u << 30;
+  int i;
+  for (i = 0; i < 16; i++) {
+    const uint32_t trial = root + bit;
+    const uint32_t mask = -(uint32_t)(rem >= trial);
+    rem -= trial & mask;
+    root = (root >> 1) + (bit & mask);
+    bit >>= 2;
+  }
+  return root;
+}
+
+/*
+ * 1/sqrt(x) for x in [0.25, 1[ with 30 fractional bits, in [1, 2] with
+ * 30 fractional bits: linear seed within 9%, then three Newton steps.
+ */
+static inline uint32_t int32_rsqrt_q30(uint32_t x) {
+  uint64_t y = (uint64_t)BFP_OF_REAL(2.134, 30) - (((uint64_t)BFP_OF_REAL(1.22, 30) * x) >> 30);
+  int i;
+  for (i = 0; i < 3; i++) {
+    const uint64_t y2 = (y * y) >> 30;
+    const uint64_t t = ((uint64_t)3 << 30) - (((uint64_t)x * y2) >> 30);
+    y = (y * t) >> 31;
+  }
+  return y;
+}
+
+/* scales q to unit norm with a reciprocal square root, q must not be null */
+static inline void int32_quat_normalise(struct Int32Quat* q) {
+  const uint64_t n2 = (int64_t)q->qi * q->qi + (int64_t)q->qx * q->qx +
+                      (int64_t)q->qy * q->qy + (int64_t)q->qz * q->qz;
+  if (n2 == 0)
+    return;
+  /* n2 << s in [2^28, 2^30[, s even */
+  const int msb = 63 - __builtin_clzll(n2);
+  const int s = (29 - msb) & ~1;
+  const uint32_t x = s >= 0 ? n2 << s : n2 >> -s;
+  const int64_t r = int32_rsqrt_q30(x);
+  /* q / |q| = q * r * 2^(s/2 - 30) */
+  const int shift = 30 - s / 2;
+  q->qi = (q->qi * r) >> shift;
+  q->qx = (q->qx * r) >> shift;
+  q->qy = (q->qy * r) >> shift;
+  q->qz = (q->qz * r) >> shift;
+}
+
+/*
+ * atan2(y, x) with INT32_ANGLE_FRAC fractional bits, in [-pi, pi]:
+ * CORDIC in vectoring mode on the inputs scaled to 29 bits, with the
+ * angles kept with 20 fractional bits.
  */
-#define INT32_SQRT_MAX_ITER 40
+#define INT32_CORDIC_ITER 16
+#define INT32_CORDIC_FRAC 20
+
+static inline int32_t int32_atan2(int32_t y, int32_t x) {
+  static const int32_t atan_tab[INT32_CORDIC_ITER] = {
+    823550, 486170, 256879, 130396, 65451, 32757, 16383, 8192,
+    4096, 2048, 1024, 512, 256, 128, 64, 32
+  };
+  const uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+  const uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+  if ((ax | ay) == 0)
+    return 0;
+  /* largest of |x| and |y| in [2^27, 2^28[, the CORDIC gain keeps it in 30 bits */
+  const int shift = 27 - (31 - __builtin_clz(ax | ay));
+  int32_t vx, vy, z;
+  if (shift >= 0) {
+    vx = (int32_t)((uint32_t)x << shift);
+    vy = (int32_t)((uint32_t)y << shift);
+  }
+  else {
+    vx = x >> -shift;
+    vy = y >> -shift;
+  }
+  /* to the right half plane */
+  z = 0;
+  if (vx < 0) {
+    const int32_t pi = BFP_OF_REAL(3.1415926535897932384626433832795029, INT32_CORDIC_FRAC);
+    z = y < 0 ? -pi : pi;
+    vx = -vx;
+    vy = -vy;
+  }
+  int i;
+  for (i = 0; i < INT32_CORDIC_ITER; i++) {
+    /* rotates towards the x axis, by -atan(2^-i) if vy >= 0 */
+    const int32_t d = vy >> 31;
+    const int32_t dx = ((vy >> i) ^ d) - d;
+    const int32_t dy = ((vx >> i) ^ d) - d;
+    vx += dx;
+    vy -= dy;
+    z += (atan_tab[i] ^ d) - d;
+  }
+  const int32_t r = INT32_CORDIC_FRAC - INT32_ANGLE_FRAC;
+  return (z + (1 << (r - 1))) >> r;
+}
+
+/* asin(s), s with INT32_TRIG_FRAC fractional bits, clamped to [-1, 1] */
+static inline int32_t int32_asin(int32_t s) {
+  const int32_t one = TRIG_BFP_OF_REAL(1);
+  if (s > one) s = one;
+  else if (s < -one) s = -one;
+  const uint32_t c = int32_sqrt((uint32_t)(one * one - s * s));
+  return int32_atan2(s, c);
+}
+
 #define INT32_SQRT(_out,_in) {			                        \
-    if (_in == 0)							\
-      _out = 0;								\
-    else {								\
-      uint32_t s1, s2;							\
-      uint8_t iter = 0;							\
-      s2 = _in;								\
-      do {								\
-	s1 = s2;							\
-	s2 = _in / s1;							\
-	s2 += s1;							\
-	s2 /= 2;							\
-	iter++;								\
-      }									\
-      while( ( (s1-s2) > 1) && (iter < INT32_SQRT_MAX_ITER));		\
-      _out = s2;							\
-    }									\
+    _out = int32_sqrt(_in);						\
+  }
+
+
+#define INT32_ATAN2(_a, _y, _x) {			\
+    _a = int32_atan2(_y, _x);				\
   }
 
 
@@ -879,24 +965,6 @@ struct Int64Vect3 {
 
 #define R_FRAC 14
 
-#define INT32_ATAN2(_a, _y, _x) {			\
-    const int32_t c1 = INT32_ANGLE_PI_4;		\
-    const int32_t c2 = 3 * INT32_ANGLE_PI_4;		\
-    const int32_t abs_y = abs(_y) + 1;			\
-    int32_t r;						\
-    if ( _x >= 0) {					\
-      r = ((_x-abs_y)<<R_FRAC) / (_x+abs_y);		\
-      _a = c1 - ((c1 * r)>>R_FRAC);			\
-    }							\
-    else {						\
-      r = ((_x+abs_y)<<R_FRAC) / (abs_y-_x);		\
-      _a = c2 - ((c1 * r)>>R_FRAC);			\
-    }							\
-    if (_y<0)						\
-      _a = -_a;						\
-  }
-
-
 #define INT32_ATAN2_2(_a, _y, _x) {					\
     const int32_t c1 = INT32_ANGLE_PI_4;				\
     const int32_t c2 = 3 * INT32_ANGLE_PI_4;				\
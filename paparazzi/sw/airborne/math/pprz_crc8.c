@@ -0,0 +1,116 @@
+/*
+ * $Id$
+ *
+ * Copyright (C) 2010 Paparazzi Team
+ *
+ * This file is part of paparazzi.
+ *
+ * paparazzi is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * paparazzi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with paparazzi; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "math/pprz_crc8.h"
+
+/*
+ * Generated for polynomial 0x31 : table[0] is the crc of each byte,
+ * table[k][x] = table[0][table[k-1][x]].
+ */
+const uint8_t pprz_crc8_table[4][256] = {
+  {
+    0x00, 0x31, 0x62, 0x53, 0xc4, 0xf5, 0xa6, 0x97, 0xb9, 0x88, 0xdb, 0xea, 0x7d, 0x4c, 0x1f, 0x2e,
+    0x43, 0x72, 0x21, 0x10, 0x87, 0xb6, 0xe5, 0xd4, 0xfa, 0xcb, 0x98, 0xa9, 0x3e, 0x0f, 0x5c, 0x6d,
+    0x86, 0xb7, 0xe4, 0xd5, 0x42, 0x73, 0x20, 0x11, 0x3f, 0x0e, 0x5d, 0x6c, 0xfb, 0xca, 0x99, 0xa8,
+    0xc5, 0xf4, 0xa7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7c, 0x4d, 0x1e, 0x2f, 0xb8, 0x89, 0xda, 0xeb,
+    0x3d, 0x0c, 0x5f, 0x6e, 0xf9, 0xc8, 0x9b, 0xaa, 0x84, 0xb5, 0xe6, 0xd7, 0x40, 0x71, 0x22, 0x13,
+    0x7e, 0x4f, 0x1c, 0x2d, 0xba, 0x8b, 0xd8, 0xe9, 0xc7, 0xf6, 0xa5, 0x94, 0x03, 0x32, 0x61, 0x50,
+    0xbb, 0x8a, 0xd9, 0xe8, 0x7f, 0x4e, 0x1d, 0x2c, 0x02, 0x33, 0x60, 0x51, 0xc6, 0xf7, 0xa4, 0x95,
+    0xf8, 0xc9, 0x9a, 0xab, 0x3c, 0x0d, 0x5e, 0x6f, 0x41, 0x70, 0x23, 0x12, 0x85, 0xb4, 0xe7, 0xd6,
+    0x7a, 0x4b, 0x18, 0x29, 0xbe, 0x8f, 0xdc, 0xed, 0xc3, 0xf2, 0xa1, 0x90, 0x07, 0x36, 0x65, 0x54,
+    0x39, 0x08, 0x5b, 0x6a, 0xfd, 0xcc, 0x9f, 0xae, 0x80, 0xb1, 0xe2, 0xd3, 0x44, 0x75, 0x26, 0x17,
+    0xfc, 0xcd, 0x9e, 0xaf, 0x38, 0x09, 0x5a, 0x6b, 0x45, 0x74, 0x27, 0x16, 0x81, 0xb0, 0xe3, 0xd2,
+    0xbf, 0x8e, 0xdd, 0xec, 0x7b, 0x4a, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xc2, 0xf3, 0xa0, 0x91,
+    0x47, 0x76, 0x25, 0x14, 0x83, 0xb2, 0xe1, 0xd0, 0xfe, 0xcf, 0x9c, 0xad, 0x3a, 0x0b, 0x58, 0x69,
+    0x04, 0x35, 0x66, 0x57, 0xc0, 0xf1, 0xa2, 0x93, 0xbd, 0x8c, 0xdf, 0xee, 0x79, 0x48, 0x1b, 0x2a,
+    0xc1, 0xf0, 0xa3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1a, 0x2b, 0xbc, 0x8d, 0xde, 0xef,
+    0x82, 0xb3, 0xe0, 0xd1, 0x46, 0x77, 0x24, 0x15, 0x3b, 0x0a, 0x59, 0x68, 0xff, 0xce, 0x9d, 0xac
+  },
+  {
+    0x00, 0xf4, 0xd9, 0x2d, 0x83, 0x77, 0x5a, 0xae, 0x37, 0xc3, 0xee, 0x1a, 0xb4, 0x40, 0x6d, 0x99,
+    0x6e, 0x9a, 0xb7, 0x43, 0xed, 0x19, 0x34, 0xc0, 0x59, 0xad, 0x80, 0x74, 0xda, 0x2e, 0x03, 0xf7,
+    0xdc, 0x28, 0x05, 0xf1, 0x5f, 0xab, 0x86, 0x72, 0xeb, 0x1f, 0x32, 0xc6, 0x68, 0x9c, 0xb1, 0x45,
+    0xb2, 0x46, 0x6b, 0x9f, 0x31, 0xc5, 0xe8, 0x1c, 0x85, 0x71, 0x5c, 0xa8, 0x06, 0xf2, 0xdf, 0x2b,
+    0x89, 0x7d, 0x50, 0xa4, 0x0a, 0xfe, 0xd3, 0x27, 0xbe, 0x4a, 0x67, 0x93, 0x3d, 0xc9, 0xe4, 0x10,
+    0xe7, 0x13, 0x3e, 0xca, 0x64, 0x90, 0xbd, 0x49, 0xd0, 0x24, 0x09, 0xfd, 0x53, 0xa7, 0x8a, 0x7e,
+    0x55, 0xa1, 0x8c, 0x78, 0xd6, 0x22, 0x0f, 0xfb, 0x62, 0x96, 0xbb, 0x4f, 0xe1, 0x15, 0x38, 0xcc,
+    0x3b, 0xcf, 0xe2, 0x16, 0xb8, 0x4c, 0x61, 0x95, 0x0c, 0xf8, 0xd5, 0x21, 0x8f, 0x7b, 0x56, 0xa2,
+    0x23, 0xd7, 0xfa, 0x0e, 0xa0, 0x54, 0x79, 0x8d, 0x14, 0xe0, 0xcd, 0x39, 0x97, 0x63, 0x4e, 0xba,
+    0x4d, 0xb9, 0x94, 0x60, 0xce, 0x3a, 0x17, 0xe3, 0x7a, 0x8e, 0xa3, 0x57, 0xf9, 0x0d, 0x20, 0xd4,
+    0xff, 0x0b, 0x26, 0xd2, 0x7c, 0x88, 0xa5, 0x51, 0xc8, 0x3c, 0x11, 0xe5, 0x4b, 0xbf, 0x92, 0x66,
+    0x91, 0x65, 0x48, 0xbc, 0x12, 0xe6, 0xcb, 0x3f, 0xa6, 0x52, 0x7f, 0x8b, 0x25, 0xd1, 0xfc, 0x08,
+    0xaa, 0x5e, 0x73, 0x87, 0x29, 0xdd, 0xf0, 0x04, 0x9d, 0x69, 0x44, 0xb0, 0x1e, 0xea, 0xc7, 0x33,
+    0xc4, 0x30, 0x1d, 0xe9, 0x47, 0xb3, 0x9e, 0x6a, 0xf3, 0x07, 0x2a, 0xde, 0x70, 0x84, 0xa9, 0x5d,
+    0x76, 0x82, 0xaf, 0x5b, 0xf5, 0x01, 0x2c, 0xd8, 0x41, 0xb5, 0x98, 0x6c, 0xc2, 0x36, 0x1b, 0xef,
+    0x18, 0xec, 0xc1, 0x35, 0x9b, 0x6f, 0x42, 0xb6, 0x2f, 0xdb, 0xf6, 0x02, 0xac, 0x58, 0x75, 0x81
+  },
+  {
+    0x00, 0x46, 0x8c, 0xca, 0x29, 0x6f, 0xa5, 0xe3, 0x52, 0x14, 0xde, 0x98, 0x7b, 0x3d, 0xf7, 0xb1,
+    0xa4, 0xe2, 0x28, 0x6e, 0x8d, 0xcb, 0x01, 0x47, 0xf6, 0xb0, 0x7a, 0x3c, 0xdf, 0x99, 0x53, 0x15,
+    0x79, 0x3f, 0xf5, 0xb3, 0x50, 0x16, 0xdc, 0x9a, 0x2b, 0x6d, 0xa7, 0xe1, 0x02, 0x44, 0x8e, 0xc8,
+    0xdd, 0x9b, 0x51, 0x17, 0xf4, 0xb2, 0x78, 0x3e, 0x8f, 0xc9, 0x03, 0x45, 0xa6, 0xe0, 0x2a, 0x6c,
+    0xf2, 0xb4, 0x7e, 0x38, 0xdb, 0x9d, 0x57, 0x11, 0xa0, 0xe6, 0x2c, 0x6a, 0x89, 0xcf, 0x05, 0x43,
+    0x56, 0x10, 0xda, 0x9c, 0x7f, 0x39, 0xf3, 0xb5, 0x04, 0x42, 0x88, 0xce, 0x2d, 0x6b, 0xa1, 0xe7,
+    0x8b, 0xcd, 0x07, 0x41, 0xa2, 0xe4, 0x2e, 0x68, 0xd9, 0x9f, 0x55, 0x13, 0xf0, 0xb6, 0x7c, 0x3a,
+    0x2f, 0x69, 0xa3, 0xe5, 0x06, 0x40, 0x8a, 0xcc, 0x7d, 0x3b, 0xf1, 0xb7, 0x54, 0x12, 0xd8, 0x9e,
+    0xd5, 0x93, 0x59, 0x1f, 0xfc, 0xba, 0x70, 0x36, 0x87, 0xc1, 0x0b, 0x4d, 0xae, 0xe8, 0x22, 0x64,
+    0x71, 0x37, 0xfd, 0xbb, 0x58, 0x1e, 0xd4, 0x92, 0x23, 0x65, 0xaf, 0xe9, 0x0a, 0x4c, 0x86, 0xc0,
+    0xac, 0xea, 0x20, 0x66, 0x85, 0xc3, 0x09, 0x4f, 0xfe, 0xb8, 0x72, 0x34, 0xd7, 0x91, 0x5b, 0x1d,
+    0x08, 0x4e, 0x84, 0xc2, 0x21, 0x67, 0xad, 0xeb, 0x5a, 0x1c, 0xd6, 0x90, 0x73, 0x35, 0xff, 0xb9,
+    0x27, 0x61, 0xab, 0xed, 0x0e, 0x48, 0x82, 0xc4, 0x75, 0x33, 0xf9, 0xbf, 0x5c, 0x1a, 0xd0, 0x96,
+    0x83, 0xc5, 0x0f, 0x49, 0xaa, 0xec, 0x26, 0x60, 0xd1, 0x97, 0x5d, 0x1b, 0xf8, 0xbe, 0x74, 0x32,
+    0x5e, 0x18, 0xd2, 0x94, 0x77, 0x31, 0xfb, 0xbd, 0x0c, 0x4a, 0x80, 0xc6, 0x25, 0x63, 0xa9, 0xef,
+    0xfa, 0xbc, 0x76, 0x30, 0xd3, 0x95, 0x5f, 0x19, 0xa8, 0xee, 0x24, 0x62, 0x81, 0xc7, 0x0d, 0x4b
+  },
+  {
+    0x00, 0x9b, 0x07, 0x9c, 0x0e, 0x95, 0x09, 0x92, 0x1c, 0x87, 0x1b, 0x80, 0x12, 0x89, 0x15, 0x8e,
+    0x38, 0xa3, 0x3f, 0xa4, 0x36, 0xad, 0x31, 0xaa, 0x24, 0xbf, 0x23, 0xb8, 0x2a, 0xb1, 0x2d, 0xb6,
+    0x70, 0xeb, 0x77, 0xec, 0x7e, 0xe5, 0x79, 0xe2, 0x6c, 0xf7, 0x6b, 0xf0, 0x62, 0xf9, 0x65, 0xfe,
+    0x48, 0xd3, 0x4f, 0xd4, 0x46, 0xdd, 0x41, 0xda, 0x54, 0xcf, 0x53, 0xc8, 0x5a, 0xc1, 0x5d, 0xc6,
+    0xe0, 0x7b, 0xe7, 0x7c, 0xee, 0x75, 0xe9, 0x72, 0xfc, 0x67, 0xfb, 0x60, 0xf2, 0x69, 0xf5, 0x6e,
+    0xd8, 0x43, 0xdf, 0x44, 0xd6, 0x4d, 0xd1, 0x4a, 0xc4, 0x5f, 0xc3, 0x58, 0xca, 0x51, 0xcd, 0x56,
+    0x90, 0x0b, 0x97, 0x0c, 0x9e, 0x05, 0x99, 0x02, 0x8c, 0x17, 0x8b, 0x10, 0x82, 0x19, 0x85, 0x1e,
+    0xa8, 0x33, 0xaf, 0x34, 0xa6, 0x3d, 0xa1, 0x3a, 0xb4, 0x2f, 0xb3, 0x28, 0xba, 0x21, 0xbd, 0x26,
+    0xf1, 0x6a, 0xf6, 0x6d, 0xff, 0x64, 0xf8, 0x63, 0xed, 0x76, 0xea, 0x71, 0xe3, 0x78, 0xe4, 0x7f,
+    0xc9, 0x52, 0xce, 0x55, 0xc7, 0x5c, 0xc0, 0x5b, 0xd5, 0x4e, 0xd2, 0x49, 0xdb, 0x40, 0xdc, 0x47,
+    0x81, 0x1a, 0x86, 0x1d, 0x8f, 0x14, 0x88, 0x13, 0x9d, 0x06, 0x9a, 0x01, 0x93, 0x08, 0x94, 0x0f,
+    0xb9, 0x22, 0xbe, 0x25, 0xb7, 0x2c, 0xb0, 0x2b, 0xa5, 0x3e, 0xa2, 0x39, 0xab, 0x30, 0xac, 0x37,
+    0x11, 0x8a, 0x16, 0x8d, 0x1f, 0x84, 0x18, 0x83, 0x0d, 0x96, 0x0a, 0x91, 0x03, 0x98, 0x04, 0x9f,
+    0x29, 0xb2, 0x2e, 0xb5, 0x27, 0xbc, 0x20, 0xbb, 0x35, 0xae, 0x32, 0xa9, 0x3b, 0xa0, 0x3c, 0xa7,
+    0x61, 0xfa, 0x66, 0xfd, 0x6f, 0xf4, 0x68, 0xf3, 0x7d, 0xe6, 0x7a, 0xe1, 0x73, 0xe8, 0x74, 0xef,
+    0x59, 0xc2, 0x5e, 0xc5, 0x57, 0xcc, 0x50, 0xcb, 0x45, 0xde, 0x42, 0xd9, 0x4b, 0xd0, 0x4c, 0xd7
+  }
+};
+
+uint8_t pprz_crc8_update(uint8_t crc, const uint8_t* buf, uint32_t len) {
+  /* the crc is linear : the four bytes of a word contribute independently */
+  while (len >= 4) {
+    crc = pprz_crc8_table[3][crc ^ buf[0]] ^ pprz_crc8_table[2][buf[1]] ^
+          pprz_crc8_table[1][buf[2]] ^ pprz_crc8_table[0][buf[3]];
+    buf += 4;
+    len -= 4;
+  }
+  while (len--)
+    crc = PprzCrc8Byte(crc, *buf++);
+  return crc;
+}
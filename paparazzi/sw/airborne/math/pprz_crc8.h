@@ -0,0 +1,52 @@
+/*
+ * $Id$
+ *
+ * Copyright (C) 2010 Paparazzi Team
+ *
+ * This file is part of paparazzi.
+ *
+ * paparazzi is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * paparazzi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with paparazzi; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * CRC-8, polynomial x^8+x^5+x^4+1 (0x31), initial value 0, MSB first,
+ * no final xor : the checksum the STM32 SPI peripheral computes in
+ * hardware on the Overo link (SPI_CRCPolynomial = 0x31).
+ *
+ * Table driven, four bytes at a time ("slicing by 4") : the tables are
+ * const, 1 KB of flash on the microcontrollers.
+ */
+
+#ifndef PPRZ_CRC8_H
+#define PPRZ_CRC8_H
+
+#include <inttypes.h>
+
+#define PPRZ_CRC8_POLYNOMIAL 0x31
+
+/* pprz_crc8_table[k][x] : crc of byte x followed by k zero bytes */
+extern const uint8_t pprz_crc8_table[4][256];
+
+/* crc of len bytes, continuing from crc (0 for a new block) */
+extern uint8_t pprz_crc8_update(uint8_t crc, const uint8_t* buf, uint32_t len);
+
+#define PprzCrc8Byte(_crc, _byte) (pprz_crc8_table[0][(uint8_t)((_crc) ^ (_byte))])
+
+static inline uint8_t pprz_crc8_block(const uint8_t* buf, uint32_t len) {
+  return pprz_crc8_update(0, buf, len);
+}
+
+#endif /* PPRZ_CRC8_H */
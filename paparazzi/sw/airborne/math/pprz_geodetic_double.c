@@ -1,6 +1,9 @@
 #include "pprz_geodetic_double.h"
 
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void ltp_def_from_ecef_d(struct LtpDef_d* def, struct EcefCoor_d* ecef) {
 
@@ -26,7 +29,7 @@ void ltp_def_from_ecef_d(struct LtpDef_d* def, struct EcefCoor_d* ecef) {
 }
 
 /* http://en.wikipedia.org/wiki/Geodetic_system */
-void lla_of_ecef_d(struct LlaCoor_d* lla, struct EcefCoor_d* ecef) {
+static inline void lla_of_ecef_1_d(struct LlaCoor_d* lla, const struct EcefCoor_d* ecef) {
 
   // FIXME : make an ellipsoid struct
   static const double a = 6378137.0;           /* earth semimajor axis in meters */
@@ -45,7 +48,7 @@ void lla_of_ecef_d(struct LlaCoor_d* lla, struct EcefCoor_d* ecef) {
   const double F = 54.*b2*z2;
   const double G = r2 + (1-e2)*z2 - e2*E2;
   const double c = (e2*e2*F*r2)/(G*G*G);
-  const double s = pow( (1 + c + sqrt(c*c + 2*c)), 1./3.);
+  const double s = cbrt(1 + c + sqrt(c*c + 2*c));
   const double s1 = 1+s+1/s;
   const double P = F/(3*s1*s1*G*G);
   const double Q = sqrt(1+2*e2*e2*P);
@@ -61,18 +64,22 @@ void lla_of_ecef_d(struct LlaCoor_d* lla, struct EcefCoor_d* ecef) {
 
 }
 
-void ecef_of_lla_d(struct EcefCoor_d* ecef, struct LlaCoor_d* lla) {
+void lla_of_ecef_d(struct LlaCoor_d* lla, struct EcefCoor_d* ecef) {
+  lla_of_ecef_1_d(lla, ecef);
+}
+
+static inline void ecef_of_lla_1_d(struct EcefCoor_d* ecef, const struct LlaCoor_d* lla) {
 
   // FIXME : make an ellipsoid struct
   static const double a = 6378137.0;           /* earth semimajor axis in meters */
   static const double f = 1./298.257223563;    /* reciprocal flattening          */
   const double e2 = 2.*f-(f*f);                /* first eccentricity squared     */
 
-  const double sin_lat = sinf(lla->lat);
-  const double cos_lat = cosf(lla->lat);
-  const double sin_lon = sinf(lla->lon);
-  const double cos_lon = cosf(lla->lon);
-  const double chi = sqrtf(1. - e2*sin_lat*sin_lat);
+  const double sin_lat = sin(lla->lat);
+  const double cos_lat = cos(lla->lat);
+  const double sin_lon = sin(lla->lon);
+  const double cos_lon = cos(lla->lon);
+  const double chi = sqrt(1. - e2*sin_lat*sin_lat);
   const double a_chi = a / chi;
 
   ecef->x = (a_chi + lla->alt) * cos_lat * cos_lon;
@@ -80,6 +87,10 @@ void ecef_of_lla_d(struct EcefCoor_d* ecef, struct LlaCoor_d* lla) {
   ecef->z = (a_chi*(1. - e2) + lla->alt) * sin_lat;
 }
 
+void ecef_of_lla_d(struct EcefCoor_d* ecef, struct LlaCoor_d* lla) {
+  ecef_of_lla_1_d(ecef, lla);
+}
+
 void enu_of_ecef_point_d(struct EnuCoor_d* enu, struct LtpDef_d* def, struct EcefCoor_d* ecef) {
   struct EcefCoor_d delta;
   VECT3_DIFF(delta, *ecef, def->ecef);
@@ -137,3 +148,118 @@ double gc_of_gd_lat_d(double gd_lat, double hmsl) {
 
 
 
+/*
+ * out = m * (in - o1) + o2 on n points of 3 doubles, the local tangent
+ * plane conversions in both directions
+ */
+static void affine_points_d(int n, double* out, const struct DoubleMat33* m,
+                            const double* o1, const double* o2, const double* in) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128d m0 = _mm_set1_pd(m->m[0]), m1 = _mm_set1_pd(m->m[1]), m2 = _mm_set1_pd(m->m[2]);
+  const __m128d m3 = _mm_set1_pd(m->m[3]), m4 = _mm_set1_pd(m->m[4]), m5 = _mm_set1_pd(m->m[5]);
+  const __m128d m6 = _mm_set1_pd(m->m[6]), m7 = _mm_set1_pd(m->m[7]), m8 = _mm_set1_pd(m->m[8]);
+  const __m128d o1x = _mm_set1_pd(o1[0]), o1y = _mm_set1_pd(o1[1]), o1z = _mm_set1_pd(o1[2]);
+  const __m128d o2x = _mm_set1_pd(o2[0]), o2y = _mm_set1_pd(o2[1]), o2z = _mm_set1_pd(o2[2]);
+  for (; i + 2 <= n; i += 2) {
+    /* x0 y0 | z0 x1 | y1 z1 to x0 x1 | y0 y1 | z0 z1 */
+    const __m128d a = _mm_loadu_pd(in + 3 * i);
+    const __m128d b = _mm_loadu_pd(in + 3 * i + 2);
+    const __m128d c = _mm_loadu_pd(in + 3 * i + 4);
+    const __m128d x = _mm_sub_pd(_mm_shuffle_pd(a, b, _MM_SHUFFLE2(1, 0)), o1x);
+    const __m128d y = _mm_sub_pd(_mm_shuffle_pd(a, c, _MM_SHUFFLE2(0, 1)), o1y);
+    const __m128d z = _mm_sub_pd(_mm_shuffle_pd(b, c, _MM_SHUFFLE2(1, 0)), o1z);
+    const __m128d ox = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m0, x), _mm_mul_pd(m1, y)),
+                                  _mm_add_pd(_mm_mul_pd(m2, z), o2x));
+    const __m128d oy = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m3, x), _mm_mul_pd(m4, y)),
+                                  _mm_add_pd(_mm_mul_pd(m5, z), o2y));
+    const __m128d oz = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m6, x), _mm_mul_pd(m7, y)),
+                                  _mm_add_pd(_mm_mul_pd(m8, z), o2z));
+    _mm_storeu_pd(out + 3 * i,     _mm_shuffle_pd(ox, oy, _MM_SHUFFLE2(0, 0)));
+    _mm_storeu_pd(out + 3 * i + 2, _mm_shuffle_pd(oz, ox, _MM_SHUFFLE2(1, 0)));
+    _mm_storeu_pd(out + 3 * i + 4, _mm_shuffle_pd(oy, oz, _MM_SHUFFLE2(1, 1)));
+  }
+#endif
+  for (; i < n; i++) {
+    const double* p = in + 3 * i;
+    double* q = out + 3 * i;
+    const double x = p[0] - o1[0];
+    const double y = p[1] - o1[1];
+    const double z = p[2] - o1[2];
+    q[0] = m->m[0] * x + m->m[1] * y + (m->m[2] * z + o2[0]);
+    q[1] = m->m[3] * x + m->m[4] * y + (m->m[5] * z + o2[1]);
+    q[2] = m->m[6] * x + m->m[7] * y + (m->m[8] * z + o2[2]);
+  }
+}
+
+static const double zero_d[3] = { 0., 0., 0. };
+
+void enu_of_ecef_points_d(int n, struct EnuCoor_d* enu, struct LtpDef_d* def, struct EcefCoor_d* ecef) {
+  affine_points_d(n, &enu->x, &def->ltp_of_ecef, &def->ecef.x, zero_d, &ecef->x);
+}
+
+void ned_of_ecef_points_d(int n, struct NedCoor_d* ned, struct LtpDef_d* def, struct EcefCoor_d* ecef) {
+  /* the rows of ltp_of_ecef, north east down */
+  const double* m = def->ltp_of_ecef.m;
+  const struct DoubleMat33 ned_of_ecef = {{  m[3],  m[4],  m[5],
+                                             m[0],  m[1],  m[2],
+                                            -m[6], -m[7], -m[8] }};
+  affine_points_d(n, &ned->x, &ned_of_ecef, &def->ecef.x, zero_d, &ecef->x);
+}
+
+void ecef_of_enu_points_d(int n, struct EcefCoor_d* ecef, struct LtpDef_d* def, struct EnuCoor_d* enu) {
+  const double* m = def->ltp_of_ecef.m;
+  const struct DoubleMat33 ecef_of_enu = {{ m[0], m[3], m[6],
+                                            m[1], m[4], m[7],
+                                            m[2], m[5], m[8] }};
+  affine_points_d(n, &ecef->x, &ecef_of_enu, zero_d, &def->ecef.x, &enu->x);
+}
+
+void ecef_of_ned_points_d(int n, struct EcefCoor_d* ecef, struct LtpDef_d* def, struct NedCoor_d* ned) {
+  const double* m = def->ltp_of_ecef.m;
+  const struct DoubleMat33 ecef_of_ned = {{ m[3], m[0], -m[6],
+                                            m[4], m[1], -m[7],
+                                            m[5], m[2], -m[8] }};
+  affine_points_d(n, &ecef->x, &ecef_of_ned, zero_d, &def->ecef.x, &ned->x);
+}
+
+void lla_of_ecef_points_d(int n, struct LlaCoor_d* lla, struct EcefCoor_d* ecef) {
+  int i;
+  for (i = 0; i < n; i++)
+    lla_of_ecef_1_d(&lla[i], &ecef[i]);
+}
+
+void ecef_of_lla_points_d(int n, struct EcefCoor_d* ecef, struct LlaCoor_d* lla) {
+  int i;
+  for (i = 0; i < n; i++)
+    ecef_of_lla_1_d(&ecef[i], &lla[i]);
+}
+
+void enu_of_ecef_arrays_d(int n, double* east, double* north, double* up, struct LtpDef_d* def,
+                          const double* x, const double* y, const double* z) {
+  const double* m = def->ltp_of_ecef.m;
+  const double x0 = def->ecef.x, y0 = def->ecef.y, z0 = def->ecef.z;
+  int i = 0;
+#ifdef __SSE2__
+  const __m128d m0 = _mm_set1_pd(m[0]), m1 = _mm_set1_pd(m[1]), m2 = _mm_set1_pd(m[2]);
+  const __m128d m3 = _mm_set1_pd(m[3]), m4 = _mm_set1_pd(m[4]), m5 = _mm_set1_pd(m[5]);
+  const __m128d m6 = _mm_set1_pd(m[6]), m7 = _mm_set1_pd(m[7]), m8 = _mm_set1_pd(m[8]);
+  const __m128d vx0 = _mm_set1_pd(x0), vy0 = _mm_set1_pd(y0), vz0 = _mm_set1_pd(z0);
+  for (; i + 2 <= n; i += 2) {
+    const __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vx0);
+    const __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), vy0);
+    const __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), vz0);
+    _mm_storeu_pd(east + i,  _mm_add_pd(_mm_add_pd(_mm_mul_pd(m0, dx), _mm_mul_pd(m1, dy)), _mm_mul_pd(m2, dz)));
+    _mm_storeu_pd(north + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(m3, dx), _mm_mul_pd(m4, dy)), _mm_mul_pd(m5, dz)));
+    _mm_storeu_pd(up + i,    _mm_add_pd(_mm_add_pd(_mm_mul_pd(m6, dx), _mm_mul_pd(m7, dy)), _mm_mul_pd(m8, dz)));
+  }
+#endif
+  for (; i < n; i++) {
+    const double dx = x[i] - x0;
+    const double dy = y[i] - y0;
+    const double dz = z[i] - z0;
+    east[i]  = m[0] * dx + m[1] * dy + m[2] * dz;
+    north[i] = m[3] * dx + m[4] * dy + m[5] * dz;
+    up[i]    = m[6] * dx + m[7] * dy + m[8] * dz;
+  }
+}
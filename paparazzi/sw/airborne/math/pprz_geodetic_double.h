@@ -58,5 +58,21 @@ extern void ecef_of_ned_vect_d(struct EcefCoor_d* ecef, struct LtpDef_d* def, st
 
 extern double gc_of_gd_lat_d(double gd_lat, double hmsl);
 
+/*
+ * The same on arrays of n points, for the tools converting whole logs:
+ * the reference is loaded once per batch and, on SSE2 hosts, the local
+ * tangent plane conversions work on two points at once.
+ */
+extern void enu_of_ecef_points_d(int n, struct EnuCoor_d* enu, struct LtpDef_d* def, struct EcefCoor_d* ecef);
+extern void ned_of_ecef_points_d(int n, struct NedCoor_d* ned, struct LtpDef_d* def, struct EcefCoor_d* ecef);
+extern void ecef_of_enu_points_d(int n, struct EcefCoor_d* ecef, struct LtpDef_d* def, struct EnuCoor_d* enu);
+extern void ecef_of_ned_points_d(int n, struct EcefCoor_d* ecef, struct LtpDef_d* def, struct NedCoor_d* ned);
+extern void lla_of_ecef_points_d(int n, struct LlaCoor_d* lla, struct EcefCoor_d* ecef);
+extern void ecef_of_lla_points_d(int n, struct EcefCoor_d* ecef, struct LlaCoor_d* lla);
+
+/* enu_of_ecef_points_d on one array per coordinate */
+extern void enu_of_ecef_arrays_d(int n, double* east, double* north, double* up, struct LtpDef_d* def,
+                                 const double* x, const double* y, const double* z);
+
 
 #endif /* PPRZ_GEODETIC_DOUBLE_H */
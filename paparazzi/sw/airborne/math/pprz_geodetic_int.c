@@ -25,11 +25,154 @@
 #include "pprz_algebra_int.h"
 
 #define CM_OF_M(_m)  ((_m)*1e2)
-#define M_OF_CM(_cm) ((_cm)/1e2)
-#define EM7RAD_OF_RAD(_r) (_r*1e7)
-#define RAD_OF_EM7RAD(_r) (_r/1e7)
 #define HIGH_RES_TRIG_FRAC  20
 
+/*
+ * lla_of_ecef_i and ecef_of_lla_i in integer arithmetic, for processors
+ * without FPU: lengths in 64 bits with GEOD_LEN_FRAC fractional bits of
+ * cm, sines and cosines with GEOD_TRIG_FRAC fractional bits, angles with
+ * GEOD_ANGLE_FRAC fractional bits of radian.  Errors against the double
+ * computation are about 1 cm and 1e-7 rad, see test/test_geodetic_int.c
+ */
+
+#define GEOD_LEN_FRAC    2
+#define GEOD_TRIG_FRAC  31
+#define GEOD_ANGLE_FRAC 40
+#define GEOD_CORDIC_ITER 34
+
+#define GEOD_TRIG_ONE  ((int64_t)1 << GEOD_TRIG_FRAC)
+#define GEOD_MUL_TRIG(_a, _b) (((_a) * (_b) + (GEOD_TRIG_ONE >> 1)) >> GEOD_TRIG_FRAC)
+#define GEOD_BFP(_r, _frac) ((int64_t)((_r) * (double)((int64_t)1 << (_frac)) + 0.5))
+
+/* WGS84 */
+#define GEOD_A    6378137.0               /* semi major axis in m */
+#define GEOD_F    (1. / 298.257223563)     /* flattening           */
+#define GEOD_E2   (GEOD_F * (2. - GEOD_F)) /* first eccentricity squared  */
+#define GEOD_EP2  (GEOD_E2 / ((1. - GEOD_F) * (1. - GEOD_F))) /* second */
+
+static const int64_t geod_a       = GEOD_BFP(CM_OF_M(GEOD_A), GEOD_LEN_FRAC);
+static const int64_t geod_e2_a    = GEOD_BFP(CM_OF_M(GEOD_E2 * GEOD_A), GEOD_LEN_FRAC);
+static const int64_t geod_ep2_b   = GEOD_BFP(CM_OF_M(GEOD_EP2 * GEOD_A * (1. - GEOD_F)), GEOD_LEN_FRAC);
+static const int64_t geod_e2      = GEOD_BFP(GEOD_E2, GEOD_TRIG_FRAC);
+static const int64_t geod_1_m_f   = GEOD_BFP(1. - GEOD_F, GEOD_TRIG_FRAC);
+static const int64_t geod_1_m_e2  = GEOD_BFP(1. - GEOD_E2, GEOD_TRIG_FRAC);
+
+static const int64_t geod_pi      = GEOD_BFP(3.1415926535897932384626433832795029, GEOD_ANGLE_FRAC);
+static const int64_t geod_pi_2    = GEOD_BFP(1.5707963267948966192313216916397514, GEOD_ANGLE_FRAC);
+/* 1 / gain of GEOD_CORDIC_ITER steps */
+static const int64_t geod_cordic_k = GEOD_BFP(0.6072529350088814, GEOD_ANGLE_FRAC);
+/* atan(2^-i) */
+static const int64_t geod_atan[GEOD_CORDIC_ITER] = {
+  863554413089LL, 509785937287LL, 269356888665LL, 136729762476LL,
+  68630207382LL, 34348560106LL, 17178471287LL, 8589759836LL,
+  4294945451LL, 2147480917LL, 1073741483LL, 536870869LL,
+  268435451LL, 134217727LL, 67108864LL, 33554432LL,
+  16777216LL, 8388608LL, 4194304LL, 2097152LL,
+  1048576LL, 524288LL, 262144LL, 131072LL,
+  65536LL, 32768LL, 16384LL, 8192LL,
+  4096LL, 2048LL, 1024LL, 512LL,
+  256LL, 128LL
+};
+
+static inline int64_t geod_angle_of_em7rad(int32_t a) {
+  /* 2^40 / 1e7 = 230584300921 / 2^21 */
+  return ((int64_t)a * 230584300921LL) >> 21;
+}
+
+static inline int32_t geod_em7rad_of_angle(int64_t a) {
+  /* 1e7 / 2^40 = 1250000 / 2^37 */
+  return (a * 1250000 + ((int64_t)1 << 36)) >> 37;
+}
+
+static inline int32_t geod_cm_of_len(int64_t l) {
+  return (l + (1 << (GEOD_LEN_FRAC - 1))) >> GEOD_LEN_FRAC;
+}
+
+/* sine and cosine of |a| <= pi, CORDIC in rotation mode */
+static void geod_sincos(int64_t a, int64_t* s, int64_t* c) {
+  int64_t x = geod_cordic_k;
+  int64_t y = 0;
+  int i;
+  /* the CORDIC converges up to pi/2 */
+  if (a > geod_pi_2) {
+    a -= geod_pi;
+    x = -x;
+  }
+  else if (a < -geod_pi_2) {
+    a += geod_pi;
+    x = -x;
+  }
+  for (i = 0; i < GEOD_CORDIC_ITER; i++) {
+    const int64_t d = a >> 63;
+    const int64_t dx = ((y >> i) ^ d) - d;
+    const int64_t dy = ((x >> i) ^ d) - d;
+    x -= dx;
+    y += dy;
+    a -= (geod_atan[i] ^ d) - d;
+  }
+  const int r = GEOD_ANGLE_FRAC - GEOD_TRIG_FRAC;
+  *s = (y + ((int64_t)1 << (r - 1))) >> r;
+  *c = (x + ((int64_t)1 << (r - 1))) >> r;
+}
+
+/* atan2(y, x), CORDIC in vectoring mode on the inputs scaled to 52 bits */
+static int64_t geod_atan2(int64_t y, int64_t x) {
+  const uint64_t m = (x < 0 ? -(uint64_t)x : (uint64_t)x) | (y < 0 ? -(uint64_t)y : (uint64_t)y);
+  if (m == 0)
+    return 0;
+  const int shift = 52 - (63 - __builtin_clzll(m));
+  if (shift >= 0) {
+    x = (int64_t)((uint64_t)x << shift);
+    y = (int64_t)((uint64_t)y << shift);
+  }
+  else {
+    x >>= -shift;
+    y >>= -shift;
+  }
+  int64_t a = 0;
+  if (x < 0) {
+    a = y < 0 ? -geod_pi : geod_pi;
+    x = -x;
+    y = -y;
+  }
+  int i;
+  for (i = 0; i < GEOD_CORDIC_ITER; i++) {
+    const int64_t d = y >> 63;
+    const int64_t dx = ((y >> i) ^ d) - d;
+    const int64_t dy = ((x >> i) ^ d) - d;
+    x += dx;
+    y -= dy;
+    a += (geod_atan[i] ^ d) - d;
+  }
+  return a;
+}
+
+/* floor(sqrt(v)), bit by bit */
+static uint64_t geod_sqrt(uint64_t v) {
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  int i;
+  for (i = 0; i < 32; i++) {
+    const uint64_t trial = root + bit;
+    const uint64_t mask = -(uint64_t)(v >= trial);
+    v -= trial & mask;
+    root = (root >> 1) + (bit & mask);
+    bit >>= 2;
+  }
+  return root;
+}
+
+/* 1/sqrt(w) for w in [1-e2, 1], Newton from 1: r += r (1 - w r^2) / 2 */
+static int64_t geod_rsqrt(int64_t w) {
+  int64_t r = GEOD_TRIG_ONE;
+  int i;
+  for (i = 0; i < 3; i++) {
+    const int64_t r2 = GEOD_MUL_TRIG(r, r);
+    r += GEOD_MUL_TRIG(r, GEOD_TRIG_ONE - GEOD_MUL_TRIG(w, r2)) / 2;
+  }
+  return r;
+}
+
 void ltp_def_from_ecef_i(struct LtpDef_i* def, struct EcefCoor_i* ecef) {
 
   /* store the origin of the tangeant plane */
@@ -38,17 +181,14 @@ void ltp_def_from_ecef_i(struct LtpDef_i* def, struct EcefCoor_i* ecef) {
   lla_of_ecef_i(&def->lla, &def->ecef);
   /* store the rotation matrix                    */
 
-#if 1
-  int32_t sin_lat = rint(BFP_OF_REAL(sinf(RAD_OF_EM7RAD((float)def->lla.lat)), HIGH_RES_TRIG_FRAC));
-  int32_t cos_lat = rint(BFP_OF_REAL(cosf(RAD_OF_EM7RAD((float)def->lla.lat)), HIGH_RES_TRIG_FRAC));
-  int32_t sin_lon = rint(BFP_OF_REAL(sinf(RAD_OF_EM7RAD((float)def->lla.lon)), HIGH_RES_TRIG_FRAC));
-  int32_t cos_lon = rint(BFP_OF_REAL(cosf(RAD_OF_EM7RAD((float)def->lla.lon)), HIGH_RES_TRIG_FRAC));
-#else
-  int32_t sin_lat = rint(BFP_OF_REAL(sin(RAD_OF_EM7RAD((double)def->lla.lat)), HIGH_RES_TRIG_FRAC));
-  int32_t cos_lat = rint(BFP_OF_REAL(cos(RAD_OF_EM7RAD((double)def->lla.lat)), HIGH_RES_TRIG_FRAC));
-  int32_t sin_lon = rint(BFP_OF_REAL(sin(RAD_OF_EM7RAD((double)def->lla.lon)), HIGH_RES_TRIG_FRAC));
-  int32_t cos_lon = rint(BFP_OF_REAL(cos(RAD_OF_EM7RAD((double)def->lla.lon)), HIGH_RES_TRIG_FRAC));
-#endif
+  int64_t s_lat, c_lat, s_lon, c_lon;
+  geod_sincos(geod_angle_of_em7rad(def->lla.lat), &s_lat, &c_lat);
+  geod_sincos(geod_angle_of_em7rad(def->lla.lon), &s_lon, &c_lon);
+  const int r = GEOD_TRIG_FRAC - HIGH_RES_TRIG_FRAC;
+  int32_t sin_lat = (s_lat + (1 << (r - 1))) >> r;
+  int32_t cos_lat = (c_lat + (1 << (r - 1))) >> r;
+  int32_t sin_lon = (s_lon + (1 << (r - 1))) >> r;
+  int32_t cos_lon = (c_lon + (1 << (r - 1))) >> r;
 
 
   def->ltp_of_ecef.m[0] = -sin_lon;
@@ -125,43 +265,54 @@ void ned_of_ecef_vect_i(struct NedCoor_i* ned, struct LtpDef_i* def, struct Ecef
 
 
 /*
-   For now we cheat and call the floating point version
-   Anyone up for writing it in fixed point ?
-*/
-#include "pprz_geodetic_float.h"
-#include "pprz_geodetic_double.h"
-
+ * Bowring's method: the parametric latitude of the point, then one
+ * iteration for the geodetic latitude, well below 1 cm for altitudes
+ * of aircrafts.  The altitude is then computed without divisions.
+ */
 void lla_of_ecef_i(struct LlaCoor_i* out, struct EcefCoor_i* in) {
 
-  /* convert our input to floating point */
-  struct EcefCoor_d in_d;
-  in_d.x = M_OF_CM((double)in->x);
-  in_d.y = M_OF_CM((double)in->y);
-  in_d.z = M_OF_CM((double)in->z);
-  /* calls the floating point transformation */
-  struct LlaCoor_d out_d;
-  lla_of_ecef_d(&out_d, &in_d);
-  /* convert the output to fixed point       */
-  out->lon = (int32_t)rint(EM7RAD_OF_RAD(out_d.lon));
-  out->lat = (int32_t)rint(EM7RAD_OF_RAD(out_d.lat));
-  out->alt = (int32_t)CM_OF_M(out_d.alt);
+  const int64_t x = in->x;
+  const int64_t y = in->y;
+  const int64_t z = (int64_t)in->z << GEOD_LEN_FRAC;
+  /* distance to the axis, with one more bit from the square root */
+  const int64_t p = geod_sqrt((uint64_t)(x * x + y * y) << 2) << (GEOD_LEN_FRAC - 1);
+
+  /* parametric latitude */
+  int64_t s_beta, c_beta;
+  geod_sincos(geod_atan2(z, GEOD_MUL_TRIG(p, geod_1_m_f)), &s_beta, &c_beta);
+  const int64_t s3_beta = GEOD_MUL_TRIG(GEOD_MUL_TRIG(s_beta, s_beta), s_beta);
+  const int64_t c3_beta = GEOD_MUL_TRIG(GEOD_MUL_TRIG(c_beta, c_beta), c_beta);
+  const int64_t lat = geod_atan2(z + GEOD_MUL_TRIG(geod_ep2_b, s3_beta),
+                                 p - GEOD_MUL_TRIG(geod_e2_a, c3_beta));
+
+  /* alt = p cos(lat) + z sin(lat) - a sqrt(1 - e2 sin(lat)^2) */
+  int64_t s_lat, c_lat;
+  geod_sincos(lat, &s_lat, &c_lat);
+  const int64_t w = GEOD_TRIG_ONE - GEOD_MUL_TRIG(geod_e2, GEOD_MUL_TRIG(s_lat, s_lat));
+  const int64_t sqrt_w = GEOD_MUL_TRIG(w, geod_rsqrt(w));
+  const int64_t alt = GEOD_MUL_TRIG(p, c_lat) + GEOD_MUL_TRIG(z, s_lat) - GEOD_MUL_TRIG(geod_a, sqrt_w);
+
+  out->lon = geod_em7rad_of_angle(geod_atan2(y, x));
+  out->lat = geod_em7rad_of_angle(lat);
+  out->alt = geod_cm_of_len(alt);
 
 }
 
 void ecef_of_lla_i(struct EcefCoor_i* out, struct LlaCoor_i* in) {
 
-  /* convert our input to floating point */
-  struct LlaCoor_d in_d;
-  in_d.lon = RAD_OF_EM7RAD((double)in->lon);
-  in_d.lat = RAD_OF_EM7RAD((double)in->lat);
-  in_d.alt = M_OF_CM((double)in->alt);
-  /* calls the floating point transformation */
-  struct EcefCoor_d out_d;
-  ecef_of_lla_d(&out_d, &in_d);
-  /* convert the output to fixed point       */
-  out->x = (int32_t)CM_OF_M(out_d.x);
-  out->y = (int32_t)CM_OF_M(out_d.y);
-  out->z = (int32_t)CM_OF_M(out_d.z);
+  int64_t s_lat, c_lat, s_lon, c_lon;
+  geod_sincos(geod_angle_of_em7rad(in->lat), &s_lat, &c_lat);
+  geod_sincos(geod_angle_of_em7rad(in->lon), &s_lon, &c_lon);
+
+  /* radius of curvature in the prime vertical, a / sqrt(1 - e2 sin(lat)^2) */
+  const int64_t w = GEOD_TRIG_ONE - GEOD_MUL_TRIG(geod_e2, GEOD_MUL_TRIG(s_lat, s_lat));
+  const int64_t n = GEOD_MUL_TRIG(geod_a, geod_rsqrt(w));
+  const int64_t alt = (int64_t)in->alt << GEOD_LEN_FRAC;
+
+  const int64_t r = GEOD_MUL_TRIG(n + alt, c_lat);
+  out->x = geod_cm_of_len(GEOD_MUL_TRIG(r, c_lon));
+  out->y = geod_cm_of_len(GEOD_MUL_TRIG(r, s_lon));
+  out->z = geod_cm_of_len(GEOD_MUL_TRIG(GEOD_MUL_TRIG(n, geod_1_m_e2) + alt, s_lat));
 
 }
 
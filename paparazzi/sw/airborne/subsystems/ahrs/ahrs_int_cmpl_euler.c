@@ -189,8 +189,10 @@ __attribute__ ((always_inline)) static inline void get_psi_measurement_from_mag(
   //  -stheta     * imu.mag.x +
   //  sphi_ctheta * imu.mag.y +
   //  cphi_ctheta * imu.mag.z;
-  float m_psi = -atan2(me, mn);
-  *psi_meas = ((m_psi - RadOfDeg(ahrs_mag_offset))*(float)(1<<(INT32_ANGLE_FRAC))*F_UPDATE);
+  int32_t m_psi = -int32_atan2(me, mn);
+  /* the offset is a setting in degrees, one float product at the mag rate */
+  int32_t offset = ANGLE_BFP_OF_REAL(RadOfDeg(ahrs_mag_offset));
+  *psi_meas = (m_psi - offset) * F_UPDATE;
 
 }
 
@@ -0,0 +1,281 @@
+/*
+ * $Id$
+ *
+ * Copyright (C) 2008-2010 The Paparazzi Team
+ *
+ * This file is part of paparazzi.
+ *
+ * paparazzi is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * paparazzi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with paparazzi; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Fixed point complementary filter on the ltp to imu quaternion.
+ *
+ * The quaternion is integrated from the unbiased gyros, plus a rate
+ * correction pulling the estimated vertical toward the accelerometer and
+ * the estimated north toward the magnetometer, a fraction of which goes
+ * to the gyro bias.  Quaternion, rotation matrix and euler angles are all
+ * computed from the quaternion once per propagation, without floating
+ * point.
+ */
+
+#include "ahrs_int_cmpl_quat.h"
+
+#include "subsystems/imu.h"
+#include "subsystems/ahrs/ahrs_aligner.h"
+#include "subsystems/ahrs/ahrs_int_utils.h"
+#include "math/pprz_trig_int.h"
+#include "math/pprz_algebra_int.h"
+
+#include "generated/airframe.h"
+
+struct AhrsIntCmplQuat ahrs_impl;
+
+static inline void compute_imu_rmat_and_euler_from_quat(void);
+static inline void compute_body_orientation(void);
+
+/* 512 Hz propagation */
+#define F_UPDATE_RES 9
+
+/*
+ * Gains, as right shifts.  The rate corrections are in rad/s per rad of
+ * error, 2^-AHRS_GRAVITY_RATE_SHIFT times g for the gravity, and
+ * 2^-AHRS_MAG_RATE_SHIFT for the magnetometer, held until the next mag
+ * update.  A 2^-*_BIAS_SHIFT fraction of the same error goes to the bias
+ * at each update.  The mag ones keep a heading step from overshooting by
+ * more than a few degrees at a 50 Hz mag rate, see
+ * test/ahrs/run_ahrs_on_synth.c.
+ */
+#ifndef AHRS_GRAVITY_RATE_SHIFT
+#define AHRS_GRAVITY_RATE_SHIFT 4
+#endif
+#ifndef AHRS_GRAVITY_BIAS_SHIFT
+#define AHRS_GRAVITY_BIAS_SHIFT 17
+#endif
+#ifndef AHRS_MAG_RATE_SHIFT
+#define AHRS_MAG_RATE_SHIFT 1
+#endif
+#ifndef AHRS_MAG_BIAS_SHIFT
+#define AHRS_MAG_BIAS_SHIFT 13
+#endif
+
+/* accel norm, Q8, for which the accel is fully trusted */
+#define GRAVITY_Q8 ((int32_t)BFP_OF_REAL(9.81, 8))
+/* the trust falls to 0 at 0.5 and 1.5 g */
+#define GRAVITY_WEIGHT_SLOPE ((int32_t)BFP_OF_REAL(2./9.81, INT32_TRIG_FRAC))
+#define TRIG_ONE (1 << INT32_TRIG_FRAC)
+
+#define QUAT_HR_ONE  (1 << AHRS_INT_CMPL_QUAT_FRAC)
+#define QUAT_HR_RES  (AHRS_INT_CMPL_QUAT_FRAC - INT32_QUAT_FRAC)
+#define BIAS_HR_RES  (AHRS_INT_CMPL_BIAS_FRAC - INT32_RATE_FRAC)
+
+void ahrs_init(void) {
+  ahrs.status = AHRS_UNINIT;
+  INT_EULERS_ZERO(ahrs.ltp_to_body_euler);
+  INT_EULERS_ZERO(ahrs.ltp_to_imu_euler);
+  INT32_QUAT_ZERO(ahrs.ltp_to_body_quat);
+  INT32_QUAT_ZERO(ahrs.ltp_to_imu_quat);
+  INT_RATES_ZERO(ahrs.body_rate);
+  INT_RATES_ZERO(ahrs.imu_rate);
+  INT_RATES_ZERO(ahrs_impl.gyro_bias);
+  INT_RATES_ZERO(ahrs_impl.rate_correction);
+  INT_RATES_ZERO(ahrs_impl.mag_correction);
+  INT_RATES_ZERO(ahrs_impl.high_rez_bias);
+  QUAT_ASSIGN(ahrs_impl.high_rez_quat, QUAT_HR_ONE, 0, 0, 0);
+  ahrs_impl.accel_weight = 0;
+
+#ifdef IMU_MAG_OFFSET
+  ahrs_set_mag_offset(IMU_MAG_OFFSET);
+#else
+  ahrs_set_mag_offset(0.);
+#endif
+}
+
+void ahrs_set_mag_offset(float offset) {
+  ahrs_mag_offset = offset;
+  int32_t angle = ANGLE_BFP_OF_REAL(RadOfDeg(offset));
+  PPRZ_ITRIG_SIN(ahrs_impl.mag_offset_sin, angle);
+  PPRZ_ITRIG_COS(ahrs_impl.mag_offset_cos, angle);
+}
+
+void ahrs_align(void) {
+
+  /* Compute an initial orientation using euler angles */
+  ahrs_int_get_euler_from_accel_mag(&ahrs.ltp_to_imu_euler, &ahrs_aligner.lp_accel, &ahrs_aligner.lp_mag);
+  INT32_QUAT_OF_EULERS(ahrs.ltp_to_imu_quat, ahrs.ltp_to_imu_euler);
+  INT32_QUAT_WRAP_SHORTEST(ahrs.ltp_to_imu_quat);
+  QUAT_ASSIGN(ahrs_impl.high_rez_quat,
+              ahrs.ltp_to_imu_quat.qi << QUAT_HR_RES, ahrs.ltp_to_imu_quat.qx << QUAT_HR_RES,
+              ahrs.ltp_to_imu_quat.qy << QUAT_HR_RES, ahrs.ltp_to_imu_quat.qz << QUAT_HR_RES);
+  compute_imu_rmat_and_euler_from_quat();
+  compute_body_orientation();
+
+  /* used averaged gyro as initial value for bias */
+  RATES_COPY(ahrs_impl.gyro_bias, ahrs_aligner.lp_gyro);
+  RATES_ASSIGN(ahrs_impl.high_rez_bias, ahrs_aligner.lp_gyro.p << BIAS_HR_RES,
+               ahrs_aligner.lp_gyro.q << BIAS_HR_RES, ahrs_aligner.lp_gyro.r << BIAS_HR_RES);
+  ahrs.status = AHRS_RUNNING;
+
+}
+
+
+void ahrs_propagate(void) {
+
+  /* unbias gyro */
+  RATES_DIFF(ahrs.imu_rate, imu.gyro, ahrs_impl.gyro_bias);
+  /* add corrections, zero the accel one, the mag one holds until the next mag update */
+  struct Int32Rates omega;
+  RATES_SUM(omega, ahrs.imu_rate, ahrs_impl.rate_correction);
+  RATES_ADD(omega, ahrs_impl.mag_correction);
+  INT_RATES_ZERO(ahrs_impl.rate_correction);
+
+  /*
+   * first order integration, q += 0.5 * q * omega * dt, on 64 bits: the
+   * increments are too small for the 15 bits of INT32_QUAT_FRAC
+   */
+  struct Int32Quat* q = &ahrs_impl.high_rez_quat;
+  const int32_t r = INT32_RATE_FRAC + 1 + F_UPDATE_RES;
+  const int64_t half = 1LL << (r - 1);
+  const int32_t dqi = (-(int64_t)omega.p * q->qx - (int64_t)omega.q * q->qy - (int64_t)omega.r * q->qz + half) >> r;
+  const int32_t dqx = ( (int64_t)omega.p * q->qi + (int64_t)omega.r * q->qy - (int64_t)omega.q * q->qz + half) >> r;
+  const int32_t dqy = ( (int64_t)omega.q * q->qi - (int64_t)omega.r * q->qx + (int64_t)omega.p * q->qz + half) >> r;
+  const int32_t dqz = ( (int64_t)omega.r * q->qi + (int64_t)omega.q * q->qx - (int64_t)omega.p * q->qy + half) >> r;
+  q->qi += dqi;
+  q->qx += dqx;
+  q->qy += dqy;
+  q->qz += dqz;
+
+  /* back to unit norm, q *= (3 - |q|^2) / 2, enough for the drift of one step */
+  const int32_t n2 = ((int64_t)q->qi * q->qi + (int64_t)q->qx * q->qx +
+                      (int64_t)q->qy * q->qy + (int64_t)q->qz * q->qz) >> AHRS_INT_CMPL_QUAT_FRAC;
+  const int32_t err = QUAT_HR_ONE - n2;
+  q->qi += ((int64_t)q->qi * err) >> (AHRS_INT_CMPL_QUAT_FRAC + 1);
+  q->qx += ((int64_t)q->qx * err) >> (AHRS_INT_CMPL_QUAT_FRAC + 1);
+  q->qy += ((int64_t)q->qy * err) >> (AHRS_INT_CMPL_QUAT_FRAC + 1);
+  q->qz += ((int64_t)q->qz * err) >> (AHRS_INT_CMPL_QUAT_FRAC + 1);
+  INT32_QUAT_WRAP_SHORTEST((*q));
+
+  const int32_t hr_round = 1 << (QUAT_HR_RES - 1);
+  QUAT_ASSIGN(ahrs.ltp_to_imu_quat,
+              (q->qi + hr_round) >> QUAT_HR_RES, (q->qx + hr_round) >> QUAT_HR_RES,
+              (q->qy + hr_round) >> QUAT_HR_RES, (q->qz + hr_round) >> QUAT_HR_RES);
+
+  compute_imu_rmat_and_euler_from_quat();
+  compute_body_orientation();
+
+}
+
+void ahrs_update_accel(void) {
+
+  /* trust the accel only when its norm is close to g */
+  struct Int32Vect3 a;
+  VECT3_SDIV(a, imu.accel, 4);    /* Q8, so that the squares fit */
+  const uint32_t n2 = (uint32_t)(a.x * a.x) + (uint32_t)(a.y * a.y) + (uint32_t)(a.z * a.z);
+  const int32_t n = int32_sqrt(n2);
+  const int32_t dn = n > GRAVITY_Q8 ? n - GRAVITY_Q8 : GRAVITY_Q8 - n;
+  const int32_t weight = TRIG_ONE - ((dn * GRAVITY_WEIGHT_SLOPE) >> 8);
+  ahrs_impl.accel_weight = Chop(weight, 0, TRIG_ONE);
+  if (ahrs_impl.accel_weight == 0)
+    return;
+
+  /*
+   * the accel measures -g along the ltp vertical, the third column of
+   * ltp_to_imu_rmat: c2 x accel is g sin(error) along the rotation
+   * bringing c2 onto the measured vertical
+   */
+  const struct Int32RMat* m = &ahrs.ltp_to_imu_rmat;
+  struct Int32Vect3 residual;
+  residual.x = (RMAT_ELMT(*m, 1, 2) * imu.accel.z - RMAT_ELMT(*m, 2, 2) * imu.accel.y) >> INT32_TRIG_FRAC;
+  residual.y = (RMAT_ELMT(*m, 2, 2) * imu.accel.x - RMAT_ELMT(*m, 0, 2) * imu.accel.z) >> INT32_TRIG_FRAC;
+  residual.z = (RMAT_ELMT(*m, 0, 2) * imu.accel.y - RMAT_ELMT(*m, 1, 2) * imu.accel.x) >> INT32_TRIG_FRAC;
+  /* from ACCEL_FRAC, weighted, to RATE_FRAC */
+  const int32_t s = INT32_TRIG_FRAC + INT32_ACCEL_FRAC - INT32_RATE_FRAC;
+  VECT3_SMUL(residual, residual, ahrs_impl.accel_weight);
+  INT32_VECT3_RSHIFT(residual, residual, s);
+
+  ahrs_impl.rate_correction.p += residual.x >> AHRS_GRAVITY_RATE_SHIFT;
+  ahrs_impl.rate_correction.q += residual.y >> AHRS_GRAVITY_RATE_SHIFT;
+  ahrs_impl.rate_correction.r += residual.z >> AHRS_GRAVITY_RATE_SHIFT;
+
+  ahrs_impl.high_rez_bias.p -= residual.x >> (AHRS_GRAVITY_BIAS_SHIFT - BIAS_HR_RES);
+  ahrs_impl.high_rez_bias.q -= residual.y >> (AHRS_GRAVITY_BIAS_SHIFT - BIAS_HR_RES);
+  ahrs_impl.high_rez_bias.r -= residual.z >> (AHRS_GRAVITY_BIAS_SHIFT - BIAS_HR_RES);
+  INT_RATES_RSHIFT(ahrs_impl.gyro_bias, ahrs_impl.high_rez_bias, BIAS_HR_RES);
+
+}
+
+
+void ahrs_update_mag(void) {
+
+  /* mag in the ltp frame, then rotated by the declination */
+  struct Int32Vect3 m_ltp;
+  INT32_RMAT_TRANSP_VMULT(m_ltp, ahrs.ltp_to_imu_rmat, imu.mag);
+  const int32_t s_off = ahrs_impl.mag_offset_sin;
+  const int32_t c_off = ahrs_impl.mag_offset_cos;
+  const int32_t mn = (c_off * m_ltp.x - s_off * m_ltp.y) >> INT32_TRIG_FRAC;
+  const int32_t me = (s_off * m_ltp.x + c_off * m_ltp.y) >> INT32_TRIG_FRAC;
+
+  /* sine of the heading error, TRIG_FRAC */
+  const int32_t h = int32_sqrt(mn * mn + me * me);
+  if (h == 0) {
+    INT_RATES_ZERO(ahrs_impl.mag_correction);
+    return;
+  }
+  int32_t sin_err = (me << INT32_TRIG_FRAC) / h;
+  /* past 90 deg the sine falls off: full correction, the shorter way */
+  if (mn < 0)
+    sin_err = me >= 0 ? TRIG_ONE : -TRIG_ONE;
+
+  /* turn around the ltp vertical, the third column of ltp_to_imu_rmat */
+  const struct Int32RMat* m = &ahrs.ltp_to_imu_rmat;
+  struct Int32Vect3 residual;
+  residual.x = -RMAT_ELMT(*m, 0, 2) * sin_err;
+  residual.y = -RMAT_ELMT(*m, 1, 2) * sin_err;
+  residual.z = -RMAT_ELMT(*m, 2, 2) * sin_err;
+
+  /* from TRIG_FRAC^2 to RATE_FRAC */
+  const int32_t s = 2 * INT32_TRIG_FRAC - INT32_RATE_FRAC;
+  ahrs_impl.mag_correction.p = residual.x >> (s + AHRS_MAG_RATE_SHIFT);
+  ahrs_impl.mag_correction.q = residual.y >> (s + AHRS_MAG_RATE_SHIFT);
+  ahrs_impl.mag_correction.r = residual.z >> (s + AHRS_MAG_RATE_SHIFT);
+
+  ahrs_impl.high_rez_bias.p -= residual.x >> (s + AHRS_MAG_BIAS_SHIFT - BIAS_HR_RES);
+  ahrs_impl.high_rez_bias.q -= residual.y >> (s + AHRS_MAG_BIAS_SHIFT - BIAS_HR_RES);
+  ahrs_impl.high_rez_bias.r -= residual.z >> (s + AHRS_MAG_BIAS_SHIFT - BIAS_HR_RES);
+  INT_RATES_RSHIFT(ahrs_impl.gyro_bias, ahrs_impl.high_rez_bias, BIAS_HR_RES);
+
+}
+
+/* Compute ltp to imu rotation matrix and euler angles from the quaternion */
+__attribute__ ((always_inline)) static inline void compute_imu_rmat_and_euler_from_quat(void) {
+
+  INT32_RMAT_OF_QUAT(ahrs.ltp_to_imu_rmat, ahrs.ltp_to_imu_quat);
+  INT32_EULERS_OF_RMAT(ahrs.ltp_to_imu_euler, ahrs.ltp_to_imu_rmat);
+
+}
+
+__attribute__ ((always_inline)) static inline void compute_body_orientation(void) {
+
+  /* Compute LTP to BODY quaternion */
+  INT32_QUAT_COMP_INV(ahrs.ltp_to_body_quat, ahrs.ltp_to_imu_quat, imu.body_to_imu_quat);
+  /* Compute LTP to BODY rotation matrix */
+  INT32_RMAT_COMP_INV(ahrs.ltp_to_body_rmat, ahrs.ltp_to_imu_rmat, imu.body_to_imu_rmat);
+  /* compute LTP to BODY eulers */
+  INT32_EULERS_OF_RMAT(ahrs.ltp_to_body_euler, ahrs.ltp_to_body_rmat);
+  /* compute body rates */
+  INT32_RMAT_TRANSP_RATEMULT(ahrs.body_rate, imu.body_to_imu_rmat, ahrs.imu_rate);
+
+}
@@ -0,0 +1,57 @@
+/*
+ * $Id$
+ *
+ * Copyright (C) 2008-2010 The Paparazzi Team
+ *
+ * This file is part of paparazzi.
+ *
+ * paparazzi is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * paparazzi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with paparazzi; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef AHRS_INT_CMPL_QUAT_H
+#define AHRS_INT_CMPL_QUAT_H
+
+#include "subsystems/ahrs.h"
+#include "std.h"
+#include "math/pprz_algebra_int.h"
+
+/* fractional bits of the internal quaternion and gyro bias */
+#define AHRS_INT_CMPL_QUAT_FRAC 30
+#define AHRS_INT_CMPL_BIAS_FRAC 28
+
+struct AhrsIntCmplQuat {
+  struct Int32Rates gyro_bias;
+  struct Int32Rates rate_correction;
+  /* applied until the next mag update */
+  struct Int32Rates mag_correction;
+  /* ltp_to_imu_quat and gyro_bias, with more resolution */
+  struct Int32Quat  high_rez_quat;
+  struct Int32Rates high_rez_bias;
+  /* confidence in the last accel measurement, TRIG_FRAC */
+  int32_t accel_weight;
+  /* of the ahrs_mag_offset declination, TRIG_FRAC */
+  int32_t mag_offset_sin;
+  int32_t mag_offset_cos;
+};
+
+extern struct AhrsIntCmplQuat ahrs_impl;
+
+/* sets ahrs_mag_offset, in degrees */
+extern void ahrs_set_mag_offset(float offset);
+/* settings handler, for a dl_setting on ahrs_mag_offset */
+#define ahrs_int_cmpl_quat_SetMagOffset(_v) ahrs_set_mag_offset(_v)
+
+#endif /* AHRS_INT_CMPL_QUAT_H */
@@ -0,0 +1,27 @@
+#ifndef AHRS_INT_UTILS_H
+#define AHRS_INT_UTILS_H
+
+#include "math/pprz_algebra_int.h"
+#include "math/pprz_trig_int.h"
+
+/* integer version of ahrs_float_get_euler_from_accel_mag() */
+static inline void ahrs_int_get_euler_from_accel_mag(struct Int32Eulers* e, struct Int32Vect3* accel, struct Int32Vect3* mag) {
+  /* get phi and theta from accelerometer */
+  int32_t cphi, sphi, ctheta, stheta;
+  INT32_ATAN2(e->phi, -accel->y, -accel->z);
+  PPRZ_ITRIG_COS(cphi, e->phi);
+  PPRZ_ITRIG_SIN(sphi, e->phi);
+  int32_t cphi_ax = -INT_MULT_RSHIFT(cphi, accel->x, INT32_TRIG_FRAC);
+  INT32_ATAN2(e->theta, -cphi_ax, -accel->z);
+  PPRZ_ITRIG_COS(ctheta, e->theta);
+  PPRZ_ITRIG_SIN(stheta, e->theta);
+  /* get psi from magnetometer */
+  /* project mag on local tangeant plane */
+  int32_t sphi_stheta = (sphi*stheta)>>INT32_TRIG_FRAC;
+  int32_t cphi_stheta = (cphi*stheta)>>INT32_TRIG_FRAC;
+  const int32_t mn = ctheta * mag->x + sphi_stheta * mag->y + cphi_stheta * mag->z;
+  const int32_t me =      0 * mag->x + cphi        * mag->y - sphi        * mag->z;
+  e->psi = -int32_atan2(me, mn);
+}
+
+#endif /* AHRS_INT_UTILS_H */
@@ -20,6 +20,7 @@
 #define AHRS_TYPE_FLG 0
 #define AHRS_TYPE_FCR 1
 #define AHRS_TYPE_ICE 2
+#define AHRS_TYPE_ICQ 3
 
 #if   defined AHRS_TYPE && AHRS_TYPE == AHRS_TYPE_FLQ
 #include "subsystems/ahrs/ahrs_float_lkf_quat.h"
@@ -30,6 +31,9 @@
 #elif defined AHRS_TYPE && AHRS_TYPE == AHRS_TYPE_ICE
 #include "subsystems/ahrs/ahrs_int_cmpl_euler.h"
 #define OUT_FILE "./out_ice.txt"
+#elif defined AHRS_TYPE && AHRS_TYPE == AHRS_TYPE_ICQ
+#include "subsystems/ahrs/ahrs_int_cmpl_quat.h"
+#define OUT_FILE "./out_icq.txt"
 #endif
 
 
@@ -188,6 +192,17 @@ static void store_filter_output(int i) {
   RATES_ASSIGN(output[i].bias_est, 0., 0., 0.);
   //  memset(output[i].P, ahrs_impl.P, sizeof(ahrs_impl.P));
 }
+#elif defined AHRS_TYPE && AHRS_TYPE == AHRS_TYPE_ICQ
+static void store_filter_output(int i) {
+#ifdef OUTPUT_IN_BODY_FRAME
+  QUAT_FLOAT_OF_BFP(output[i].quat_est, ahrs.ltp_to_body_quat);
+  RATES_FLOAT_OF_BFP(output[i].rate_est, ahrs.body_rate);
+#else
+  QUAT_FLOAT_OF_BFP(output[i].quat_est, ahrs.ltp_to_imu_quat);
+  RATES_FLOAT_OF_BFP(output[i].rate_est, ahrs.imu_rate);
+#endif /* OUTPUT_IN_BODY_FRAME */
+  RATES_FLOAT_OF_BFP(output[i].bias_est, ahrs_impl.gyro_bias);
+}
 #endif
 
 /*
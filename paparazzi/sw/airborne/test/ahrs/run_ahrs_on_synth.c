@@ -0,0 +1,235 @@
+/*
+ * Run ahrs_int_cmpl_quat on synthetic sensors, against the true attitude.
+ *
+ *   make run_ahrs_icq_on_synth && ./run_ahrs_icq_on_synth [-m] [-h deg] [-t s] [-s seed]
+ *
+ * The vehicle sits still until the aligner locks, then either stays
+ * still or, with -m, tumbles on all axes (up to 1.5 rad/s) with
+ * 0.5 m/s2 horizontal manoeuvres.  The gyros have a bias, known to the
+ * aligner, that drifts by BIAS_DRIFT right after alignment; every
+ * sensor is noisy.  -h turns the estimate by that much heading after
+ * alignment.  Mag updates come every MAG_DIVIDER propagations.
+ *
+ * Printed every 10 s: attitude and heading errors, estimated biases.
+ * At the end: attitude error over the second half of the run, the
+ * largest heading error past zero after -h (the overshoot), and the
+ * bias errors.
+ */
+
+/* getopt, with -std=c99 */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "std.h"
+
+#include "math/pprz_algebra_double.h"
+#include "math/pprz_algebra_int.h"
+
+#include "subsystems/ahrs.h"
+#include "subsystems/ahrs/ahrs_aligner.h"
+#include "subsystems/ahrs/ahrs_int_cmpl_quat.h"
+#include "subsystems/imu.h"
+
+#define DT (1./512.)
+#define MAG_DIVIDER 10
+
+#define GYRO_NOISE  0.01     /* rad/s */
+#define ACCEL_NOISE 0.1      /* m/s2 */
+#define MAG_NOISE   0.01     /* of a unit field */
+
+static const struct DoubleRates bias_0 = { 0.02, -0.03, 0.01 };
+#define BIAS_DRIFT 0.01      /* rad/s, on each axis, after alignment */
+
+/* toulouse, magnetic north along x */
+static const struct DoubleVect3 h_ltp = { 0.51562740288882, 0., 0.85490967783446 };
+
+/* the aligner needs about 6 s of still sensors */
+#define ALIGN_TIME_MAX 30.
+
+
+static uint32_t rnd_state;
+
+static double rnd_gauss(void) {
+  double u1, u2;
+  do {
+    rnd_state ^= rnd_state << 13; rnd_state ^= rnd_state >> 17; rnd_state ^= rnd_state << 5;
+    u1 = rnd_state / 4294967296.;
+    rnd_state ^= rnd_state << 13; rnd_state ^= rnd_state >> 17; rnd_state ^= rnd_state << 5;
+    u2 = rnd_state / 4294967296.;
+  } while (u1 <= 0.);
+  return sqrt(-2. * log(u1)) * cos(2. * M_PI * u2);
+}
+
+/* a2c = a2b * b2c */
+static void quat_comp(struct DoubleQuat* a2c, const struct DoubleQuat* a2b, const struct DoubleQuat* b2c) {
+  struct DoubleQuat r;
+  r.qi = a2b->qi*b2c->qi - a2b->qx*b2c->qx - a2b->qy*b2c->qy - a2b->qz*b2c->qz;
+  r.qx = a2b->qi*b2c->qx + a2b->qx*b2c->qi + a2b->qy*b2c->qz - a2b->qz*b2c->qy;
+  r.qy = a2b->qi*b2c->qy - a2b->qx*b2c->qz + a2b->qy*b2c->qi + a2b->qz*b2c->qx;
+  r.qz = a2b->qi*b2c->qz + a2b->qx*b2c->qy - a2b->qy*b2c->qx + a2b->qz*b2c->qi;
+  *a2c = r;
+}
+
+/* a vector of the ltp in the imu frame */
+static void quat_vmult(struct DoubleVect3* v_imu, const struct DoubleQuat* q, const struct DoubleVect3* v) {
+  const double qi = q->qi, qx = q->qx, qy = q->qy, qz = q->qz;
+  v_imu->x = (1. - 2.*(qy*qy + qz*qz)) * v->x + 2.*(qx*qy + qi*qz) * v->y + 2.*(qx*qz - qi*qy) * v->z;
+  v_imu->y = 2.*(qx*qy - qi*qz) * v->x + (1. - 2.*(qx*qx + qz*qz)) * v->y + 2.*(qy*qz + qi*qx) * v->z;
+  v_imu->z = 2.*(qx*qz + qi*qy) * v->x + 2.*(qy*qz - qi*qx) * v->y + (1. - 2.*(qx*qx + qy*qy)) * v->z;
+}
+
+/* rotation of the estimate with respect to the truth, in the ltp frame */
+static void attitude_error(const struct DoubleQuat* q_true, double* angle, double* heading) {
+  struct DoubleQuat q_est, q_inv, d;
+  QUAT_FLOAT_OF_BFP(q_est, ahrs.ltp_to_imu_quat);
+  QUAT_INVERT(q_inv, *q_true);
+  quat_comp(&d, &q_est, &q_inv);
+  if (d.qi < 0.)
+    QUAT_EXPLEMENTARY(d, d);
+  *angle = DegOfRad(2. * atan2(sqrt(d.qx*d.qx + d.qy*d.qy + d.qz*d.qz), d.qi));
+  *heading = DegOfRad(2. * atan2(d.qz, d.qi));
+}
+
+static void feed_imu(const struct DoubleQuat* q, const struct DoubleRates* omega,
+                     const struct DoubleVect3* accel_ltp, const struct DoubleRates* bias) {
+  struct DoubleRates gyro;
+  struct DoubleVect3 accel, mag, sf_ltp;
+  RATES_ASSIGN(gyro, omega->p + bias->p + GYRO_NOISE * rnd_gauss(),
+               omega->q + bias->q + GYRO_NOISE * rnd_gauss(),
+               omega->r + bias->r + GYRO_NOISE * rnd_gauss());
+  /* specific force: acceleration minus gravity, ltp is north east down */
+  VECT3_ASSIGN(sf_ltp, accel_ltp->x, accel_ltp->y, accel_ltp->z - 9.81);
+  quat_vmult(&accel, q, &sf_ltp);
+  VECT3_ASSIGN(accel, accel.x + ACCEL_NOISE * rnd_gauss(), accel.y + ACCEL_NOISE * rnd_gauss(),
+               accel.z + ACCEL_NOISE * rnd_gauss());
+  quat_vmult(&mag, q, &h_ltp);
+  VECT3_ASSIGN(mag, mag.x + MAG_NOISE * rnd_gauss(), mag.y + MAG_NOISE * rnd_gauss(),
+               mag.z + MAG_NOISE * rnd_gauss());
+  RATES_COPY(imu.gyro_prev, imu.gyro);
+  RATES_BFP_OF_REAL(imu.gyro, gyro);
+  ACCELS_BFP_OF_REAL(imu.accel, accel);
+  MAGS_BFP_OF_REAL(imu.mag, mag);
+}
+
+static void turn_estimate_heading(double heading) {
+  struct DoubleQuat yaw = { cos(heading / 2.), 0., 0., sin(heading / 2.) };
+  struct DoubleQuat q, q_est;
+  QUAT_FLOAT_OF_BFP(q, ahrs.ltp_to_imu_quat);
+  quat_comp(&q_est, &yaw, &q);
+  QUAT_ASSIGN(ahrs_impl.high_rez_quat,
+              (int32_t)rint(BFP_OF_REAL(q_est.qi, AHRS_INT_CMPL_QUAT_FRAC)),
+              (int32_t)rint(BFP_OF_REAL(q_est.qx, AHRS_INT_CMPL_QUAT_FRAC)),
+              (int32_t)rint(BFP_OF_REAL(q_est.qy, AHRS_INT_CMPL_QUAT_FRAC)),
+              (int32_t)rint(BFP_OF_REAL(q_est.qz, AHRS_INT_CMPL_QUAT_FRAC)));
+}
+
+/* imu.h wants that */
+void imu_impl_init(void) {}
+
+int main(int argc, char** argv) {
+
+  double duration = 300.;
+  double heading_0 = 0.;
+  bool_t motion = FALSE;
+  int opt;
+  rnd_state = 1;
+  while ((opt = getopt(argc, argv, "mh:t:s:")) != -1) {
+    switch (opt) {
+    case 'm': motion = TRUE; break;
+    case 'h': heading_0 = atof(optarg); break;
+    case 't': duration = atof(optarg); break;
+    case 's': rnd_state = atoi(optarg) ? atoi(optarg) : 1; break;
+    default:
+      fprintf(stderr, "usage: %s [-m] [-h heading error deg] [-t duration s] [-s seed]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  imu_init();
+  ahrs_init();
+  ahrs_aligner_init();
+
+  /* still, at some attitude, until the aligner locks */
+  struct DoubleEulers e_0 = { 0.3, -0.2, 1.0 };
+  struct DoubleQuat q;
+  DOUBLE_QUAT_OF_EULERS(q, e_0);
+  struct DoubleRates bias = bias_0;
+  const struct DoubleRates zero_rates = { 0., 0., 0. };
+  const struct DoubleVect3 zero_accel = { 0., 0., 0. };
+  double t;
+  for (t = 0.; ahrs.status == AHRS_UNINIT; t += DT) {
+    if (t > ALIGN_TIME_MAX) {
+      fprintf(stderr, "aligner did not lock\n");
+      return 1;
+    }
+    feed_imu(&q, &zero_rates, &zero_accel, &bias);
+    ahrs_aligner_run();
+    if (ahrs_aligner.status == AHRS_ALIGNER_LOCKED)
+      ahrs_align();
+  }
+  printf("aligned after %.1f s\n", t);
+
+  RATES_ASSIGN(bias, bias_0.p + BIAS_DRIFT, bias_0.q - BIAS_DRIFT, bias_0.r + BIAS_DRIFT);
+  if (heading_0 != 0.)
+    turn_estimate_heading(RadOfDeg(heading_0));
+
+  double err_max = 0., err_sum2 = 0., overshoot = 0.;
+  bool_t settling = FALSE;
+  long nb = 0, nb_steps = duration / DT;
+  for (long i = 0; i < nb_steps; i++) {
+    t = i * DT;
+    struct DoubleRates omega = zero_rates;
+    struct DoubleVect3 accel = zero_accel;
+    if (motion) {
+      RATES_ASSIGN(omega, 1.5 * sin(0.7 * t), 1.2 * sin(0.5 * t + 1.), 0.8 * cos(0.3 * t));
+      VECT3_ASSIGN(accel, 0.5 * sin(2. * t), 0.3 * cos(3. * t), 0.);
+    }
+    /* exact integration of a constant rate over the step */
+    const double w = sqrt(omega.p*omega.p + omega.q*omega.q + omega.r*omega.r);
+    if (w > 0.) {
+      const double s = sin(w * DT / 2.) / w;
+      struct DoubleQuat dq = { cos(w * DT / 2.), omega.p * s, omega.q * s, omega.r * s };
+      quat_comp(&q, &q, &dq);
+    }
+
+    feed_imu(&q, &omega, &accel, &bias);
+    ahrs_propagate();
+    ahrs_update_accel();
+    if (i % MAG_DIVIDER == 0)
+      ahrs_update_mag();
+
+    double angle, heading;
+    attitude_error(&q, &angle, &heading);
+    /* past zero, once on the way: not the wrap at 180 deg of a large -h */
+    if (fabs(heading) < fabs(heading_0) / 2.)
+      settling = TRUE;
+    if (settling && heading_0 > 0. && -heading > overshoot)
+      overshoot = -heading;
+    if (settling && heading_0 < 0. && heading > overshoot)
+      overshoot = heading;
+    if (t >= duration / 2.) {
+      if (angle > err_max)
+        err_max = angle;
+      err_sum2 += angle * angle;
+      nb++;
+    }
+    if (i % (long)(10. / DT) == 0) {
+      struct DoubleRates b;
+      RATES_FLOAT_OF_BFP(b, ahrs_impl.gyro_bias);
+      printf("t %5.0f  error %7.3f deg  heading %8.3f deg  bias %7.4f %7.4f %7.4f\n",
+             t, angle, heading, b.p, b.q, b.r);
+    }
+  }
+
+  struct DoubleRates b;
+  RATES_FLOAT_OF_BFP(b, ahrs_impl.gyro_bias);
+  printf("second half : attitude error max %.2f rms %.2f deg\n", err_max, nb ? sqrt(err_sum2 / nb) : 0.);
+  if (heading_0 != 0.)
+    printf("heading overshoot %.2f deg\n", overshoot);
+  printf("bias error %.4f %.4f %.4f rad/s\n", b.p - bias.p, b.q - bias.q, b.r - bias.r);
+  return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Check the table driven CRC-8 of the Overo link against the bit by bit
+ * definition, on every length and alignment of a frame, and time both.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "math/pprz_crc8.h"
+
+#define MAX_LEN 300
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* the implementation fms_spi_link.c had */
+static uint8_t crc8_bitwise(const uint8_t* buf, uint32_t len) {
+  uint8_t remainder = 0;
+  for (uint32_t byte = 0; byte < len; ++byte) {
+    remainder ^= buf[byte];
+    for (uint8_t bit = 8; bit > 0; --bit) {
+      if (remainder & 0x80)
+        remainder = (remainder << 1) ^ PPRZ_CRC8_POLYNOMIAL;
+      else
+        remainder = (remainder << 1);
+    }
+  }
+  return remainder;
+}
+
+static void bench(uint32_t len) {
+  static uint8_t buf[4096];
+  uint32_t i, n = (1 << 24) / len;
+  volatile uint8_t sink = 0;
+  for (i = 0; i < len; i++)
+    buf[i] = rand();
+  double t0 = now();
+  for (i = 0; i < n; i++) {
+    buf[0] = i;
+    sink ^= crc8_bitwise(buf, len);
+  }
+  double t1 = now();
+  for (i = 0; i < n; i++) {
+    buf[0] = i;
+    sink ^= pprz_crc8_block(buf, len);
+  }
+  double t2 = now();
+  printf("%4u bytes : bitwise %6.2f ns/byte, table %6.2f ns/byte\n", len,
+         (t1 - t0) * 1e9 / n / len, (t2 - t1) * 1e9 / n / len);
+}
+
+int main(void) {
+
+  uint8_t buf[MAX_LEN + 8];
+  uint32_t len, offset, i;
+  int err = 0;
+
+  srand(42);
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = rand();
+
+  /* the check value of CRC-8 0x31 with no reflection, init and xorout 0 */
+  if (pprz_crc8_block((const uint8_t*)"123456789", 9) != 0xA2)
+    err++;
+
+  for (len = 0; len <= MAX_LEN; len++)
+    for (offset = 0; offset < 8; offset++) {
+      if (pprz_crc8_block(buf + offset, len) != crc8_bitwise(buf + offset, len))
+        err++;
+      /* in two pieces */
+      uint8_t crc = pprz_crc8_update(0, buf + offset, len / 3);
+      if (pprz_crc8_update(crc, buf + offset + len / 3, len - len / 3) !=
+          crc8_bitwise(buf + offset, len))
+        err++;
+    }
+
+  /* a frame followed by its crc leaves no remainder */
+  for (len = 0; len < MAX_LEN; len++) {
+    buf[len] = pprz_crc8_block(buf, len);
+    if (pprz_crc8_block(buf, len + 1) != 0)
+      err++;
+  }
+  printf("check : %s\n", err ? "FAILED" : "ok");
+
+  bench(32);
+  bench(64);
+  bench(256);
+  bench(4096);
+
+  return err ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * Times the hot families of pprz_algebra_int.h, pprz_algebra_float.h and
+ * pprz_geodetic_*.c over arrays of varied inputs, and prints for each one
+ * the time per operation and the bytes it reads and writes.
+ *
+ *   bench_math [-n rounds] [name_filter]
+ *
+ * Without -n, every benchmark runs for about 0.2 s.  With -n, every one
+ * runs exactly rounds x NB_DATA operations, whatever the host: use it
+ * under an emulator or an instruction counter, e.g.
+ *
+ *   make bench_math.arm && qemu-arm ./bench_math.arm -n 20
+ *   valgrind --tool=callgrind ./bench_math -n 20 quat
+ *
+ * The checksum of the outputs, printed last, must not change with a pure
+ * speed optimization.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "std.h"
+#include "math/pprz_algebra_int.h"
+#include "math/pprz_algebra_float.h"
+#include "math/pprz_geodetic_int.h"
+#include "math/pprz_geodetic_float.h"
+#include "math/pprz_geodetic_double.h"
+
+#define CM_OF_M(_m)       ((_m)*1e2)
+#define EM7RAD_OF_RAD(_r) ((_r)*1e7)
+
+#define NB_DATA 256
+#define MIN_TIME 0.2
+
+/* inputs */
+static struct Int32Quat    qa_i[NB_DATA], qb_i[NB_DATA];
+static struct Int32RMat    rm_i[NB_DATA];
+static struct Int32Eulers  eu_i[NB_DATA];
+static int32_t             sq_i[NB_DATA];
+static struct FloatQuat    qa_f[NB_DATA], qb_f[NB_DATA];
+static struct FloatRMat    rm_f[NB_DATA];
+static struct FloatEulers  eu_f[NB_DATA];
+static struct EcefCoor_i   ecef_i[NB_DATA];
+static struct LlaCoor_i    lla_i[NB_DATA];
+static struct EcefCoor_f   ecef_f[NB_DATA];
+static struct LlaCoor_f    lla_f[NB_DATA];
+static struct EcefCoor_d   ecef_d[NB_DATA];
+static struct LlaCoor_d    lla_d[NB_DATA];
+static double              ecef_x[NB_DATA], ecef_y[NB_DATA], ecef_z[NB_DATA];
+static struct LtpDef_i     ltp_i, ltp_tmp_i;
+static struct LtpDef_f     ltp_f;
+static struct LtpDef_d     ltp_d;
+
+/* outputs, each benchmark writes one */
+static union {
+  struct Int32Quat   q_i;
+  struct Int32RMat   rm_i;
+  struct Int32Eulers eu_i;
+  int32_t            s_i;
+  struct FloatQuat   q_f;
+  struct FloatRMat   rm_f;
+  struct FloatEulers eu_f;
+  struct EcefCoor_i  ecef_i;
+  struct LlaCoor_i   lla_i;
+  struct NedCoor_i   ned_i;
+  struct EnuCoor_i   enu_i;
+  struct EcefCoor_f  ecef_f;
+  struct LlaCoor_f   lla_f;
+  struct NedCoor_f   ned_f;
+  struct EcefCoor_d  ecef_d;
+  struct LlaCoor_d   lla_d;
+  struct NedCoor_d   ned_d;
+  struct EnuCoor_d   enu_d;
+} out[NB_DATA];
+
+/* the batches write packed arrays, over the outputs */
+#define OUT_ARRAY(_type) ((_type*)out)
+#define OUT_DOUBLES(_k)  ((double*)out + (_k) * NB_DATA)
+
+#define BENCH(_name, _stmt)                             \
+  static void bench_##_name(void) {                     \
+    int i;                                              \
+    for (i = 0; i < NB_DATA; i++) {                     \
+      _stmt;                                            \
+    }                                                   \
+  }
+
+/* integer attitude */
+BENCH(int32_quat_comp,      INT32_QUAT_COMP(out[i].q_i, qa_i[i], qb_i[i]))
+BENCH(int32_quat_normalise, out[i].q_i = qa_i[i]; INT32_QUAT_NORMALISE(out[i].q_i))
+BENCH(int32_quat_of_rmat,   INT32_QUAT_OF_RMAT(out[i].q_i, rm_i[i]))
+BENCH(int32_quat_of_eulers, INT32_QUAT_OF_EULERS(out[i].q_i, eu_i[i]))
+BENCH(int32_rmat_of_quat,   INT32_RMAT_OF_QUAT(out[i].rm_i, qa_i[i]))
+BENCH(int32_rmat_of_eulers, INT32_RMAT_OF_EULERS(out[i].rm_i, eu_i[i]))
+BENCH(int32_rmat_comp,      INT32_RMAT_COMP(out[i].rm_i, rm_i[i], rm_i[NB_DATA-1-i]))
+BENCH(int32_eulers_of_rmat, INT32_EULERS_OF_RMAT(out[i].eu_i, rm_i[i]))
+BENCH(int32_eulers_of_quat, INT32_EULERS_OF_QUAT(out[i].eu_i, qa_i[i]))
+BENCH(int32_sqrt,           INT32_SQRT(out[i].s_i, sq_i[i]))
+BENCH(int32_atan2,          INT32_ATAN2(out[i].s_i, qa_i[i].qx, qa_i[i].qy))
+BENCH(int32_asin,           out[i].s_i = int32_asin(rm_i[i].m[2]))
+
+/* float attitude */
+BENCH(float_quat_comp,      FLOAT_QUAT_COMP(out[i].q_f, qa_f[i], qb_f[i]))
+BENCH(float_quat_normalise, out[i].q_f = qa_f[i]; FLOAT_QUAT_NORMALISE(out[i].q_f))
+BENCH(float_quat_of_rmat,   FLOAT_QUAT_OF_RMAT(out[i].q_f, rm_f[i]))
+BENCH(float_quat_of_eulers, FLOAT_QUAT_OF_EULERS(out[i].q_f, eu_f[i]))
+BENCH(float_rmat_of_quat,   FLOAT_RMAT_OF_QUAT(out[i].rm_f, qa_f[i]))
+BENCH(float_rmat_of_eulers, FLOAT_RMAT_OF_EULERS(out[i].rm_f, eu_f[i]))
+BENCH(float_rmat_comp,      FLOAT_RMAT_COMP(out[i].rm_f, rm_f[i], rm_f[NB_DATA-1-i]))
+BENCH(float_eulers_of_rmat, FLOAT_EULERS_OF_RMAT(out[i].eu_f, rm_f[i]))
+BENCH(float_eulers_of_quat, FLOAT_EULERS_OF_QUAT(out[i].eu_f, qa_f[i]))
+
+/* geodetic */
+BENCH(lla_of_ecef_i,        lla_of_ecef_i(&out[i].lla_i, &ecef_i[i]))
+BENCH(ecef_of_lla_i,        ecef_of_lla_i(&out[i].ecef_i, &lla_i[i]))
+BENCH(ltp_def_from_ecef_i,  ltp_def_from_ecef_i(&ltp_tmp_i, &ecef_i[i]); out[i].lla_i = ltp_tmp_i.lla)
+BENCH(ned_of_ecef_point_i,  ned_of_ecef_point_i(&out[i].ned_i, &ltp_i, &ecef_i[i]))
+BENCH(enu_of_lla_point_i,   enu_of_lla_point_i(&out[i].enu_i, &ltp_i, &lla_i[i]))
+BENCH(lla_of_ecef_f,        lla_of_ecef_f(&out[i].lla_f, &ecef_f[i]))
+BENCH(ecef_of_lla_f,        ecef_of_lla_f(&out[i].ecef_f, &lla_f[i]))
+BENCH(ned_of_ecef_point_f,  ned_of_ecef_point_f(&out[i].ned_f, &ltp_f, &ecef_f[i]))
+BENCH(lla_of_ecef_d,        lla_of_ecef_d(&out[i].lla_d, &ecef_d[i]))
+BENCH(ecef_of_lla_d,        ecef_of_lla_d(&out[i].ecef_d, &lla_d[i]))
+BENCH(ned_of_ecef_point_d,  ned_of_ecef_point_d(&out[i].ned_d, &ltp_d, &ecef_d[i]))
+BENCH(enu_of_ecef_point_d,  enu_of_ecef_point_d(&out[i].enu_d, &ltp_d, &ecef_d[i]))
+
+/* geodetic, one call for all the points */
+#define BENCH_BATCH(_name, _stmt)                       \
+  static void bench_##_name(void) {                     \
+    _stmt;                                              \
+  }
+
+BENCH_BATCH(lla_of_ecef_points_d,  lla_of_ecef_points_d(NB_DATA, OUT_ARRAY(struct LlaCoor_d), ecef_d))
+BENCH_BATCH(ecef_of_lla_points_d,  ecef_of_lla_points_d(NB_DATA, OUT_ARRAY(struct EcefCoor_d), lla_d))
+BENCH_BATCH(ned_of_ecef_points_d,  ned_of_ecef_points_d(NB_DATA, OUT_ARRAY(struct NedCoor_d), &ltp_d, ecef_d))
+BENCH_BATCH(enu_of_ecef_points_d,  enu_of_ecef_points_d(NB_DATA, OUT_ARRAY(struct EnuCoor_d), &ltp_d, ecef_d))
+BENCH_BATCH(enu_of_ecef_arrays_d,  enu_of_ecef_arrays_d(NB_DATA, OUT_DOUBLES(0), OUT_DOUBLES(1), OUT_DOUBLES(2),
+                                                        &ltp_d, ecef_x, ecef_y, ecef_z))
+
+struct bench {
+  const char* name;
+  void (*run)(void);
+  /* bytes read and written by one operation */
+  unsigned in, out;
+};
+
+#define B(_name, _in, _out) { #_name, bench_##_name, _in, _out }
+
+static const struct bench benches[] = {
+  B(int32_quat_comp,      2*sizeof(struct Int32Quat),   sizeof(struct Int32Quat)),
+  B(int32_quat_normalise, sizeof(struct Int32Quat),     sizeof(struct Int32Quat)),
+  B(int32_quat_of_rmat,   sizeof(struct Int32RMat),     sizeof(struct Int32Quat)),
+  B(int32_quat_of_eulers, sizeof(struct Int32Eulers),   sizeof(struct Int32Quat)),
+  B(int32_rmat_of_quat,   sizeof(struct Int32Quat),     sizeof(struct Int32RMat)),
+  B(int32_rmat_of_eulers, sizeof(struct Int32Eulers),   sizeof(struct Int32RMat)),
+  B(int32_rmat_comp,      2*sizeof(struct Int32RMat),   sizeof(struct Int32RMat)),
+  B(int32_eulers_of_rmat, sizeof(struct Int32RMat),     sizeof(struct Int32Eulers)),
+  B(int32_eulers_of_quat, sizeof(struct Int32Quat),     sizeof(struct Int32Eulers)),
+  B(int32_sqrt,           sizeof(int32_t),              sizeof(int32_t)),
+  B(int32_atan2,          2*sizeof(int32_t),            sizeof(int32_t)),
+  B(int32_asin,           sizeof(int32_t),              sizeof(int32_t)),
+  B(float_quat_comp,      2*sizeof(struct FloatQuat),   sizeof(struct FloatQuat)),
+  B(float_quat_normalise, sizeof(struct FloatQuat),     sizeof(struct FloatQuat)),
+  B(float_quat_of_rmat,   sizeof(struct FloatRMat),     sizeof(struct FloatQuat)),
+  B(float_quat_of_eulers, sizeof(struct FloatEulers),   sizeof(struct FloatQuat)),
+  B(float_rmat_of_quat,   sizeof(struct FloatQuat),     sizeof(struct FloatRMat)),
+  B(float_rmat_of_eulers, sizeof(struct FloatEulers),   sizeof(struct FloatRMat)),
+  B(float_rmat_comp,      2*sizeof(struct FloatRMat),   sizeof(struct FloatRMat)),
+  B(float_eulers_of_rmat, sizeof(struct FloatRMat),     sizeof(struct FloatEulers)),
+  B(float_eulers_of_quat, sizeof(struct FloatQuat),     sizeof(struct FloatEulers)),
+  B(lla_of_ecef_i,        sizeof(struct EcefCoor_i),    sizeof(struct LlaCoor_i)),
+  B(ecef_of_lla_i,        sizeof(struct LlaCoor_i),     sizeof(struct EcefCoor_i)),
+  B(ltp_def_from_ecef_i,  sizeof(struct EcefCoor_i),    sizeof(struct LtpDef_i)),
+  B(ned_of_ecef_point_i,  sizeof(struct EcefCoor_i) + sizeof(struct LtpDef_i), sizeof(struct NedCoor_i)),
+  B(enu_of_lla_point_i,   sizeof(struct LlaCoor_i) + sizeof(struct LtpDef_i),  sizeof(struct EnuCoor_i)),
+  B(lla_of_ecef_f,        sizeof(struct EcefCoor_f),    sizeof(struct LlaCoor_f)),
+  B(ecef_of_lla_f,        sizeof(struct LlaCoor_f),     sizeof(struct EcefCoor_f)),
+  B(ned_of_ecef_point_f,  sizeof(struct EcefCoor_f) + sizeof(struct LtpDef_f), sizeof(struct NedCoor_f)),
+  B(lla_of_ecef_d,        sizeof(struct EcefCoor_d),    sizeof(struct LlaCoor_d)),
+  B(ecef_of_lla_d,        sizeof(struct LlaCoor_d),     sizeof(struct EcefCoor_d)),
+  B(ned_of_ecef_point_d,  sizeof(struct EcefCoor_d) + sizeof(struct LtpDef_d), sizeof(struct NedCoor_d)),
+  B(enu_of_ecef_point_d,  sizeof(struct EcefCoor_d) + sizeof(struct LtpDef_d), sizeof(struct EnuCoor_d)),
+  B(lla_of_ecef_points_d, sizeof(struct EcefCoor_d),    sizeof(struct LlaCoor_d)),
+  B(ecef_of_lla_points_d, sizeof(struct LlaCoor_d),     sizeof(struct EcefCoor_d)),
+  B(ned_of_ecef_points_d, sizeof(struct EcefCoor_d),    sizeof(struct NedCoor_d)),
+  B(enu_of_ecef_points_d, sizeof(struct EcefCoor_d),    sizeof(struct EnuCoor_d)),
+  B(enu_of_ecef_arrays_d, sizeof(struct EcefCoor_d),    sizeof(struct EnuCoor_d)),
+};
+#define NB_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* reproducible on every host */
+static double rand_uniform(double min, double max) {
+  static uint32_t x = 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return min + (max - min) * (x / 4294967296.);
+}
+
+static void init_data(void) {
+  int i;
+  /* around Toulouse, up to 50 km away, 0 to 3000 m high */
+  struct LlaCoor_d ref = { RadOfDeg(1.45), RadOfDeg(43.56), 150. };
+  ecef_of_lla_d(&ecef_d[0], &ref);
+  ecef_i[0].x = rint(CM_OF_M(ecef_d[0].x));
+  ecef_i[0].y = rint(CM_OF_M(ecef_d[0].y));
+  ecef_i[0].z = rint(CM_OF_M(ecef_d[0].z));
+  VECT3_COPY(ecef_f[0], ecef_d[0]);
+  ltp_def_from_ecef_i(&ltp_i, &ecef_i[0]);
+  ltp_def_from_ecef_f(&ltp_f, &ecef_f[0]);
+  ltp_def_from_ecef_d(&ltp_d, &ecef_d[0]);
+
+  for (i = 0; i < NB_DATA; i++) {
+    eu_f[i].phi   = rand_uniform(-M_PI, M_PI);
+    eu_f[i].theta = rand_uniform(-M_PI_2 * 0.95, M_PI_2 * 0.95);
+    eu_f[i].psi   = rand_uniform(-M_PI, M_PI);
+    FLOAT_QUAT_OF_EULERS(qa_f[i], eu_f[i]);
+    FLOAT_RMAT_OF_EULERS(rm_f[i], eu_f[i]);
+    struct FloatEulers e = { rand_uniform(-1, 1), rand_uniform(-1, 1), rand_uniform(-1, 1) };
+    FLOAT_QUAT_OF_EULERS(qb_f[i], e);
+    EULERS_BFP_OF_REAL(eu_i[i], eu_f[i]);
+    QUAT_BFP_OF_REAL(qa_i[i], qa_f[i]);
+    QUAT_BFP_OF_REAL(qb_i[i], qb_f[i]);
+    RMAT_BFP_OF_REAL(rm_i[i], rm_f[i]);
+    sq_i[i] = rand_uniform(0, 1 << 30);
+
+    lla_d[i].lat = ref.lat + rand_uniform(-0.008, 0.008);
+    lla_d[i].lon = ref.lon + rand_uniform(-0.008, 0.008);
+    lla_d[i].alt = rand_uniform(0, 3000.);
+    if (i)
+      ecef_of_lla_d(&ecef_d[i], &lla_d[i]);
+    lla_f[i].lat = lla_d[i].lat;
+    lla_f[i].lon = lla_d[i].lon;
+    lla_f[i].alt = lla_d[i].alt;
+    lla_i[i].lat = rint(EM7RAD_OF_RAD(lla_d[i].lat));
+    lla_i[i].lon = rint(EM7RAD_OF_RAD(lla_d[i].lon));
+    lla_i[i].alt = rint(CM_OF_M(lla_d[i].alt));
+    ecef_i[i].x = rint(CM_OF_M(ecef_d[i].x));
+    ecef_i[i].y = rint(CM_OF_M(ecef_d[i].y));
+    ecef_i[i].z = rint(CM_OF_M(ecef_d[i].z));
+    VECT3_COPY(ecef_f[i], ecef_d[i]);
+    ecef_x[i] = ecef_d[i].x;
+    ecef_y[i] = ecef_d[i].y;
+    ecef_z[i] = ecef_d[i].z;
+  }
+}
+
+static uint32_t checksum(void) {
+  const uint8_t* p = (const uint8_t*)out;
+  uint32_t sum = 0;
+  size_t i;
+  for (i = 0; i < sizeof(out); i++)
+    sum = (sum << 5) + sum + p[i];
+  return sum;
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s [-n rounds] [name_filter]\n", name);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  long rounds = 0;
+  const char* filter = NULL;
+  uint32_t sum = 0;
+  unsigned b;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:")) != -1) {
+    if (c == 'n')
+      rounds = atol(optarg);
+    else
+      usage(argv[0]);
+  }
+  if (optind < argc)
+    filter = argv[optind];
+  if (optind + 1 < argc || rounds < 0)
+    usage(argv[0]);
+
+  init_data();
+  printf("%-22s %10s %8s %8s\n", "", "ns/op", "B in", "B out");
+  for (b = 0; b < NB_BENCHES; b++) {
+    const struct bench* bench = &benches[b];
+    long n = 0;
+    double t0, dt;
+    if (filter && !strstr(bench->name, filter))
+      continue;
+    memset(out, 0, sizeof(out));
+    bench->run();      /* warm up caches and branch predictors */
+    t0 = now();
+    do {
+      bench->run();
+      n++;
+      dt = now() - t0;
+    } while (rounds ? n < rounds : dt < MIN_TIME);
+    printf("%-22s %10.2f %8u %8u\n", bench->name, 1e9 * dt / (n * NB_DATA),
+           bench->in, bench->out);
+    sum ^= checksum();
+  }
+  printf("checksum %08x\n", sum);
+  return 0;
+}
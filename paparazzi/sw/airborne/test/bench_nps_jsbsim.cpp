@@ -0,0 +1,167 @@
+/*
+ * Time the JSBSim FDM step of NPS with the two ways of moving the
+ * actuator commands and the simulation time in and out of the model:
+ * lookup of the properties by name at every step (the former
+ * feed_jsbsim/fetch_state) and property nodes resolved once at init
+ * (nps_fdm_jsbsim.c).
+ *
+ *   make bench_nps_jsbsim && ./bench_nps_jsbsim [model] [nb_steps]
+ *
+ * The model defaults to BOOZ2_A1 in $PAPARAZZI_HOME/conf/simulator/jsbsim.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <FGFDMExec.h>
+#include <models/FGPropulsion.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+
+using namespace JSBSim;
+
+#define NB_ACTUATORS 4
+#define DT (1./512.)
+
+static const char* names[NB_ACTUATORS] = {"front_motor", "back_motor", "right_motor", "left_motor"};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static FGFDMExec* load(const char* model) {
+  std::string rootdir = std::string(getenv("PAPARAZZI_HOME")) + "/conf/simulator/jsbsim/";
+  FGFDMExec* fdm = new FGFDMExec();
+  fdm->Setdt(DT);
+  fdm->DisableOutput();
+  fdm->SetDebugLevel(0);
+  if (!fdm->LoadModel(rootdir + "aircraft", rootdir + "engine", rootdir + "systems", model, false) ||
+      !fdm->GetIC()->Load("reset00")) {
+    fprintf(stderr, "could not load JSBSim model %s from %s\n", model, rootdir.c_str());
+    exit(1);
+  }
+  fdm->GetPropulsion()->InitRunning(-1);
+  fdm->RunIC();
+  return fdm;
+}
+
+/* hover-ish commands, varied a bit so that nothing is constant folded */
+static double command(int step, int i) {
+  return 0.5 + 0.01 * ((step + i) & 7);
+}
+
+/* property access only, no FDM step */
+static void bench_access(FGFDMExec* fdm, int nb_steps, double* by_name, double* cached) {
+  FGPropertyManager* pm = fdm->GetPropertyManager();
+  char buf[64];
+  double sum = 0.;
+  int s, i;
+
+  double t0 = now();
+  for (s = 0; s < nb_steps; s++) {
+    for (i = 0; i < NB_ACTUATORS; i++) {
+      sprintf(buf, "fcs/%s", names[i]);
+      pm->SetDouble(std::string(buf), command(s, i));
+    }
+    sum += pm->GetNode("simulation/sim-time-sec")->getDoubleValue();
+  }
+  double t1 = now();
+
+  FGPropertyManager* nodes[NB_ACTUATORS];
+  for (i = 0; i < NB_ACTUATORS; i++) {
+    sprintf(buf, "fcs/%s", names[i]);
+    nodes[i] = pm->GetNode(buf, false);
+  }
+  FGPropertyManager* time_node = pm->GetNode("simulation/sim-time-sec", false);
+  double t2 = now();
+  for (s = 0; s < nb_steps; s++) {
+    for (i = 0; i < NB_ACTUATORS; i++)
+      nodes[i]->setDoubleValue(command(s, i));
+    sum += time_node->getDoubleValue();
+  }
+  double t3 = now();
+
+  *by_name = (t1 - t0) * 1e9 / nb_steps;
+  *cached = (t3 - t2) * 1e9 / nb_steps;
+  if (sum < 0.)
+    printf("%f\n", sum);
+}
+
+/* full FDM step, commands in and time out through nodes or by name */
+static double bench_step(FGFDMExec* fdm, int nb_steps, bool use_nodes) {
+  FGPropertyManager* pm = fdm->GetPropertyManager();
+  FGPropertyManager* nodes[NB_ACTUATORS];
+  char buf[64];
+  double sim_time = 0.;
+  int s, i;
+
+  for (i = 0; i < NB_ACTUATORS; i++) {
+    sprintf(buf, "fcs/%s", names[i]);
+    nodes[i] = pm->GetNode(buf, false);
+  }
+  FGPropertyManager* time_node = pm->GetNode("simulation/sim-time-sec", false);
+
+  double t0 = now();
+  for (s = 0; s < nb_steps; s++) {
+    if (use_nodes) {
+      for (i = 0; i < NB_ACTUATORS; i++)
+        nodes[i]->setDoubleValue(command(s, i));
+    }
+    else {
+      for (i = 0; i < NB_ACTUATORS; i++) {
+        sprintf(buf, "fcs/%s", names[i]);
+        pm->SetDouble(std::string(buf), command(s, i));
+      }
+    }
+    fdm->Run();
+    sim_time = use_nodes ? time_node->getDoubleValue() :
+      pm->GetNode("simulation/sim-time-sec")->getDoubleValue();
+  }
+  double t1 = now();
+  if (sim_time <= 0.)
+    fprintf(stderr, "simulation time did not advance\n");
+  return (t1 - t0) * 1e6 / nb_steps;
+}
+
+int main(int argc, char** argv) {
+
+  const char* model = argc > 1 ? argv[1] : "BOOZ2_A1";
+  int nb_steps = argc > 2 ? atoi(argv[2]) : 512 * 60;
+
+  if (!getenv("PAPARAZZI_HOME")) {
+    fprintf(stderr, "PAPARAZZI_HOME is not set\n");
+    return 1;
+  }
+
+  FGFDMExec* fdm = load(model);
+  for (int i = 0; i < NB_ACTUATORS; i++) {
+    char buf[64];
+    sprintf(buf, "fcs/%s", names[i]);
+    if (!fdm->GetPropertyManager()->GetNode(buf, false)) {
+      fprintf(stderr, "model %s has no property %s\n", model, buf);
+      return 1;
+    }
+  }
+
+  double by_name, cached;
+  bench_access(fdm, nb_steps, &by_name, &cached);
+  printf("property access per step : by name %7.1f ns  cached nodes %7.1f ns\n", by_name, cached);
+  delete fdm;
+
+  /* a fresh model for each run, so that both fly the same trajectory */
+  fdm = load(model);
+  double step_by_name = bench_step(fdm, nb_steps, false);
+  delete fdm;
+  fdm = load(model);
+  double step_cached = bench_step(fdm, nb_steps, true);
+  delete fdm;
+
+  printf("fdm step                 : by name %7.2f us  cached nodes %7.2f us\n", step_by_name, step_cached);
+  printf("throughput (sim s / wall s) : by name %.0f  cached nodes %.0f  (%+.1f%%)\n",
+         DT * 1e6 / step_by_name, DT * 1e6 / step_cached,
+         100. * (step_by_name / step_cached - 1.));
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Check that the NPS random streams are reproducible whatever the
+ * interleaving of their consumers, that their output is N(0,1),
+ * and time the gaussian sample generation against the R250 + polar
+ * method generator NPS used before.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "nps_random.h"
+
+#define NB_SAMPLES 10000000
+
+/*
+ * former generator, for reference : R250 (Kirkpatrick & Stoll, 1981)
+ * seeded by the Park & Miller minimal standard LCG, and polar method
+ */
+#define R250_MSB        0x40000000L
+#define R250_ALL_BITS   0x7fffffffL
+#define R250_HALF_RANGE 0x20000000L
+
+static unsigned int r250_buffer[250];
+static int r250_index;
+static long lcg_seed;
+
+static long lcg(void) {
+  lcg_seed = (lcg_seed * 16807L) % 2147483647L;
+  return lcg_seed;
+}
+
+static void r250_init(int seed) {
+  unsigned int mask = R250_ALL_BITS, msb = R250_MSB;
+  int j;
+  lcg_seed = seed ? seed : 1;
+  r250_index = 0;
+  for (j = 0; j < 250; j++)
+    r250_buffer[j] = lcg();
+  for (j = 0; j < 250; j++)
+    if (lcg() > R250_HALF_RANGE)
+      r250_buffer[j] |= R250_MSB;
+  for (j = 0; j < 31; j++) {
+    int k = 7 * j + 3;
+    r250_buffer[k] &= mask;
+    r250_buffer[k] |= msb;
+    mask >>= 1;
+    msb >>= 1;
+  }
+}
+
+static double dr250(void) {
+  int j = r250_index >= 147 ? r250_index - 147 : r250_index + 103;
+  unsigned int new_rand = r250_buffer[r250_index] ^ r250_buffer[j];
+  r250_buffer[r250_index] = new_rand;
+  r250_index = r250_index >= 249 ? 0 : r250_index + 1;
+  return (double)new_rand / R250_ALL_BITS;
+}
+
+static double r250_gaussian(void) {
+  static int odd = 0;
+  static double x2, w;
+  double x1;
+  odd = !odd;
+  if (!odd)
+    return x2 * w;
+  do {
+    x1 = 2.0 * dr250() - 1.0;
+    x2 = 2.0 * dr250() - 1.0;
+    w = x1 * x1 + x2 * x2;
+  } while (w >= 1.0 || w == 0.);
+  w = sqrt((-2.0 * log(w)) / w);
+  return x1 * w;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+int main(void) {
+
+  struct NpsRandomStream a, b, c;
+  int i, err = 0;
+
+  /* same stream, consumed alone or interleaved with another one */
+  nps_random_stream_init(&a, 42, NPS_RANDOM_STREAM_GYRO);
+  nps_random_stream_init(&b, 42, NPS_RANDOM_STREAM_GYRO);
+  nps_random_stream_init(&c, 42, NPS_RANDOM_STREAM_ACCEL);
+  for (i = 0; i < 1000; i++) {
+    double va = nps_random_stream_gaussian(&a);
+    if (i % 3 == 0)
+      nps_random_stream_gaussian(&c);
+    if (va != nps_random_stream_gaussian(&b))
+      err++;
+  }
+  printf("reproducibility : %s\n", err ? "FAILED" : "ok");
+
+  /* statistics : moments and tail of N(0,1), P(|x| > 3) = 0.0027 */
+  nps_random_stream_init(&a, 1, NPS_RANDOM_STREAM_DEFAULT);
+  double sum = 0., sum2 = 0., sum4 = 0.;
+  int nb_tail = 0;
+  double t0 = now();
+  for (i = 0; i < NB_SAMPLES; i++) {
+    double v = nps_random_stream_gaussian(&a);
+    sum += v;
+    sum2 += v * v;
+    sum4 += v * v * v * v;
+    if (fabs(v) > 3.)
+      nb_tail++;
+  }
+  double t1 = now();
+  double mean = sum / NB_SAMPLES;
+  double var = sum2 / NB_SAMPLES - mean * mean;
+  double kurtosis = sum4 / NB_SAMPLES;
+  double tail = (double)nb_tail / NB_SAMPLES;
+  printf("mean %f variance %f kurtosis %f P(|x|>3) %f\n", mean, var, kurtosis, tail);
+  printf("streams : %.1f ns/sample (with statistics)\n", (t1 - t0) * 1e9 / NB_SAMPLES);
+
+  if (fabs(mean) > 1e-2 || fabs(var - 1.) > 1e-2 || fabs(kurtosis - 3.) > 3e-2 ||
+      fabs(tail - 0.0027) > 2e-4)
+    err++;
+
+  /* generation alone, new streams against former R250 */
+  double acc = 0.;
+  t0 = now();
+  for (i = 0; i < NB_SAMPLES; i++)
+    acc += nps_random_stream_gaussian(&a);
+  t1 = now();
+  r250_init(1);
+  double t2 = now();
+  for (i = 0; i < NB_SAMPLES; i++)
+    acc += r250_gaussian();
+  double t3 = now();
+  printf("streams : %.1f ns/sample\n", (t1 - t0) * 1e9 / NB_SAMPLES);
+  printf("R250    : %.1f ns/sample\n", (t3 - t2) * 1e9 / NB_SAMPLES);
+  if (acc == 0.)
+    printf("\n");
+
+  return err ? 1 : 0;
+}
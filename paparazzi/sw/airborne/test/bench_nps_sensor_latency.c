@@ -0,0 +1,87 @@
+/*
+ * Compare the cost of the NPS sensor latency history :
+ * former linked list ( one prepend + two mallocs per sample, O(n) walk
+ * to the oldest reading ) against the preallocated circular buffer.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nps_sensors_utils.h"
+
+#define NB_SAMPLES 1000000
+#define DT         (1./512.)
+
+struct DatedSample {
+  double value[3];
+  double time;
+  struct DatedSample* next;
+};
+
+/* reference : list kept newest first, like the former GSList version */
+static void update_latency_list(double time, const double* cur, struct DatedSample** history,
+                                double latency, double* out) {
+  struct DatedSample* s = malloc(sizeof(struct DatedSample));
+  memcpy(s->value, cur, sizeof(s->value));
+  s->time = time;
+  s->next = *history;
+  *history = s;
+  for (;;) {
+    struct DatedSample* prev = NULL;
+    struct DatedSample* last = *history;
+    while (last->next) {
+      prev = last;
+      last = last->next;
+    }
+    if (!prev || last->time >= time - latency) {
+      memcpy(out, last->value, sizeof(last->value));
+      return;
+    }
+    prev->next = NULL;
+    free(last);
+  }
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+
+  double latency = argc > 1 ? atof(argv[1]) : 0.1;
+  double out_list[3], out_ring[3], cur[3];
+  double sum_list = 0., sum_ring = 0.;
+
+  struct DatedSample* list = NULL;
+  struct NpsSensorHistory ring;
+  nps_sensor_history_init(&ring, 3, latency, DT);
+
+  double t0 = now();
+  for (int i = 0; i < NB_SAMPLES; i++) {
+    cur[0] = i; cur[1] = -i; cur[2] = 0.5 * i;
+    update_latency_list(i * DT, cur, &list, latency, out_list);
+    sum_list += out_list[0];
+  }
+  double t1 = now();
+  for (int i = 0; i < NB_SAMPLES; i++) {
+    cur[0] = i; cur[1] = -i; cur[2] = 0.5 * i;
+    UpdateSensorLatency(i * DT, cur, &ring, latency, out_ring);
+    sum_ring += out_ring[0];
+  }
+  double t2 = now();
+
+  printf("latency %.3f s at %.0f Hz, %d samples\n", latency, 1. / DT, NB_SAMPLES);
+  printf("list : %8.1f ns/sample\n", (t1 - t0) * 1e9 / NB_SAMPLES);
+  printf("ring : %8.1f ns/sample\n", (t2 - t1) * 1e9 / NB_SAMPLES);
+  if (sum_list != sum_ring) {
+    printf("MISMATCH %f %f\n", sum_list, sum_ring);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Example driver of the NPS lockstep library : find by bisection the
+ * open loop hover command of the aircraft, i.e. the common motor
+ * command that keeps the vertical speed null, one short rollout per
+ * iteration. The autopilot flies the first 8 s, the constant commands
+ * are then applied for 2 s.
+ *
+ *   make AIRCRAFT=<ac> sim.lib   (from the paparazzi home)
+ *   make nps_lockstep_example AIRCRAFT=<ac> && ./nps_lockstep_example
+ */
+
+#include <stdio.h>
+
+#include "nps_lockstep.h"
+
+#define NB_MOTORS 4
+#define TAKE_OFF_STEPS (unsigned int)(10. / NPS_LOCKSTEP_DT)
+#define TEST_STEPS     (unsigned int)(2. / NPS_LOCKSTEP_DT)
+
+/* NED vertical speed at the end of a rollout flown with command cmd */
+static double vertical_speed(double cmd) {
+  struct NpsConfig config = { 1, 0., 0 };
+  struct NpsState state;
+  double commands[NB_MOTORS];
+  int i;
+  if (nps_init(&config) != 0)
+    return 0.;
+  nps_step(TAKE_OFF_STEPS);
+  for (i = 0; i < NB_MOTORS; i++)
+    commands[i] = cmd;
+  nps_set_commands(commands, NB_MOTORS);
+  nps_step(TEST_STEPS);
+  nps_get_state(&state);
+  return state.ltpprz_ecef_vel.z;
+}
+
+int main(void) {
+  double lo = 0., hi = 1.;
+  int i;
+  for (i = 0; i < 12; i++) {
+    double mid = 0.5 * (lo + hi);
+    double vz = vertical_speed(mid);
+    printf("command %.4f vertical speed %+.3f m/s\n", mid, -vz);
+    /* positive down : not enough thrust */
+    if (vz > 0.)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  printf("hover command %.4f\n", 0.5 * (lo + hi));
+  return 0;
+}
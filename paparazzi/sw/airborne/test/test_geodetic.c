@@ -152,11 +152,11 @@ static void test_enu_of_ecef_int(void) {
 	       M_OF_CM((double)my_enu_point_i.z));
 #endif
 
-	FLOAT_T ex = my_enu_point_f.x - M_OF_CM((double)my_enu_point_i.x);
+	double ex = my_enu_point_f.x - M_OF_CM((double)my_enu_point_i.x);
 	if (fabs(ex) > max_err.x) max_err.x = fabs(ex);
-	FLOAT_T ey = my_enu_point_f.y - M_OF_CM((double)my_enu_point_i.y);
+	double ey = my_enu_point_f.y - M_OF_CM((double)my_enu_point_i.y);
 	if (fabs(ey) > max_err.y) max_err.y = fabs(ey);
-	FLOAT_T ez = my_enu_point_f.z - M_OF_CM((double)my_enu_point_i.z);
+	double ez = my_enu_point_f.z - M_OF_CM((double)my_enu_point_i.z);
 	if (fabs(ez) > max_err.z) max_err.z = fabs(ez);
 	sum_err += ex*ex + ey*ey + ez*ez;
       }
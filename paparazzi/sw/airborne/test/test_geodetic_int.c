@@ -0,0 +1,121 @@
+/*
+ * Accuracy of the integer lla_of_ecef_i and ecef_of_lla_i over the whole
+ * globe, from -1000 m to 30000 m, against the exact transformation in
+ * double.  The double version, through which the integer one used to go,
+ * is measured the same way.  Fails if an error is above its bound.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "std.h"
+#include "math/pprz_geodetic_int.h"
+#include "math/pprz_geodetic_double.h"
+
+#define NB_POINTS 1000000
+
+/* cm and 1e-7 rad */
+#define MAX_ERR_POS 2.
+#define MAX_ERR_ANGLE 1.
+
+struct err {
+  double max, sum2;
+  long n;
+};
+
+static void err_add(struct err* e, double d) {
+  d = fabs(d);
+  if (d > e->max)
+    e->max = d;
+  e->sum2 += d * d;
+  e->n++;
+}
+
+static int err_print(const char* name, const struct err* e, double bound) {
+  int ok = e->max <= bound;
+  printf("%-18s %10.3f %10.3f   %s\n", name, e->max, sqrt(e->sum2 / e->n),
+         bound ? (ok ? "ok" : "FAILED") : "");
+  return ok || !bound;
+}
+
+/* reproducible on every host */
+static double rand_uniform(double min, double max) {
+  static uint32_t x = 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return min + (max - min) * (x / 4294967296.);
+}
+
+static void ecef_of_lla_exact(struct EcefCoor_d* ecef, const struct LlaCoor_d* lla) {
+  const double a = 6378137.0;
+  const double f = 1. / 298.257223563;
+  const double e2 = f * (2. - f);
+  const double n = a / sqrt(1. - e2 * sin(lla->lat) * sin(lla->lat));
+  ecef->x = (n + lla->alt) * cos(lla->lat) * cos(lla->lon);
+  ecef->y = (n + lla->alt) * cos(lla->lat) * sin(lla->lon);
+  ecef->z = (n * (1. - e2) + lla->alt) * sin(lla->lat);
+}
+
+int main(void) {
+  struct err ecef_i = { 0, 0, 0 }, ecef_d = { 0, 0, 0 };
+  struct err lat_i = { 0, 0, 0 }, lon_i = { 0, 0, 0 }, alt_i = { 0, 0, 0 };
+  struct err lat_d = { 0, 0, 0 }, lon_d = { 0, 0, 0 }, alt_d = { 0, 0, 0 };
+  int ok = 1;
+  long k;
+
+  for (k = 0; k < NB_POINTS; k++) {
+    /* on the integer grid, so that the integer input is exact */
+    struct LlaCoor_i lla = {
+      rint(rand_uniform(-M_PI, M_PI) * 1e7),
+      rint(asin(rand_uniform(-1, 1)) * 1e7),
+      rint(rand_uniform(-1000, 30000) * 1e2)
+    };
+    struct LlaCoor_d lla_ref = { lla.lon / 1e7, lla.lat / 1e7, lla.alt / 1e2 };
+    struct EcefCoor_d ecef_ref;
+    ecef_of_lla_exact(&ecef_ref, &lla_ref);
+
+    /* lla -> ecef */
+    struct EcefCoor_i ecef;
+    ecef_of_lla_i(&ecef, &lla);
+    err_add(&ecef_i, ecef.x - ecef_ref.x * 1e2);
+    err_add(&ecef_i, ecef.y - ecef_ref.y * 1e2);
+    err_add(&ecef_i, ecef.z - ecef_ref.z * 1e2);
+    struct EcefCoor_d ecef_dbl;
+    ecef_of_lla_d(&ecef_dbl, &lla_ref);
+    err_add(&ecef_d, (ecef_dbl.x - ecef_ref.x) * 1e2);
+    err_add(&ecef_d, (ecef_dbl.y - ecef_ref.y) * 1e2);
+    err_add(&ecef_d, (ecef_dbl.z - ecef_ref.z) * 1e2);
+
+    /* ecef -> lla, from the nearest integer point */
+    struct EcefCoor_i ecef_in = { rint(ecef_ref.x * 1e2), rint(ecef_ref.y * 1e2), rint(ecef_ref.z * 1e2) };
+    struct LlaCoor_i lla_out;
+    lla_of_ecef_i(&lla_out, &ecef_in);
+    /* close to the axis the cm of the input are more than 1e-7 rad of longitude */
+    if (fabs(lla_ref.lat) < RadOfDeg(89.))
+      err_add(&lon_i, remainder(lla_out.lon - lla_ref.lon * 1e7, 2e7 * M_PI));
+    err_add(&lat_i, lla_out.lat - lla_ref.lat * 1e7);
+    err_add(&alt_i, lla_out.alt - lla_ref.alt * 1e2);
+    struct EcefCoor_d ecef_in_d = { ecef_in.x / 1e2, ecef_in.y / 1e2, ecef_in.z / 1e2 };
+    struct LlaCoor_d lla_dbl;
+    lla_of_ecef_d(&lla_dbl, &ecef_in_d);
+    if (fabs(lla_ref.lat) < RadOfDeg(89.))
+      err_add(&lon_d, remainder(lla_dbl.lon - lla_ref.lon, 2 * M_PI) * 1e7);
+    err_add(&lat_d, (lla_dbl.lat - lla_ref.lat) * 1e7);
+    err_add(&alt_d, (lla_dbl.alt - lla_ref.alt) * 1e2);
+  }
+
+  printf("%ld points, errors in cm and 1e-7 rad\n", k);
+  printf("%-18s %10s %10s\n", "", "max", "rms");
+  ok &= err_print("ecef_of_lla_i", &ecef_i, MAX_ERR_POS);
+  ok &= err_print("ecef_of_lla_d", &ecef_d, 0);
+  ok &= err_print("lla_of_ecef_i lon", &lon_i, MAX_ERR_ANGLE);
+  ok &= err_print("lla_of_ecef_i lat", &lat_i, MAX_ERR_ANGLE);
+  ok &= err_print("lla_of_ecef_i alt", &alt_i, MAX_ERR_POS);
+  ok &= err_print("lla_of_ecef_d lon", &lon_d, 0);
+  ok &= err_print("lla_of_ecef_d lat", &lat_d, 0);
+  ok &= err_print("lla_of_ecef_d alt", &alt_d, 0);
+
+  return ok ? 0 : 1;
+}
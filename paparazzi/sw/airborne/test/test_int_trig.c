@@ -0,0 +1,111 @@
+/*
+ * Accuracy of the integer sqrt, reciprocal sqrt, atan2 and asin kernels
+ * of pprz_algebra_int.h against libm, over their whole input range.
+ * Prints the maximum and rms errors, in units of the last place of the
+ * integer result, and fails if a maximum is above its bound.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "std.h"
+#include "math/pprz_algebra_int.h"
+
+struct err {
+  double max, sum2;
+  long n;
+};
+
+static void err_add(struct err* e, double d) {
+  d = fabs(d);
+  if (d > e->max)
+    e->max = d;
+  e->sum2 += d * d;
+  e->n++;
+}
+
+static int err_print(const char* name, const struct err* e, double bound) {
+  int ok = e->max <= bound;
+  printf("%-22s %10ld %10.3f %10.3f   %s\n", name, e->n, e->max, sqrt(e->sum2 / e->n),
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+/* reproducible on every host */
+static uint32_t rand32(void) {
+  static uint32_t x = 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static double angle_diff(double a, double b) {
+  double d = a - b;
+  while (d > M_PI) d -= 2 * M_PI;
+  while (d < -M_PI) d += 2 * M_PI;
+  return d;
+}
+
+int main(void) {
+  const double lsb_angle = 1. / (1 << INT32_ANGLE_FRAC);
+  struct err e;
+  int ok = 1;
+  long i;
+
+  printf("%-22s %10s %10s %10s   (lsb)\n", "", "samples", "max", "rms");
+
+  /* floor(sqrt()) must be exact */
+  e = (struct err){ 0, 0, 0 };
+  for (i = 0; i < 2000000; i++) {
+    uint32_t in = i < 100000 ? i : rand32() >> (rand32() % 32);
+    uint32_t r = int32_sqrt(in);
+    err_add(&e, (double)r - floor(sqrt((double)in)));
+  }
+  ok &= err_print("int32_sqrt", &e, 0);
+
+  /* normalised quaternion, from norms of 1e-3 to 2 */
+  e = (struct err){ 0, 0, 0 };
+  for (i = 0; i < 1000000; i++) {
+    double v[4], n = 0, scale = exp(log(1e-3) + (log(2.) - log(1e-3)) * (rand32() / 4294967296.));
+    int j;
+    for (j = 0; j < 4; j++) {
+      v[j] = (int32_t)rand32() / 2147483648.;
+      n += v[j] * v[j];
+    }
+    n = sqrt(n);
+    struct Int32Quat q = { QUAT1_BFP_OF_REAL(v[0] / n * scale), QUAT1_BFP_OF_REAL(v[1] / n * scale),
+                           QUAT1_BFP_OF_REAL(v[2] / n * scale), QUAT1_BFP_OF_REAL(v[3] / n * scale) };
+    double qn = sqrt((double)q.qi * q.qi + (double)q.qx * q.qx + (double)q.qy * q.qy + (double)q.qz * q.qz);
+    struct Int32Quat in = q;
+    INT32_QUAT_NORMALISE(q);
+    err_add(&e, q.qi - in.qi / qn * (1 << INT32_QUAT_FRAC));
+    err_add(&e, q.qx - in.qx / qn * (1 << INT32_QUAT_FRAC));
+    err_add(&e, q.qy - in.qy / qn * (1 << INT32_QUAT_FRAC));
+    err_add(&e, q.qz - in.qz / qn * (1 << INT32_QUAT_FRAC));
+  }
+  ok &= err_print("int32_quat_normalise", &e, 1.5);
+
+  /* every direction, magnitudes from 1 to 2^31 */
+  e = (struct err){ 0, 0, 0 };
+  for (i = 0; i < 2000000; i++) {
+    int shift = rand32() % 31;
+    int32_t y = (int32_t)rand32() >> shift;
+    int32_t x = (int32_t)rand32() >> shift;
+    if (x == 0 && y == 0)
+      continue;
+    int32_t a = int32_atan2(y, x);
+    err_add(&e, angle_diff(a * lsb_angle, atan2(y, x)) / lsb_angle);
+  }
+  ok &= err_print("int32_atan2", &e, 1);
+
+  e = (struct err){ 0, 0, 0 };
+  for (i = -TRIG_BFP_OF_REAL(1); i <= TRIG_BFP_OF_REAL(1); i++) {
+    int32_t a = int32_asin(i);
+    err_add(&e, (a * lsb_angle - asin((double)i / (1 << INT32_TRIG_FRAC))) / lsb_angle);
+  }
+  ok &= err_print("int32_asin", &e, 1);
+
+  return ok ? 0 : 1;
+}
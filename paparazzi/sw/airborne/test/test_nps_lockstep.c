@@ -0,0 +1,116 @@
+/*
+ * Determinism of the NPS lockstep library : rollouts started by
+ * nps_init() with the same config must fly the same trajectory, bit
+ * for bit, whatever ran before them in the process.  Nor may a rollout
+ * leave heap or file descriptors behind once the next one started.
+ *
+ *   make AIRCRAFT=<ac> sim.lib   (from the paparazzi home)
+ *   make test_nps_lockstep AIRCRAFT=<ac> && ./test_nps_lockstep
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <dirent.h>
+
+#include "nps_lockstep.h"
+
+#define NB_STEPS (20 * 512)
+#define NB_LEAK_ROLLOUTS 20
+
+struct Sample {
+  struct NedCoor_d pos;
+  struct DoubleQuat quat;
+};
+
+static struct Sample ref[NB_STEPS];
+static struct Sample run[NB_STEPS];
+
+static int rollout(const struct NpsConfig* config, struct Sample* traj, unsigned int nb_steps) {
+  struct NpsState state;
+  unsigned int i;
+  if (nps_init(config) != 0) {
+    fprintf(stderr, "nps_init failed\n");
+    exit(1);
+  }
+  for (i = 0; i < nb_steps; i++) {
+    nps_step(1);
+    nps_get_state(&state);
+    if (traj) {
+      traj[i].pos = state.ltpprz_pos;
+      traj[i].quat = state.ltp_to_body_quat;
+    }
+  }
+  return 0;
+}
+
+/* index of the first step where the trajectories differ, -1 if none */
+static int compare(const char* name) {
+  int i;
+  for (i = 0; i < NB_STEPS; i++)
+    if (memcmp(&ref[i], &run[i], sizeof(struct Sample))) {
+      printf("%-40s : FAILED, diverges at step %d (%.3f s), pos %f %f %f / %f %f %f\n",
+             name, i, i * NPS_LOCKSTEP_DT,
+             ref[i].pos.x, ref[i].pos.y, ref[i].pos.z, run[i].pos.x, run[i].pos.y, run[i].pos.z);
+      return i;
+    }
+  printf("%-40s : ok\n", name);
+  return -1;
+}
+
+/* heap in use and open file descriptors of the process */
+static void resources(size_t* heap, int* nb_fd) {
+  struct mallinfo2 mi = mallinfo2();
+  *heap = mi.uordblks + mi.hblkhd;
+  *nb_fd = 0;
+  DIR* d = opendir("/proc/self/fd");
+  if (!d)
+    return;
+  while (readdir(d))
+    (*nb_fd)++;
+  closedir(d);
+}
+
+int main(void) {
+
+  struct NpsConfig config = { 1, 1., 0 };
+  struct NpsConfig other = { 7, 2., 0 };
+  int nb_err = 0;
+
+  rollout(&config, ref, NB_STEPS);
+
+  rollout(&config, run, NB_STEPS);
+  if (compare("same config, twice from init") >= 0)
+    nb_err++;
+
+  /* a rollout of odd length, with other noise and overridden commands */
+  if (nps_init(&other) != 0)
+    return 1;
+  double commands[4] = { 0.3, 0.6, 0.2, 0.7 };
+  nps_set_commands(commands, 4);
+  nps_step(1237);
+  nps_release_commands();
+
+  rollout(&config, run, NB_STEPS);
+  if (compare("after an unrelated rollout") >= 0)
+    nb_err++;
+
+  /* the previous ones let whatever is allocated once settle */
+  size_t heap_0, heap_1;
+  int nb_fd_0, nb_fd_1, i;
+  rollout(&config, NULL, NB_STEPS);
+  resources(&heap_0, &nb_fd_0);
+  for (i = 0; i < NB_LEAK_ROLLOUTS; i++)
+    rollout(&config, NULL, NB_STEPS);
+  resources(&heap_1, &nb_fd_1);
+  if (heap_1 != heap_0 || nb_fd_1 != nb_fd_0) {
+    printf("%-40s : FAILED, %ld bytes and %d descriptors more after %d rollouts\n",
+           "no leak across rollouts", (long)heap_1 - (long)heap_0, nb_fd_1 - nb_fd_0, NB_LEAK_ROLLOUTS);
+    nb_err++;
+  }
+  else
+    printf("%-40s : ok\n", "no leak across rollouts");
+
+  return nb_err ? 1 : 0;
+}
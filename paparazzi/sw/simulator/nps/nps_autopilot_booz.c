@@ -3,6 +3,7 @@
 #include "firmwares/rotorcraft/main.h"
 #include "nps_sensors.h"
 #include "nps_radio_control.h"
+#include "nps_profiler.h"
 #include "subsystems/radio_control.h"
 #include "subsystems/imu.h"
 #include "firmwares/rotorcraft/baro.h"
@@ -34,38 +35,46 @@ void nps_autopilot_init(enum NpsRadioControlType type_rc, int num_rc_script, cha
 #include <stdio.h>
 #include "booz_gps.h"
 
+#define NpsAutopilotMainEvent() {                        \
+    uint64_t _t = nps_profiler_start();                  \
+    main_event();                                        \
+    nps_profiler_stop(NPS_PROF_AP_EVENT, _t);            \
+  }
+
 void nps_autopilot_run_step(double time __attribute__ ((unused))) {
 
   if (nps_radio_control_available(time)) {
     radio_control_feed();
-    main_event();
+    NpsAutopilotMainEvent();
   }
 
   if (nps_sensors_gyro_available()) {
     imu_feed_gyro_accel();
-    main_event();
+    NpsAutopilotMainEvent();
   }
 
   if (nps_sensors_mag_available()) {
     imu_feed_mag();
-    main_event();
+    NpsAutopilotMainEvent();
  }
 
   if (nps_sensors_baro_available()) {
     baro_feed_value(sensors.baro.value);
-    main_event();
+    NpsAutopilotMainEvent();
   }
 
   if (nps_sensors_gps_available()) {
     booz_gps_feed_value();
-    main_event();
+    NpsAutopilotMainEvent();
   }
 
   if (nps_bypass_ahrs) {
     sim_overwrite_ahrs();
   }
 
+  uint64_t t = nps_profiler_start();
   main_periodic();
+  nps_profiler_stop(NPS_PROF_AP_PERIODIC, t);
 
   if (time < 8) { /* start with a little bit of hovering */
     int32_t init_cmd[4];
@@ -0,0 +1,134 @@
+#include "nps_campaign.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+struct NpsCampaignRun {
+  pid_t  pid;
+  int    fd;
+  bool_t ok;
+  struct NpsMetrics metrics;
+};
+
+static double campaign_noise_scale(struct NpsCampaign* c, int run) {
+  if (c->nb_runs < 2)
+    return c->noise_scale_min;
+  return c->noise_scale_min +
+    (c->noise_scale_max - c->noise_scale_min) * run / (c->nb_runs - 1);
+}
+
+static int campaign_start_run(struct NpsCampaign* c, struct NpsCampaignRun* r, int run,
+                              NpsCampaignRunFunc run_fn) {
+  int fds[2];
+  if (pipe(fds) < 0) {
+    perror("pipe");
+    return -1;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  r->pid = fork();
+  if (r->pid < 0) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (r->pid == 0) {
+    /* child : run one simulation and report its metrics to the father */
+    struct NpsMetrics metrics;
+    close(fds[0]);
+    run_fn(c->seed + run, campaign_noise_scale(c, run), &metrics);
+    ssize_t n = write(fds[1], &metrics, sizeof(metrics));
+    close(fds[1]);
+    _exit(n == sizeof(metrics) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  close(fds[1]);
+  r->fd = fds[0];
+  return 0;
+}
+
+static void campaign_collect_run(struct NpsCampaignRun* r) {
+  r->ok = (read(r->fd, &r->metrics, sizeof(r->metrics)) == sizeof(r->metrics));
+  close(r->fd);
+  r->pid = 0;
+}
+
+static void campaign_write_csv(struct NpsCampaign* c, struct NpsCampaignRun* runs, FILE* out) {
+  fprintf(out, "run,seed,noise_scale,ok,tracking_err_max,tracking_err_rms,"
+          "time_to_wp_max,nb_wp_missed,crashed,att_err_max,att_err_rms\n");
+  for (int i = 0; i < c->nb_runs; i++) {
+    struct NpsMetrics* m = &runs[i].metrics;
+    if (runs[i].ok) {
+      fprintf(out, "%d,%d,%f,1,%f,%f,%f,%d,%d,", i, c->seed + i, campaign_noise_scale(c, i),
+              m->tracking_err_max, m->tracking_err_rms, m->time_to_wp_max,
+              m->nb_wp_missed, m->crashed);
+      /* empty without --ahrs */
+      if (m->att_err_valid)
+        fprintf(out, "%f,%f\n", m->att_err_max, m->att_err_rms);
+      else
+        fprintf(out, ",\n");
+    }
+    else
+      fprintf(out, "%d,%d,%f,0,,,,,1,,\n", i, c->seed + i, campaign_noise_scale(c, i));
+  }
+}
+
+int nps_campaign_run(struct NpsCampaign* c, NpsCampaignRunFunc run_fn) {
+
+  if (c->nb_jobs <= 0)
+    c->nb_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  if (c->nb_jobs <= 0)
+    c->nb_jobs = 1;
+
+  struct NpsCampaignRun* runs = (struct NpsCampaignRun*)calloc(c->nb_runs, sizeof(struct NpsCampaignRun));
+  if (!runs)
+    return -1;
+
+  printf("Running %d simulations, %d at a time\n", c->nb_runs, c->nb_jobs);
+
+  int next = 0, running = 0, failed = 0;
+  while (next < c->nb_runs || running > 0) {
+    while (running < c->nb_jobs && next < c->nb_runs) {
+      if (campaign_start_run(c, &runs[next], next, run_fn) < 0) {
+        runs[next].ok = FALSE;
+        failed++;
+      }
+      else
+        running++;
+      next++;
+    }
+    if (running == 0)
+      continue;
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      perror("wait");
+      break;
+    }
+    for (int i = 0; i < next; i++) {
+      if (runs[i].pid == pid) {
+        campaign_collect_run(&runs[i]);
+        if (!runs[i].ok)
+          failed++;
+        running--;
+        break;
+      }
+    }
+  }
+
+  FILE* out = stdout;
+  if (c->csv_file && !(out = fopen(c->csv_file, "w"))) {
+    perror(c->csv_file);
+    out = stdout;
+  }
+  campaign_write_csv(c, runs, out);
+  if (out != stdout)
+    fclose(out);
+
+  printf("%d runs done, %d failed\n", c->nb_runs, failed);
+  free(runs);
+  return failed;
+}
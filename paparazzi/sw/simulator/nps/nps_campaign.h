@@ -0,0 +1,26 @@
+#ifndef NPS_CAMPAIGN_H
+#define NPS_CAMPAIGN_H
+
+#include "nps_metrics.h"
+
+/*
+ * Monte-Carlo campaign : nb_runs independent batch simulations,
+ * each in its own process, nb_jobs of them at a time.
+ * Run i uses seed + i and a noise scale linearly spread
+ * between noise_scale_min and noise_scale_max.
+ */
+struct NpsCampaign {
+  int nb_runs;
+  int nb_jobs;
+  int seed;
+  double noise_scale_min;
+  double noise_scale_max;
+  const char* csv_file;
+};
+
+/* called in the child process, must fill metrics */
+typedef void (*NpsCampaignRunFunc)(int seed, double noise_scale, struct NpsMetrics* metrics);
+
+extern int nps_campaign_run(struct NpsCampaign* campaign, NpsCampaignRunFunc run);
+
+#endif /* NPS_CAMPAIGN_H */
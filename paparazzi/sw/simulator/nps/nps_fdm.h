@@ -68,5 +68,7 @@ extern struct NpsFdm fdm;
 
 extern void nps_fdm_init(double dt);
 extern void nps_fdm_run_step(double* commands);
+/* release the flight dynamics model, nps_fdm_init() may follow */
+extern void nps_fdm_free(void);
 
 #endif /* NPS_FDM */
@@ -3,6 +3,7 @@
 #include <models/FGPropulsion.h>
 #include <models/FGGroundReactions.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "nps_fdm.h"
 #include "6dof.h"
 #include "generated/airframe.h"
@@ -29,16 +30,23 @@ static void lla_from_jsbsim_geocentric(LlaCoor_d* fdm_lla, FGPropagate* propagat
 //static void rate_to_vec(DoubleVect3* vector, DoubleRates* rate);
 
 static void init_jsbsim(double dt);
+static void init_jsbsim_nodes(void);
 static void init_ltp(void);
 
 struct NpsFdm fdm;
-static FGFDMExec* FDMExec;
+static FGFDMExec* FDMExec = NULL;
 static struct LtpDef_d ltpdef;
 
+/* property nodes resolved once at init, to avoid lookups by name at every step */
+static FGPropertyManager* commands_node[SERVOS_NB];
+static FGPropertyManager* sim_time_node;
+
 void nps_fdm_init(double dt) {
 
   init_jsbsim(dt);
 
+  init_jsbsim_nodes();
+
   FDMExec->RunIC();
 
   init_ltp();
@@ -57,24 +65,23 @@ void nps_fdm_run_step(double* commands) {
 
 }
 
-static void feed_jsbsim(double* commands) {
+void nps_fdm_free(void) {
 
-  char buf[64];
-  const char* names[] = NPS_ACTUATOR_NAMES;
-  string property;
+  delete FDMExec;
+  FDMExec = NULL;
+
+}
+
+static void feed_jsbsim(double* commands) {
 
   int i;
-  for (i=0; i<SERVOS_NB; i++) {
-    sprintf(buf,"fcs/%s",names[i]);
-    property = string(buf);
-    FDMExec->GetPropertyManager()->SetDouble(property,commands[i]);
-  }
+  for (i=0; i<SERVOS_NB; i++)
+    commands_node[i]->setDoubleValue(commands[i]);
 }
 
 static void fetch_state(void) {
 
-  FGPropertyManager* node = FDMExec->GetPropertyManager()->GetNode("simulation/sim-time-sec");
-  fdm.time = node->getDoubleValue();
+  fdm.time = sim_time_node->getDoubleValue();
 
   FGPropagate* propagate = FDMExec->GetPropagate();
 
@@ -153,6 +160,9 @@ static void init_jsbsim(double dt) {
 
   sprintf(buf,"%s/conf/simulator/jsbsim/",getenv("PAPARAZZI_HOME"));
   rootdir = string(buf);
+  /* we may be restarted for a new run */
+  if (FDMExec)
+    delete FDMExec;
   FDMExec = new FGFDMExec();
 
   FDMExec->Setsim_time(0.);
@@ -187,6 +197,32 @@ static void init_jsbsim(double dt) {
 
 }
 
+static void init_jsbsim_nodes(void) {
+
+  char buf[64];
+  const char* names[] = NPS_ACTUATOR_NAMES;
+  FGPropertyManager* pm = FDMExec->GetPropertyManager();
+
+  /* do not create missing properties: a misspelled name would read zero forever */
+  int i;
+  for (i=0; i<SERVOS_NB; i++) {
+    sprintf(buf,"fcs/%s",names[i]);
+    commands_node[i] = pm->GetNode(buf, false);
+    if (!commands_node[i]) {
+      fprintf(stderr, "JSBSim model %s has no property %s\n", AIRFRAME_NAME, buf);
+      delete FDMExec;
+      exit(-1);
+    }
+  }
+  sim_time_node = pm->GetNode("simulation/sim-time-sec", false);
+  if (!sim_time_node) {
+    fprintf(stderr, "JSBSim has no property simulation/sim-time-sec\n");
+    delete FDMExec;
+    exit(-1);
+  }
+
+}
+
 static void init_ltp(void) {
 
   FGPropagate* propagate = FDMExec->GetPropagate();
@@ -0,0 +1,207 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "nps_lockstep.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <link.h>
+
+#include "nps_sim.h"
+#include "nps_fdm.h"
+#include "nps_sensors.h"
+#include "nps_sensors_utils.h"
+#include "nps_autopilot.h"
+#include "nps_random.h"
+#ifdef SIM_UDP
+#include "sim_udp.h"
+#endif
+
+static struct {
+  double sim_time;
+  bool_t commands_override;
+  double commands[SERVOS_NB];
+} nps_lockstep;
+
+
+/*
+ * Pristine copy of the writable data of the module holding this file
+ * (libnps.so), taken at the first nps_init() before anything ran.
+ * The airborne code keeps state in globals and in function statics
+ * that its init functions do not reset (the prescalers of
+ * PeriodicPrescaleBy10 and RunOnceEvery for instance), so every later
+ * nps_init() puts the whole data and bss back first.
+ *
+ * Only what lives in the library's data and bss is put back: the heap
+ * and the file descriptors a rollout owns are released by
+ * release_rollout() before their handles are reset, and nothing on the
+ * nps_init() path may hand a pointer into the library to libc, glib or
+ * Ivy (signal handlers, atexit, timeouts, bindings are nps_main only).
+ * The library is linked with -z now, so the lazy binding slots of the
+ * loader are read only too.
+ */
+
+#define NPS_LOCKSTEP_MAX_SEGMENTS 8
+
+struct NpsLockstepSegment {
+  char*  addr;
+  size_t len;
+  char*  copy;
+};
+
+static struct {
+  bool_t taken;
+  unsigned int nb;
+  struct NpsLockstepSegment seg[NPS_LOCKSTEP_MAX_SEGMENTS];
+} snapshot;
+
+static int find_data_segments(struct dl_phdr_info* info, size_t size __attribute__ ((unused)), void* data __attribute__ ((unused))) {
+  const char* self = (const char*)&nps_lockstep;
+  bool_t is_self = FALSE;
+  ElfW(Addr) relro_start = 0, relro_end = 0;
+  int i;
+  for (i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr)* p = &info->dlpi_phdr[i];
+    const char* start = (const char*)(info->dlpi_addr + p->p_vaddr);
+    if (p->p_type == PT_LOAD && self >= start && self < start + p->p_memsz)
+      is_self = TRUE;
+    if (p->p_type == PT_GNU_RELRO) {
+      relro_start = info->dlpi_addr + p->p_vaddr;
+      relro_end = relro_start + p->p_memsz;
+    }
+  }
+  if (!is_self)
+    return 0;
+  for (i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr)* p = &info->dlpi_phdr[i];
+    if (p->p_type != PT_LOAD || !(p->p_flags & PF_W))
+      continue;
+    ElfW(Addr) start = info->dlpi_addr + p->p_vaddr;
+    ElfW(Addr) end = start + p->p_memsz;
+    /* relocated then made read only by the loader, not ours to write */
+    if (relro_start < end && relro_end > start) {
+      if (relro_start <= start)
+        start = Min(relro_end, end);
+      else
+        end = relro_start;
+    }
+    if (end > start && snapshot.nb < NPS_LOCKSTEP_MAX_SEGMENTS) {
+      snapshot.seg[snapshot.nb].addr = (char*)start;
+      snapshot.seg[snapshot.nb].len = end - start;
+      snapshot.nb++;
+    }
+  }
+  return 1;
+}
+
+static int snapshot_take(void) {
+  unsigned int i;
+  snapshot.nb = 0;
+  if (!dl_iterate_phdr(find_data_segments, NULL) || snapshot.nb == 0)
+    return -1;
+  /* allocate everything first : the copies hold the snapshot bookkeeping too */
+  for (i = 0; i < snapshot.nb; i++)
+    if (!(snapshot.seg[i].copy = (char*)malloc(snapshot.seg[i].len)))
+      return -1;
+  snapshot.taken = TRUE;
+  for (i = 0; i < snapshot.nb; i++)
+    memcpy(snapshot.seg[i].copy, snapshot.seg[i].addr, snapshot.seg[i].len);
+  return 0;
+}
+
+static void snapshot_restore(void) {
+  struct NpsLockstepSegment seg[NPS_LOCKSTEP_MAX_SEGMENTS];
+  unsigned int i, nb = snapshot.nb;
+  memcpy(seg, snapshot.seg, sizeof(seg));
+  for (i = 0; i < nb; i++)
+    memcpy(seg[i].addr, seg[i].copy, seg[i].len);
+}
+
+/*
+ * What the previous rollout owns outside the data and bss, its handles
+ * are about to be reset. By init of nps_sim_init() :
+ *   nps_fdm_init        the JSBSim executive, which owns the property
+ *                       tree the command and time nodes point in
+ *   nps_sensors_init    the GPS latency histories, the other sensors
+ *                       are plain structs
+ *   nps_autopilot_init  nothing with the SCRIPT radio control, and the
+ *                       airborne code of main_init() allocates nothing;
+ *                       with the UDP downlink, the socket its first
+ *                       flush opened
+ * Anything added to these inits has to be released here too.
+ */
+static void release_rollout(void) {
+  nps_fdm_free();
+  nps_sensor_history_free(&sensors.gps.hmsl_history);
+  nps_sensor_history_free(&sensors.gps.pos_history);
+  nps_sensor_history_free(&sensors.gps.lla_history);
+  nps_sensor_history_free(&sensors.gps.speed_history);
+#ifdef SIM_UDP
+  sim_udp_close();
+#endif
+}
+
+
+int nps_init(const struct NpsConfig* config) {
+
+  if (NPS_LOCKSTEP_DT != NPS_SIM_DT)
+    return -1;
+
+  if (!snapshot.taken) {
+    if (snapshot_take() != 0)
+      return -1;
+  }
+  else {
+    release_rollout();
+    snapshot_restore();
+  }
+
+  nps_random_set_seed(config->seed);
+
+  nps_lockstep.sim_time = 0.;
+  nps_lockstep.commands_override = FALSE;
+
+  nps_sim_init(nps_lockstep.sim_time, SCRIPT, config->rc_script, NULL);
+  nps_sensors_scale_noise(config->noise_scale);
+
+  return 0;
+}
+
+
+void nps_step(unsigned int n) {
+  while (n--) {
+    nps_sim_run_step(nps_lockstep.sim_time,
+                     nps_lockstep.commands_override ? nps_lockstep.commands : autopilot.commands,
+                     FALSE);
+    nps_lockstep.sim_time += NPS_SIM_DT;
+  }
+}
+
+
+void nps_get_state(struct NpsState* state) {
+  state->time = nps_lockstep.sim_time;
+  state->on_ground = fdm.on_ground;
+  state->ecef_pos = fdm.ecef_pos;
+  state->ltpprz_pos = fdm.ltpprz_pos;
+  state->ltpprz_ecef_vel = fdm.ltpprz_ecef_vel;
+  state->ltp_to_body_quat = fdm.ltp_to_body_quat;
+  state->ltp_to_body_eulers = fdm.ltp_to_body_eulers;
+  state->body_ecef_rotvel = fdm.body_ecef_rotvel;
+  double* commands = nps_lockstep.commands_override ? nps_lockstep.commands : autopilot.commands;
+  state->nb_commands = Min((unsigned int)SERVOS_NB, (unsigned int)(sizeof(state->commands) / sizeof(state->commands[0])));
+  memcpy(state->commands, commands, state->nb_commands * sizeof(double));
+}
+
+
+void nps_set_commands(const double* commands, unsigned int nb) {
+  unsigned int i;
+  for (i = 0; i < SERVOS_NB; i++)
+    nps_lockstep.commands[i] = i < nb ? commands[i] : 0.;
+  nps_lockstep.commands_override = TRUE;
+}
+
+
+void nps_release_commands(void) {
+  nps_lockstep.commands_override = FALSE;
+}
@@ -0,0 +1,63 @@
+#ifndef NPS_LOCKSTEP_H
+#define NPS_LOCKSTEP_H
+
+/*
+ * Lockstep API : drive NPS from an external program, one simulation
+ * step at a time, without Ivy, FlightGear or wall-clock pacing.
+ * Built as libnps.so with "make AIRCRAFT=<ac> sim.lib".
+ *
+ * nps_init() may be called again to start a new rollout from the
+ * initial conditions : the data and bss of the library are put back
+ * as they were at the first call, so a rollout does not depend on the
+ * previous ones. The heap and file descriptors of the previous rollout
+ * are released first. The library is not reentrant, one simulation per
+ * process.
+ *
+ * Example driver : sw/airborne/test/nps_lockstep_example.c
+ */
+
+#include "std.h"
+#include "math/pprz_algebra_double.h"
+#include "math/pprz_geodetic_double.h"
+
+/* NPS_SIM_DT of nps_sim.h, nps_init() fails if they differ */
+#define NPS_LOCKSTEP_DT (1./512.)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct NpsConfig {
+  int    seed;          /* random seed for sensor noise         */
+  double noise_scale;   /* factor applied to all sensor noises  */
+  int    rc_script;     /* radio control script number          */
+};
+
+struct NpsState {
+  double time;
+  bool_t on_ground;
+  struct EcefCoor_d   ecef_pos;
+  struct NedCoor_d    ltpprz_pos;
+  struct NedCoor_d    ltpprz_ecef_vel;
+  struct DoubleQuat   ltp_to_body_quat;
+  struct DoubleEulers ltp_to_body_eulers;
+  struct DoubleRates  body_ecef_rotvel;
+  unsigned int nb_commands;
+  double commands[16];  /* commands applied to the FDM at last step */
+};
+
+/* 0 on success */
+extern int  nps_init(const struct NpsConfig* config);
+/* run n steps of NPS_LOCKSTEP_DT */
+extern void nps_step(unsigned int n);
+extern void nps_get_state(struct NpsState* state);
+/* override the autopilot commands with nb values in [0:1]
+   until nps_release_commands() is called */
+extern void nps_set_commands(const double* commands, unsigned int nb);
+extern void nps_release_commands(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NPS_LOCKSTEP_H */
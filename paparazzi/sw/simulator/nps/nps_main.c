@@ -6,14 +6,23 @@
 #include <sys/time.h>
 #include <getopt.h>
 
+#include "nps_sim.h"
 #include "nps_fdm.h"
 #include "nps_sensors.h"
 #include "nps_atmosphere.h"
 #include "nps_autopilot.h"
+#include "nps_autopilot_booz.h"
 #include "nps_ivy.h"
 #include "nps_flightgear.h"
+#include "nps_random.h"
+#include "nps_metrics.h"
+#include "nps_campaign.h"
+#include "nps_traffic.h"
+#include "nps_profiler.h"
+#ifdef SIM_UDP
+#include "sim_udp.h"
+#endif
 
-#define SIM_DT     (1./512.)
 #define DISPLAY_DT (1./30.)
 #define HOST_TIMEOUT_MS 40
 #define HOST_TIME_FACTOR 1.
@@ -28,12 +37,23 @@ static struct {
   char* js_dev;
   char* spektrum_dev;
   int rc_script;
+  bool_t traffic;
+  bool_t profile;
+  char* profile_file;
+  bool_t ahrs;
+  bool_t batch;
+  double duration;
+  int seed;
+  double noise_scale;
+  struct NpsCampaign campaign;
 } nps_main;
 
 static bool_t nps_main_parse_options(int argc, char** argv);
 static void nps_main_init(void);
 static void nps_main_display(void);
 static void nps_main_run_sim_step(void);
+static void nps_main_run_batch(void);
+static void nps_main_run_campaign_member(int seed, double noise_scale, struct NpsMetrics* metrics);
 static gboolean nps_main_periodic(gpointer data __attribute__ ((unused)));
 
 int pauseSignal = 0;
@@ -62,8 +82,28 @@ int main ( int argc, char** argv) {
 
   if (!nps_main_parse_options(argc, argv)) return 1;
 
+  if (nps_main.campaign.nb_runs > 0)
+    return nps_campaign_run(&nps_main.campaign, nps_main_run_campaign_member) ? 1 : 0;
+
+  nps_random_set_seed(nps_main.seed);
+  if (nps_main.profile)
+    nps_profiler_init(nps_main.profile_file);
   nps_main_init();
 
+  if (nps_main.batch) {
+    nps_sensors_scale_noise(nps_main.noise_scale);
+    nps_main_run_batch();
+    printf("tracking error max %f rms %f, time to wp max %f, %d wp missed%s\n",
+           nps_metrics.tracking_err_max, nps_metrics.tracking_err_rms,
+           nps_metrics.time_to_wp_max, nps_metrics.nb_wp_missed,
+           nps_metrics.crashed ? ", CRASHED" : "");
+    if (nps_metrics.att_err_valid)
+      printf("attitude error max %f rms %f deg\n", nps_metrics.att_err_max, nps_metrics.att_err_rms);
+    if (nps_metrics.min_separation >= 0.)
+      printf("min separation with other aircraft %f m\n", nps_metrics.min_separation);
+    return 0;
+  }
+
   signal(SIGCONT, cont_hdl);
   signal(SIGTSTP, tstp_hdl);
   printf("Time factor is %f. (Press Ctrl-Z to change)\n", nps_main.host_time_factor);
@@ -85,10 +125,9 @@ static void nps_main_init(void) {
   nps_main.scaled_initial_time = time_to_double(&t);
   nps_main.host_time_factor = HOST_TIME_FACTOR;
 
-  nps_ivy_init();
-  nps_fdm_init(SIM_DT);
-  nps_sensors_init(nps_main.sim_time);
-
+  /* no Ivy nor FlightGear I/O in batch mode */
+  if (!nps_main.batch)
+    nps_ivy_init();
   enum NpsRadioControlType rc_type;
   char* rc_dev = NULL;
   if (nps_main.js_dev) {
@@ -102,32 +141,83 @@ static void nps_main_init(void) {
   else {
     rc_type = SCRIPT;
   }
-  nps_autopilot_init(rc_type, nps_main.rc_script, rc_dev);
+  nps_sim_init(nps_main.sim_time, rc_type, nps_main.rc_script, rc_dev);
+  if (nps_main.ahrs)
+    nps_bypass_ahrs = FALSE;
 
-  if (nps_main.fg_host)
+  if (nps_main.fg_host && !nps_main.batch)
     nps_flightgear_init(nps_main.fg_host, nps_main.fg_port);
 
+  if (nps_main.traffic && !nps_traffic_init())
+    nps_main.traffic = FALSE;
+
 }
 
 
 
 static void nps_main_run_sim_step(void) {
   //  printf("sim at %f\n", nps_main.sim_time);
+  nps_sim_run_step(nps_main.sim_time, autopilot.commands, nps_main.traffic);
+}
+
 
-  nps_fdm_run_step(autopilot.commands);
+/*
+ * Headless run : step the simulation as fast as the host allows
+ * until nps_main.duration seconds of simulated time have elapsed
+ */
+static void nps_main_run_batch(void) {
+  struct timeval tv_start, tv_end;
 
-  nps_sensors_run_step(nps_main.sim_time);
+  nps_metrics_init();
+  gettimeofday(&tv_start, NULL);
+  while (nps_main.sim_time < nps_main.duration) {
+    nps_main_run_sim_step();
+    nps_metrics_run_step(nps_main.sim_time);
+    nps_main.sim_time += NPS_SIM_DT;
+#ifdef SIM_UDP
+    /* no display loop here, send the telemetry at the same rate */
+    if (nps_main.display_time < nps_main.sim_time) {
+      sim_udp_flush();
+      nps_main.display_time += DISPLAY_DT;
+    }
+#endif
+  }
+  gettimeofday(&tv_end, NULL);
+#ifdef SIM_UDP
+  sim_udp_flush();
+#endif
+  nps_metrics_finish();
+
+  double host_time_elapsed = time_to_double(&tv_end) - time_to_double(&tv_start);
+  printf("Simulated %.3f s in %.3f s of host time", nps_main.sim_time, host_time_elapsed);
+  if (host_time_elapsed > 0.)
+    printf(" (%.1f sim-s per wall-s)", nps_main.sim_time / host_time_elapsed);
+  printf("\n");
+}
 
-  nps_autopilot_run_step(nps_main.sim_time);
 
+/*
+ * One run of a Monte-Carlo campaign, called in a forked child
+ */
+static void nps_main_run_campaign_member(int seed, double noise_scale, struct NpsMetrics* metrics) {
+  nps_random_set_seed(seed);
+  nps_main_init();
+  nps_sensors_scale_noise(noise_scale);
+  nps_main_run_batch();
+  *metrics = nps_metrics;
 }
 
 
 static void nps_main_display(void) {
   //  printf("display at %f\n", nps_main.display_time);
+  uint64_t t = nps_profiler_start();
   nps_ivy_display();
+#ifdef SIM_UDP
+  sim_udp_flush();
+#endif
   if (nps_main.fg_host)
     nps_flightgear_send();
+  nps_profiler_stop(NPS_PROF_DISPLAY, t);
 }
 
 
@@ -169,7 +259,7 @@ static gboolean nps_main_periodic(gpointer data __attribute__ ((unused))) {
 
   while (nps_main.sim_time <= host_time_elapsed) {
     nps_main_run_sim_step();
-    nps_main.sim_time += SIM_DT;
+    nps_main.sim_time += NPS_SIM_DT;
     if (nps_main.display_time < nps_main.sim_time) {
       nps_main_display();
       nps_main.display_time += DISPLAY_DT;
@@ -188,6 +278,19 @@ static bool_t nps_main_parse_options(int argc, char** argv) {
   nps_main.js_dev = NULL;
   nps_main.spektrum_dev = NULL;
   nps_main.rc_script = 0;
+  nps_main.traffic = FALSE;
+  nps_main.profile = FALSE;
+  nps_main.profile_file = NULL;
+  nps_main.ahrs = FALSE;
+  nps_main.batch = FALSE;
+  nps_main.duration = 0.;
+  nps_main.seed = 1;
+  nps_main.noise_scale = 1.;
+  nps_main.campaign.nb_runs = 0;
+  nps_main.campaign.nb_jobs = 0;
+  nps_main.campaign.noise_scale_min = 1.;
+  nps_main.campaign.noise_scale_max = 1.;
+  nps_main.campaign.csv_file = NULL;
 
   static const char* usage =
 "Usage: %s [options]\n"
@@ -196,7 +299,17 @@ static bool_t nps_main_parse_options(int argc, char** argv) {
 "   --fg_port flight gear port\n"
 "   -j --js_dev joystick device\n"
 "   --spektrum_dev spektrum device\n"
-"   --rc_script no\n";
+"   --rc_script no\n"
+"   --batch run headless, as fast as possible (no Ivy, no FlightGear)\n"
+"   --duration simulated time in seconds for batch mode\n"
+"   --seed random seed for the sensor noise (default 1)\n"
+"   --noise_scale factor applied to all sensor noises, min[:max] for a campaign\n"
+"   --runs number of batch runs of a Monte-Carlo campaign\n"
+"   --jobs number of runs in parallel (default: number of cpus)\n"
+"   --csv campaign results file (default: stdout)\n"
+"   --traffic share our true state with the other NPS aircraft of this host\n"
+"   --profile[=file] time the simulation stages, report at exit and on SIGUSR1\n"
+"   --ahrs fly on the estimated attitude instead of the true one\n";
 
 
   while (1) {
@@ -207,6 +320,16 @@ static bool_t nps_main_parse_options(int argc, char** argv) {
       {"js_dev", 1, NULL, 0},
       {"spektrum_dev", 1, NULL, 0},
       {"rc_script", 1, NULL, 0},
+      {"batch", 0, NULL, 0},
+      {"duration", 1, NULL, 0},
+      {"seed", 1, NULL, 0},
+      {"noise_scale", 1, NULL, 0},
+      {"runs", 1, NULL, 0},
+      {"jobs", 1, NULL, 0},
+      {"csv", 1, NULL, 0},
+      {"traffic", 0, NULL, 0},
+      {"profile", 2, NULL, 0},
+      {"ahrs", 0, NULL, 0},
       {0, 0, 0, 0}
     };
     int option_index = 0;
@@ -228,6 +351,34 @@ static bool_t nps_main_parse_options(int argc, char** argv) {
         nps_main.spektrum_dev = strdup(optarg); break;
       case 4:
         nps_main.rc_script = atoi(optarg); break;
+      case 5:
+        nps_main.batch = TRUE; break;
+      case 6:
+        nps_main.duration = atof(optarg); break;
+      case 7:
+        nps_main.seed = atoi(optarg); break;
+      case 8:
+        nps_main.campaign.noise_scale_min = nps_main.campaign.noise_scale_max = atof(optarg);
+        if (strchr(optarg, ':'))
+          nps_main.campaign.noise_scale_max = atof(strchr(optarg, ':') + 1);
+        nps_main.noise_scale = nps_main.campaign.noise_scale_min;
+        break;
+      case 9:
+        nps_main.campaign.nb_runs = atoi(optarg);
+        nps_main.batch = TRUE; break;
+      case 10:
+        nps_main.campaign.nb_jobs = atoi(optarg); break;
+      case 11:
+        nps_main.campaign.csv_file = strdup(optarg); break;
+      case 12:
+        nps_main.traffic = TRUE; break;
+      case 13:
+        nps_main.profile = TRUE;
+        if (optarg)
+          nps_main.profile_file = strdup(optarg);
+        break;
+      case 14:
+        nps_main.ahrs = TRUE; break;
       }
       break;
 
@@ -241,5 +392,19 @@ static bool_t nps_main_parse_options(int argc, char** argv) {
       exit(EXIT_FAILURE);
     }
   }
+
+  nps_main.campaign.seed = nps_main.seed;
+
+  /* every run of a campaign has our AC_ID, they would share a slot */
+  if (nps_main.traffic && nps_main.campaign.nb_runs > 0) {
+    fprintf(stderr, "--traffic is ignored in a campaign\n");
+    nps_main.traffic = FALSE;
+  }
+
+  if (nps_main.batch && nps_main.duration <= 0.) {
+    fprintf(stderr, "batch mode needs a positive --duration\n");
+    fprintf(stderr, usage, argv[0]);
+    return FALSE;
+  }
   return TRUE;
 }
@@ -0,0 +1,119 @@
+#include "nps_metrics.h"
+
+#include <math.h>
+
+#include "nps_fdm.h"
+#include "nps_traffic.h"
+#include "nps_autopilot_booz.h"
+#include "firmwares/rotorcraft/autopilot.h"
+#include "firmwares/rotorcraft/navigation.h"
+#include "firmwares/rotorcraft/guidance/guidance_h.h"
+#include "subsystems/ahrs.h"
+#include "math/pprz_algebra_int.h"
+
+/* vertical speed at touchdown above which we call it a crash (m/s) */
+#define NPS_METRICS_CRASH_SPEED 3.
+
+struct NpsMetrics nps_metrics;
+
+void nps_metrics_init(void) {
+  nps_metrics.tracking_err_max = 0.;
+  nps_metrics.tracking_err_rms = 0.;
+  nps_metrics.time_to_wp_max = -1.;
+  nps_metrics.nb_wp_missed = 0;
+  nps_metrics.crashed = FALSE;
+  nps_metrics.att_err_valid = FALSE;
+  nps_metrics.att_err_max = 0.;
+  nps_metrics.att_err_rms = 0.;
+  nps_metrics.min_separation = -1.;
+  nps_metrics.tracking_err_sum2 = 0.;
+  nps_metrics.nb_samples = 0;
+  nps_metrics.att_err_sum2 = 0.;
+  nps_metrics.nb_att_samples = 0;
+  nps_metrics.target_time = 0.;
+  nps_metrics.target_block = 0;
+  nps_metrics.target_stage = 0;
+  nps_metrics.target_reached = TRUE;
+}
+
+void nps_metrics_run_step(double time) {
+
+  /* vertical speed in the tangent plane at the aircraft, positive down */
+  if (isnan(fdm.ltpprz_pos.x) || isnan(fdm.ltpprz_pos.z) ||
+      (fdm.on_ground && fdm.ltp_ecef_vel.z > NPS_METRICS_CRASH_SPEED))
+    nps_metrics.crashed = TRUE;
+
+  if (!nps_bypass_ahrs && ahrs.status == AHRS_RUNNING) {
+    struct DoubleQuat q;
+    QUAT_FLOAT_OF_BFP(q, ahrs.ltp_to_body_quat);
+    double dot = fabs(q.qi * fdm.ltp_to_body_quat.qi + q.qx * fdm.ltp_to_body_quat.qx +
+                      q.qy * fdm.ltp_to_body_quat.qy + q.qz * fdm.ltp_to_body_quat.qz);
+    double err = DegOfRad(2. * acos(Min(dot, 1.)));
+    nps_metrics.att_err_sum2 += err * err;
+    nps_metrics.nb_att_samples++;
+    nps_metrics.att_err_valid = TRUE;
+    if (err > nps_metrics.att_err_max)
+      nps_metrics.att_err_max = err;
+  }
+
+  /* only with --traffic, other processes run at their own pace */
+  uint8_t ac_id;
+  double dist;
+  if (nps_traffic_nearest(time, NPS_METRICS_TRAFFIC_SYNC, &ac_id, &dist) &&
+      (nps_metrics.min_separation < 0. || dist < nps_metrics.min_separation))
+    nps_metrics.min_separation = dist;
+
+  if (!autopilot_in_flight)
+    return;
+
+  /* guidance setpoint is NED, fdm ltpprz position is NED */
+  if (autopilot_mode == AP_MODE_HOVER_Z_HOLD || autopilot_mode == AP_MODE_HOVER_CLIMB ||
+      autopilot_mode == AP_MODE_HOVER_DIRECT || autopilot_mode == AP_MODE_NAV) {
+    double ex = fdm.ltpprz_pos.x - POS_FLOAT_OF_BFP(guidance_h_pos_sp.x);
+    double ey = fdm.ltpprz_pos.y - POS_FLOAT_OF_BFP(guidance_h_pos_sp.y);
+    double err2 = ex*ex + ey*ey;
+    nps_metrics.tracking_err_sum2 += err2;
+    nps_metrics.nb_samples++;
+    if (err2 > nps_metrics.tracking_err_max * nps_metrics.tracking_err_max)
+      nps_metrics.tracking_err_max = sqrt(err2);
+  }
+
+  if (autopilot_mode != AP_MODE_NAV)
+    return;
+
+  /*
+   * a new target with each flight plan stage: circles and routes move
+   * navigation_target at every step, the stage stays
+   */
+  if (nav_block != nps_metrics.target_block || nav_stage != nps_metrics.target_stage) {
+    if (!nps_metrics.target_reached)
+      nps_metrics.nb_wp_missed++;
+    nps_metrics.target_block = nav_block;
+    nps_metrics.target_stage = nav_stage;
+    nps_metrics.target_time = time;
+    nps_metrics.target_reached = FALSE;
+  }
+  if (!nps_metrics.target_reached) {
+    /* navigation target is ENU */
+    double dx = fdm.ltpprz_pos.x - POS_FLOAT_OF_BFP(navigation_target.y);
+    double dy = fdm.ltpprz_pos.y - POS_FLOAT_OF_BFP(navigation_target.x);
+    if (dx*dx + dy*dy < NPS_METRICS_WP_RADIUS * NPS_METRICS_WP_RADIUS) {
+      double time_to_wp = time - nps_metrics.target_time;
+      if (time_to_wp > nps_metrics.time_to_wp_max)
+        nps_metrics.time_to_wp_max = time_to_wp;
+      nps_metrics.target_reached = TRUE;
+    }
+  }
+
+}
+
+void nps_metrics_finish(void) {
+  if (nps_metrics.nb_samples > 0)
+    nps_metrics.tracking_err_rms = sqrt(nps_metrics.tracking_err_sum2 / nps_metrics.nb_samples);
+  if (nps_metrics.nb_att_samples > 0)
+    nps_metrics.att_err_rms = sqrt(nps_metrics.att_err_sum2 / nps_metrics.nb_att_samples);
+  if (!nps_metrics.target_reached) {
+    nps_metrics.nb_wp_missed++;
+    nps_metrics.target_reached = TRUE;
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef NPS_METRICS_H
+#define NPS_METRICS_H
+
+#include "std.h"
+
+/* distance to the navigation target under which it is considered reached */
+#define NPS_METRICS_WP_RADIUS 1.
+/* other aircraft states at most this far in simulated time are compared (s) */
+#define NPS_METRICS_TRAFFIC_SYNC 0.1
+
+struct NpsMetrics {
+  /* horizontal distance between true position and guidance setpoint (m) */
+  double tracking_err_max;
+  double tracking_err_rms;
+  /* longest time taken to reach a navigation target, -1 if none reached (s) */
+  double time_to_wp_max;
+  /* navigation targets not reached at end of run */
+  int    nb_wp_missed;
+  bool_t crashed;
+  /*
+   * angle between true and estimated attitude, once the AHRS runs (deg),
+   * only measured with --ahrs: the bypass copies the truth into the AHRS
+   */
+  bool_t att_err_valid;
+  double att_err_max;
+  double att_err_rms;
+  /* distance to the nearest other NPS aircraft of the host, -1 if none seen (m) */
+  double min_separation;
+  /* internal */
+  double tracking_err_sum2;
+  unsigned int nb_samples;
+  double att_err_sum2;
+  unsigned int nb_att_samples;
+  double target_time;
+  uint8_t target_block;
+  uint8_t target_stage;
+  bool_t target_reached;
+};
+
+extern struct NpsMetrics nps_metrics;
+
+extern void nps_metrics_init(void);
+extern void nps_metrics_run_step(double time);
+extern void nps_metrics_finish(void);
+
+#endif /* NPS_METRICS_H */
@@ -0,0 +1,107 @@
+#include "nps_profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct NpsProfiler nps_profiler;
+
+static const char* nps_profiler_stage_names[NPS_PROF_NB] = {
+  "step", "fdm", "gyro", "accel", "mag", "baro", "gps",
+  "ap_event", "ap_periodic", "display"
+};
+
+static double nps_profiler_host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void nps_profiler_sig_hdl(int n __attribute__ ((unused))) {
+  nps_profiler.dump_requested = 1;
+}
+
+static void nps_profiler_at_exit(void) {
+  nps_profiler_dump();
+}
+
+void nps_profiler_init(const char* file) {
+  memset(&nps_profiler, 0, sizeof(nps_profiler));
+  int i;
+  for (i=0; i<NPS_PROF_NB; i++)
+    nps_profiler.stats[i].min = UINT64_MAX;
+  nps_profiler.file = file;
+  nps_profiler.start_ns = nps_profiler_host_ns();
+  nps_profiler.start_ticks = nps_profiler_ticks();
+  nps_profiler.enabled = TRUE;
+  signal(SIGUSR1, nps_profiler_sig_hdl);
+  atexit(nps_profiler_at_exit);
+}
+
+/* upper bound of the bucket holding the q quantile, in ticks */
+static uint64_t nps_profiler_quantile(struct NpsProfilerStats* s, double q) {
+  uint64_t rank = (uint64_t)(q * s->count);
+  uint64_t n = 0;
+  int i;
+  for (i=0; i<NPS_PROF_HIST_NB; i++) {
+    n += s->hist[i];
+    if (n > rank)
+      break;
+  }
+  uint64_t bound = i < NPS_PROF_HIST_NB - 1 ? (2ULL << i) : s->max;
+  return bound < s->max ? bound : s->max;
+}
+
+void nps_profiler_dump(void) {
+  if (!nps_profiler.enabled)
+    return;
+
+  /* ticks to ns ratio measured over the whole run */
+  double elapsed_ns = nps_profiler_host_ns() - nps_profiler.start_ns;
+  uint64_t elapsed_ticks = nps_profiler_ticks() - nps_profiler.start_ticks;
+  double ns_per_tick = elapsed_ticks ? elapsed_ns / elapsed_ticks : 1.;
+
+  FILE* f = stderr;
+  if (nps_profiler.file && !(f = fopen(nps_profiler.file, "w"))) {
+    perror(nps_profiler.file);
+    return;
+  }
+
+  struct NpsProfilerStats* step = &nps_profiler.stats[NPS_PROF_STEP];
+  fprintf(f, "# nps profile over %.3f s of host time (%.3f ns per tick)\n",
+          elapsed_ns * 1e-9, ns_per_tick);
+  fprintf(f, "# %-12s %10s %10s %10s %10s %10s %10s %7s\n",
+          "stage", "count", "mean_ns", "min_ns", "p50_ns", "p99_ns", "max_ns", "share");
+  int i;
+  for (i=0; i<NPS_PROF_NB; i++) {
+    struct NpsProfilerStats* s = &nps_profiler.stats[i];
+    if (!s->count)
+      continue;
+    fprintf(f, "%-14s %10llu %10.0f %10.0f %10.0f %10.0f %10.0f %6.1f%%\n",
+            nps_profiler_stage_names[i], (unsigned long long)s->count,
+            ns_per_tick * s->total / s->count,
+            ns_per_tick * s->min,
+            ns_per_tick * nps_profiler_quantile(s, 0.5),
+            ns_per_tick * nps_profiler_quantile(s, 0.99),
+            ns_per_tick * s->max,
+            step->total ? 100. * s->total / step->total : 0.);
+  }
+
+  /* non empty buckets as lower_bound_ns:count */
+  for (i=0; i<NPS_PROF_NB; i++) {
+    struct NpsProfilerStats* s = &nps_profiler.stats[i];
+    if (!s->count)
+      continue;
+    fprintf(f, "hist %s", nps_profiler_stage_names[i]);
+    int b;
+    for (b=0; b<NPS_PROF_HIST_NB; b++)
+      if (s->hist[b])
+        fprintf(f, " %.0f:%llu", ns_per_tick * (1ULL << b), (unsigned long long)s->hist[b]);
+    fprintf(f, "\n");
+  }
+
+  if (f != stderr)
+    fclose(f);
+  else
+    fflush(f);
+}
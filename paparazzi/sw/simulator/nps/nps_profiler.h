@@ -0,0 +1,99 @@
+#ifndef NPS_PROFILER_H
+#define NPS_PROFILER_H
+
+/*
+ * Host time spent in each stage of a simulation step.
+ *
+ * Stages are timed with the cpu time stamp counter when available
+ * (clock_gettime otherwise) and accumulated in log2 histograms.
+ * Statistics are printed at exit and whenever SIGUSR1 is received.
+ * Nothing is measured unless nps_profiler_init() was called.
+ */
+
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include "std.h"
+
+enum NpsProfilerStage {
+  NPS_PROF_STEP,
+  NPS_PROF_FDM,
+  NPS_PROF_GYRO,
+  NPS_PROF_ACCEL,
+  NPS_PROF_MAG,
+  NPS_PROF_BARO,
+  NPS_PROF_GPS,
+  NPS_PROF_AP_EVENT,
+  NPS_PROF_AP_PERIODIC,
+  NPS_PROF_DISPLAY,
+  NPS_PROF_NB
+};
+
+/* bucket i holds the durations d with 2^i <= d < 2^(i+1) ticks */
+#define NPS_PROF_HIST_NB 40
+
+struct NpsProfilerStats {
+  uint64_t count;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+  uint64_t hist[NPS_PROF_HIST_NB];
+};
+
+struct NpsProfiler {
+  bool_t enabled;
+  const char* file;
+  volatile sig_atomic_t dump_requested;
+  uint64_t start_ticks;
+  double   start_ns;
+  struct NpsProfilerStats stats[NPS_PROF_NB];
+};
+
+extern struct NpsProfiler nps_profiler;
+
+/* file is NULL for stderr */
+extern void nps_profiler_init(const char* file);
+extern void nps_profiler_dump(void);
+
+
+static inline uint64_t nps_profiler_ticks(void) {
+#if defined __i386__ || defined __x86_64__
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* returns the start tick of a stage, 0 when profiling is disabled */
+static inline uint64_t nps_profiler_start(void) {
+  return nps_profiler.enabled ? nps_profiler_ticks() : 0;
+}
+
+/* records the stage started at t0, returns the current tick to chain stages */
+static inline uint64_t nps_profiler_stop(enum NpsProfilerStage stage, uint64_t t0) {
+  if (!nps_profiler.enabled)
+    return 0;
+  uint64_t now = nps_profiler_ticks();
+  uint64_t d = now - t0;
+  struct NpsProfilerStats* s = &nps_profiler.stats[stage];
+  s->count++;
+  s->total += d;
+  if (d < s->min) s->min = d;
+  if (d > s->max) s->max = d;
+  int b = d ? 63 - __builtin_clzll(d) : 0;
+  if (b >= NPS_PROF_HIST_NB) b = NPS_PROF_HIST_NB - 1;
+  s->hist[b]++;
+  return now;
+}
+
+/* dumps the statistics if SIGUSR1 was received since the last call */
+static inline void nps_profiler_poll(void) {
+  if (nps_profiler.dump_requested) {
+    nps_profiler.dump_requested = 0;
+    nps_profiler_dump();
+  }
+}
+
+#endif /* NPS_PROFILER_H */
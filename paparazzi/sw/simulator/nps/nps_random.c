@@ -1,52 +1,37 @@
 #include "nps_random.h"
 
-
 #include <math.h>
-#include <limits.h>
-
-/*
- * R250
- * Kirkpatrick, S., and E. Stoll, 1981; "A Very Fast
- * Shift-Register Sequence Random Number Generator",
- * Journal of Computational Physics, V.40
- *
- */
-
-static void         r250_init(int seed);
-//static unsigned int r250( void );
-static double       dr250( void );
-
-/*
- * randclg
- * Linear Congruential Method, the "minimal standard generator"
- * Park & Miller, 1988, Comm of the ACM, 31(10), pp. 1192-1201
- *
- */
-
-static long              set_seed(long);
-//static long              get_seed(void);
-static unsigned long int randlcg(void);
+#include "std.h"
 
+static int random_seed = 0;
+static struct NpsRandomStream default_stream;
 
+void nps_random_set_seed(int seed) {
+  random_seed = seed;
+  nps_random_stream_init(&default_stream, random_seed, NPS_RANDOM_STREAM_DEFAULT);
+}
 
+int nps_random_get_seed(void) {
+  return random_seed;
+}
 
 
-void double_vect3_add_gaussian_noise(struct DoubleVect3* vect, struct DoubleVect3* std_dev) {
-  vect->x += get_gaussian_noise() * std_dev->x;
-  vect->y += get_gaussian_noise() * std_dev->y;
-  vect->z += get_gaussian_noise() * std_dev->z;
+void double_vect3_add_gaussian_noise(struct NpsRandomStream* s, struct DoubleVect3* vect, struct DoubleVect3* std_dev) {
+  vect->x += nps_random_stream_gaussian(s) * std_dev->x;
+  vect->y += nps_random_stream_gaussian(s) * std_dev->y;
+  vect->z += nps_random_stream_gaussian(s) * std_dev->z;
 }
 
-void double_vect3_get_gaussian_noise(struct DoubleVect3* vect, struct DoubleVect3* std_dev) {
-  vect->x = get_gaussian_noise() * std_dev->x;
-  vect->y = get_gaussian_noise() * std_dev->y;
-  vect->z = get_gaussian_noise() * std_dev->z;
+void double_vect3_get_gaussian_noise(struct NpsRandomStream* s, struct DoubleVect3* vect, struct DoubleVect3* std_dev) {
+  vect->x = nps_random_stream_gaussian(s) * std_dev->x;
+  vect->y = nps_random_stream_gaussian(s) * std_dev->y;
+  vect->z = nps_random_stream_gaussian(s) * std_dev->z;
 }
 
 
-void double_vect3_update_random_walk(struct DoubleVect3* rw, struct DoubleVect3* std_dev, double dt, double thau) {
+void double_vect3_update_random_walk(struct NpsRandomStream* s, struct DoubleVect3* rw, struct DoubleVect3* std_dev, double dt, double thau) {
   struct DoubleVect3 drw;
-  double_vect3_get_gaussian_noise(&drw, std_dev);
+  double_vect3_get_gaussian_noise(s, &drw, std_dev);
   struct DoubleVect3 tmp;
   VECT3_SMUL(tmp, *rw, (-1./thau));
   VECT3_ADD(drw, tmp);
@@ -54,191 +39,150 @@ void double_vect3_update_random_walk(struct DoubleVect3* rw, struct DoubleVect3*
   VECT3_ADD(*rw, drw);
 }
 
-/*
-   http://www.taygeta.com/random/gaussian.html
-*/
-
 
 double get_gaussian_noise(void) {
-
-  double x1;
-  static int nb_call = 0;
-  static double x2, w;
-  if (nb_call==0) r250_init(0);
-  nb_call++;
-  if (nb_call%2) {
-    do {
-      x1 = 2.0 * dr250() - 1.0;
-      x2 = 2.0 * dr250() - 1.0;
-      w = x1 * x1 + x2 * x2;
-    } while ( w >= 1.0 );
-
-    w = sqrt( (-2.0 * log( w ) ) / w );
-    return x1 * w;
-  }
-  else
-    return x2 * w;
+  /* default stream is lazily initialised with seed 0 */
+  if (default_stream.key == 0)
+    nps_random_set_seed(random_seed);
+  return nps_random_stream_gaussian(&default_stream);
 }
 
 
-
-
 /*
- * R250
- * Kirkpatrick, S., and E. Stoll, 1981; "A Very Fast
- * Shift-Register Sequence Random Number Generator",
- * Journal of Computational Physics, V.40
- *
+ * SplitMix64 finaliser
+ * Steele, Lea & Flood, 2014; "Fast Splittable Pseudorandom Number Generators",
+ * OOPSLA'14
+ * Used as a counter based generator : output n is mix(key + n * gamma).
  */
 
-/* defines to allow for 16 or 32 bit integers */
-#define BITS 31
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15ULL
 
+static inline uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
 
-#if WORD_BIT == 32
-#ifndef BITS
-#define BITS	32
-#endif
-#else
-#ifndef BITS
-#define BITS    16
-#endif
-#endif
-
-#if BITS == 31
-#define MSB          0x40000000L
-#define ALL_BITS     0x7fffffffL
-#define HALF_RANGE   0x20000000L
-#define STEP         7
-#endif
+/* raw IEEE 754 representation of a double and back */
+static inline uint64_t bits_of_double(double d) {
+  union { double d; uint64_t u; } c;
+  c.d = d;
+  return c.u;
+}
 
-#if BITS == 32
-#define MSB          0x80000000L
-#define ALL_BITS     0xffffffffL
-#define HALF_RANGE   0x40000000L
-#define STEP         7
-#endif
+static inline double double_of_bits(uint64_t u) {
+  union { double d; uint64_t u; } c;
+  c.u = u;
+  return c.d;
+}
 
-#if BITS == 16
-#define MSB         0x8000
-#define ALL_BITS    0xffff
-#define HALF_RANGE  0x4000
-#define STEP        11
+#ifndef M_LN2
+#define M_LN2 0.69314718055994530942
 #endif
 
-static unsigned int r250_buffer[ 250 ];
-static int r250_index;
-
-static void r250_init(int sd) {
-  int j, k;
-  unsigned int mask, msb;
-  set_seed( sd );
-
-  r250_index = 0;
-  for (j = 0; j < 250; j++)      /* fill r250 buffer with BITS-1 bit values */
-    r250_buffer[j] = randlcg();
-
-  for (j = 0; j < 250; j++)	/* set some MSBs to 1 */
-    if ( randlcg() > HALF_RANGE )
-      r250_buffer[j] |= MSB;
-
-  msb = MSB;	        /* turn on diagonal bit */
-  mask = ALL_BITS;	/* turn off the leftmost bits */
-
-  for (j = 0; j < BITS; j++)  {
-    k = STEP * j + 3;	/* select a word to operate on */
-    r250_buffer[k] &= mask; /* turn off bits left of the diagonal */
-    r250_buffer[k] |= msb;	/* turn on the diagonal bit */
-    mask >>= 1;
-    msb  >>= 1;
-  }
+#define DOUBLE_ONE_BITS 0x3ff0000000000000ULL
+#define DOUBLE_SQRT1_2_BITS 0x3fe6a09e667f3bcdULL
+#define DOUBLE_MANTISSA_MASK 0x000fffffffffffffULL
 
+/* 52 random bits as a double in [1..2[ */
+static inline double one_two_of_bits(uint64_t bits) {
+  return double_of_bits(DOUBLE_ONE_BITS | (bits >> 12));
 }
 
-#if 0
-/* returns a random unsigned integer */
-static unsigned int r250(void) {
-  register int	j;
-  register unsigned int new_rand;
-
-  if ( r250_index >= 147 )
-    j = r250_index - 147;	/* wrap pointer around */
-  else
-    j = r250_index + 103;
-
-  new_rand = r250_buffer[ r250_index ] ^ r250_buffer[ j ];
-  r250_buffer[ r250_index ] = new_rand;
-
-  if ( r250_index >= 249 )	/* increment pointer for next time */
-    r250_index = 0;
-  else
-    r250_index++;
-
-  return new_rand;
-
+/*
+ * Natural log of x > 0, after fdlibm e_log.c : x = 2^k m with
+ * sqrt(2)/2 <= m < sqrt(2), log(m) = 2 atanh((m-1)/(m+1)) as a
+ * polynomial. Integer bit tricks only, no branch and no int64 to
+ * double conversion, so that it vectorises with plain SSE2.
+ */
+static inline double branchless_log(double x) {
+  static const double Lg1 = 6.666666666666735130e-01;
+  static const double Lg2 = 3.999999999940941908e-01;
+  static const double Lg3 = 2.857142874366239149e-01;
+  static const double Lg4 = 2.222219843214978396e-01;
+  static const double Lg5 = 1.818357216161805012e-01;
+  static const double Lg6 = 1.531383769920937332e-01;
+  static const double Lg7 = 1.479819860511658591e-01;
+  uint64_t ix = bits_of_double(x) + (DOUBLE_ONE_BITS - DOUBLE_SQRT1_2_BITS);
+  /* biased exponent, read back exactly through the 2^52 mantissa */
+  double k = double_of_bits(0x4330000000000000ULL | (ix >> 52)) - (4503599627370496. + 1023.);
+  double f = double_of_bits((ix & DOUBLE_MANTISSA_MASK) + DOUBLE_SQRT1_2_BITS) - 1.;
+  double hfsq = 0.5 * f * f;
+  double s = f / (2. + f);
+  double z = s * s;
+  double w = z * z;
+  double R = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7))) + w * (Lg2 + w * (Lg4 + w * Lg6));
+  return k * M_LN2 - ((hfsq - s * (hfsq + R)) - f);
 }
-#endif
-
-/* returns a random double in range 0..1 */
-static double dr250(void) {
-  register int	j;
-  register unsigned int new_rand;
-
-  if ( r250_index >= 147 )
-    j = r250_index - 147;	/* wrap pointer around */
-  else
-    j = r250_index + 103;
-
-  new_rand = r250_buffer[ r250_index ] ^ r250_buffer[ j ];
-  r250_buffer[ r250_index ] = new_rand;
 
-  if ( r250_index >= 249 )	/* increment pointer for next time */
-    r250_index = 0;
-  else
-    r250_index++;
+/* sin and cos of |a| <= pi/4, fdlibm k_sin.c and k_cos.c polynomials */
+static inline double kernel_sin(double a) {
+  double z = a * a;
+  return a + a * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 +
+         z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 +
+         z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+}
 
-  return (double)new_rand / ALL_BITS;
+static inline double kernel_cos(double a) {
+  double z = a * a;
+  return 1. - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 +
+         z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 +
+         z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+}
 
+void nps_random_stream_init(struct NpsRandomStream* s, int seed, unsigned int stream_id) {
+  /* never zero, so that a zero key means "not initialised" */
+  s->key = mix64(((uint64_t)(uint32_t)seed << 32 | stream_id) + GOLDEN_GAMMA) | 1;
+  s->counter = 0;
+  s->idx = NPS_RANDOM_BLOCK;
 }
 
 /*
- * randclg
- * Linear Congruential Method, the "minimal standard generator"
- * Park & Miller, 1988, Comm of the ACM, 31(10), pp. 1192-1201
- *
+ * Box-Muller transform over a whole block.
+ * The 64 bit hashes are computed first, the transform then runs over
+ * them with no branch, no libm call but sqrt and no int64 to double
+ * conversion, and vectorises with SSE2 (gcc -O2 -fno-math-errno, see
+ * fdm_nps.makefile). The hash loop only vectorises with AVX2.
+ * The angle is 2 pi u with u uniform, taken as a quadrant from the top
+ * two bits of the hash and an angle in [-pi/4..pi/4[ from the next 52.
  */
-
-static long int quotient  = LONG_MAX / 16807L;
-static long int my_remainder = LONG_MAX % 16807L;
-
-static long int seed_val = 1L;
-
-static long set_seed(long int sd) {
-  return seed_val = sd;
+static void stream_fill_block(struct NpsRandomStream* s) {
+  uint64_t base = s->key + s->counter * GOLDEN_GAMMA;
+  uint64_t h_radius[NPS_RANDOM_BLOCK / 2];
+  uint64_t h_angle[NPS_RANDOM_BLOCK / 2];
+  double radius[NPS_RANDOM_BLOCK / 2];
+  double c[NPS_RANDOM_BLOCK / 2];
+  double sn[NPS_RANDOM_BLOCK / 2];
+  int i;
+  for (i = 0; i < NPS_RANDOM_BLOCK / 2; i++) {
+    h_radius[i] = mix64(base + (uint64_t)(2 * i) * GOLDEN_GAMMA);
+    h_angle[i] = mix64(base + (uint64_t)(2 * i + 1) * GOLDEN_GAMMA);
+  }
+  for (i = 0; i < NPS_RANDOM_BLOCK / 2; i++) {
+    /* uniform in ]0..1] */
+    double u = 2. - one_two_of_bits(h_radius[i]);
+    radius[i] = sqrt(-2. * branchless_log(u));
+    double a = (one_two_of_bits(h_angle[i] << 2) - 1.5) * M_PI_2;
+    double ka = kernel_cos(a);
+    double sa = kernel_sin(a);
+    /* rotate by the quadrant: odd ones swap cos and sin, then signs */
+    uint64_t quadrant = h_angle[i] >> 62;
+    uint64_t swap = -(quadrant & 1);
+    uint64_t bc = (bits_of_double(sa) & swap) | (bits_of_double(ka) & ~swap);
+    uint64_t bs = (bits_of_double(ka) & swap) | (bits_of_double(sa) & ~swap);
+    c[i] = double_of_bits(bc ^ ((quadrant >> 1) << 63));
+    sn[i] = double_of_bits(bs ^ (((quadrant ^ (quadrant >> 1)) & 1) << 63));
+  }
+  for (i = 0; i < NPS_RANDOM_BLOCK / 2; i++) {
+    s->block[2 * i]     = radius[i] * c[i];
+    s->block[2 * i + 1] = radius[i] * sn[i];
+  }
+  s->counter += NPS_RANDOM_BLOCK;
+  s->idx = 0;
 }
 
-//static long get_seed(void) {
-//  return seed_val;
-//}
-
-/* returns a random unsigned integer */
-unsigned long int randlcg() {
-  if ( seed_val <= quotient )
-    seed_val = (seed_val * 16807L) % LONG_MAX;
-  else
-    {
-      long int high_part = seed_val / quotient;
-      long int low_part  = seed_val % quotient;
-
-      long int test = 16807L * low_part - my_remainder * high_part;
-
-      if ( test > 0 )
-	seed_val = test;
-      else
-	seed_val = test + LONG_MAX;
-
-    }
-
-  return seed_val;
+double nps_random_stream_gaussian(struct NpsRandomStream* s) {
+  if (s->idx >= NPS_RANDOM_BLOCK)
+    stream_fill_block(s);
+  return s->block[s->idx++];
 }
-
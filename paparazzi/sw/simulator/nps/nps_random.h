@@ -1,12 +1,46 @@
 #ifndef NPS_RANDOM_H
 #define NPS_RANDOM_H
 
+#include <stdint.h>
 #include "math/pprz_algebra_double.h"
 
+/*
+ * Counter based random streams.
+ * Sample n of a stream only depends on ( seed, stream id, n ) so that
+ * every consumer owning its stream gets the same sequence whatever the
+ * other consumers do, in whatever order or thread they run.
+ * Gaussian samples are produced NPS_RANDOM_BLOCK at a time.
+ */
+
+#define NPS_RANDOM_BLOCK 64
+
+enum NpsRandomStreamId {
+  NPS_RANDOM_STREAM_DEFAULT,
+  NPS_RANDOM_STREAM_GYRO,
+  NPS_RANDOM_STREAM_ACCEL,
+  NPS_RANDOM_STREAM_MAG,
+  NPS_RANDOM_STREAM_BARO,
+  NPS_RANDOM_STREAM_GPS
+};
+
+struct NpsRandomStream {
+  uint64_t key;
+  uint64_t counter;
+  unsigned int idx;
+  double block[NPS_RANDOM_BLOCK];
+};
+
+extern void nps_random_set_seed(int seed);
+extern int  nps_random_get_seed(void);
+
+extern void   nps_random_stream_init(struct NpsRandomStream* s, int seed, unsigned int stream_id);
+extern double nps_random_stream_gaussian(struct NpsRandomStream* s);
+
+/* draws from the default stream */
 extern double get_gaussian_noise(void);
-extern void double_vect3_add_gaussian_noise(struct DoubleVect3* vect, struct DoubleVect3* std_dev);
-extern void double_vect3_get_gaussian_noise(struct DoubleVect3* vect, struct DoubleVect3* std_dev);
-extern void double_vect3_update_random_walk(struct DoubleVect3* rw, struct DoubleVect3* std_dev, double dt, double thau);
 
-#endif /* NPS_RANDOM_H */
+extern void double_vect3_add_gaussian_noise(struct NpsRandomStream* s, struct DoubleVect3* vect, struct DoubleVect3* std_dev);
+extern void double_vect3_get_gaussian_noise(struct NpsRandomStream* s, struct DoubleVect3* vect, struct DoubleVect3* std_dev);
+extern void double_vect3_update_random_walk(struct NpsRandomStream* s, struct DoubleVect3* rw, struct DoubleVect3* std_dev, double dt, double thau);
 
+#endif /* NPS_RANDOM_H */
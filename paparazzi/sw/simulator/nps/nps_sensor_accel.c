@@ -18,6 +18,7 @@ void   nps_sensor_accel_init(struct NpsSensorAccel* accel, double time) {
 	       NPS_ACCEL_NOISE_STD_DEV_X, NPS_ACCEL_NOISE_STD_DEV_Y, NPS_ACCEL_NOISE_STD_DEV_Z);
   VECT3_ASSIGN(accel->bias,
 	       NPS_ACCEL_BIAS_X, NPS_ACCEL_BIAS_Y, NPS_ACCEL_BIAS_Z);
+  nps_random_stream_init(&accel->noise_stream, nps_random_get_seed(), NPS_RANDOM_STREAM_ACCEL);
   accel->next_update = time;
   accel->data_available = FALSE;
 }
@@ -55,7 +56,7 @@ void   nps_sensor_accel_run_step(struct NpsSensorAccel* accel, double time, stru
   /* constant bias */
   VECT3_COPY(accelero_error, accel->bias);
   /* white noise   */
-  double_vect3_add_gaussian_noise(&accelero_error, &accel->noise_std_dev);
+  double_vect3_add_gaussian_noise(&accel->noise_stream, &accelero_error, &accel->noise_std_dev);
   /* scale */
   struct DoubleVect3 gain = {NPS_ACCEL_SENSITIVITY_XX, NPS_ACCEL_SENSITIVITY_YY, NPS_ACCEL_SENSITIVITY_ZZ};
   VECT3_EW_MUL(accelero_error, accelero_error, gain);
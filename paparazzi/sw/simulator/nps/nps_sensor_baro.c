@@ -11,6 +11,8 @@
 
 void nps_sensor_baro_init(struct NpsSensorBaro* baro, double time) {
   baro->value = 0.;
+  baro->noise_std_dev = NPS_BARO_NOISE_STD_DEV;
+  nps_random_stream_init(&baro->noise_stream, nps_random_get_seed(), NPS_RANDOM_STREAM_BARO);
   baro->next_update = time;
   baro->data_available = FALSE;
 }
@@ -24,7 +26,7 @@ void nps_sensor_baro_run_step(struct NpsSensorBaro* baro, double time) {
   /*if (time < 10.)
     baro->value = rint(time*90);
     else {*/
-    double z = fdm.ltpprz_pos.z + get_gaussian_noise()*NPS_BARO_NOISE_STD_DEV;
+    double z = fdm.ltpprz_pos.z + nps_random_stream_gaussian(&baro->noise_stream)*baro->noise_std_dev;
     double baro_reading = NPS_BARO_QNH + z * NPS_BARO_SENSITIVITY;
     baro_reading = rint(baro_reading);
     baro->value = baro_reading;
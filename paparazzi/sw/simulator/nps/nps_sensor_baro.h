@@ -5,9 +5,12 @@
 #include "math/pprz_algebra_double.h"
 #include "math/pprz_algebra_float.h"
 #include "std.h"
+#include "nps_random.h"
 
 struct NpsSensorBaro {
   double  value;
+  double  noise_std_dev;
+  struct NpsRandomStream noise_stream;
   double  next_update;
   bool_t  data_available;
 };
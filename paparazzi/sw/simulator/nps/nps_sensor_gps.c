@@ -24,6 +24,16 @@ void nps_sensor_gps_init(struct NpsSensorGps* gps, double time) {
 			   NPS_GPS_POS_BIAS_RANDOM_WALK_STD_DEV_Y,
 			   NPS_GPS_POS_BIAS_RANDOM_WALK_STD_DEV_Z);
   FLOAT_VECT3_ZERO(gps->pos_bias_random_walk_value);
+  nps_random_stream_init(&gps->noise_stream, nps_random_get_seed(), NPS_RANDOM_STREAM_GPS);
+  /* histories of a previous run, if any */
+  nps_sensor_history_free(&gps->hmsl_history);
+  nps_sensor_history_free(&gps->pos_history);
+  nps_sensor_history_free(&gps->lla_history);
+  nps_sensor_history_free(&gps->speed_history);
+  nps_sensor_history_init(&gps->hmsl_history, 1, gps->pos_latency, NPS_GPS_DT);
+  nps_sensor_history_init(&gps->pos_history, 3, gps->pos_latency, NPS_GPS_DT);
+  nps_sensor_history_init(&gps->lla_history, 3, gps->pos_latency, NPS_GPS_DT);
+  nps_sensor_history_init(&gps->speed_history, 3, gps->speed_latency, NPS_GPS_DT);
   gps->next_update = time;
   gps->data_available = FALSE;
 }
@@ -47,10 +57,10 @@ void nps_sensor_gps_run_step(struct NpsSensorGps* gps, double time) {
   struct DoubleVect3 cur_speed_reading;
   VECT3_COPY(cur_speed_reading, fdm.ecef_ecef_vel);
   /* add a gaussian noise */
-  double_vect3_add_gaussian_noise(&cur_speed_reading, &gps->speed_noise_std_dev);
+  double_vect3_add_gaussian_noise(&gps->noise_stream, &cur_speed_reading, &gps->speed_noise_std_dev);
 
   /* store that for later and retrieve a previously stored data */
-  UpdateSensorLatency(time, &cur_speed_reading, &gps->speed_history, gps->speed_latency, &gps->ecef_vel);
+  UpdateSensorLatency(time, (double*)&cur_speed_reading, &gps->speed_history, gps->speed_latency, (double*)&gps->ecef_vel);
 
 
   /*
@@ -60,9 +70,9 @@ void nps_sensor_gps_run_step(struct NpsSensorGps* gps, double time) {
   struct DoubleVect3 pos_error;
   VECT3_COPY(pos_error, gps->pos_bias_initial);
   /* add a gaussian noise */
-  double_vect3_add_gaussian_noise(&pos_error, &gps->pos_noise_std_dev);
+  double_vect3_add_gaussian_noise(&gps->noise_stream, &pos_error, &gps->pos_noise_std_dev);
   /* update random walk bias and add it to error*/
-  double_vect3_update_random_walk(&gps->pos_bias_random_walk_value, &gps->pos_bias_random_walk_std_dev, NPS_GPS_DT, 5.);
+  double_vect3_update_random_walk(&gps->noise_stream, &gps->pos_bias_random_walk_value, &gps->pos_bias_random_walk_std_dev, NPS_GPS_DT, 5.);
   VECT3_ADD(pos_error, gps->pos_bias_random_walk_value);
 
   /* add error to current pos reading */
@@ -71,7 +81,7 @@ void nps_sensor_gps_run_step(struct NpsSensorGps* gps, double time) {
   VECT3_ADD(cur_pos_reading, pos_error);
 
   /* store that for later and retrieve a previously stored data */
-  UpdateSensorLatency(time, &cur_pos_reading, &gps->pos_history, gps->pos_latency, &gps->ecef_pos);
+  UpdateSensorLatency(time, (double*)&cur_pos_reading, &gps->pos_history, gps->pos_latency, (double*)&gps->ecef_pos);
 
 
   /*
@@ -82,10 +92,10 @@ void nps_sensor_gps_run_step(struct NpsSensorGps* gps, double time) {
   lla_of_ecef_d(&cur_lla_reading, (EcefCoor_d*) &cur_pos_reading);
 
   /* store that for later and retrieve a previously stored data */
-  UpdateSensorLatency(time, &cur_lla_reading, &gps->lla_history, gps->pos_latency, &gps->lla_pos);
+  UpdateSensorLatency(time, (double*)&cur_lla_reading, &gps->lla_history, gps->pos_latency, (double*)&gps->lla_pos);
 
   double cur_hmsl_reading = fdm.hmsl;
-  UpdateSensorLatency_Single(time, &cur_hmsl_reading, &gps->hmsl_history, gps->pos_latency, &gps->hmsl);
+  UpdateSensorLatency(time, &cur_hmsl_reading, &gps->hmsl_history, gps->pos_latency, &gps->hmsl);
 
   gps->next_update += NPS_GPS_DT;
   gps->data_available = TRUE;
@@ -22,6 +22,7 @@ void  nps_sensor_gyro_init(struct NpsSensorGyro* gyro, double time) {
 	       NPS_GYRO_BIAS_RANDOM_WALK_STD_DEV_Q,
 	       NPS_GYRO_BIAS_RANDOM_WALK_STD_DEV_R);
   FLOAT_VECT3_ZERO(gyro->bias_random_walk_value);
+  nps_random_stream_init(&gyro->noise_stream, nps_random_get_seed(), NPS_RANDOM_STREAM_GYRO);
   gyro->next_update = time;
   gyro->data_available = FALSE;
 }
@@ -41,8 +42,8 @@ void nps_sensor_gyro_run_step(struct NpsSensorGyro* gyro, double time, struct Do
   /* compute gyro error readings */
   struct DoubleVect3 gyro_error;
   VECT3_COPY(gyro_error, gyro->bias_initial);
-  double_vect3_add_gaussian_noise(&gyro_error, &gyro->noise_std_dev);
-  double_vect3_update_random_walk(&gyro->bias_random_walk_value, &gyro->bias_random_walk_std_dev,
+  double_vect3_add_gaussian_noise(&gyro->noise_stream, &gyro_error, &gyro->noise_std_dev);
+  double_vect3_update_random_walk(&gyro->noise_stream, &gyro->bias_random_walk_value, &gyro->bias_random_walk_std_dev,
 				  NPS_GYRO_DT, 5.);
   VECT3_ADD(gyro_error, gyro->bias_random_walk_value);
 
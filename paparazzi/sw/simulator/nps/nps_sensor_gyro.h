@@ -5,6 +5,7 @@
 #include "math/pprz_algebra_double.h"
 #include "math/pprz_algebra_float.h"
 #include "std.h"
+#include "nps_random.h"
 
 struct NpsSensorGyro {
   struct DoubleVect3  value;
@@ -15,6 +16,7 @@ struct NpsSensorGyro {
   struct DoubleVect3  bias_initial;
   struct DoubleVect3  bias_random_walk_std_dev;
   struct DoubleVect3  bias_random_walk_value;
+  struct NpsRandomStream noise_stream;
   double       next_update;
   bool_t       data_available;
 };
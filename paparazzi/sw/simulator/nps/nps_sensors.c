@@ -1,4 +1,5 @@
 #include "nps_sensors.h"
+#include "nps_profiler.h"
 
 #include "generated/airframe.h"
 #include NPS_SENSORS_PARAMS
@@ -20,12 +21,31 @@ void nps_sensors_init(double time) {
 }
 
 
+/* scale all the noise parameters read from NPS_SENSORS_PARAMS */
+void nps_sensors_scale_noise(double scale) {
+  VECT3_SMUL(sensors.gyro.noise_std_dev, sensors.gyro.noise_std_dev, scale);
+  VECT3_SMUL(sensors.gyro.bias_random_walk_std_dev, sensors.gyro.bias_random_walk_std_dev, scale);
+  VECT3_SMUL(sensors.accel.noise_std_dev, sensors.accel.noise_std_dev, scale);
+  VECT3_SMUL(sensors.mag.noise_std_dev, sensors.mag.noise_std_dev, scale);
+  sensors.baro.noise_std_dev *= scale;
+  VECT3_SMUL(sensors.gps.pos_noise_std_dev, sensors.gps.pos_noise_std_dev, scale);
+  VECT3_SMUL(sensors.gps.speed_noise_std_dev, sensors.gps.speed_noise_std_dev, scale);
+  VECT3_SMUL(sensors.gps.pos_bias_random_walk_std_dev, sensors.gps.pos_bias_random_walk_std_dev, scale);
+}
+
+
 void nps_sensors_run_step(double time) {
+  uint64_t t = nps_profiler_start();
   nps_sensor_gyro_run_step(&sensors.gyro, time, &sensors.body_to_imu_rmat);
+  t = nps_profiler_stop(NPS_PROF_GYRO, t);
   nps_sensor_accel_run_step(&sensors.accel, time, &sensors.body_to_imu_rmat);
+  t = nps_profiler_stop(NPS_PROF_ACCEL, t);
   nps_sensor_mag_run_step(&sensors.mag, time, &sensors.body_to_imu_rmat);
+  t = nps_profiler_stop(NPS_PROF_MAG, t);
   nps_sensor_baro_run_step(&sensors.baro, time);
+  t = nps_profiler_stop(NPS_PROF_BARO, t);
   nps_sensor_gps_run_step(&sensors.gps, time);
+  nps_profiler_stop(NPS_PROF_GPS, t);
 }
 
 
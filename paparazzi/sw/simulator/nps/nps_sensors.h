@@ -22,6 +22,7 @@ extern struct NpsSensors sensors;
 
 extern void nps_sensors_init(double time);
 extern void nps_sensors_run_step(double time);
+extern void nps_sensors_scale_noise(double scale);
 
 extern bool_t nps_sensors_gyro_available();
 extern bool_t nps_sensors_mag_available();
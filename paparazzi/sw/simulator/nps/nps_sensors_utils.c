@@ -1,47 +1,44 @@
 #include "nps_sensors_utils.h"
 
-//#include <string.h>
-#include "6dof.h"
-#include "math/pprz_algebra.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
-void UpdateSensorLatency(double time, gpointer cur_reading, GSList **history, double latency, gpointer sensor_reading) {
-  /* add new reading */
-  struct BoozDatedSensor* cur_read = g_new(struct BoozDatedSensor, 1);
-  cur_read->time = time;
-  cur_read->value = (struct DoubleVect3*) g_memdup(cur_reading, sizeof(struct DoubleVect3));
-  *history = g_slist_prepend(*history, cur_read);
-  /* remove old readings */
-  GSList* last =  g_slist_last(*history);
-  while (last && ((struct BoozDatedSensor*)last->data)->time < time - latency) {
-    *history = g_slist_remove_link(*history, last);
-	g_free(((struct BoozDatedSensor*)last->data)->value);
-	g_free((struct BoozDatedSensor*)last->data);
-    g_slist_free_1(last);
-    last = g_slist_last(*history);
-  }
-  /* update sensor        */
-  //g_memmove((gpointer)sensor_reading, (gpointer)((struct BoozDatedSensor*)last->data)->value, sizeof(struct DoubleVect3));
-  VECT3_COPY(*((struct DoubleVect3*)sensor_reading), *((struct BoozDatedSensor*)last->data)->value);
+void nps_sensor_history_init(struct NpsSensorHistory* h, unsigned int dim,
+                             double latency, double dt) {
+  /* all readings younger than latency, plus the current one */
+  h->size = (latency > 0. && dt > 0.) ? (unsigned int)ceil(latency / dt) + 2 : 2;
+  h->dim = dim;
+  h->time = (double*)calloc(h->size, sizeof(double));
+  h->value = (double*)calloc(h->size * dim, sizeof(double));
+  h->tail = 0;
+  h->len = 0;
 }
 
-void UpdateSensorLatency_Single(double time, gpointer cur_reading, GSList **history, double latency, gpointer sensor_reading) {
-  /* add new reading */
-  struct BoozDatedSensor_Single* cur_read = g_new(struct BoozDatedSensor_Single, 1);
-  cur_read->time = time;
-  cur_read->value = (double*) g_memdup(cur_reading, sizeof(double));
-  *history = g_slist_prepend(*history, cur_read);
-  /* remove old readings */
-  GSList* last =  g_slist_last(*history);
-  while (last && ((struct BoozDatedSensor_Single*)last->data)->time < time - latency) {
-    *history = g_slist_remove_link(*history, last);
-	g_free(((struct BoozDatedSensor_Single*)last->data)->value);
-	g_free((struct BoozDatedSensor_Single*)last->data);
-    g_slist_free_1(last);
-    last = g_slist_last(*history);
-  }
-
-  /* update sensor        */
-  //g_memmove((gpointer)sensor_reading, (gpointer)((struct BoozDatedSensor*)last->data)->value, sizeof(struct DoubleVect3));
-  *((double*)sensor_reading) = *(((struct BoozDatedSensor_Single*)last->data)->value);
+void nps_sensor_history_free(struct NpsSensorHistory* h) {
+  free(h->time);
+  free(h->value);
+  h->time = NULL;
+  h->value = NULL;
+  h->len = 0;
+}
 
+void UpdateSensorLatency(double time, const double* cur_reading, struct NpsSensorHistory* h,
+                         double latency, double* sensor_reading) {
+  /* add new reading, overwriting the oldest one if full */
+  if (h->len == h->size) {
+    h->tail = (h->tail + 1) % h->size;
+    h->len--;
+  }
+  unsigned int head = (h->tail + h->len) % h->size;
+  h->time[head] = time;
+  memcpy(&h->value[head * h->dim], cur_reading, h->dim * sizeof(double));
+  h->len++;
+  /* remove old readings, the new one is always kept */
+  while (h->len > 1 && h->time[h->tail] < time - latency) {
+    h->tail = (h->tail + 1) % h->size;
+    h->len--;
+  }
+  /* update sensor */
+  memcpy(sensor_reading, &h->value[h->tail * h->dim], h->dim * sizeof(double));
 }
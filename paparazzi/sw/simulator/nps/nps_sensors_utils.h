@@ -1,25 +1,29 @@
 #ifndef NPS_SENSORS_UTILS_H
 #define NPS_SENSORS_UTILS_H
 
-#include <glib.h>
-#include "math/pprz_algebra_double.h"
-
-struct BoozDatedSensor {
-  struct DoubleVect3* value;
-  double time;
-};
-
-struct BoozDatedSensor_Single {
+/*
+ * Dated history of a sensor reading, used to simulate latency.
+ * Circular buffer of dim doubles per sample, allocated once at init
+ * with room for latency/dt samples : no heap traffic while running.
+ */
+struct NpsSensorHistory {
+  double* time;
   double* value;
-  double time;
+  unsigned int dim;
+  unsigned int size;
+  unsigned int tail;   /* oldest sample */
+  unsigned int len;
 };
 
-/* cur_reading and sensor_reading must be of a type that can be cast to DoubleVect3* */
-extern void UpdateSensorLatency(double time, gpointer cur_reading, GSList **history,
-								double latency, gpointer sensor_reading);
+extern void nps_sensor_history_init(struct NpsSensorHistory* h, unsigned int dim,
+                                    double latency, double dt);
+
+/* release the buffers, h is then ready for a new init */
+extern void nps_sensor_history_free(struct NpsSensorHistory* h);
 
-/* ...and the same for single double values */
-extern void UpdateSensorLatency_Single(double time, gpointer cur_reading, GSList **history,
-								double latency, gpointer sensor_reading);
+/* cur_reading and sensor_reading are arrays of dim doubles
+   ( e.g. anything that can be cast from DoubleVect3* or LlaCoor_d* ) */
+extern void UpdateSensorLatency(double time, const double* cur_reading, struct NpsSensorHistory* history,
+                                double latency, double* sensor_reading);
 
 #endif /* NPS_SENSORS_UTILS_H */
@@ -0,0 +1,36 @@
+#include "nps_sim.h"
+
+#include "nps_fdm.h"
+#include "nps_sensors.h"
+#include "nps_autopilot.h"
+#include "nps_traffic.h"
+#include "nps_profiler.h"
+
+
+void nps_sim_init(double time, enum NpsRadioControlType rc_type, int rc_script, char* rc_dev) {
+
+  nps_fdm_init(NPS_SIM_DT);
+  nps_sensors_init(time);
+  nps_autopilot_init(rc_type, rc_script, rc_dev);
+
+}
+
+
+void nps_sim_run_step(double time, double* commands, bool_t traffic) {
+
+  uint64_t t_step = nps_profiler_start();
+
+  nps_fdm_run_step(commands);
+  nps_profiler_stop(NPS_PROF_FDM, t_step);
+
+  nps_sensors_run_step(time);
+
+  nps_autopilot_run_step(time);
+
+  if (traffic)
+    nps_traffic_publish(time);
+
+  nps_profiler_stop(NPS_PROF_STEP, t_step);
+  nps_profiler_poll();
+
+}
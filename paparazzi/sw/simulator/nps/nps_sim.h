@@ -0,0 +1,18 @@
+#ifndef NPS_SIM_H
+#define NPS_SIM_H
+
+/*
+ * One simulation step, shared by the NPS main loops (nps_main.c) and
+ * the lockstep library (nps_lockstep.c), so that both fly the same.
+ */
+
+#include "std.h"
+#include "nps_radio_control.h"
+
+#define NPS_SIM_DT (1./512.)
+
+extern void nps_sim_init(double time, enum NpsRadioControlType rc_type, int rc_script, char* rc_dev);
+/* advance the simulation of NPS_SIM_DT, flying the given actuator commands */
+extern void nps_sim_run_step(double time, double* commands, bool_t traffic);
+
+#endif /* NPS_SIM_H */
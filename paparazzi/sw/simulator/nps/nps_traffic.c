@@ -0,0 +1,99 @@
+#include "nps_traffic.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "generated/airframe.h"
+#include "nps_fdm.h"
+#include "math/pprz_algebra_float.h"
+
+static struct NpsTrafficSlot* nps_traffic_table = NULL;
+
+/* shared by all the processes of the host */
+static double host_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+bool_t nps_traffic_init(void) {
+  size_t size = NPS_TRAFFIC_NB_AC * sizeof(struct NpsTrafficSlot);
+  int fd = shm_open(NPS_TRAFFIC_SHM_NAME, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    perror("nps_traffic shm_open");
+    return FALSE;
+  }
+  /* a new segment is zero filled */
+  if (ftruncate(fd, size) < 0) {
+    perror("nps_traffic ftruncate");
+    close(fd);
+    return FALSE;
+  }
+  void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("nps_traffic mmap");
+    return FALSE;
+  }
+  nps_traffic_table = (struct NpsTrafficSlot*)p;
+  return TRUE;
+}
+
+void nps_traffic_publish(double time) {
+  if (!nps_traffic_table)
+    return;
+  struct NpsTrafficSlot* slot = &nps_traffic_table[AC_ID];
+  __sync_fetch_and_add(&slot->seq, 1);
+  slot->info.ac_id = AC_ID;
+  slot->info.time = time;
+  slot->info.host_time = host_time();
+  slot->info.ecef_pos = fdm.ecef_pos;
+  slot->info.ecef_vel = fdm.ecef_ecef_vel;
+  slot->info.ltp_to_body_quat = fdm.ltp_to_body_quat;
+  __sync_fetch_and_add(&slot->seq, 1);
+}
+
+bool_t nps_traffic_get(uint8_t ac_id, struct NpsTrafficInfo* info) {
+  if (!nps_traffic_table)
+    return FALSE;
+  struct NpsTrafficSlot* slot = &nps_traffic_table[ac_id];
+  unsigned int retries = 0;
+  uint32_t seq;
+  do {
+    /* a writer that died in the middle leaves seq odd for ever */
+    while ((seq = slot->seq) & 1)
+      if (++retries > NPS_TRAFFIC_MAX_RETRIES)
+        return FALSE;
+    __sync_synchronize();
+    *info = slot->info;
+    __sync_synchronize();
+  } while (seq != slot->seq && ++retries <= NPS_TRAFFIC_MAX_RETRIES);
+  if (seq != slot->seq || seq == 0)
+    return FALSE;
+  return host_time() - info->host_time < NPS_TRAFFIC_TIMEOUT;
+}
+
+bool_t nps_traffic_nearest(double time, double max_dt, uint8_t* ac_id, double* distance) {
+  if (!nps_traffic_table)
+    return FALSE;
+  bool_t found = FALSE;
+  struct NpsTrafficInfo info;
+  int i;
+  for (i = 0; i < NPS_TRAFFIC_NB_AC; i++) {
+    if (i == AC_ID || !nps_traffic_get(i, &info) || fabs(info.time - time) > max_dt)
+      continue;
+    struct DoubleVect3 d;
+    VECT3_DIFF(d, info.ecef_pos, fdm.ecef_pos);
+    double dist = sqrt(FLOAT_VECT3_NORM2(d));
+    if (!found || dist < *distance) {
+      *ac_id = i;
+      *distance = dist;
+      found = TRUE;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,49 @@
+#ifndef NPS_TRAFFIC_H
+#define NPS_TRAFFIC_H
+
+/*
+ * Traffic picture shared in memory by all the NPS processes of a host.
+ *
+ * The airborne code is global state, so each simulated aircraft still
+ * runs in its own process, but the true states are exchanged through
+ * a shared memory table indexed by AC_ID instead of going through Ivy.
+ * Each slot has a single writer and is protected by a sequence counter,
+ * readers never block the writer. A slot not updated for
+ * NPS_TRAFFIC_TIMEOUT seconds of host time belongs to an aircraft that
+ * stopped, or died while writing, and is ignored.
+ */
+
+#include <stdint.h>
+#include "std.h"
+#include "math/pprz_algebra_double.h"
+#include "math/pprz_geodetic_double.h"
+
+#define NPS_TRAFFIC_SHM_NAME "/nps_traffic"
+#define NPS_TRAFFIC_NB_AC    256
+#define NPS_TRAFFIC_TIMEOUT  1.
+/* reads of a slot being written before giving up */
+#define NPS_TRAFFIC_MAX_RETRIES 1000
+
+struct NpsTrafficInfo {
+  uint8_t ac_id;
+  double  time;          /* simulated time of the state */
+  double  host_time;     /* CLOCK_MONOTONIC time of the update */
+  struct EcefCoor_d ecef_pos;
+  struct EcefCoor_d ecef_vel;
+  struct DoubleQuat ltp_to_body_quat;
+};
+
+struct NpsTrafficSlot {
+  volatile uint32_t seq;     /* odd while being written, 0 if never written */
+  struct NpsTrafficInfo info;
+};
+
+extern bool_t nps_traffic_init(void);
+/* publish our own true state in slot AC_ID */
+extern void   nps_traffic_publish(double time);
+/* copy the latest state of ac_id, FALSE if unknown, stale or still being written */
+extern bool_t nps_traffic_get(uint8_t ac_id, struct NpsTrafficInfo* info);
+/* nearest other live aircraft whose state is at most max_dt apart from time */
+extern bool_t nps_traffic_nearest(double time, double max_dt, uint8_t* ac_id, double* distance);
+
+#endif /* NPS_TRAFFIC_H */
@@ -63,10 +63,18 @@ struct BoozFlightModel bfm;
 
 //static void motor_model_derivative(VEC* x, VEC* u, VEC* xdot);
 
+/*
+   The state, its derivatives and all intermediate quantities are kept
+   in fixed size arrays and pprz_algebra structs : nothing is allocated
+   or resized while integrating. Meschach VEC/MAT are only used for the
+   byproducts exported to the sensors models.
+*/
 static void booz_flight_model_update_byproducts(void);
-static VEC* booz_get_forces_ltp(VEC* F , VEC* speed_ltp, MAT* dcm_t, VEC* omega_square);
-static VEC* booz_get_moments_body_frame(VEC* M, VEC* omega_square );
-static void booz_flight_model_get_derivatives(VEC* X, VEC* u, VEC* Xdot);
+static inline void booz_get_forces_ltp(struct DoubleVect3* F, const struct DoubleVect3* speed_ltp,
+                                       const struct DoubleRMat* dcm, const double* omega_square);
+static inline void booz_get_moments_body_frame(struct DoubleVect3* M, const double* omega_square);
+static void booz_flight_model_get_derivatives(const double* X, const double* u, double* Xdot);
+static void booz_flight_model_rk4(double* X, const double* u, double dt);
 
 void booz_flight_model_init( void ) {
   bfm.on_ground = TRUE;
@@ -91,7 +99,7 @@ void booz_flight_model_init( void ) {
 
   bfm.dcm =  m_get(AXIS_NB, AXIS_NB);
   bfm.dcm_t =  m_get(AXIS_NB, AXIS_NB);
-  bfm.quat = v_get(AXIS_NB);
+  bfm.quat = v_get(4);
 
   bfm.omega = v_get(SERVOS_NB);
   bfm.omega_square = v_get(SERVOS_NB);
@@ -112,30 +120,23 @@ void booz_flight_model_init( void ) {
   bfm.thrust_factor = 0.5 * RHO * PROP_AREA * C_t * PROP_RADIUS * PROP_RADIUS;
   bfm.torque_factor = 0.5 * RHO * PROP_AREA * C_q * PROP_RADIUS * PROP_RADIUS;
 
-  bfm.props_moment_matrix = m_get(AXIS_NB, SERVOS_NB);
-  m_zero(bfm.props_moment_matrix);
-  bfm.props_moment_matrix->me[AXIS_X][SERVO_LEFT]  =  L * bfm.thrust_factor;
-  bfm.props_moment_matrix->me[AXIS_X][SERVO_RIGHT] = -L * bfm.thrust_factor;
-  bfm.props_moment_matrix->me[AXIS_Y][SERVO_BACK]  = -L * bfm.thrust_factor;
-  bfm.props_moment_matrix->me[AXIS_Y][SERVO_FRONT] =  L * bfm.thrust_factor;
-  bfm.props_moment_matrix->me[AXIS_Z][SERVO_LEFT]  =  bfm.torque_factor;
-  bfm.props_moment_matrix->me[AXIS_Z][SERVO_RIGHT] =  bfm.torque_factor;
-  bfm.props_moment_matrix->me[AXIS_Z][SERVO_BACK]  =  -bfm.torque_factor;
-  bfm.props_moment_matrix->me[AXIS_Z][SERVO_FRONT] =  -bfm.torque_factor;
+  int i, j;
+  for (i=0; i<AXIS_NB; i++)
+    for (j=0; j<SERVOS_NB; j++)
+      bfm.props_moment_matrix[i][j] = 0.;
+  bfm.props_moment_matrix[AXIS_X][SERVO_LEFT]  =  L * bfm.thrust_factor;
+  bfm.props_moment_matrix[AXIS_X][SERVO_RIGHT] = -L * bfm.thrust_factor;
+  bfm.props_moment_matrix[AXIS_Y][SERVO_BACK]  = -L * bfm.thrust_factor;
+  bfm.props_moment_matrix[AXIS_Y][SERVO_FRONT] =  L * bfm.thrust_factor;
+  bfm.props_moment_matrix[AXIS_Z][SERVO_LEFT]  =  bfm.torque_factor;
+  bfm.props_moment_matrix[AXIS_Z][SERVO_RIGHT] =  bfm.torque_factor;
+  bfm.props_moment_matrix[AXIS_Z][SERVO_BACK]  =  -bfm.torque_factor;
+  bfm.props_moment_matrix[AXIS_Z][SERVO_FRONT] =  -bfm.torque_factor;
 
   bfm.mass = MASS;
 
-  bfm.Inert = m_get(AXIS_NB, AXIS_NB);
-  m_zero(bfm.Inert);
-  bfm.Inert->me[AXIS_X][AXIS_X] = Ix;
-  bfm.Inert->me[AXIS_Y][AXIS_Y] = Iy;
-  bfm.Inert->me[AXIS_Z][AXIS_Z] = Iz;
-
-  bfm.Inert_inv = m_get(AXIS_NB, AXIS_NB);
-  m_zero(bfm.Inert_inv);
-  bfm.Inert_inv->me[AXIS_X][AXIS_X] = 1./Ix;
-  bfm.Inert_inv->me[AXIS_Y][AXIS_Y] = 1./Iy;
-  bfm.Inert_inv->me[AXIS_Z][AXIS_Z] = 1./Iz;
+  FLOAT_MAT33_DIAG(bfm.Inert, Ix, Iy, Iz);
+  FLOAT_MAT33_DIAG(bfm.Inert_inv, 1./Ix, 1./Iy, 1./Iz);
 
 }
 
@@ -149,7 +150,7 @@ void booz_flight_model_run( double dt, double* commands ) {
   for (i=0; i<SERVOS_NB; i++)
     bfm.mot_voltage->ve[i] = bfm.bat_voltage * commands[i];
   //  rk4(motor_model_derivative, bfm.mot_omega, bfm.mot_voltage, dt);
-  rk4(booz_flight_model_get_derivatives, bfm.state, bfm.mot_voltage, dt);
+  booz_flight_model_rk4(bfm.state->ve, bfm.mot_voltage->ve, dt);
   /* wrap euler angles */
   WRAP( bfm.state->ve[BFMS_PHI], M_PI);
   WRAP( bfm.state->ve[BFMS_THETA], M_PI_2);
@@ -159,6 +160,37 @@ void booz_flight_model_run( double dt, double* commands ) {
 }
 
 
+/*
+   classical fourth order Runge-Kutta on the fixed size state.
+   Same sequence of operations as rk4() in booz_flight_model_utils.c
+*/
+static void booz_flight_model_rk4(double* X, const double* u, double dt) {
+
+  double v1[BFMS_SIZE], v2[BFMS_SIZE], v3[BFMS_SIZE], v4[BFMS_SIZE];
+  double temp[BFMS_SIZE];
+  int i;
+
+  booz_flight_model_get_derivatives(X, u, v1);
+  for (i=0; i<BFMS_SIZE; i++)
+    temp[i] = X[i] + 0.5*dt * v1[i];
+  booz_flight_model_get_derivatives(temp, u, v2);
+  for (i=0; i<BFMS_SIZE; i++)
+    temp[i] = X[i] + 0.5*dt * v2[i];
+  booz_flight_model_get_derivatives(temp, u, v3);
+  for (i=0; i<BFMS_SIZE; i++)
+    temp[i] = X[i] + dt * v3[i];
+  booz_flight_model_get_derivatives(temp, u, v4);
+
+  for (i=0; i<BFMS_SIZE; i++) {
+    temp[i] = v1[i] + 2.0 * v2[i];
+    temp[i] = temp[i] + 2.0 * v3[i];
+    temp[i] = temp[i] + v4[i];
+    X[i] = X[i] + dt/6.0 * temp[i];
+  }
+
+}
+
+
 static void booz_flight_model_update_byproducts(void) {
 
   /* extract eulers angles from state */
@@ -181,10 +213,16 @@ static void booz_flight_model_update_byproducts(void) {
   /* compute square */
   v_star(bfm.omega, bfm.omega, bfm.omega_square);
   /* compute ltp accelerations */
-  static VEC *f_ltp = VNULL;
-  f_ltp = v_resize(f_ltp, AXIS_NB);
-  f_ltp = booz_get_forces_ltp(f_ltp , bfm.speed_ltp, bfm.dcm_t, bfm.omega_square);
-  sv_mlt( 1./bfm.mass, f_ltp, bfm.accel_ltp);
+  const double* X = bfm.state->ve;
+  struct DoubleEulers eulers = { X[BFMS_PHI], X[BFMS_THETA], X[BFMS_PSI] };
+  struct DoubleRMat dcm;
+  DOUBLE_RMAT_OF_EULERS(dcm, eulers);
+  struct DoubleVect3 speed_ltp = { X[BFMS_XD], X[BFMS_YD], X[BFMS_ZD] };
+  struct DoubleVect3 f_ltp;
+  booz_get_forces_ltp(&f_ltp, &speed_ltp, &dcm, bfm.omega_square->ve);
+  bfm.accel_ltp->ve[AXIS_X] = 1./bfm.mass * f_ltp.x;
+  bfm.accel_ltp->ve[AXIS_Y] = 1./bfm.mass * f_ltp.y;
+  bfm.accel_ltp->ve[AXIS_Z] = 1./bfm.mass * f_ltp.z;
   /* rotate speed and accel to body frame */
   mv_mlt(bfm.dcm, bfm.speed_ltp, bfm.speed_body);
   mv_mlt(bfm.dcm, bfm.accel_ltp, bfm.accel_body);
@@ -201,143 +239,127 @@ static void booz_flight_model_update_byproducts(void) {
    compute the sum of external forces.
    assumes that dcm and omega_square are already precomputed from X
 */
-static VEC* booz_get_forces_ltp(VEC* F , VEC* speed_ltp, MAT* dcm_t, VEC* omega_square) {
+static inline void booz_get_forces_ltp(struct DoubleVect3* F, const struct DoubleVect3* speed_ltp,
+                                       const struct DoubleRMat* dcm, const double* omega_square) {
 
   // FIXME : nimporte koi !
-  F = v_zero(F);
+  FLOAT_VECT3_ZERO(*F);
   if (!bfm.on_ground) {
 
     // propeller thrust
-    static VEC *prop_thrust_body = VNULL;
-    prop_thrust_body = v_resize(prop_thrust_body, AXIS_NB);
-    prop_thrust_body->ve[AXIS_X] = 0;
-    prop_thrust_body->ve[AXIS_Y] = 0;
-    prop_thrust_body->ve[AXIS_Z] = -v_sum(omega_square) * bfm.thrust_factor;
-    static VEC *prop_thrust_ltp = VNULL;
-    prop_thrust_ltp = v_resize(prop_thrust_ltp, AXIS_NB);
-    prop_thrust_ltp = mv_mlt(dcm_t, prop_thrust_body, prop_thrust_ltp);
-    F = v_add(F, prop_thrust_ltp, F);
+    double sum_omega_square = 0.;
+    int i;
+    for (i=0; i<SERVOS_NB; i++)
+      sum_omega_square += omega_square[i];
+    struct DoubleVect3 prop_thrust_body = { 0., 0., -sum_omega_square * bfm.thrust_factor };
+    struct DoubleVect3 prop_thrust_ltp;
+    MAT33_VECT3_TRANSP_MUL(prop_thrust_ltp, *dcm, prop_thrust_body);
+    VECT3_ADD(*F, prop_thrust_ltp);
 
     // gravity
-    F = v_mltadd(F, bfm.g_ltp, bfm.mass, F);
+    F->x += bfm.mass * bfm.g_ltp->ve[AXIS_X];
+    F->y += bfm.mass * bfm.g_ltp->ve[AXIS_Y];
+    F->z += bfm.mass * bfm.g_ltp->ve[AXIS_Z];
 
     // drag
-    static VEC *airspeed_ltp = VNULL;
-    airspeed_ltp = v_resize(airspeed_ltp, AXIS_NB);
-    airspeed_ltp = v_sub(speed_ltp, bwm.velocity, airspeed_ltp);
-    double norm_speed = v_norm2(airspeed_ltp);
-    F = v_mltadd(F, airspeed_ltp, -norm_speed * C_d_body, F);
+    struct DoubleVect3 airspeed_ltp = { speed_ltp->x - bwm.velocity->ve[AXIS_X],
+                                        speed_ltp->y - bwm.velocity->ve[AXIS_Y],
+                                        speed_ltp->z - bwm.velocity->ve[AXIS_Z] };
+    double norm_speed = sqrt(FLOAT_VECT3_NORM2(airspeed_ltp));
+    F->x += -norm_speed * C_d_body * airspeed_ltp.x;
+    F->y += -norm_speed * C_d_body * airspeed_ltp.y;
+    F->z += -norm_speed * C_d_body * airspeed_ltp.z;
 
   }
-  return F;
 }
 
 /*
    compute the sum of external moments.
    assumes that omega_square is already precomputed from X
 */
-static VEC* booz_get_moments_body_frame(VEC* M, VEC* omega_square ) {
-  if (bfm.on_ground) {
-    M = v_zero(M);
-  }
-  else {
-    M =  mv_mlt(bfm.props_moment_matrix, omega_square, M);
+static inline void booz_get_moments_body_frame(struct DoubleVect3* M, const double* omega_square) {
+  FLOAT_VECT3_ZERO(*M);
+  if (!bfm.on_ground) {
+    int j;
+    for (j=0; j<SERVOS_NB; j++) {
+      M->x += bfm.props_moment_matrix[AXIS_X][j] * omega_square[j];
+      M->y += bfm.props_moment_matrix[AXIS_Y][j] * omega_square[j];
+      M->z += bfm.props_moment_matrix[AXIS_Z][j] * omega_square[j];
+    }
   }
-  return M;
 }
 
-static void booz_flight_model_get_derivatives(VEC* X, VEC* u, VEC* Xdot) {
+static void booz_flight_model_get_derivatives(const double* X, const double* u, double* Xdot) {
 
+  /* FIXME : apart from the motors, the derivatives are evaluated on  */
+  /* bfm.state and not on X, so the intermediate rk4 stages only act  */
+  /* on the motors. Kept as is so that trajectories are unchanged.    */
+  const double* S = bfm.state->ve;
   /* square of prop rotational speeds */
-  static VEC *omega_square = VNULL;
-  omega_square = v_resize(omega_square,SERVOS_NB);
-  BoozFlighModelGetRPMS(omega_square);
-  omega_square = v_star(omega_square, omega_square, omega_square);
+  double omega_square[SERVOS_NB];
+  omega_square[SERVO_BACK]  = S[BFMS_OM_B] * S[BFMS_OM_B];
+  omega_square[SERVO_FRONT] = S[BFMS_OM_F] * S[BFMS_OM_F];
+  omega_square[SERVO_RIGHT] = S[BFMS_OM_R] * S[BFMS_OM_R];
+  omega_square[SERVO_LEFT]  = S[BFMS_OM_L] * S[BFMS_OM_L];
   /* extract eulers angles from state */
-  static VEC *eulers = VNULL;
-  eulers = v_resize(eulers, AXIS_NB);
-  BoozFlighModelGetAngles(eulers);
+  struct DoubleEulers eulers = { S[BFMS_PHI], S[BFMS_THETA], S[BFMS_PSI] };
   /* direct cosine matrix ( inertial to body )*/
-  static MAT *dcm = MNULL;
-  dcm = m_resize(dcm,AXIS_NB, AXIS_NB);
-  dcm = dcm_of_eulers(eulers, dcm);
-  /* transpose of dcm ( body to inertial ) */
-  static MAT *dcm_t = MNULL;
-  dcm_t = m_resize(dcm_t,AXIS_NB, AXIS_NB);
-  dcm_t = m_transp(dcm, dcm_t);
+  struct DoubleRMat dcm;
+  DOUBLE_RMAT_OF_EULERS(dcm, eulers);
   /* extract ltp_speeds_from state */
-  static VEC *speed_ltp = VNULL;
-  speed_ltp = v_resize(speed_ltp, AXIS_NB);
-  BoozFlighModelGetSpeedLtp(speed_ltp);
+  struct DoubleVect3 speed_ltp = { S[BFMS_XD], S[BFMS_YD], S[BFMS_ZD] };
   /* extracts body rates from state */
-  static VEC *rate_body = VNULL;
-  rate_body = v_resize(rate_body, AXIS_NB);
-  BoozFlighModelGetRate(rate_body);
+  struct DoubleVect3 rate_body = { S[BFMS_P], S[BFMS_Q], S[BFMS_R] };
 
   /* derivatives of position */
-  Xdot->ve[BFMS_X] = speed_ltp->ve[AXIS_X];
-  Xdot->ve[BFMS_Y] = speed_ltp->ve[AXIS_Y];
-  Xdot->ve[BFMS_Z] = speed_ltp->ve[AXIS_Z];
+  Xdot[BFMS_X] = speed_ltp.x;
+  Xdot[BFMS_Y] = speed_ltp.y;
+  Xdot[BFMS_Z] = speed_ltp.z;
 
   /* derivatives of speed           */
-  static VEC *f_ltp = VNULL;
-  f_ltp = v_resize(f_ltp, AXIS_NB);
-  f_ltp = booz_get_forces_ltp(f_ltp , speed_ltp, dcm_t, omega_square);
-  Xdot->ve[BFMS_XD] = 1./bfm.mass * f_ltp->ve[AXIS_X];
-  Xdot->ve[BFMS_YD] = 1./bfm.mass * f_ltp->ve[AXIS_Y];
-  Xdot->ve[BFMS_ZD] = 1./bfm.mass * f_ltp->ve[AXIS_Z];
+  struct DoubleVect3 f_ltp;
+  booz_get_forces_ltp(&f_ltp, &speed_ltp, &dcm, omega_square);
+  Xdot[BFMS_XD] = 1./bfm.mass * f_ltp.x;
+  Xdot[BFMS_YD] = 1./bfm.mass * f_ltp.y;
+  Xdot[BFMS_ZD] = 1./bfm.mass * f_ltp.z;
 
   /* derivatives of eulers   */
-  double sinPHI   = sin(eulers->ve[EULER_PHI]);
-  double cosPHI   = cos(eulers->ve[EULER_PHI]);
-  double cosTHETA = cos(eulers->ve[EULER_THETA]);
-  double tanTHETA = tan(eulers->ve[EULER_THETA]);
-  static MAT *euler_dot_of_pqr = MNULL;
-  euler_dot_of_pqr = m_resize(euler_dot_of_pqr,AXIS_NB, AXIS_NB);
-  euler_dot_of_pqr->me[EULER_PHI][AXIS_P] = 1.;
-  euler_dot_of_pqr->me[EULER_PHI][AXIS_Q] = sinPHI*tanTHETA;
-  euler_dot_of_pqr->me[EULER_PHI][AXIS_R] = cosPHI*tanTHETA;
-  euler_dot_of_pqr->me[EULER_THETA][AXIS_P] = 0.;
-  euler_dot_of_pqr->me[EULER_THETA][AXIS_Q] = cosPHI;
-  euler_dot_of_pqr->me[EULER_THETA][AXIS_R] = -sinPHI;
-  euler_dot_of_pqr->me[EULER_PSI][AXIS_P] = 0.;
-  euler_dot_of_pqr->me[EULER_PSI][AXIS_Q] = sinPHI/cosTHETA;
-  euler_dot_of_pqr->me[EULER_PSI][AXIS_R] = cosPHI/cosTHETA;
-  static VEC *euler_dot = VNULL;
-  euler_dot = v_resize(euler_dot, AXIS_NB);
-  euler_dot = mv_mlt(euler_dot_of_pqr, rate_body, euler_dot);
-  Xdot->ve[BFMS_PHI] = euler_dot->ve[EULER_PHI];
-  Xdot->ve[BFMS_THETA] = euler_dot->ve[EULER_THETA];
-  Xdot->ve[BFMS_PSI] = euler_dot->ve[EULER_PSI];
+  double sinPHI   = sin(eulers.phi);
+  double cosPHI   = cos(eulers.phi);
+  double cosTHETA = cos(eulers.theta);
+  double tanTHETA = tan(eulers.theta);
+  struct DoubleMat33 euler_dot_of_pqr = {{ 1., sinPHI*tanTHETA, cosPHI*tanTHETA,
+                                           0., cosPHI,          -sinPHI,
+                                           0., sinPHI/cosTHETA, cosPHI/cosTHETA }};
+  struct DoubleVect3 euler_dot;
+  MAT33_VECT3_MUL(euler_dot, euler_dot_of_pqr, rate_body);
+  Xdot[BFMS_PHI]   = euler_dot.x;
+  Xdot[BFMS_THETA] = euler_dot.y;
+  Xdot[BFMS_PSI]   = euler_dot.z;
 
   /* derivatives of rates    */
   /* compute external moments */
-  static VEC *m_body = VNULL;
-  m_body = v_resize(m_body, AXIS_NB);
-  m_body = booz_get_moments_body_frame(m_body, omega_square);
+  struct DoubleVect3 m_body;
+  booz_get_moments_body_frame(&m_body, omega_square);
   /* Newton in body frame    */
-  static VEC *i_omega = VNULL;
-  i_omega = v_resize(i_omega, AXIS_NB);
-  i_omega = mv_mlt(bfm.Inert, rate_body, i_omega);
-  static VEC *omega_i_omega = VNULL;
-  omega_i_omega = v_resize(omega_i_omega, AXIS_NB);
-  omega_i_omega = out_prod(rate_body, i_omega, omega_i_omega);
-  static VEC *m_tot = VNULL;
-  m_tot = v_resize(m_tot, AXIS_NB);
-  m_tot = v_sub(m_body, omega_i_omega, m_tot);
-  static VEC *I_inv_m_tot = VNULL;
-  I_inv_m_tot = v_resize(I_inv_m_tot, AXIS_NB);
-  I_inv_m_tot = mv_mlt(bfm.Inert_inv, m_tot, I_inv_m_tot);
-  Xdot->ve[BFMS_P] = I_inv_m_tot->ve[AXIS_P];
-  Xdot->ve[BFMS_Q] = I_inv_m_tot->ve[AXIS_Q];
-  Xdot->ve[BFMS_R] = I_inv_m_tot->ve[AXIS_R];
+  struct DoubleVect3 i_omega;
+  MAT33_VECT3_MUL(i_omega, bfm.Inert, rate_body);
+  struct DoubleVect3 omega_i_omega;
+  DOUBLE_VECT3_CROSS_PRODUCT(omega_i_omega, rate_body, i_omega);
+  struct DoubleVect3 m_tot;
+  VECT3_DIFF(m_tot, m_body, omega_i_omega);
+  struct DoubleVect3 I_inv_m_tot;
+  MAT33_VECT3_MUL(I_inv_m_tot, bfm.Inert_inv, m_tot);
+  Xdot[BFMS_P] = I_inv_m_tot.x;
+  Xdot[BFMS_Q] = I_inv_m_tot.y;
+  Xdot[BFMS_R] = I_inv_m_tot.z;
 
   /* derivatives of motors rpm */
   /* omega_dot = -1/THAU*omega - Kq*omega^2 + Kv/THAU * V */
-  Xdot->ve[BFMS_OM_B] = -1./THAU * X->ve[BFMS_OM_B] - Kq * omega_square->ve[SERVO_BACK] + Kv/THAU * u->ve[SERVO_BACK];
-  Xdot->ve[BFMS_OM_F] = -1./THAU * X->ve[BFMS_OM_F] - Kq * omega_square->ve[SERVO_FRONT] + Kv/THAU * u->ve[SERVO_FRONT];
-  Xdot->ve[BFMS_OM_R] = -1./THAU * X->ve[BFMS_OM_R] - Kq * omega_square->ve[SERVO_RIGHT] + Kv/THAU * u->ve[SERVO_RIGHT];
-  Xdot->ve[BFMS_OM_L] = -1./THAU * X->ve[BFMS_OM_L] - Kq * omega_square->ve[SERVO_LEFT] + Kv/THAU * u->ve[SERVO_LEFT];
+  Xdot[BFMS_OM_B] = -1./THAU * X[BFMS_OM_B] - Kq * omega_square[SERVO_BACK] + Kv/THAU * u[SERVO_BACK];
+  Xdot[BFMS_OM_F] = -1./THAU * X[BFMS_OM_F] - Kq * omega_square[SERVO_FRONT] + Kv/THAU * u[SERVO_FRONT];
+  Xdot[BFMS_OM_R] = -1./THAU * X[BFMS_OM_R] - Kq * omega_square[SERVO_RIGHT] + Kv/THAU * u[SERVO_RIGHT];
+  Xdot[BFMS_OM_L] = -1./THAU * X[BFMS_OM_L] - Kq * omega_square[SERVO_LEFT] + Kv/THAU * u[SERVO_LEFT];
 
 }
 
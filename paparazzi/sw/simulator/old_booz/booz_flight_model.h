@@ -3,6 +3,7 @@
 
 #include <matrix.h>
 #include "generated/airframe.h"
+#include "pprz_algebra_double.h"
 
 
 
@@ -47,13 +48,13 @@ struct BoozFlightModel {
   /* propeller torque factor    */
   double torque_factor;
   /* Matrix used to compute the moments produced by props */
-  MAT* props_moment_matrix;
+  double props_moment_matrix[3][SERVOS_NB];
   /* */
   double mass;
   /* inertia matrix             */
-  MAT* Inert;
+  struct DoubleMat33 Inert;
   /* invert of inertia matrix             */
-  MAT* Inert_inv;
+  struct DoubleMat33 Inert_inv;
 };
 
 extern struct BoozFlightModel bfm;
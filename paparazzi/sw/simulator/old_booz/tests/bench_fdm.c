@@ -0,0 +1,43 @@
+/*
+ * Flight model throughput benchmark
+ *
+ * Runs the flight model for a fixed number of steps and reports
+ * wall time per step and simulated seconds per wall second.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "std.h"
+#include "booz_flight_model.h"
+#include "booz_wind_model.h"
+
+#define DT_FDM  (1./250.)
+
+int main(int argc, char** argv) {
+
+  int nb_iter = argc > 1 ? atoi(argv[1]) : 1000000;
+  double commands[SERVOS_NB];
+  int i;
+  for (i=0; i<SERVOS_NB; i++)
+    commands[i] = 0.6;
+
+  booz_wind_model_init();
+  booz_flight_model_init();
+  bfm.on_ground = FALSE;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i=0; i<nb_iter; i++)
+    booz_flight_model_run(DT_FDM, commands);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+  printf("%d steps in %.3f s : %.1f ns/step, %.0f sim-s per wall-s (z=%f)\n",
+         nb_iter, elapsed, 1e9 * elapsed / nb_iter, nb_iter * DT_FDM / elapsed,
+         bfm.state->ve[2]);
+  return 0;
+}
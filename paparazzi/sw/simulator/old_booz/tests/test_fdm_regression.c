@@ -0,0 +1,105 @@
+/*
+ * Flight model regression test
+ *
+ * Flies a fixed command sequence and compares the state trajectory
+ * against a reference recorded with the meschach based flight model.
+ *
+ *   test_fdm_regression             prints the trajectory
+ *   test_fdm_regression file.ref    compares against file.ref
+ *
+ * test_fdm_regression.ref was not recorded against the real meschach
+ * library but against a minimal stand-in of the routines the old model
+ * used.  Meschach may round differently (unrolled inner products, fused
+ * multiply-adds), so the comparison is on a relative tolerance, not bit
+ * for bit: recompiling the old model with FMAs moves the trajectory by
+ * about 5e-14, changing the body drag coefficient by 1e-6 moves it by
+ * about 6e-8.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#include "std.h"
+#include "booz_flight_model.h"
+#include "booz_wind_model.h"
+#include "6dof.h"
+
+#define DT_FDM     (1./250.)
+#define NB_ITER    1250
+#define LOG_DECIM  25
+/* relative, on every state component */
+#define TOLERANCE  1e-9
+
+/* indexed by servo name so that the result does not depend on the airframe ordering */
+static void get_commands(int iter, double* commands) {
+  double t = iter * DT_FDM;
+  commands[SERVO_FRONT] = 0.6 + 0.05 * sin(2. * M_PI * 0.5 * t);
+  commands[SERVO_BACK]  = 0.6 + 0.05 * sin(2. * M_PI * 0.8 * t);
+  commands[SERVO_RIGHT] = 0.6 + 0.05 * sin(2. * M_PI * 1.1 * t);
+  commands[SERVO_LEFT]  = 0.6 + 0.05 * sin(2. * M_PI * 1.4 * t);
+}
+
+int main(int argc, char** argv) {
+
+  FILE* ref = NULL;
+  if (argc > 1) {
+    ref = fopen(argv[1], "r");
+    if (!ref) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  booz_wind_model_init();
+  bwm.velocity->ve[AXIS_X] = 0.5;
+  bwm.velocity->ve[AXIS_Y] = -0.3;
+  bwm.velocity->ve[AXIS_Z] = 0.;
+  booz_flight_model_init();
+  bfm.on_ground = FALSE;
+
+  double commands[SERVOS_NB];
+  double max_err = 0.;
+  int nb_cmp = 0;
+  int i;
+  for (i=1; i<=NB_ITER; i++) {
+    get_commands(i, commands);
+    booz_flight_model_run(DT_FDM, commands);
+    if (i % LOG_DECIM)
+      continue;
+    unsigned j;
+    if (!ref) {
+      printf("%.17g", bfm.time);
+      for (j=0; j<bfm.state->dim; j++)
+        printf(" %.17g", bfm.state->ve[j]);
+      printf("\n");
+      continue;
+    }
+    double t;
+    if (fscanf(ref, "%lf", &t) != 1) {
+      fprintf(stderr, "reference too short at t=%f\n", bfm.time);
+      return 1;
+    }
+    for (j=0; j<bfm.state->dim; j++) {
+      double expected;
+      if (fscanf(ref, "%lf", &expected) != 1) {
+        fprintf(stderr, "reference too short at t=%f\n", bfm.time);
+        return 1;
+      }
+      double err = fabs(bfm.state->ve[j] - expected) / (1. + fabs(expected));
+      if (err > max_err)
+        max_err = err;
+      if (err > TOLERANCE) {
+        fprintf(stderr, "t=%f state[%u] %.17g expected %.17g\n",
+                bfm.time, j, bfm.state->ve[j], expected);
+        return 1;
+      }
+      nb_cmp++;
+    }
+  }
+
+  if (ref) {
+    fclose(ref);
+    printf("%d values compared, max relative error %g\n", nb_cmp, max_err);
+  }
+  return 0;
+}